@@ -83,6 +83,7 @@ cdef extern from "consus.h":
     const char* consus_error_location(consus_client* client)
     const char* consus_returncode_to_string(consus_returncode)
     int64_t consus_begin_transaction(consus_client* client, consus_returncode* status, consus_transaction** xact)
+    int64_t consus_begin_buffered_transaction(consus_client* client, consus_returncode* status, consus_transaction** xact)
     int64_t consus_commit_transaction(consus_transaction* xact, consus_returncode* status)
     int64_t consus_abort_transaction(consus_transaction* xact, consus_returncode* status)
     int64_t consus_restart_transaction(consus_transaction* xact, consus_returncode* status)
@@ -98,6 +99,28 @@ cdef extern from "consus.h":
                        const char* key, size_t key_sz,
                        const char* value, size_t value_sz,
                        consus_returncode* status)
+    int64_t consus_get_binary(consus_transaction* xact,
+                              const char* table,
+                              const char* key, size_t key_sz,
+                              consus_returncode* status,
+                              char** value, size_t* value_sz)
+    int64_t consus_put_binary(consus_transaction* xact,
+                              const char* table,
+                              const char* key, size_t key_sz,
+                              const char* value, size_t value_sz,
+                              consus_returncode* status)
+    int64_t consus_multi_get(consus_transaction* xact,
+                             const char* table,
+                             const char* const* keys, const size_t* keys_sz,
+                             size_t num,
+                             consus_returncode* status,
+                             char** values, size_t* values_sz)
+    int64_t consus_multi_put(consus_transaction* xact,
+                             const char* table,
+                             const char* const* keys, const size_t* keys_sz,
+                             const char* const* values, const size_t* values_sz,
+                             size_t num,
+                             consus_returncode* status)
 
 cdef extern from "consus-unsafe.h":
 
@@ -188,6 +211,9 @@ cdef class Client:
     def begin_transaction(self):
         return Transaction(self)
 
+    def begin_buffered_transaction(self):
+        return Transaction(self, True)
+
     def unsafe_get(self, str table, key):
         cdef bytes tmp = table.encode('ascii')
         cdef bytes jkey = json.dumps(key).encode('utf8')
@@ -282,10 +308,13 @@ cdef class Transaction:
     cdef Client client
     cdef consus_transaction* xact
 
-    def __cinit__(self, Client client):
+    def __cinit__(self, Client client, buffered=False):
         cdef consus_returncode status
         self.client = client
-        req = consus_begin_transaction(self.client.client, &status, &self.xact)
+        if buffered:
+            req = consus_begin_buffered_transaction(self.client.client, &status, &self.xact)
+        else:
+            req = consus_begin_transaction(self.client.client, &status, &self.xact)
         self.finish(req, &status)
         assert self.xact
 
@@ -325,6 +354,98 @@ cdef class Transaction:
         self.finish(req, &status)
         return True
 
+    def get_bytes(self, str table, bytes key):
+        cdef bytes tmp = table.encode('ascii')
+        cdef consus_returncode status
+        cdef const char* t = tmp
+        cdef const char* k = key
+        cdef size_t k_sz = len(key)
+        cdef char* value
+        cdef size_t value_sz
+        req = consus_get_binary(self.xact, t, k, k_sz, &status, &value, &value_sz)
+        self.finish(req, &status)
+        if status == CONSUS_SUCCESS:
+            x = value[:value_sz]
+            free(value)
+            return x
+        else:
+            return None
+
+    def put_bytes(self, str table, bytes key, bytes value):
+        cdef bytes tmp = table.encode('ascii')
+        cdef consus_returncode status
+        cdef const char* t = tmp
+        cdef const char* k = key
+        cdef size_t k_sz = len(key)
+        cdef const char* v = value
+        cdef size_t v_sz = len(value)
+        req = consus_put_binary(self.xact, t, k, k_sz, v, v_sz, &status)
+        self.finish(req, &status)
+        return True
+
+    def multi_get(self, str table, keys):
+        cdef bytes tmp = table.encode('ascii')
+        cdef consus_returncode status
+        cdef const char* t = tmp
+        cdef size_t num = len(keys)
+        jkeys = [json.dumps(k).encode('utf8') for k in keys]
+        cdef const char** ks = <const char**>malloc(sizeof(char*) * num)
+        cdef size_t* ks_sz = <size_t*>malloc(sizeof(size_t) * num)
+        cdef char** vs = <char**>malloc(sizeof(char*) * num)
+        cdef size_t* vs_sz = <size_t*>malloc(sizeof(size_t) * num)
+        cdef size_t i
+        try:
+            for i in range(num):
+                ks[i] = jkeys[i]
+                ks_sz[i] = len(jkeys[i])
+                vs[i] = NULL
+                vs_sz[i] = 0
+            req = consus_multi_get(self.xact, t, ks, ks_sz, num, &status, vs, vs_sz)
+            self.finish(req, &status)
+            ret = []
+            for i in range(num):
+                if vs[i] == NULL:
+                    ret.append(None)
+                else:
+                    ret.append(json.loads(vs[i][:vs_sz[i]].decode('utf8')))
+            return ret
+        finally:
+            for i in range(num):
+                if vs[i] != NULL:
+                    free(vs[i])
+            free(ks)
+            free(ks_sz)
+            free(vs)
+            free(vs_sz)
+
+    def multi_put(self, str table, pairs):
+        cdef bytes tmp = table.encode('ascii')
+        cdef consus_returncode status
+        cdef const char* t = tmp
+        pairs = list(pairs.items() if isinstance(pairs, dict) else pairs)
+        cdef size_t num = len(pairs)
+        jkeys = [json.dumps(k).encode('utf8') for k, v in pairs]
+        jvalues = [json.dumps(v).encode('utf8') for k, v in pairs]
+        cdef const char** ks = <const char**>malloc(sizeof(char*) * num)
+        cdef size_t* ks_sz = <size_t*>malloc(sizeof(size_t) * num)
+        cdef const char** vs = <const char**>malloc(sizeof(char*) * num)
+        cdef size_t* vs_sz = <size_t*>malloc(sizeof(size_t) * num)
+        cdef size_t i
+        try:
+            for i in range(num):
+                ks[i] = jkeys[i]
+                ks_sz[i] = len(jkeys[i])
+                vs[i] = jvalues[i]
+                vs_sz[i] = len(jvalues[i])
+            req = consus_multi_put(self.xact, t, ks, ks_sz, vs, vs_sz, num, &status)
+            self.finish(req, &status)
+            return True
+        finally:
+            free(ks)
+            free(ks_sz)
+            free(vs)
+            free(vs_sz)
+
     def commit(self):
         cdef consus_returncode status
         req = consus_commit_transaction(self.xact, &status)
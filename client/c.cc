@@ -165,6 +165,16 @@ consus_loop(consus_client* client, int timeout, consus_returncode* status)
     );
 }
 
+CONSUS_API int64_t
+consus_loop_many(consus_client* client, int timeout,
+                 int64_t* ids, consus_returncode* statuses, size_t n,
+                 consus_returncode* status)
+{
+    C_WRAP_EXCEPT(
+    return cl->loop_many(timeout, ids, statuses, n, status);
+    );
+}
+
 CONSUS_API int64_t
 consus_wait(consus_client* client, int64_t id, int timeout, consus_returncode* status)
 {
@@ -223,7 +233,17 @@ consus_begin_transaction(consus_client* client,
                          consus_transaction** xact)
 {
     C_WRAP_EXCEPT(
-    return cl->begin_transaction(status, xact);
+    return cl->begin_transaction(status, xact, false);
+    );
+}
+
+CONSUS_API int64_t
+consus_begin_buffered_transaction(consus_client* client,
+                                  consus_returncode* status,
+                                  consus_transaction** xact)
+{
+    C_WRAP_EXCEPT(
+    return cl->begin_transaction(status, xact, true);
     );
 }
 
@@ -303,6 +323,56 @@ consus_put(consus_transaction* xact,
     );
 }
 
+CONSUS_API int64_t
+consus_get_binary(consus_transaction* xact,
+                  const char* table,
+                  const char* key, size_t key_sz,
+                  consus_returncode* status,
+                  char** value, size_t* value_sz)
+{
+    C_WRAP_EXCEPT_XACT(
+    return tx->get_binary(table, key, key_sz, status, value, value_sz);
+    );
+}
+
+CONSUS_API int64_t
+consus_put_binary(consus_transaction* xact,
+                  const char* table,
+                  const char* key, size_t key_sz,
+                  const char* value, size_t value_sz,
+                  consus_returncode* status)
+{
+    C_WRAP_EXCEPT_XACT(
+    return tx->put_binary(table, key, key_sz, value, value_sz, status);
+    );
+}
+
+CONSUS_API int64_t
+consus_multi_get(consus_transaction* xact,
+                 const char* table,
+                 const char* const* keys, const size_t* keys_sz,
+                 size_t num,
+                 consus_returncode* status,
+                 char** values, size_t* values_sz)
+{
+    C_WRAP_EXCEPT_XACT(
+    return tx->multi_get(table, keys, keys_sz, num, status, values, values_sz);
+    );
+}
+
+CONSUS_API int64_t
+consus_multi_put(consus_transaction* xact,
+                 const char* table,
+                 const char* const* keys, const size_t* keys_sz,
+                 const char* const* values, const size_t* values_sz,
+                 size_t num,
+                 consus_returncode* status)
+{
+    C_WRAP_EXCEPT_XACT(
+    return tx->multi_put(table, keys, keys_sz, values, values_sz, num, status);
+    );
+}
+
 CONSUS_API int64_t
 consus_commit_transaction(consus_transaction* xact,
                           consus_returncode* status)
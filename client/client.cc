@@ -25,6 +25,17 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// C
+#include <assert.h>
+
+// STL
+#include <algorithm>
+#include <map>
+#include <set>
+
+// e
+#include <e/atomic.h>
+
 // BusyBee
 #include <busybee_constants.h>
 
@@ -40,6 +51,7 @@
 #include "common/paxos_group.h"
 #include "common/txman_configuration.h"
 #include "client/client.h"
+#include "client/completion_ring.h"
 #include "client/pending.h"
 #include "client/pending_begin_transaction.h"
 #include "client/pending_string.h"
@@ -49,10 +61,16 @@
 
 using consus::client;
 
+// milliseconds to wait on the coordinator before giving up, and between polls
+// of an outstanding coordinator call; another thread may have taken in its
+// completion, leaving nothing on the fd to wake for
+#define COORD_TIMEOUT 10000
+#define COORD_POLL 100
+
 #define ERROR(CODE) \
     *status = CONSUS_ ## CODE; \
-    m_last_error.set_loc(__FILE__, __LINE__); \
-    m_last_error.set_msg()
+    get_endpoint()->last_error.set_loc(__FILE__, __LINE__); \
+    get_endpoint()->last_error.set_msg()
 
 #define _BUSYBEE_ERROR(BBRC) \
     case BUSYBEE_ ## BBRC: \
@@ -66,79 +84,153 @@ using consus::client;
     _BUSYBEE_ERROR(BBRC); \
     return false;
 
+// One pthread key serves every client in the process; a key per client would
+// cap live clients at PTHREAD_KEYS_MAX.  Its value maps each client's serial
+// number to the thread's endpoint for that client.
+static pthread_once_t s_endpoint_once = PTHREAD_ONCE_INIT;
+static pthread_key_t s_endpoint_key;
+static bool s_endpoint_key_ok = false;
+// serials of the clients still alive; a thread that exits after its client
+// is gone must leave that client's endpoint alone.  Serials are never reused.
+static pthread_mutex_t s_clients_mtx = PTHREAD_MUTEX_INITIALIZER;
+static std::set<uint64_t>* s_live_clients = NULL;
+static uint64_t s_next_serial = 0;
+
+void
+client :: create_endpoint_key()
+{
+    s_live_clients = new std::set<uint64_t>();
+    s_endpoint_key_ok = pthread_key_create(&s_endpoint_key, &client::release_endpoints) == 0;
+}
+
+struct client::endpoint
+{
+    endpoint(client* owner, replicant_client* coord);
+    ~endpoint() throw ();
+
+    client* owner;
+    // configuration; a snapshot of the client's
+    e::compat::shared_ptr<const configuration> config;
+    uint64_t config_generation;
+    // communication
+    mapper busybee_mapper;
+    busybee_st busybee;
+    // operations
+    std::map<std::pair<comm_id, uint64_t>, e::intrusive_ptr<consus::pending> > pending;
+    completion_ring returnable;
+    e::intrusive_ptr<consus::pending> returned;
+    e::error last_error;
+
+    private:
+        endpoint(const endpoint&);
+        endpoint& operator = (const endpoint&);
+};
+
+client :: endpoint :: endpoint(client* o, replicant_client* coord)
+    : owner(o)
+    , config(new configuration())
+    , config_generation(0)
+    , busybee_mapper(&config)
+    , busybee(&busybee_mapper, 0)
+    , pending()
+    , returnable()
+    , returned()
+    , last_error()
+{
+    busybee_returncode rc = busybee.set_external_fd(replicant_client_poll_fd(coord));
+    assert(rc == BUSYBEE_SUCCESS);
+}
+
+client :: endpoint :: ~endpoint() throw ()
+{
+}
+
 client :: client(const char* host, uint16_t port)
-    : m_coord(replicant_client_create(host, port))
-    , m_config()
+    : m_coord_mtx()
+    , m_coord(replicant_client_create(host, port))
+    , m_config(new configuration())
     , m_config_id(-1)
     , m_config_status(REPLICANT_SUCCESS)
     , m_config_state(0)
     , m_config_data(NULL)
     , m_config_data_sz(0)
-    , m_busybee_mapper(&m_config)
-    , m_busybee(&m_busybee_mapper, 0)
-    , m_next_client_id(1)
-    , m_next_server_nonce(1)
-    , m_pending()
-    , m_returnable()
-    , m_returned()
+    , m_config_generation(0)
+    , m_coord_ready(0)
+    , m_next_client_id(0)
+    , m_next_server_nonce(0)
+    , m_serial(0)
+    , m_endpoints_mtx()
+    , m_endpoints()
     , m_flagfd()
-    , m_last_error()
 {
     if (!m_coord)
     {
         throw std::bad_alloc();
     }
 
-    busybee_returncode rc = m_busybee.set_external_fd(replicant_client_poll_fd(m_coord));
-    assert(rc == BUSYBEE_SUCCESS);
+    if (!enroll())
+    {
+        replicant_client_destroy(m_coord);
+        throw std::bad_alloc();
+    }
 }
 
 client :: client(const char* conn_str)
-    : m_coord(replicant_client_create_conn_str(conn_str))
-    , m_config()
+    : m_coord_mtx()
+    , m_coord(replicant_client_create_conn_str(conn_str))
+    , m_config(new configuration())
     , m_config_id(-1)
     , m_config_status(REPLICANT_SUCCESS)
     , m_config_state(0)
     , m_config_data(NULL)
     , m_config_data_sz(0)
-    , m_busybee_mapper(&m_config)
-    , m_busybee(&m_busybee_mapper, 0)
-    , m_next_client_id(1)
-    , m_next_server_nonce(1)
-    , m_pending()
-    , m_returnable()
-    , m_returned()
+    , m_config_generation(0)
+    , m_coord_ready(0)
+    , m_next_client_id(0)
+    , m_next_server_nonce(0)
+    , m_serial(0)
+    , m_endpoints_mtx()
+    , m_endpoints()
     , m_flagfd()
-    , m_last_error()
 {
     if (!m_coord)
     {
         throw std::bad_alloc();
     }
 
-    busybee_returncode rc = m_busybee.set_external_fd(replicant_client_poll_fd(m_coord));
-    assert(rc == BUSYBEE_SUCCESS);
+    if (!enroll())
+    {
+        replicant_client_destroy(m_coord);
+        throw std::bad_alloc();
+    }
 }
 
 client :: ~client() throw ()
 {
+    retire();
+
+    for (size_t i = 0; i < m_endpoints.size(); ++i)
+    {
+        delete m_endpoints[i];
+    }
+
     replicant_client_destroy(m_coord);
 }
 
 int64_t
 client :: loop(int timeout, consus_returncode* status)
 {
+    endpoint* ep = get_endpoint();
     *status = CONSUS_SUCCESS;
-    m_last_error = e::error();
+    ep->last_error = e::error();
 
-    while (!m_returnable.empty() || !m_pending.empty())
+    while (!ep->returnable.empty() || !ep->pending.empty())
     {
-        if (!m_returnable.empty())
+        if (!ep->returnable.empty())
         {
-            m_returned = m_returnable.front();
-            m_returnable.pop_front();
-            m_last_error = m_returned->error();
-            return m_returned->client_id();
+            ep->returned = ep->returnable.pop();
+            ep->last_error = ep->returned->error();
+            return ep->returned->client_id();
         }
 
         if (inner_loop(timeout, status) < 0)
@@ -150,25 +242,72 @@ client :: loop(int timeout, consus_returncode* status)
     return post_loop(status);
 }
 
+int64_t
+client :: loop_many(int timeout, int64_t* ids, consus_returncode* statuses,
+                    size_t n, consus_returncode* status)
+{
+    if (n == 0)
+    {
+        *status = CONSUS_SUCCESS;
+        return 0;
+    }
+
+    // block, as loop does, for the first completion
+    int64_t id = loop(timeout, status);
+
+    if (id < 0)
+    {
+        return -1;
+    }
+
+    endpoint* ep = get_endpoint();
+    ids[0] = id;
+    statuses[0] = ep->returned->status();
+    size_t count = 1;
+
+    // then take whatever else is ready without waiting, until nothing is
+    // pending or the network has nothing more for us; inner_loop returns 0
+    // for disruptions and coordinator traffic, which are no reason to stop.
+    // Any other failure is left for the next call to report.
+    while (count < n && (!ep->returnable.empty() || !ep->pending.empty()))
+    {
+        if (!ep->returnable.empty())
+        {
+            ep->returned = ep->returnable.pop();
+            ids[count] = ep->returned->client_id();
+            statuses[count] = ep->returned->status();
+            ++count;
+            continue;
+        }
+
+        consus_returncode lstatus;
+
+        if (inner_loop(0, &lstatus) < 0)
+        {
+            break;
+        }
+    }
+
+    ep->last_error = ep->returned->error();
+    return count;
+}
+
 int64_t
 client :: wait(int64_t id, int timeout, consus_returncode* status)
 {
+    endpoint* ep = get_endpoint();
     *status = CONSUS_SUCCESS;
-    m_last_error = e::error();
+    ep->last_error = e::error();
 
     while (true)
     {
-        for (std::list<e::intrusive_ptr<pending> >::iterator it = m_returnable.begin();
-                it != m_returnable.end(); ++it)
+        for (size_t i = 0; i < ep->returnable.size(); ++i)
         {
-            pending* p = it->get();
-
-            if (p->client_id() == id)
+            if (ep->returnable.at(i)->client_id() == id)
             {
-                m_returned = *it;
-                m_returnable.erase(it);
-                m_last_error = m_returned->error();
-                return m_returned->client_id();
+                ep->returned = ep->returnable.remove(i);
+                ep->last_error = ep->returned->error();
+                return ep->returned->client_id();
             }
         }
 
@@ -183,7 +322,8 @@ client :: wait(int64_t id, int timeout, consus_returncode* status)
 
 int64_t
 client :: begin_transaction(consus_returncode* status,
-                            consus_transaction** xact)
+                            consus_transaction** xact,
+                            bool buffer_writes)
 {
     if (!maintain_coord_connection(status))
     {
@@ -191,7 +331,7 @@ client :: begin_transaction(consus_returncode* status,
     }
 
     int64_t client_id = generate_new_client_id();
-    pending* p = new pending_begin_transaction(client_id, status, xact);
+    pending* p = new pending_begin_transaction(client_id, status, xact, buffer_writes);
     p->kickstart_state_machine(this);
     return client_id;
 }
@@ -324,9 +464,14 @@ client :: create_data_center(const char* name, consus_returncode* status)
     replicant_returncode rc;
     char* data = NULL;
     size_t data_sz = 0;
-    int64_t id = replicant_client_call(m_coord, "consus", "data_center_create",
-                                       tmp.data(), tmp.size(), REPLICANT_CALL_ROBUST,
-                                       &rc, &data, &data_sz);
+    int64_t id = -1;
+
+    {
+        po6::threads::mutex::hold hold(&m_coord_mtx);
+        id = replicant_client_call(m_coord, "consus", "data_center_create",
+                                   tmp.data(), tmp.size(), REPLICANT_CALL_ROBUST,
+                                   &rc, &data, &data_sz);
+    }
 
     if (!replicant_finish(id, &rc, status))
     {
@@ -366,9 +511,14 @@ client :: set_default_data_center(const char* name, consus_returncode* status)
     replicant_returncode rc;
     char* data = NULL;
     size_t data_sz = 0;
-    int64_t id = replicant_client_call(m_coord, "consus", "data_center_default",
-                                       tmp.data(), tmp.size(), REPLICANT_CALL_ROBUST,
-                                       &rc, &data, &data_sz);
+    int64_t id = -1;
+
+    {
+        po6::threads::mutex::hold hold(&m_coord_mtx);
+        id = replicant_client_call(m_coord, "consus", "data_center_default",
+                                   tmp.data(), tmp.size(), REPLICANT_CALL_ROBUST,
+                                   &rc, &data, &data_sz);
+    }
 
     if (!replicant_finish(id, &rc, status))
     {
@@ -419,7 +569,6 @@ client :: availability_check(consus_availability_requirements* reqs,
         replicant_returncode rc = REPLICANT_GARBAGE;
         char* data = NULL;
         size_t data_sz = 0;
-        int64_t id = replicant_client_cond_wait(m_coord, "consus", "txmanconf", version, &rc, &data, &data_sz);
         int to = -1;
 
         if (timeout >= 0)
@@ -428,10 +577,16 @@ client :: availability_check(consus_availability_requirements* reqs,
             to = std::min(to, int(100));
         }
 
-        if (!replicant_finish(id, to, &rc, status))
+        int64_t id = -1;
+
         {
-            replicant_client_kill(m_coord, id);
+            po6::threads::mutex::hold hold(&m_coord_mtx);
+            id = replicant_client_cond_wait(m_coord, "consus", "txmanconf", version, &rc, &data, &data_sz);
+        }
 
+        // replicant_finish kills the wait if it times out
+        if (!replicant_finish(id, to, &rc, status))
+        {
             if (rc == REPLICANT_TIMEOUT)
             {
                 continue;
@@ -447,11 +602,15 @@ client :: availability_check(consus_availability_requirements* reqs,
         cluster_id cid;
         version_id vid;
         uint64_t flags;
+        uint64_t low_water;
         std::vector<data_center> dcs;
         std::vector<txman_state> txmans;
         std::vector<paxos_group> txman_groups;
         std::vector<kvs> kvss;
-        up = txman_configuration(up, &cid, &vid, &flags, &dcs, &txmans, &txman_groups, &kvss);
+        version_id checkpoint;
+        std::vector<ring_ptr> rings;
+        std::vector<ring_patch> patches;
+        up = txman_configuration(up, &cid, &vid, &flags, &low_water, &dcs, &txmans, &txman_groups, &kvss, &checkpoint, &rings, &patches);
 
         if (data)
         {
@@ -491,13 +650,16 @@ client :: availability_check(consus_availability_requirements* reqs,
         rc = REPLICANT_GARBAGE;
         data = NULL;
         data_sz = 0;
-        id = replicant_client_call(m_coord, "consus", "is_stable",
-                                   NULL, 0, REPLICANT_CALL_IDEMPOTENT,
-                                   &rc, &data, &data_sz);
+
+        {
+            po6::threads::mutex::hold hold(&m_coord_mtx);
+            id = replicant_client_call(m_coord, "consus", "is_stable",
+                                       NULL, 0, REPLICANT_CALL_IDEMPOTENT,
+                                       &rc, &data, &data_sz);
+        }
 
         if (!replicant_finish(id, -1, &rc, status))
         {
-            replicant_client_kill(m_coord, id);
             return -1;
         }
 
@@ -537,11 +699,45 @@ client :: replicant_finish(int64_t id, int timeout, replicant_returncode* rc, co
         return false;
     }
 
+    const uint64_t start = po6::monotonic_time();
+    const uint64_t limit = timeout < 0 ? COORD_TIMEOUT : timeout;
     replicant_returncode lrc;
-    int64_t lid = replicant_client_wait(m_coord, id, timeout, &lrc);
+    int64_t lid = -1;
+
+    // the coordinator is polled under m_coord_mtx, but waited on without it
+    while (true)
+    {
+        {
+            po6::threads::mutex::hold hold(&m_coord_mtx);
+            lid = replicant_client_wait(m_coord, id, 0, &lrc);
+            // that may have taken in a new configuration that no fd will
+            // announce again; a failure here is for the next pump to report
+            consus_returncode ignored;
+            pump_config(&ignored);
+
+            if (lid >= 0 || lrc != REPLICANT_TIMEOUT)
+            {
+                break;
+            }
+        }
+
+        if (start + limit * PO6_MILLIS <= po6::monotonic_time())
+        {
+            break;
+        }
+
+        replicant_client_block(m_coord, COORD_POLL);
+    }
 
     if (lid < 0)
     {
+        if (lrc == REPLICANT_TIMEOUT)
+        {
+            // its outputs point into the caller's frame
+            po6::threads::mutex::hold hold(&m_coord_mtx);
+            replicant_client_kill(m_coord, id);
+        }
+
         *rc = lrc;
         ERROR(COORD_FAIL) << "coordinator failure: " << replicant_client_error_message(m_coord);
         return false;
@@ -569,7 +765,12 @@ client :: debug_client_configuration(consus_returncode* status, const char** str
     replicant_returncode rc = REPLICANT_GARBAGE;
     char* data = NULL;
     size_t data_sz = 0;
-    int64_t id = replicant_client_cond_wait(m_coord, "consus", "clientconf", 0, &rc, &data, &data_sz);
+    int64_t id = -1;
+
+    {
+        po6::threads::mutex::hold hold(&m_coord_mtx);
+        id = replicant_client_cond_wait(m_coord, "consus", "clientconf", 0, &rc, &data, &data_sz);
+    }
 
     if (!replicant_finish(id, &rc, status) || (!data && data_sz != 0))
     {
@@ -614,9 +815,10 @@ client :: debug_client_configuration(consus_returncode* status, const char** str
 
     e::intrusive_ptr<pending_string> p = new pending_string(ostr.str());
     *str = p->string();
-    m_returned = p.get();
+    endpoint* ep = get_endpoint();
+    ep->returned = p.get();
     *status = CONSUS_SUCCESS;
-    m_last_error = e::error();
+    ep->last_error = e::error();
     return 0;
 }
 
@@ -631,7 +833,12 @@ client :: debug_txman_configuration(consus_returncode* status, const char** str)
     replicant_returncode rc = REPLICANT_GARBAGE;
     char* data = NULL;
     size_t data_sz = 0;
-    int64_t id = replicant_client_cond_wait(m_coord, "consus", "txmanconf", 0, &rc, &data, &data_sz);
+    int64_t id = -1;
+
+    {
+        po6::threads::mutex::hold hold(&m_coord_mtx);
+        id = replicant_client_cond_wait(m_coord, "consus", "txmanconf", 0, &rc, &data, &data_sz);
+    }
 
     if (!replicant_finish(id, &rc, status) || (!data && data_sz != 0))
     {
@@ -642,11 +849,15 @@ client :: debug_txman_configuration(consus_returncode* status, const char** str)
     cluster_id cid;
     version_id vid;
     uint64_t flags;
+    uint64_t low_water;
     std::vector<data_center> dcs;
     std::vector<txman_state> txmans;
     std::vector<paxos_group> txman_groups;
     std::vector<kvs> kvss;
-    up = txman_configuration(up, &cid, &vid, &flags, &dcs, &txmans, &txman_groups, &kvss);
+    version_id checkpoint;
+    std::vector<ring_ptr> rings;
+    std::vector<ring_patch> patches;
+    up = txman_configuration(up, &cid, &vid, &flags, &low_water, &dcs, &txmans, &txman_groups, &kvss, &checkpoint, &rings, &patches);
     free(data);
 
     if (up.error())
@@ -655,12 +866,55 @@ client :: debug_txman_configuration(consus_returncode* status, const char** str)
         return -1;
     }
 
-    std::string s = txman_configuration(cid, vid, flags, dcs, txmans, txman_groups, kvss);
+    if (checkpoint != vid)
+    {
+        data = NULL;
+        data_sz = 0;
+
+        {
+            po6::threads::mutex::hold hold(&m_coord_mtx);
+            id = replicant_client_cond_wait(m_coord, "consus", "txmanckpt", 0, &rc, &data, &data_sz);
+        }
+
+        if (!replicant_finish(id, &rc, status) || (!data && data_sz != 0))
+        {
+            return -1;
+        }
+
+        cluster_id ckpt_cid;
+        version_id ckpt_vid;
+        uint64_t ckpt_flags;
+        uint64_t ckpt_low_water;
+        std::vector<data_center> ckpt_dcs;
+        std::vector<txman_state> ckpt_txmans;
+        std::vector<paxos_group> ckpt_txman_groups;
+        std::vector<kvs> ckpt_kvss;
+        version_id ckpt_checkpoint;
+        std::vector<ring_ptr> ckpt_rings;
+        std::vector<ring_patch> ckpt_patches;
+        up = e::unpacker(data, data_sz);
+        up = txman_configuration(up, &ckpt_cid, &ckpt_vid, &ckpt_flags, &ckpt_low_water,
+                                 &ckpt_dcs, &ckpt_txmans, &ckpt_txman_groups, &ckpt_kvss,
+                                 &ckpt_checkpoint, &ckpt_rings, &ckpt_patches);
+        free(data);
+
+        // the checkpoint moves on when the coordinator issues a new one;
+        // the caller may simply retry
+        if (up.error() || ckpt_vid != checkpoint ||
+            !patch_rings(ckpt_rings, patches, &rings))
+        {
+            ERROR(COORD_FAIL) << "coordinator failure: configuration does not apply to the current checkpoint";
+            return -1;
+        }
+    }
+
+    std::string s = txman_configuration(cid, vid, flags, low_water, dcs, txmans, txman_groups, kvss, rings);
     e::intrusive_ptr<pending_string> p = new pending_string(s);
     *str = p->string();
-    m_returned = p.get();
+    endpoint* ep = get_endpoint();
+    ep->returned = p.get();
     *status = CONSUS_SUCCESS;
-    m_last_error = e::error();
+    ep->last_error = e::error();
     return 0;
 }
 
@@ -675,7 +929,12 @@ client :: debug_kvs_configuration(consus_returncode* status, const char** str)
     replicant_returncode rc = REPLICANT_GARBAGE;
     char* data = NULL;
     size_t data_sz = 0;
-    int64_t id = replicant_client_cond_wait(m_coord, "consus", "kvsconf", 0, &rc, &data, &data_sz);
+    int64_t id = -1;
+
+    {
+        po6::threads::mutex::hold hold(&m_coord_mtx);
+        id = replicant_client_cond_wait(m_coord, "consus", "kvsconf", 0, &rc, &data, &data_sz);
+    }
 
     if (!replicant_finish(id, &rc, status) || (!data && data_sz != 0))
     {
@@ -686,9 +945,12 @@ client :: debug_kvs_configuration(consus_returncode* status, const char** str)
     cluster_id cid;
     version_id vid;
     uint64_t flags;
+    uint64_t low_water;
     std::vector<kvs_state> kvss;
-    std::vector<ring> rings;
-    up = kvs_configuration(up, &cid, &vid, &flags, &kvss, &rings);
+    version_id checkpoint;
+    std::vector<ring_ptr> rings;
+    std::vector<ring_patch> patches;
+    up = kvs_configuration(up, &cid, &vid, &flags, &low_water, &kvss, &checkpoint, &rings, &patches);
     free(data);
 
     if (up.error())
@@ -697,63 +959,110 @@ client :: debug_kvs_configuration(consus_returncode* status, const char** str)
         return -1;
     }
 
-    std::string s = kvs_configuration(cid, vid, flags, kvss, rings);
+    if (checkpoint != vid)
+    {
+        data = NULL;
+        data_sz = 0;
+
+        {
+            po6::threads::mutex::hold hold(&m_coord_mtx);
+            id = replicant_client_cond_wait(m_coord, "consus", "kvsckpt", 0, &rc, &data, &data_sz);
+        }
+
+        if (!replicant_finish(id, &rc, status) || (!data && data_sz != 0))
+        {
+            return -1;
+        }
+
+        cluster_id ckpt_cid;
+        version_id ckpt_vid;
+        uint64_t ckpt_flags;
+        uint64_t ckpt_low_water;
+        std::vector<kvs_state> ckpt_kvss;
+        version_id ckpt_checkpoint;
+        std::vector<ring_ptr> ckpt_rings;
+        std::vector<ring_patch> ckpt_patches;
+        up = e::unpacker(data, data_sz);
+        up = kvs_configuration(up, &ckpt_cid, &ckpt_vid, &ckpt_flags, &ckpt_low_water,
+                               &ckpt_kvss, &ckpt_checkpoint, &ckpt_rings, &ckpt_patches);
+        free(data);
+
+        // the checkpoint moves on when the coordinator issues a new one;
+        // the caller may simply retry
+        if (up.error() || ckpt_vid != checkpoint ||
+            !patch_rings(ckpt_rings, patches, &rings))
+        {
+            ERROR(COORD_FAIL) << "coordinator failure: configuration does not apply to the current checkpoint";
+            return -1;
+        }
+    }
+
+    std::string s = kvs_configuration(cid, vid, flags, low_water, kvss, rings);
     e::intrusive_ptr<pending_string> p = new pending_string(s);
     *str = p->string();
-    m_returned = p.get();
+    endpoint* ep = get_endpoint();
+    ep->returned = p.get();
     *status = CONSUS_SUCCESS;
-    m_last_error = e::error();
+    ep->last_error = e::error();
     return 0;
 }
 
 const char*
 client :: error_message()
 {
-    return m_last_error.msg();
+    return get_endpoint()->last_error.msg();
 }
 
 const char*
 client :: error_location()
 {
-    return m_last_error.loc();
+    return get_endpoint()->last_error.loc();
+}
+
+e::error*
+client :: set_error_message()
+{
+    return &get_endpoint()->last_error;
 }
 
 void
 client :: set_error_message(const char* msg)
 {
-    m_last_error = e::error();
-    m_last_error.set_loc(__FILE__, __LINE__);
-    m_last_error.set_msg() << msg;
+    endpoint* ep = get_endpoint();
+    ep->last_error = e::error();
+    ep->last_error.set_loc(__FILE__, __LINE__);
+    ep->last_error.set_msg() << msg;
 }
 
 uint64_t
 client :: generate_new_nonce()
 {
-    return m_next_server_nonce++;
+    return e::atomic::increment_64_nobarrier(&m_next_server_nonce, 1);
 }
 
 int64_t
 client :: generate_new_client_id()
 {
-    return m_next_client_id++;
+    return e::atomic::increment_64_nobarrier(&m_next_client_id, 1);
 }
 
 void
 client :: initialize(server_selector* ss)
 {
-    m_config.initialize(ss);
+    get_endpoint()->config->initialize(ss);
 }
 
 void
 client :: add_to_returnable(pending* p)
 {
-    m_returnable.push_back(p);
+    get_endpoint()->returnable.push(p);
 }
 
 bool
 client :: send(uint64_t nonce, comm_id id, std::auto_ptr<e::buffer> msg, pending* p)
 {
-    busybee_returncode rc = m_busybee.send(id.get(), msg);
+    endpoint* ep = get_endpoint();
+    busybee_returncode rc = ep->busybee.send(id.get(), msg);
 
     if (rc == BUSYBEE_DISRUPTED)
     {
@@ -762,7 +1071,7 @@ client :: send(uint64_t nonce, comm_id id, std::auto_ptr<e::buffer> msg, pending
 
     if (rc == BUSYBEE_SUCCESS)
     {
-        m_pending[std::make_pair(id, nonce)] = p;
+        ep->pending[std::make_pair(id, nonce)] = p;
     }
 
     return rc == BUSYBEE_SUCCESS;
@@ -771,15 +1080,17 @@ client :: send(uint64_t nonce, comm_id id, std::auto_ptr<e::buffer> msg, pending
 void
 client :: handle_disruption(const comm_id& id)
 {
-    for (std::map<std::pair<comm_id, uint64_t>, e::intrusive_ptr<pending> >::iterator it = m_pending.begin();
-            it != m_pending.end(); )
+    endpoint* ep = get_endpoint();
+
+    for (std::map<std::pair<comm_id, uint64_t>, e::intrusive_ptr<pending> >::iterator it = ep->pending.begin();
+            it != ep->pending.end(); )
     {
         if (it->first.first == id)
         {
             e::intrusive_ptr<pending> p = it->second;
-            m_pending.erase(it);
+            ep->pending.erase(it);
             p->handle_server_disruption(this, id);
-            it = m_pending.begin();
+            it = ep->pending.begin();
         }
         else
         {
@@ -791,10 +1102,11 @@ client :: handle_disruption(const comm_id& id)
 int64_t
 client :: inner_loop(int timeout, consus_returncode* status)
 {
+    endpoint* ep = get_endpoint();
     uint64_t cid_num;
     std::auto_ptr<e::buffer> msg;
-    m_busybee.set_timeout(timeout);
-    busybee_returncode rc = m_busybee.recv(&cid_num, &msg);
+    ep->busybee.set_timeout(timeout);
+    busybee_returncode rc = ep->busybee.recv(&cid_num, &msg);
     comm_id id(cid_num);
 
     switch (rc)
@@ -805,12 +1117,13 @@ client :: inner_loop(int timeout, consus_returncode* status)
             ERROR(INTERRUPTED) << "signal received";
             return -1;
         case BUSYBEE_TIMEOUT:
-            return 0;
+            ERROR(TIMEOUT) << "operation timed out";
+            return -1;
         case BUSYBEE_DISRUPTED:
             handle_disruption(id);
             return 0;
         case BUSYBEE_EXTERNAL:
-            if (!maintain_coord_connection(status))
+            if (!pump_coord_connection(status))
             {
                 return -1;
             }
@@ -839,12 +1152,12 @@ client :: inner_loop(int timeout, consus_returncode* status)
     }
 
     std::map<std::pair<comm_id, uint64_t>, e::intrusive_ptr<pending> >::iterator it;
-    it = m_pending.find(std::make_pair(id, nonce));
+    it = ep->pending.find(std::make_pair(id, nonce));
 
-    if (it != m_pending.end())
+    if (it != ep->pending.end())
     {
         e::intrusive_ptr<pending> p(it->second);
-        m_pending.erase(it);
+        ep->pending.erase(it);
         p->handle_busybee_op(this, nonce, msg, up);
         return p->client_id();
     }
@@ -855,9 +1168,10 @@ client :: inner_loop(int timeout, consus_returncode* status)
 int64_t
 client :: post_loop(consus_returncode* status)
 {
+    endpoint* ep = get_endpoint();
     uint64_t cid_num;
-    m_busybee.set_timeout(0);
-    busybee_returncode rc = m_busybee.recv_no_msg(&cid_num);
+    ep->busybee.set_timeout(0);
+    busybee_returncode rc = ep->busybee.recv_no_msg(&cid_num);
 
     switch (rc)
     {
@@ -870,7 +1184,7 @@ client :: post_loop(consus_returncode* status)
             handle_disruption(comm_id(cid_num));
             break;
         case BUSYBEE_EXTERNAL:
-            if (!maintain_coord_connection(status))
+            if (!pump_coord_connection(status))
             {
                 return -1;
             }
@@ -889,32 +1203,211 @@ client :: post_loop(consus_returncode* status)
     return -1;
 }
 
+client::endpoint*
+client :: get_endpoint()
+{
+    endpoint_map_t* eps = static_cast<endpoint_map_t*>(pthread_getspecific(s_endpoint_key));
+
+    if (eps)
+    {
+        endpoint_map_t::iterator it = eps->find(m_serial);
+
+        if (it != eps->end())
+        {
+            return it->second;
+        }
+    }
+    else
+    {
+        eps = new endpoint_map_t();
+        pthread_setspecific(s_endpoint_key, eps);
+    }
+
+    endpoint* ep = new endpoint(this, m_coord);
+
+    {
+        po6::threads::mutex::hold hold(&m_endpoints_mtx);
+        m_endpoints.push_back(ep);
+    }
+
+    // forget the endpoints of clients destroyed since; they went with them
+    pthread_mutex_lock(&s_clients_mtx);
+
+    for (endpoint_map_t::iterator it = eps->begin(); it != eps->end(); )
+    {
+        if (s_live_clients->find(it->first) == s_live_clients->end())
+        {
+            eps->erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    pthread_mutex_unlock(&s_clients_mtx);
+    (*eps)[m_serial] = ep;
+    return ep;
+}
+
+bool
+client :: enroll()
+{
+    pthread_once(&s_endpoint_once, &client::create_endpoint_key);
+
+    if (!s_endpoint_key_ok)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&s_clients_mtx);
+    m_serial = ++s_next_serial;
+    s_live_clients->insert(m_serial);
+    pthread_mutex_unlock(&s_clients_mtx);
+    return true;
+}
+
+void
+client :: retire()
+{
+    // once this returns, no exiting thread will touch m_endpoints
+    pthread_mutex_lock(&s_clients_mtx);
+    s_live_clients->erase(m_serial);
+    pthread_mutex_unlock(&s_clients_mtx);
+}
+
+void
+client :: drop_endpoint(endpoint* ep)
+{
+    {
+        po6::threads::mutex::hold hold(&m_endpoints_mtx);
+        std::vector<endpoint*>::iterator it;
+        it = std::find(m_endpoints.begin(), m_endpoints.end(), ep);
+        assert(it != m_endpoints.end());
+        m_endpoints.erase(it);
+    }
+
+    delete ep;
+}
+
+// Runs as a thread exits.  Its operations can no longer complete, as only
+// this thread could have looped for them, so they go with the endpoint.
+// Their statuses are left alone:  they may live on the stack just unwound.
+void
+client :: release_endpoints(void* p)
+{
+    endpoint_map_t* eps = static_cast<endpoint_map_t*>(p);
+    pthread_mutex_lock(&s_clients_mtx);
+
+    for (endpoint_map_t::iterator it = eps->begin(); it != eps->end(); ++it)
+    {
+        if (s_live_clients->find(it->first) != s_live_clients->end())
+        {
+            it->second->owner->drop_endpoint(it->second);
+        }
+    }
+
+    pthread_mutex_unlock(&s_clients_mtx);
+    delete eps;
+}
+
 bool
 client :: maintain_coord_connection(consus_returncode* status)
 {
-    if (m_config_status != REPLICANT_SUCCESS)
+    endpoint* ep = get_endpoint();
+
+    // the common case:  connected and holding the latest configuration;
+    // anything newer shows up on the coordinator's fd and is pumped by
+    // whichever thread's loop sees it
+    if (e::atomic::load_64_acquire(&m_coord_ready) &&
+        ep->config_generation == e::atomic::load_64_acquire(&m_config_generation))
+    {
+        return true;
+    }
+
+    const uint64_t start = po6::monotonic_time();
+
+    while (true)
+    {
+        {
+            po6::threads::mutex::hold hold(&m_coord_mtx);
+
+            if (!pump_config(status))
+            {
+                return false;
+            }
+
+            ep->config = m_config;
+            ep->config_generation = e::atomic::load_64_acquire(&m_config_generation);
+        }
+
+        if (e::atomic::load_64_acquire(&m_coord_ready))
+        {
+            return true;
+        }
+
+        if (start + COORD_TIMEOUT * PO6_MILLIS < po6::monotonic_time())
+        {
+            ERROR(COORD_FAIL) << "coordinator failure: timed out waiting for a configuration";
+            return false;
+        }
+
+        // wait for the coordinator without holding up other threads
+        replicant_client_block(m_coord, COORD_POLL);
+    }
+}
+
+bool
+client :: pump_coord_connection(consus_returncode* status)
+{
+    endpoint* ep = get_endpoint();
+
+    // whoever holds the lock is already talking to the coordinator and will
+    // take in whatever woke this thread
+    if (!m_coord_mtx.trylock())
     {
+        return true;
+    }
+
+    bool ret = pump_config(status);
+    ep->config = m_config;
+    ep->config_generation = e::atomic::load_64_acquire(&m_config_generation);
+    m_coord_mtx.unlock();
+    return ret;
+}
+
+bool
+client :: pump_config(consus_returncode* status)
+{
+    if (m_config_id >= 0 &&
+        m_config_status != REPLICANT_SUCCESS &&
+        m_config_status != REPLICANT_GARBAGE)
+    {
+        e::atomic::store_64_release(&m_coord_ready, 0);
         replicant_client_kill(m_coord, m_config_id);
         m_config_id = -1;
     }
 
     if (m_config_id < 0)
     {
+        // the status stays garbage until the first configuration arrives
+        m_config_status = REPLICANT_GARBAGE;
         m_config_id = replicant_client_cond_follow(m_coord, "consus", "clientconf",
                                                    &m_config_status, &m_config_state,
                                                    &m_config_data, &m_config_data_sz);
-        replicant_returncode rc;
 
-        if (replicant_client_wait(m_coord, m_config_id, -1, &rc) < 0)
+        if (m_config_id < 0)
         {
             ERROR(COORD_FAIL) << "coordinator failure: " << replicant_client_error_message(m_coord);
             return false;
         }
     }
 
+    // waits on the follow alone, so it never takes the completion of a
+    // call another thread is waiting on
     replicant_returncode rc;
 
-    if (replicant_client_loop(m_coord, 0, &rc) < 0)
+    if (replicant_client_wait(m_coord, m_config_id, 0, &rc) < 0)
     {
         if (rc == REPLICANT_TIMEOUT ||
             rc == REPLICANT_INTERRUPTED ||
@@ -928,17 +1421,24 @@ client :: maintain_coord_connection(consus_returncode* status)
         }
     }
 
-    if (m_config.version().get() < m_config_state)
+    if (m_config_status == REPLICANT_SUCCESS &&
+        m_config->version().get() < m_config_state)
     {
-        configuration new_config;
+        std::auto_ptr<configuration> new_config(new configuration());
         e::unpacker up(m_config_data, m_config_data_sz);
-        up = up >> new_config;
+        up = up >> *new_config;
 
         if (!up.error())
         {
-            m_config = new_config;
+            m_config.reset(new_config.release());
+            e::atomic::increment_64_nobarrier(&m_config_generation, 1);
         }
     }
 
+    if (m_config_status == REPLICANT_SUCCESS)
+    {
+        e::atomic::store_64_release(&m_coord_ready, 1);
+    }
+
     return true;
 }
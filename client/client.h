@@ -31,11 +31,18 @@
 // C
 #include <stdint.h>
 
+// POSIX
+#include <pthread.h>
+
 // STL
 #include <map>
-#include <list>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
 
 // e
+#include <e/compat.h>
 #include <e/error.h>
 #include <e/flagfd.h>
 
@@ -57,6 +64,12 @@
 
 BEGIN_CONSUS_NAMESPACE
 
+// A client may be shared by many threads.  Each thread talks to the servers
+// through its own endpoint, and an operation completes only in loop/wait
+// calls made by the thread that issued it; when the thread exits, its
+// endpoint and anything still pending there are discarded.  All endpoints
+// share one coordinator connection and one configuration.  A transaction
+// must be used by one thread at a time.
 class client
 {
     public:
@@ -67,9 +80,12 @@ class client
     public:
         // public API
         int64_t loop(int timeout, consus_returncode* status);
+        int64_t loop_many(int timeout, int64_t* ids, consus_returncode* statuses,
+                          size_t n, consus_returncode* status);
         int64_t wait(int64_t id, int timeout, consus_returncode* status);
         int64_t begin_transaction(consus_returncode* status,
-                                  consus_transaction** xact);
+                                  consus_transaction** xact,
+                                  bool buffer_writes);
         int64_t unsafe_get(const char* table,
                            const char* key, size_t key_sz,
                            consus_returncode* status,
@@ -97,7 +113,7 @@ class client
         const char* error_message();
         const char* error_location();
         void set_error_message(const char* msg);
-        e::error* set_error_message() { return &m_last_error; }
+        e::error* set_error_message();
 
     public:
         uint64_t generate_new_nonce();
@@ -110,35 +126,47 @@ class client
         bool replicant_finish(int64_t id, int timeout, replicant_returncode* rc, consus_returncode* status);
 
     private:
+        struct endpoint;
+        typedef std::map<uint64_t, endpoint*> endpoint_map_t;
         friend class transaction;
         // returns the ID of something that made progress; does not guarantee
         // that it can return, so verify that at the callsite
         int64_t inner_loop(int timeout, consus_returncode* status);
         int64_t post_loop(consus_returncode* status);
         bool maintain_coord_connection(consus_returncode* status);
+        bool pump_coord_connection(consus_returncode* status);
+        // call with m_coord_mtx held; never blocks
+        bool pump_config(consus_returncode* status);
+        endpoint* get_endpoint();
+        bool enroll();
+        void retire();
+        void drop_endpoint(endpoint* ep);
+        static void create_endpoint_key();
+        static void release_endpoints(void* p);
 
     private:
-        // configuration
+        // configuration; guarded by m_coord_mtx
+        po6::threads::mutex m_coord_mtx;
         replicant_client* m_coord;
-        configuration m_config;
+        e::compat::shared_ptr<const configuration> m_config;
         int64_t m_config_id;
         replicant_returncode m_config_status;
         uint64_t m_config_state;
         char* m_config_data;
         size_t m_config_data_sz;
-        // communication
-        mapper m_busybee_mapper;
-        busybee_st m_busybee;
-        // nonces
-        int64_t m_next_client_id;
+        // bumped (atomically) each time m_config changes
+        uint64_t m_config_generation;
+        uint64_t m_coord_ready;
+        // nonces; incremented atomically
+        uint64_t m_next_client_id;
         uint64_t m_next_server_nonce;
-        // operations
-        std::map<std::pair<comm_id, uint64_t>, e::intrusive_ptr<pending> > m_pending;
-        std::list<e::intrusive_ptr<pending> > m_returnable;
-        e::intrusive_ptr<pending> m_returned;
+        // per-thread endpoints, found under m_serial through one key shared
+        // by every client in the process
+        uint64_t m_serial;
+        po6::threads::mutex m_endpoints_mtx;
+        std::vector<endpoint*> m_endpoints;
         // misc
         e::flagfd m_flagfd;
-        e::error m_last_error;
 
     private:
         client(const client&);
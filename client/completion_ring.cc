@@ -0,0 +1,111 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <assert.h>
+
+// STL
+#include <algorithm>
+
+// consus
+#include "client/completion_ring.h"
+
+using consus::completion_ring;
+using consus::pending;
+
+#define INITIAL_SLOTS 16
+
+completion_ring :: completion_ring()
+    : m_slots(INITIAL_SLOTS)
+    , m_head(0)
+    , m_count(0)
+{
+}
+
+completion_ring :: ~completion_ring() throw ()
+{
+}
+
+pending*
+completion_ring :: at(size_t i) const
+{
+    assert(i < m_count);
+    return m_slots[index(i)].get();
+}
+
+void
+completion_ring :: push(pending* p)
+{
+    if (m_count == m_slots.size())
+    {
+        grow();
+    }
+
+    m_slots[index(m_count)] = p;
+    ++m_count;
+}
+
+e::intrusive_ptr<pending>
+completion_ring :: pop()
+{
+    assert(m_count > 0);
+    e::intrusive_ptr<pending> p;
+    std::swap(p, m_slots[m_head]);
+    m_head = index(1);
+    --m_count;
+    return p;
+}
+
+e::intrusive_ptr<pending>
+completion_ring :: remove(size_t i)
+{
+    assert(i < m_count);
+    e::intrusive_ptr<pending> p;
+    std::swap(p, m_slots[index(i)]);
+
+    for (size_t j = i; j + 1 < m_count; ++j)
+    {
+        std::swap(m_slots[index(j)], m_slots[index(j + 1)]);
+    }
+
+    --m_count;
+    return p;
+}
+
+void
+completion_ring :: grow()
+{
+    std::vector<e::intrusive_ptr<pending> > slots(m_slots.size() * 2);
+
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        std::swap(slots[i], m_slots[index(i)]);
+    }
+
+    m_slots.swap(slots);
+    m_head = 0;
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_client_completion_ring_h_
+#define consus_client_completion_ring_h_
+
+// STL
+#include <vector>
+
+// e
+#include <e/intrusive_ptr.h>
+
+// consus
+#include "namespace.h"
+#include "client/pending.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// A FIFO of completed operations kept in one flat, power-of-two sized array
+// that doubles when full, so completing an operation allocates nothing in
+// the steady state.
+class completion_ring
+{
+    public:
+        completion_ring();
+        ~completion_ring() throw ();
+
+    public:
+        bool empty() const { return m_count == 0; }
+        size_t size() const { return m_count; }
+        // the i-th oldest completion
+        pending* at(size_t i) const;
+        void push(pending* p);
+        e::intrusive_ptr<pending> pop();
+        // removes the i-th oldest, preserving the order of the rest
+        e::intrusive_ptr<pending> remove(size_t i);
+
+    private:
+        size_t index(size_t i) const { return (m_head + i) & (m_slots.size() - 1); }
+        void grow();
+
+    private:
+        std::vector<e::intrusive_ptr<pending> > m_slots;
+        size_t m_head;
+        size_t m_count;
+
+    private:
+        completion_ring(const completion_ring&);
+        completion_ring& operator = (const completion_ring&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_client_completion_ring_h_
@@ -66,7 +66,7 @@ configuration :: get_address(const comm_id& id) const
 }
 
 void
-configuration :: initialize(server_selector* ss)
+configuration :: initialize(server_selector* ss) const
 {
     std::vector<comm_id> ids;
 
@@ -61,7 +61,7 @@ class configuration
     public:
         bool exists(const comm_id& id) const;
         po6::net::location get_address(const comm_id& id) const;
-        void initialize(server_selector* ss);
+        void initialize(server_selector* ss) const;
 
     public:
         configuration& operator = (const configuration& rhs);
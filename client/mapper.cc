@@ -30,7 +30,7 @@
 
 using consus::mapper;
 
-mapper :: mapper(const configuration* config)
+mapper :: mapper(const e::compat::shared_ptr<const configuration>* config)
     : m_config(config)
 {
 }
@@ -42,6 +42,6 @@ mapper :: ~mapper() throw ()
 bool
 mapper :: lookup(uint64_t id, po6::net::location* addr)
 {
-    *addr = m_config->get_address(comm_id(id));
+    *addr = (*m_config)->get_address(comm_id(id));
     return *addr != po6::net::location();
 }
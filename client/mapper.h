@@ -28,6 +28,9 @@
 #ifndef consus_client_mapper_h_
 #define consus_client_mapper_h_
 
+// e
+#include <e/compat.h>
+
 // BusyBee
 #include <busybee_mapper.h>
 
@@ -40,7 +43,8 @@ BEGIN_CONSUS_NAMESPACE
 class mapper : public ::busybee_mapper
 {
     public:
-        mapper(const configuration* config);
+        // follows whichever configuration "*config" points to at lookup
+        mapper(const e::compat::shared_ptr<const configuration>* config);
         ~mapper() throw ();
 
     public:
@@ -51,7 +55,7 @@ class mapper : public ::busybee_mapper
         mapper& operator = (const mapper&);
 
     private:
-        const configuration* m_config;
+        const e::compat::shared_ptr<const configuration>* m_config;
 };
 
 END_CONSUS_NAMESPACE
@@ -39,9 +39,11 @@ using consus::pending_begin_transaction;
 
 pending_begin_transaction :: pending_begin_transaction(int64_t client_id,
                                                        consus_returncode* status,
-                                                       consus_transaction** xact)
+                                                       consus_transaction** xact,
+                                                       bool buffer_writes)
     : pending(client_id, status)
     , m_xact(xact)
+    , m_buffer_writes(buffer_writes)
     , m_ss()
 {
     *m_xact = NULL;
@@ -94,7 +96,7 @@ pending_begin_transaction :: handle_busybee_op(client* cl,
         return;
     }
 
-    transaction* t = new transaction(cl, txid, &ids[0], ids.size());
+    transaction* t = new transaction(cl, txid, &ids[0], ids.size(), m_buffer_writes);
     *m_xact = reinterpret_cast<consus_transaction*>(t);
     this->success();
     cl->add_to_returnable(this);
@@ -39,7 +39,8 @@ class pending_begin_transaction : public pending
     public:
         pending_begin_transaction(int64_t client_id,
                                   consus_returncode* status,
-                                  consus_transaction** xact);
+                                  consus_transaction** xact,
+                                  bool buffer_writes);
         virtual ~pending_begin_transaction() throw ();
 
     public:
@@ -57,6 +58,7 @@ class pending_begin_transaction : public pending
 
     private:
         consus_transaction** m_xact;
+        const bool m_buffer_writes;
         server_selector m_ss;
 
     private:
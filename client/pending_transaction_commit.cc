@@ -39,12 +39,20 @@ using consus::pending_transaction_commit;
 pending_transaction_commit :: pending_transaction_commit(int64_t client_id,
                                                          consus_returncode* status,
                                                          transaction* xact,
-                                                         uint64_t slot)
+                                                         uint64_t slot,
+                                                         const std::vector<std::string>& tables,
+                                                         const std::vector<std::string>& keys,
+                                                         const std::vector<std::string>& values)
     : pending(client_id, status)
     , m_xact(xact)
     , m_ss()
     , m_slot(slot)
+    , m_tables(tables)
+    , m_keys(keys)
+    , m_values(values)
 {
+    assert(m_tables.size() == m_keys.size());
+    assert(m_keys.size() == m_values.size());
 }
 
 pending_transaction_commit :: ~pending_transaction_commit() throw ()
@@ -102,10 +110,18 @@ pending_transaction_commit :: send_request(client* cl)
     while (true)
     {
         const uint64_t nonce = m_xact->parent()->generate_new_nonce();
-        const size_t sz = BUSYBEE_HEADER_SIZE
-                        + pack_size(TXMAN_COMMIT)
-                        + pack_size(m_xact->txid())
-                        + 2 * VARINT_64_MAX_SIZE;
+        size_t sz = BUSYBEE_HEADER_SIZE
+                  + pack_size(TXMAN_COMMIT)
+                  + pack_size(m_xact->txid())
+                  + 3 * VARINT_64_MAX_SIZE;
+
+        for (size_t i = 0; i < m_keys.size(); ++i)
+        {
+            sz += pack_size(e::slice(m_tables[i]))
+                + pack_size(e::slice(m_keys[i]))
+                + pack_size(e::slice(m_values[i]));
+        }
+
         comm_id id = m_ss.next();
 
         if (id == comm_id())
@@ -117,10 +133,22 @@ pending_transaction_commit :: send_request(client* cl)
         }
 
         std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-        msg->pack_at(BUSYBEE_HEADER_SIZE)
-            << TXMAN_COMMIT << m_xact->txid()
-            << e::pack_varint(nonce)
-            << e::pack_varint(m_slot);
+        e::packer pa = msg->pack_at(BUSYBEE_HEADER_SIZE);
+        pa = pa << TXMAN_COMMIT << m_xact->txid()
+                << e::pack_varint(nonce)
+                << e::pack_varint(m_slot);
+
+        if (!m_keys.empty())
+        {
+            pa = pa << e::pack_varint(m_keys.size());
+
+            for (size_t i = 0; i < m_keys.size(); ++i)
+            {
+                pa = pa << e::slice(m_tables[i])
+                        << e::slice(m_keys[i])
+                        << e::slice(m_values[i]);
+            }
+        }
 
         if (cl->send(nonce, id, msg, this))
         {
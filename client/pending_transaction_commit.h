@@ -28,6 +28,9 @@
 #ifndef consus_client_pending_transaction_commit_h_
 #define consus_client_pending_transaction_commit_h_
 
+// STL
+#include <vector>
+
 // consus
 #include "client/pending.h"
 #include "client/server_selector.h"
@@ -41,7 +44,10 @@ class pending_transaction_commit : public pending
         pending_transaction_commit(int64_t client_id,
                                    consus_returncode* status,
                                    transaction* xact,
-                                   uint64_t slot);
+                                   uint64_t slot,
+                                   const std::vector<std::string>& tables,
+                                   const std::vector<std::string>& keys,
+                                   const std::vector<std::string>& values);
         virtual ~pending_transaction_commit() throw ();
 
     public:
@@ -61,6 +67,10 @@ class pending_transaction_commit : public pending
         transaction* m_xact;
         server_selector m_ss;
         const uint64_t m_slot;
+        // buffered writes; the prepare follows them at m_slot + m_keys.size()
+        std::vector<std::string> m_tables;
+        std::vector<std::string> m_keys;
+        std::vector<std::string> m_values;
 
     private:
         pending_transaction_commit(const pending_transaction_commit&);
@@ -0,0 +1,115 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// treadstone
+#include <treadstone.h>
+
+// consus
+#include "client/client.h"
+#include "client/pending_transaction_local.h"
+#include "client/transaction.h"
+
+using consus::pending_transaction_local;
+
+pending_transaction_local :: pending_transaction_local(int64_t client_id,
+                                                       consus_returncode* status,
+                                                       transaction* xact)
+    : pending(client_id, status)
+    , m_xact(xact)
+    , m_binval()
+    , m_binary(false)
+    , m_value(NULL)
+    , m_value_sz(NULL)
+{
+}
+
+pending_transaction_local :: pending_transaction_local(int64_t client_id,
+                                                       consus_returncode* status,
+                                                       transaction* xact,
+                                                       const std::string& binval,
+                                                       bool binary,
+                                                       char** value, size_t* value_sz)
+    : pending(client_id, status)
+    , m_xact(xact)
+    , m_binval(binval)
+    , m_binary(binary)
+    , m_value(value)
+    , m_value_sz(value_sz)
+{
+}
+
+pending_transaction_local :: ~pending_transaction_local() throw ()
+{
+}
+
+std::string
+pending_transaction_local :: describe()
+{
+    std::ostringstream ostr;
+    ostr << "pending_transaction_local(id=" << m_xact->txid()
+         << ", read=" << (m_value ? "true" : "false") << ")";
+    return ostr.str();
+}
+
+void
+pending_transaction_local :: kickstart_state_machine(client* cl)
+{
+    if (m_value && m_binary)
+    {
+        char* tmp = static_cast<char*>(malloc(m_binval.size() + 1));
+
+        if (!tmp)
+        {
+            PENDING_ERROR(SEE_ERRNO) << po6::strerror(errno);
+            cl->add_to_returnable(this);
+            return;
+        }
+
+        memmove(tmp, m_binval.data(), m_binval.size());
+        tmp[m_binval.size()] = '\0';
+        *m_value = tmp;
+        *m_value_sz = m_binval.size();
+    }
+    else if (m_value)
+    {
+        char* tmp = NULL;
+
+        if (treadstone_binary_to_json(reinterpret_cast<const unsigned char*>(m_binval.data()),
+                                      m_binval.size(), &tmp))
+        {
+            PENDING_ERROR(SEE_ERRNO) << po6::strerror(errno);
+            cl->add_to_returnable(this);
+            return;
+        }
+
+        *m_value = tmp;
+        *m_value_sz = strlen(tmp);
+    }
+
+    this->success();
+    cl->add_to_returnable(this);
+}
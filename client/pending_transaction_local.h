@@ -0,0 +1,71 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_client_pending_transaction_local_h_
+#define consus_client_pending_transaction_local_h_
+
+// consus
+#include "client/pending.h"
+
+BEGIN_CONSUS_NAMESPACE
+class transaction;
+
+// An operation on a transaction's buffered writes.  It completes without
+// contacting any server; reads hand back the buffered value.
+class pending_transaction_local : public pending
+{
+    public:
+        pending_transaction_local(int64_t client_id,
+                                  consus_returncode* status,
+                                  transaction* xact);
+        pending_transaction_local(int64_t client_id,
+                                  consus_returncode* status,
+                                  transaction* xact,
+                                  const std::string& binval,
+                                  bool binary,
+                                  char** value, size_t* value_sz);
+        virtual ~pending_transaction_local() throw ();
+
+    public:
+        virtual std::string describe();
+        virtual void kickstart_state_machine(client* cl);
+
+    private:
+        transaction* m_xact;
+        std::string m_binval;
+        const bool m_binary;
+        char** m_value;
+        size_t* m_value_sz;
+
+    private:
+        pending_transaction_local(const pending_transaction_local&);
+        pending_transaction_local& operator = (const pending_transaction_local&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_client_pending_transaction_local_h_
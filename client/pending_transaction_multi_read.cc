@@ -0,0 +1,299 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// e
+#include <e/strescape.h>
+
+// treadstone
+#include <treadstone.h>
+
+// BusyBee
+#include <busybee_constants.h>
+
+// consus
+#include "common/consus.h"
+#include "client/client.h"
+#include "client/pending_transaction_multi_read.h"
+#include "client/transaction.h"
+
+using consus::pending_transaction_multi_read;
+
+pending_transaction_multi_read :: pending_transaction_multi_read(int64_t client_id,
+                                                                 consus_returncode* status,
+                                                                 transaction* xact,
+                                                                 uint64_t slot,
+                                                                 const char* table,
+                                                                 const std::vector<std::string>& keys,
+                                                                 char** values, size_t* values_sz)
+    : pending(client_id, status)
+    , m_xact(xact)
+    , m_ss()
+    , m_slot(slot)
+    , m_table(table)
+    , m_keys(keys)
+    , m_values(values)
+    , m_values_sz(values_sz)
+    , m_buffered()
+{
+}
+
+pending_transaction_multi_read :: ~pending_transaction_multi_read() throw ()
+{
+}
+
+void
+pending_transaction_multi_read :: buffered(size_t idx, const std::string& value)
+{
+    assert(idx < m_keys.size());
+    m_buffered[idx] = value;
+}
+
+std::string
+pending_transaction_multi_read :: describe()
+{
+    std::ostringstream ostr;
+    ostr << "pending_transaction_multi_read(id=" << m_xact->txid()
+         << ", table=\"" << e::strescape(m_table)
+         << "\", keys=" << m_keys.size() << ")";
+    return ostr.str();
+}
+
+void
+pending_transaction_multi_read :: kickstart_state_machine(client* cl)
+{
+    // read-your-writes:  a multi-get of only buffered keys never leaves the
+    // client, just as a single get would not
+    if (m_buffered.size() == m_keys.size())
+    {
+        std::vector<char*> values(m_keys.size(), static_cast<char*>(NULL));
+        std::vector<size_t> values_sz(m_keys.size(), 0);
+        finish(cl, &values, &values_sz);
+        return;
+    }
+
+    m_xact->initialize(&m_ss);
+    send_request(cl);
+}
+
+void
+pending_transaction_multi_read :: handle_server_failure(client* cl, comm_id)
+{
+    send_request(cl);
+}
+
+void
+pending_transaction_multi_read :: handle_server_disruption(client* cl, comm_id)
+{
+    send_request(cl);
+}
+
+void
+pending_transaction_multi_read :: handle_busybee_op(client* cl,
+                                                    uint64_t,
+                                                    std::auto_ptr<e::buffer>,
+                                                    e::unpacker up)
+{
+    consus_returncode rc;
+    uint64_t count = 0;
+    up = up >> rc;
+
+    // the server answers only the keys that were sent, in order
+    if (!up.error() && rc == CONSUS_SUCCESS)
+    {
+        up = up >> e::unpack_varint(count);
+
+        if (count != m_keys.size() - m_buffered.size())
+        {
+            up = up.error_out();
+        }
+    }
+
+    if (up.error())
+    {
+        m_xact->mark_aborted();
+        PENDING_ERROR(SERVER_ERROR) << "server sent a corrupt response to \"transaction-multi-read\"";
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    if (rc != CONSUS_SUCCESS)
+    {
+        m_xact->mark_aborted();
+        set_status(rc);
+        error(__FILE__, __LINE__) << "server sent failure code";
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    std::vector<char*> values(m_keys.size(), static_cast<char*>(NULL));
+    std::vector<size_t> values_sz(m_keys.size(), 0);
+    bool failed = false;
+
+    for (size_t i = 0; !failed && i < m_keys.size(); ++i)
+    {
+        if (m_buffered.find(i) != m_buffered.end())
+        {
+            continue;
+        }
+
+        uint64_t timestamp;
+        e::slice value;
+        up = up >> rc >> timestamp >> value;
+
+        if (up.error())
+        {
+            m_xact->mark_aborted();
+            PENDING_ERROR(SERVER_ERROR) << "server sent a corrupt response to \"transaction-multi-read\"";
+            failed = true;
+        }
+        else if (rc == CONSUS_SUCCESS)
+        {
+            if (treadstone_binary_to_json(value.data(), value.size(), &values[i]))
+            {
+                PENDING_ERROR(SEE_ERRNO) << po6::strerror(errno);
+                failed = true;
+            }
+            else
+            {
+                values_sz[i] = strlen(values[i]);
+            }
+        }
+        else if (rc != CONSUS_NOT_FOUND)
+        {
+            m_xact->mark_aborted();
+            set_status(rc);
+            error(__FILE__, __LINE__) << "server sent failure code";
+            failed = true;
+        }
+    }
+
+    if (failed)
+    {
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            free(values[i]);
+        }
+
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    finish(cl, &values, &values_sz);
+}
+
+// fill in the buffered keys and hand every value to the caller
+void
+pending_transaction_multi_read :: finish(client* cl,
+                                         std::vector<char*>* values,
+                                         std::vector<size_t>* values_sz)
+{
+    for (std::map<size_t, std::string>::iterator it = m_buffered.begin();
+            it != m_buffered.end(); ++it)
+    {
+        const size_t i = it->first;
+
+        if (treadstone_binary_to_json(reinterpret_cast<const unsigned char*>(it->second.data()),
+                                      it->second.size(), &(*values)[i]))
+        {
+            PENDING_ERROR(SEE_ERRNO) << po6::strerror(errno);
+
+            for (size_t j = 0; j < values->size(); ++j)
+            {
+                free((*values)[j]);
+            }
+
+            cl->add_to_returnable(this);
+            return;
+        }
+
+        (*values_sz)[i] = strlen((*values)[i]);
+    }
+
+    // keys that were not found come back as a NULL value
+    for (size_t i = 0; i < values->size(); ++i)
+    {
+        m_values[i] = (*values)[i];
+        m_values_sz[i] = (*values_sz)[i];
+    }
+
+    this->success();
+    cl->add_to_returnable(this);
+}
+
+void
+pending_transaction_multi_read :: send_request(client* cl)
+{
+    while (true)
+    {
+        const uint64_t nonce = m_xact->parent()->generate_new_nonce();
+        size_t sz = BUSYBEE_HEADER_SIZE
+                  + pack_size(TXMAN_MULTI_READ)
+                  + pack_size(m_xact->txid())
+                  + 3 * VARINT_64_MAX_SIZE
+                  + pack_size(e::slice(m_table));
+
+        for (size_t i = 0; i < m_keys.size(); ++i)
+        {
+            if (m_buffered.find(i) == m_buffered.end())
+            {
+                sz += pack_size(e::slice(m_keys[i]));
+            }
+        }
+
+        comm_id id = m_ss.next();
+
+        if (id == comm_id())
+        {
+            m_xact->mark_aborted();
+            PENDING_ERROR(UNAVAILABLE) << "insufficient number of servers to ensure durability";
+            cl->add_to_returnable(this);
+            return;
+        }
+
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        e::packer pa = msg->pack_at(BUSYBEE_HEADER_SIZE);
+        pa = pa << TXMAN_MULTI_READ << m_xact->txid()
+                << e::pack_varint(nonce)
+                << e::pack_varint(m_slot)
+                << e::slice(m_table)
+                << e::pack_varint(m_keys.size() - m_buffered.size());
+
+        // buffered keys are answered locally and take no slot
+        for (size_t i = 0; i < m_keys.size(); ++i)
+        {
+            if (m_buffered.find(i) == m_buffered.end())
+            {
+                pa = pa << e::slice(m_keys[i]);
+            }
+        }
+
+        if (cl->send(nonce, id, msg, this))
+        {
+            return;
+        }
+    }
+}
@@ -48,6 +48,7 @@ pending_transaction_read :: pending_transaction_read(int64_t client_id,
                                                      uint64_t slot,
                                                      const char* table,
                                                      const unsigned char* key, size_t key_sz,
+                                                     bool binary,
                                                      char** value, size_t* value_sz)
     : pending(client_id, status)
     , m_xact(xact)
@@ -55,6 +56,7 @@ pending_transaction_read :: pending_transaction_read(int64_t client_id,
     , m_slot(slot)
     , m_table(table)
     , m_key(key, key + key_sz)
+    , m_binary(binary)
     , m_value(value)
     , m_value_sz(value_sz)
 {
@@ -121,7 +123,25 @@ pending_transaction_read :: handle_busybee_op(client* cl,
         return;
     }
 
-    if (rc == CONSUS_SUCCESS)
+    if (rc == CONSUS_SUCCESS && m_binary)
+    {
+        char* tmp = static_cast<char*>(malloc(value.size() + 1));
+
+        if (!tmp)
+        {
+            PENDING_ERROR(SEE_ERRNO) << po6::strerror(errno);
+            cl->add_to_returnable(this);
+            return;
+        }
+
+        memmove(tmp, value.data(), value.size());
+        tmp[value.size()] = '\0';
+        *m_value = tmp;
+        *m_value_sz = value.size();
+        this->success();
+        cl->add_to_returnable(this);
+    }
+    else if (rc == CONSUS_SUCCESS)
     {
         char* tmp = NULL;
 
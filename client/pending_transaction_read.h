@@ -44,6 +44,7 @@ class pending_transaction_read : public pending
                                  uint64_t slot,
                                  const char* table,
                                  const unsigned char* key, size_t key_sz,
+                                 bool binary,
                                  char** value, size_t* value_sz);
         virtual ~pending_transaction_read() throw ();
 
@@ -66,6 +67,8 @@ class pending_transaction_read : public pending
         const uint64_t m_slot;
         std::string m_table;
         std::string m_key;
+        // hand back the stored bytes rather than JSON
+        const bool m_binary;
         char** m_value;
         size_t* m_value_sz;
 
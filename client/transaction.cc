@@ -31,6 +31,9 @@
 // consus
 #include "client/client.h"
 #include "client/transaction.h"
+#include "client/pending_transaction_local.h"
+#include "client/pending_transaction_multi_read.h"
+#include "client/pending_transaction_multi_write.h"
 #include "client/pending_transaction_read.h"
 #include "client/pending_transaction_write.h"
 #include "client/pending_transaction_commit.h"
@@ -44,11 +47,14 @@
 using consus::transaction;
 
 transaction :: transaction(client* cl, const transaction_id& txid,
-                           const comm_id* ids, size_t ids_sz)
+                           const comm_id* ids, size_t ids_sz,
+                           bool buffer_writes)
     : m_cl(cl)
     , m_txid(txid)
     , m_ids(ids, ids + ids_sz)
     , m_next_slot(1)
+    , m_buffer_writes(buffer_writes)
+    , m_writes()
 {
 }
 
@@ -76,14 +82,9 @@ transaction :: get(const char* table,
         return -1;
     }
 
-    uint64_t slot = m_next_slot;
-    ++m_next_slot;
-    int64_t client_id = m_cl->generate_new_client_id();
-    pending* p = new pending_transaction_read(client_id, status, this, slot,
-            table, binkey, binkey_sz, value, value_sz);
+    int64_t ret = read(table, binkey, binkey_sz, false, status, value, value_sz);
     free(binkey);
-    p->kickstart_state_machine(m_cl);
-    return client_id;
+    return ret;
 }
 
 int64_t
@@ -115,13 +116,175 @@ transaction :: put(const char* table,
         return -1;
     }
 
-    uint64_t slot = m_next_slot;
-    ++m_next_slot;
-    int64_t client_id = m_cl->generate_new_client_id();
-    pending* p = new pending_transaction_write(client_id, status, this, slot,
-            table, binkey, binkey_sz, binval, binval_sz);
+    int64_t ret = write(table, binkey, binkey_sz, binval, binval_sz, status);
     free(binkey);
     free(binval);
+    return ret;
+}
+
+int64_t
+transaction :: get_binary(const char* table,
+                          const char* key, size_t key_sz,
+                          consus_returncode* status,
+                          char** value, size_t* value_sz)
+{
+    if (!m_cl->maintain_coord_connection(status))
+    {
+        return -1;
+    }
+
+    return read(table, reinterpret_cast<const unsigned char*>(key), key_sz,
+                true, status, value, value_sz);
+}
+
+int64_t
+transaction :: put_binary(const char* table,
+                          const char* key, size_t key_sz,
+                          const char* value, size_t value_sz,
+                          consus_returncode* status)
+{
+    if (!m_cl->maintain_coord_connection(status))
+    {
+        return -1;
+    }
+
+    return write(table,
+                 reinterpret_cast<const unsigned char*>(key), key_sz,
+                 reinterpret_cast<const unsigned char*>(value), value_sz,
+                 status);
+}
+
+int64_t
+transaction :: multi_get(const char* table,
+                         const char* const* keys, const size_t* keys_sz,
+                         size_t num,
+                         consus_returncode* status,
+                         char** values, size_t* values_sz)
+{
+    if (!m_cl->maintain_coord_connection(status))
+    {
+        return -1;
+    }
+
+    if (num == 0)
+    {
+        ERROR(INVALID) << "multi-get requires at least one key";
+        return -1;
+    }
+
+    std::vector<std::string> binkeys(num);
+
+    for (size_t i = 0; i < num; ++i)
+    {
+        unsigned char* binkey = NULL;
+        size_t binkey_sz = 0;
+
+        if (treadstone_json_sz_to_binary(keys[i], keys_sz[i], &binkey, &binkey_sz) < 0)
+        {
+            ERROR(INVALID) << "key " << i << " contains invalid JSON";
+            return -1;
+        }
+
+        binkeys[i].assign(binkey, binkey + binkey_sz);
+        free(binkey);
+    }
+
+    std::vector<const std::string*> buffered(num);
+    size_t remote = num;
+
+    for (size_t i = 0; i < num; ++i)
+    {
+        buffered[i] = buffered_write(table,
+                reinterpret_cast<const unsigned char*>(binkeys[i].data()),
+                binkeys[i].size());
+        remote -= buffered[i] ? 1 : 0;
+    }
+
+    // the keys sent occupy consecutive slots so the servers may log them as
+    // one; buffered keys are read-your-writes and take none
+    uint64_t slot = m_next_slot;
+    m_next_slot += remote;
+    int64_t client_id = m_cl->generate_new_client_id();
+    pending_transaction_multi_read* p = new pending_transaction_multi_read(
+            client_id, status, this, slot, table, binkeys, values, values_sz);
+
+    for (size_t i = 0; i < num; ++i)
+    {
+        if (buffered[i])
+        {
+            p->buffered(i, *buffered[i]);
+        }
+    }
+
+    p->kickstart_state_machine(m_cl);
+    return client_id;
+}
+
+int64_t
+transaction :: multi_put(const char* table,
+                         const char* const* keys, const size_t* keys_sz,
+                         const char* const* values, const size_t* values_sz,
+                         size_t num,
+                         consus_returncode* status)
+{
+    if (!m_cl->maintain_coord_connection(status))
+    {
+        return -1;
+    }
+
+    if (num == 0)
+    {
+        ERROR(INVALID) << "multi-put requires at least one key";
+        return -1;
+    }
+
+    std::vector<std::string> binkeys(num);
+    std::vector<std::string> binvals(num);
+
+    for (size_t i = 0; i < num; ++i)
+    {
+        unsigned char* binkey = NULL;
+        size_t binkey_sz = 0;
+        unsigned char* binval = NULL;
+        size_t binval_sz = 0;
+
+        if (treadstone_json_sz_to_binary(keys[i], keys_sz[i], &binkey, &binkey_sz) < 0)
+        {
+            ERROR(INVALID) << "key " << i << " contains invalid JSON";
+            return -1;
+        }
+
+        if (treadstone_json_sz_to_binary(values[i], values_sz[i], &binval, &binval_sz) < 0)
+        {
+            ERROR(INVALID) << "value " << i << " contains invalid JSON";
+            free(binkey);
+            return -1;
+        }
+
+        binkeys[i].assign(binkey, binkey + binkey_sz);
+        binvals[i].assign(binval, binval + binval_sz);
+        free(binkey);
+        free(binval);
+    }
+
+    if (m_buffer_writes)
+    {
+        for (size_t i = 0; i < num; ++i)
+        {
+            m_writes[std::make_pair(std::string(table), binkeys[i])] = binvals[i];
+        }
+
+        int64_t client_id = m_cl->generate_new_client_id();
+        pending* p = new pending_transaction_local(client_id, status, this);
+        p->kickstart_state_machine(m_cl);
+        return client_id;
+    }
+
+    uint64_t slot = m_next_slot;
+    m_next_slot += num;
+    int64_t client_id = m_cl->generate_new_client_id();
+    pending* p = new pending_transaction_multi_write(client_id, status, this, slot,
+            table, binkeys, binvals);
     p->kickstart_state_machine(m_cl);
     return client_id;
 }
@@ -134,10 +297,25 @@ transaction :: commit(consus_returncode* status)
         return -1;
     }
 
+    std::vector<std::string> tables;
+    std::vector<std::string> keys;
+    std::vector<std::string> values;
+
+    for (std::map<std::pair<std::string, std::string>, std::string>::iterator it = m_writes.begin();
+            it != m_writes.end(); ++it)
+    {
+        tables.push_back(it->first.first);
+        keys.push_back(it->first.second);
+        values.push_back(it->second);
+    }
+
+    // buffered writes take the slots just before the prepare
     uint64_t slot = m_next_slot;
-    ++m_next_slot;
+    m_next_slot += m_writes.size() + 1;
+    m_writes.clear();
     int64_t client_id = m_cl->generate_new_client_id();
-    pending* p = new pending_transaction_commit(client_id, status, this, slot);
+    pending* p = new pending_transaction_commit(client_id, status, this, slot,
+            tables, keys, values);
     p->kickstart_state_machine(m_cl);
     return client_id;
 }
@@ -164,6 +342,82 @@ transaction :: initialize(server_selector* ss)
     ss->set(&m_ids[0], m_ids.size());
 }
 
+int64_t
+transaction :: read(const char* table,
+                    const unsigned char* key, size_t key_sz,
+                    bool binary,
+                    consus_returncode* status,
+                    char** value, size_t* value_sz)
+{
+    const std::string* buffered = buffered_write(table, key, key_sz);
+
+    // read-your-writes, without taking a slot
+    if (buffered)
+    {
+        int64_t client_id = m_cl->generate_new_client_id();
+        pending* p = new pending_transaction_local(client_id, status, this,
+                *buffered, binary, value, value_sz);
+        p->kickstart_state_machine(m_cl);
+        return client_id;
+    }
+
+    uint64_t slot = m_next_slot;
+    ++m_next_slot;
+    int64_t client_id = m_cl->generate_new_client_id();
+    pending* p = new pending_transaction_read(client_id, status, this, slot,
+            table, key, key_sz, binary, value, value_sz);
+    p->kickstart_state_machine(m_cl);
+    return client_id;
+}
+
+int64_t
+transaction :: write(const char* table,
+                     const unsigned char* key, size_t key_sz,
+                     const unsigned char* value, size_t value_sz,
+                     consus_returncode* status)
+{
+    if (m_buffer_writes)
+    {
+        buffer_write(table, key, key_sz, value, value_sz);
+        int64_t client_id = m_cl->generate_new_client_id();
+        pending* p = new pending_transaction_local(client_id, status, this);
+        p->kickstart_state_machine(m_cl);
+        return client_id;
+    }
+
+    uint64_t slot = m_next_slot;
+    ++m_next_slot;
+    int64_t client_id = m_cl->generate_new_client_id();
+    pending* p = new pending_transaction_write(client_id, status, this, slot,
+            table, key, key_sz, value, value_sz);
+    p->kickstart_state_machine(m_cl);
+    return client_id;
+}
+
+const std::string*
+transaction :: buffered_write(const char* table,
+                              const unsigned char* key, size_t key_sz)
+{
+    if (!m_buffer_writes)
+    {
+        return NULL;
+    }
+
+    std::map<std::pair<std::string, std::string>, std::string>::iterator it;
+    it = m_writes.find(std::make_pair(std::string(table), std::string(key, key + key_sz)));
+    return it != m_writes.end() ? &it->second : NULL;
+}
+
+void
+transaction :: buffer_write(const char* table,
+                            const unsigned char* key, size_t key_sz,
+                            const unsigned char* value, size_t value_sz)
+{
+    assert(m_buffer_writes);
+    std::pair<std::string, std::string> k(table, std::string(key, key + key_sz));
+    m_writes[k].assign(value, value + value_sz);
+}
+
 void
 transaction :: mark_aborted()
 {
@@ -31,6 +31,11 @@
 // C
 #include <stdint.h>
 
+// STL
+#include <map>
+#include <string>
+#include <vector>
+
 // e
 #include <e/error.h>
 
@@ -46,7 +51,8 @@ class transaction
 {
     public:
         transaction(client* cl, const transaction_id& txid,
-                    const comm_id* ids, size_t ids_sz);
+                    const comm_id* ids, size_t ids_sz,
+                    bool buffer_writes);
         ~transaction() throw ();
 
     public:
@@ -60,16 +66,54 @@ class transaction
                     const char* key, size_t key_sz,
                     const char* value, size_t value_sz,
                     consus_returncode* status);
+        // like get/put, but keys and values are raw bytes, not JSON
+        int64_t get_binary(const char* table,
+                           const char* key, size_t key_sz,
+                           consus_returncode* status,
+                           char** value, size_t* value_sz);
+        int64_t put_binary(const char* table,
+                           const char* key, size_t key_sz,
+                           const char* value, size_t value_sz,
+                           consus_returncode* status);
+        int64_t multi_get(const char* table,
+                          const char* const* keys, const size_t* keys_sz,
+                          size_t num,
+                          consus_returncode* status,
+                          char** values, size_t* values_sz);
+        int64_t multi_put(const char* table,
+                          const char* const* keys, const size_t* keys_sz,
+                          const char* const* values, const size_t* values_sz,
+                          size_t num,
+                          consus_returncode* status);
         int64_t commit(consus_returncode* status);
         int64_t abort(consus_returncode* status);
         void initialize(server_selector* ss);
         void mark_aborted();
 
+    private:
+        int64_t read(const char* table,
+                     const unsigned char* key, size_t key_sz,
+                     bool binary,
+                     consus_returncode* status,
+                     char** value, size_t* value_sz);
+        int64_t write(const char* table,
+                      const unsigned char* key, size_t key_sz,
+                      const unsigned char* value, size_t value_sz,
+                      consus_returncode* status);
+        const std::string* buffered_write(const char* table,
+                                          const unsigned char* key, size_t key_sz);
+        void buffer_write(const char* table,
+                          const unsigned char* key, size_t key_sz,
+                          const unsigned char* value, size_t value_sz);
+
     private:
         client* const m_cl;
         const transaction_id m_txid;
         const std::vector<comm_id> m_ids;
         uint64_t m_next_slot;
+        // when buffering, puts stay here until commit ships them all at once
+        const bool m_buffer_writes;
+        std::map<std::pair<std::string, std::string>, std::string> m_writes;
 
     private:
         transaction(const transaction&);
@@ -30,6 +30,11 @@
 
 #define CONSUS_MAX_REPLICATION_FACTOR 9
 
+// How many replicas of each partition the KVS keeps, and so how many the
+// transaction managers spread operations across.  Must not exceed
+// CONSUS_MAX_REPLICATION_FACTOR.
+#define CONSUS_KVS_REPLICATION_FACTOR 5
+
 #define CONSUS_PORT_TXMAN 22751
 #define CONSUS_PORT_KVS 22761
 
@@ -57,4 +62,6 @@
 
 #define CONSUS_WRITE_TOMBSTONE 1
 
+#define CONSUS_READ_DIGEST 1
+
 #endif // consus_common_constants_h_
@@ -27,6 +27,7 @@
 
 // C
 #include <stdio.h>
+#include <stdlib.h>
 
 // POSIX
 #include <signal.h>
@@ -213,7 +214,18 @@ coordinator_link :: maintain_connection()
     if (m_last_config_state < m_config_state)
     {
         m_last_config_valid = m_cb->new_config(m_config_data, m_config_data_sz);
-        m_last_config_state = m_config_state;
+
+        if (!m_last_config_valid && m_cb->missing_checkpoint() && fetch_checkpoint())
+        {
+            m_last_config_valid = m_cb->new_config(m_config_data, m_config_data_sz);
+        }
+
+        // if the checkpoint is still missing, the one fetched predates this
+        // config; keep the old state so the next call fetches it again
+        if (m_last_config_valid || !m_cb->missing_checkpoint())
+        {
+            m_last_config_state = m_config_state;
+        }
 
         if (!m_cb->has_id(m_id) && m_allow_rereg)
         {
@@ -338,6 +350,41 @@ coordinator_link :: call_no_lock(const char* func,
     return true;
 }
 
+bool
+coordinator_link :: fetch_checkpoint()
+{
+    std::string cond = m_cb->prefix() + "ckpt";
+    replicant_returncode status = REPLICANT_GARBAGE;
+    replicant_returncode lstatus = REPLICANT_GARBAGE;
+    char* data = NULL;
+    size_t data_sz = 0;
+    int64_t req = replicant_client_cond_wait(m_repl, "consus", cond.c_str(), 0,
+                                             &status, &data, &data_sz);
+
+    if (req < 0 ||
+        replicant_client_wait(m_repl, req, 10000, &lstatus) != req ||
+        status != REPLICANT_SUCCESS)
+    {
+        LOG(ERROR) << "coordinator failure: " << replicant_client_error_message(m_repl);
+
+        if (data)
+        {
+            free(data);
+        }
+
+        return false;
+    }
+
+    bool ret = m_cb->new_checkpoint(data, data_sz);
+
+    if (data)
+    {
+        free(data);
+    }
+
+    return ret;
+}
+
 bool
 coordinator_link :: registration()
 {
@@ -408,3 +455,15 @@ coordinator_link :: callback :: callback()
 coordinator_link :: callback :: ~callback() throw ()
 {
 }
+
+bool
+coordinator_link :: callback :: missing_checkpoint()
+{
+    return false;
+}
+
+bool
+coordinator_link :: callback :: new_checkpoint(const char*, size_t)
+{
+    return false;
+}
@@ -90,6 +90,7 @@ class coordinator_link
     private:
         void invariant_check();
         bool call_no_lock(const char* func, const char* input, size_t input_sz, coordinator_returncode* coord);
+        bool fetch_checkpoint();
         bool registration();
         bool online();
 
@@ -129,6 +130,12 @@ class coordinator_link::callback
     public:
         virtual std::string prefix() = 0;
         virtual bool new_config(const char* data, size_t data_sz) = 0;
+        // A config may be encoded against an earlier checkpoint the callback
+        // never saw.  If "new_config" fails and "missing_checkpoint" is true,
+        // the link passes the latest checkpoint to "new_checkpoint" and then
+        // retries "new_config".  The defaults suit full configurations.
+        virtual bool missing_checkpoint();
+        virtual bool new_checkpoint(const char* data, size_t data_sz);
         virtual bool has_id(comm_id id) = 0;
         virtual po6::net::location address(comm_id id) = 0;
         virtual bool is_steady_state(comm_id id) = 0;
@@ -36,22 +36,43 @@ consus :: kvs_configuration(e::unpacker up,
                             cluster_id* cid,
                             version_id* vid,
                             uint64_t* flags,
+                            uint64_t* low_water,
                             std::vector<kvs_state>* kvss,
-                            std::vector<ring>* rings)
+                            version_id* checkpoint,
+                            std::vector<ring_ptr>* rings,
+                            std::vector<ring_patch>* patches)
 {
-    return up >> *cid >> *vid >> *flags >> *kvss >> *rings;
+    up = up >> *cid >> *vid >> *flags >> *low_water >> *kvss >> *checkpoint;
+    rings->clear();
+    patches->clear();
+
+    if (up.error())
+    {
+        return up;
+    }
+
+    if (*checkpoint == *vid)
+    {
+        return up >> *rings;
+    }
+    else
+    {
+        return up >> *patches;
+    }
 }
 
 std::string
 consus :: kvs_configuration(const cluster_id& cid,
                               const version_id& vid,
                               uint64_t,
+                              uint64_t low_water,
                               const std::vector<kvs_state>& kvss,
-                              const std::vector<ring>& rings)
+                              const std::vector<ring_ptr>& rings)
 {
     std::ostringstream ostr;
     ostr << cid << "\n"
-         << vid << "\n";
+         << vid << "\n"
+         << "low water mark " << low_water << "\n";
 
     if (kvss.empty())
     {
@@ -73,8 +94,8 @@ consus :: kvs_configuration(const cluster_id& cid,
 
     for (size_t i = 0; i < rings.size(); ++i)
     {
-        ostr << "ring for " << rings[i].dc << "\n";
-        const partition* ptr = rings[i].partitions;
+        ostr << "ring for " << rings[i]->dc << "\n";
+        const partition* ptr = rings[i]->partitions;
         const partition* const end = ptr + CONSUS_KVS_PARTITIONS;
 
         while (ptr < end)
@@ -33,20 +33,28 @@
 #include "common/ids.h"
 #include "common/kvs_state.h"
 #include "common/ring.h"
+#include "common/ring_patch.h"
 
 BEGIN_CONSUS_NAMESPACE
 
+// A configuration whose checkpoint is its own version carries every ring in
+// full.  Any other carries one patch per ring against the rings of the
+// checkpoint version, which the coordinator also publishes as "kvsckpt".
 e::unpacker kvs_configuration(e::unpacker up,
                               cluster_id* cid,
                               version_id* vid,
                               uint64_t* flags,
+                              uint64_t* low_water,
                               std::vector<kvs_state>* kvss,
-                              std::vector<ring>* rings);
+                              version_id* checkpoint,
+                              std::vector<ring_ptr>* rings,
+                              std::vector<ring_patch>* patches);
 std::string kvs_configuration(const cluster_id& cid,
                               const version_id& vid,
                               uint64_t flags,
+                              uint64_t low_water,
                               const std::vector<kvs_state>& kvss,
-                              const std::vector<ring>& rings);
+                              const std::vector<ring_ptr>& rings);
 
 END_CONSUS_NAMESPACE
 
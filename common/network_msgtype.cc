@@ -50,6 +50,8 @@ consus :: operator << (std::ostream& lhs, network_msgtype rhs)
         STRINGIFY(TXMAN_COMMIT);
         STRINGIFY(TXMAN_ABORT);
         STRINGIFY(TXMAN_WOUND);
+        STRINGIFY(TXMAN_MULTI_READ);
+        STRINGIFY(TXMAN_MULTI_WRITE);
         STRINGIFY(TXMAN_PAXOS_2A);
         STRINGIFY(TXMAN_PAXOS_2B);
         STRINGIFY(LV_VOTE_1A);
@@ -78,6 +80,8 @@ consus :: operator << (std::ostream& lhs, network_msgtype rhs)
         STRINGIFY(KVS_WOUND_XACT);
         STRINGIFY(KVS_MIGRATE_SYN);
         STRINGIFY(KVS_MIGRATE_ACK);
+        STRINGIFY(KVS_MIGRATE_PULL);
+        STRINGIFY(KVS_MIGRATE_DATA);
         STRINGIFY(CONSUS_NOP);
         default:
             lhs << "unknown msgtype";
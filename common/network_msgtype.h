@@ -54,6 +54,8 @@ enum network_msgtype
     TXMAN_COMMIT    = 7427,
     TXMAN_ABORT     = 7428,
     TXMAN_WOUND     = 7429,
+    TXMAN_MULTI_READ  = 7430,
+    TXMAN_MULTI_WRITE = 7431,
 
     TXMAN_PAXOS_2A  = 7439,
     TXMAN_PAXOS_2B  = 7433,
@@ -92,6 +94,8 @@ enum network_msgtype
 
     KVS_MIGRATE_SYN = 7800,
     KVS_MIGRATE_ACK = 7801,
+    KVS_MIGRATE_PULL = 7802,
+    KVS_MIGRATE_DATA = 7803,
 
     CONSUS_NOP      = 7835
 };
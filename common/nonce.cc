@@ -0,0 +1,86 @@
+// Copyright (c) 2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdint.h>
+
+// po6
+#include <po6/time.h>
+
+// e
+#include <e/identity.h>
+
+// consus
+#include "common/nonce.h"
+
+namespace
+{
+
+// splitmix64 is a bijection on 64-bit integers, so stepping it along a counter
+// yields a full-period sequence with good avalanche between adjacent outputs.
+uint64_t
+mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+__thread bool t_seeded = false;
+__thread uint64_t t_counter = 0;
+
+void
+seed()
+{
+    uint64_t s = 0;
+
+    if (!e::generate_token(&s))
+    {
+        // fall back to something that still differs between threads and
+        // process restarts
+        s = mix(po6::monotonic_time())
+          ^ mix(po6::wallclock_time())
+          ^ mix(reinterpret_cast<uintptr_t>(&t_counter));
+    }
+
+    t_counter = s;
+    t_seeded = true;
+}
+
+} // namespace
+
+uint64_t
+consus :: generate_nonce()
+{
+    if (!t_seeded)
+    {
+        seed();
+    }
+
+    t_counter += 0x9e3779b97f4a7c15ULL;
+    return mix(t_counter);
+}
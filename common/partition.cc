@@ -43,6 +43,22 @@ partition :: ~partition() throw ()
 {
 }
 
+bool
+consus :: operator == (const partition& lhs, const partition& rhs)
+{
+    return lhs.index == rhs.index &&
+           lhs.id == rhs.id &&
+           lhs.owner == rhs.owner &&
+           lhs.next_id == rhs.next_id &&
+           lhs.next_owner == rhs.next_owner;
+}
+
+bool
+consus :: operator != (const partition& lhs, const partition& rhs)
+{
+    return !(lhs == rhs);
+}
+
 e::packer
 consus :: operator << (e::packer lhs, const partition& rhs)
 {
@@ -46,6 +46,11 @@ struct partition
     comm_id next_owner;
 };
 
+bool
+operator == (const partition& lhs, const partition& rhs);
+bool
+operator != (const partition& lhs, const partition& rhs);
+
 e::packer
 operator << (e::packer lhs, const partition& rhs);
 e::unpacker
@@ -25,6 +25,15 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// C
+#include <assert.h>
+
+// STL
+#include <algorithm>
+
+// e
+#include <e/endian.h>
+
 // consus
 #include "common/ring.h"
 
@@ -92,6 +101,155 @@ ring :: set_owners(comm_id owners[CONSUS_KVS_PARTITIONS], uint64_t* counter)
     }
 }
 
+unsigned
+ring :: replicas(unsigned index, unsigned max,
+                 comm_id* owners, comm_id* next_owners) const
+{
+    // Pair each replica with the one that takes its place, so that while
+    // partitions move an operation reaches the replicas of both rings.  A
+    // move reaches back along the ring:  the runs ahead of a moving partition
+    // may gain its new owner as a replica, not just the partition itself.
+    assert(max <= CONSUS_MAX_REPLICATION_FACTOR);
+    comm_id next[CONSUS_MAX_REPLICATION_FACTOR];
+    const unsigned num = walk(index, max, false, owners);
+    const unsigned next_num = walk(index, max, true, next);
+
+    for (unsigned i = 0; i < num; ++i)
+    {
+        next_owners[i] = i < next_num && next[i] != owners[i] ? next[i] : comm_id();
+    }
+
+    return num;
+}
+
+void
+ring :: migrations(unsigned max,
+                   std::map<unsigned, std::vector<unsigned> >* indices) const
+{
+    assert(max <= CONSUS_MAX_REPLICATION_FACTOR);
+    indices->clear();
+    comm_id owners[CONSUS_MAX_REPLICATION_FACTOR];
+    comm_id next[CONSUS_MAX_REPLICATION_FACTOR];
+    unsigned num = 0;
+    unsigned next_num = 0;
+    // the partitions, outside the current run, whose moves bring the run's
+    // new replicas
+    std::vector<unsigned> sources;
+
+    for (unsigned p = 0; p < CONSUS_KVS_PARTITIONS; ++p)
+    {
+        const partition& part(partitions[p]);
+
+        // every partition in a run of the same owner and next owner walks the
+        // ring the same way, so only walk at the start of each run
+        if (p == 0 ||
+            part.owner != partitions[p - 1].owner ||
+            part.next_owner != partitions[p - 1].next_owner)
+        {
+            num = walk(p, max, false, owners);
+            next_num = walk(p, max, true, next);
+            sources.clear();
+
+            for (unsigned i = 0; i < next_num; ++i)
+            {
+                if (std::find(owners, owners + num, next[i]) != owners + num ||
+                    next[i] == part.next_owner)
+                {
+                    continue;
+                }
+
+                for (unsigned j = 1; j < CONSUS_KVS_PARTITIONS; ++j)
+                {
+                    const partition& q(partitions[(p + j) % CONSUS_KVS_PARTITIONS]);
+
+                    if (q.next_owner == next[i] &&
+                        q.owner != next[i] &&
+                        std::find(owners, owners + num, q.owner) != owners + num)
+                    {
+                        sources.push_back(q.index);
+                        break;
+                    }
+                }
+            }
+        }
+
+        // a partition moving to an owner that is already a replica goes with
+        // its own migration all the same
+        if (part.next_owner != comm_id() && part.next_owner != part.owner)
+        {
+            (*indices)[p].push_back(p);
+        }
+
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            (*indices)[sources[i]].push_back(p);
+        }
+    }
+}
+
+unsigned
+ring :: walk(unsigned index, unsigned max, bool next, comm_id* owners) const
+{
+    unsigned num = 0;
+
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS && num < max; ++i)
+    {
+        const partition* p = &partitions[(index + i) % CONSUS_KVS_PARTITIONS];
+        const comm_id owner = next && p->next_owner != comm_id() ? p->next_owner : p->owner;
+
+        // if the partition is assigned, we haven't wrapped around, and it's not
+        // the same as the previous partition
+        if (owner != comm_id() &&
+            (num == 0 || (owner != owners[0] && owner != owners[num - 1])))
+        {
+            owners[num] = owner;
+            ++num;
+        }
+    }
+
+    return num;
+}
+
+// FNV-1a over the table's length, the table, and the key, with the 64-bit
+// MurmurHash3 finalizer on top so that every input bit affects the upper bits
+// used to pick a partition.  Hashing the length keeps ("ab", "c") and ("a",
+// "bc") apart.
+static uint64_t
+hash_table_key(const e::slice& table, const e::slice& key)
+{
+    uint64_t h = 14695981039346656037ULL;
+    unsigned char buf[sizeof(uint32_t)];
+    e::pack32be(table.size(), buf);
+
+    for (size_t i = 0; i < sizeof(buf); ++i)
+    {
+        h = (h ^ buf[i]) * 1099511628211ULL;
+    }
+
+    for (size_t i = 0; i < table.size(); ++i)
+    {
+        h = (h ^ table.data()[i]) * 1099511628211ULL;
+    }
+
+    for (size_t i = 0; i < key.size(); ++i)
+    {
+        h = (h ^ key.data()[i]) * 1099511628211ULL;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+unsigned
+ring :: partition_index(const e::slice& table, const e::slice& key)
+{
+    return hash_table_key(table, key) % CONSUS_KVS_PARTITIONS;
+}
+
 e::packer
 consus :: operator << (e::packer lhs, const ring& rhs)
 {
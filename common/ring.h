@@ -28,6 +28,13 @@
 #ifndef consus_common_ring_h_
 #define consus_common_ring_h_
 
+// STL
+#include <map>
+#include <vector>
+
+// e
+#include <e/slice.h>
+
 // consus
 #include "namespace.h"
 #include "common/constants.h"
@@ -46,6 +53,30 @@ class ring
     public:
         void get_owners(comm_id owners[CONSUS_KVS_PARTITIONS]);
         void set_owners(comm_id owners[CONSUS_KVS_PARTITIONS], uint64_t* post_inc_counter);
+        // Walk the ring starting at partition "index", collecting up to "max"
+        // distinct owners.  "next_owners" holds, in the same position, the
+        // owner that will be there once every partition has moved to its
+        // next owner, or comm_id() where that is unchanged.  Returns the
+        // number of owners collected.  "max" must not exceed
+        // CONSUS_MAX_REPLICATION_FACTOR.
+        unsigned replicas(unsigned index, unsigned max,
+                          comm_id* owners, comm_id* next_owners) const;
+        // For each partition moving to a new owner, keyed by its index, the
+        // indices whose first "max" replicas gain that owner.  Each such
+        // index goes with the first partition on its walk that moves to the
+        // new owner from one of its current replicas, so that exactly one
+        // migration copies it.  A moving partition is always among its own.
+        void migrations(unsigned max,
+                        std::map<unsigned, std::vector<unsigned> >* indices) const;
+
+    public:
+        // The partition responsible for (table, key).
+        static unsigned partition_index(const e::slice& table, const e::slice& key);
+
+    private:
+        // the first "max" distinct owners on the walk from "index", as the
+        // ring is or, if "next", as it will be after every move
+        unsigned walk(unsigned index, unsigned max, bool next, comm_id* owners) const;
 
     public:
         data_center_id dc;
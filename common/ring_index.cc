@@ -0,0 +1,131 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <map>
+
+// consus
+#include "common/ring_index.h"
+
+using consus::ring_index;
+
+ring_index :: replicas_t :: replicas_t()
+    : num(0)
+{
+}
+
+bool
+ring_index :: replicas_t :: operator < (const replicas_t& rhs) const
+{
+    if (num != rhs.num)
+    {
+        return num < rhs.num;
+    }
+
+    for (unsigned i = 0; i < num; ++i)
+    {
+        if (owners[i] != rhs.owners[i])
+        {
+            return owners[i] < rhs.owners[i];
+        }
+
+        if (next_owners[i] != rhs.next_owners[i])
+        {
+            return next_owners[i] < rhs.next_owners[i];
+        }
+    }
+
+    return false;
+}
+
+ring_index :: ring_index()
+    : m_dc()
+    , m_partitions()
+    , m_sets()
+{
+}
+
+ring_index :: ~ring_index() throw ()
+{
+}
+
+void
+ring_index :: init(const ring& r)
+{
+    m_dc = r.dc;
+    m_partitions.resize(CONSUS_KVS_PARTITIONS);
+    m_sets.clear();
+    std::map<replicas_t, uint16_t> seen;
+    uint16_t current = 0;
+
+    for (unsigned p = 0; p < CONSUS_KVS_PARTITIONS; ++p)
+    {
+        const partition& part(r.partitions[p]);
+
+        // every partition in a run of the same owner and next owner has the
+        // same replicas, so only walk the ring at the start of each run
+        if (p == 0 ||
+            part.owner != r.partitions[p - 1].owner ||
+            part.next_owner != r.partitions[p - 1].next_owner)
+        {
+            replicas_t rs;
+            rs.num = r.replicas(p, CONSUS_MAX_REPLICATION_FACTOR,
+                                rs.owners, rs.next_owners);
+            std::map<replicas_t, uint16_t>::iterator it = seen.find(rs);
+
+            if (it != seen.end())
+            {
+                current = it->second;
+            }
+            else
+            {
+                // at most CONSUS_KVS_PARTITIONS sets, so this fits
+                current = m_sets.size();
+                m_sets.push_back(rs);
+                seen.insert(std::make_pair(rs, current));
+            }
+        }
+
+        m_partitions[p] = current;
+    }
+}
+
+unsigned
+ring_index :: replicas(unsigned index,
+                       const comm_id** owners,
+                       const comm_id** next_owners) const
+{
+    if (index >= m_partitions.size())
+    {
+        return 0;
+    }
+
+    const replicas_t& rs(m_sets[m_partitions[index]]);
+    *owners = rs.owners;
+    *next_owners = rs.next_owners;
+    return rs.num;
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_common_ring_index_h_
+#define consus_common_ring_index_h_
+
+// STL
+#include <vector>
+
+// consus
+#include "namespace.h"
+#include "common/constants.h"
+#include "common/ids.h"
+#include "common/ring.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The replicas of every partition of a ring, computed once when a
+// configuration is installed so that hashing a key is a table lookup.
+// Partitions map to a small table of distinct replica sets; a ring assigned
+// in contiguous runs typically has only a handful.
+class ring_index
+{
+    public:
+        ring_index();
+        ~ring_index() throw ();
+
+    public:
+        void init(const ring& r);
+        data_center_id dc() const { return m_dc; }
+        // Same as ring::replicas(index, CONSUS_MAX_REPLICATION_FACTOR, ...),
+        // except that "owners" and "next_owners" point into the index.
+        unsigned replicas(unsigned index,
+                          const comm_id** owners,
+                          const comm_id** next_owners) const;
+        size_t distinct_replica_sets() const { return m_sets.size(); }
+
+    private:
+        struct replicas_t
+        {
+            replicas_t();
+            bool operator < (const replicas_t& rhs) const;
+            unsigned num;
+            comm_id owners[CONSUS_MAX_REPLICATION_FACTOR];
+            comm_id next_owners[CONSUS_MAX_REPLICATION_FACTOR];
+        };
+
+    private:
+        data_center_id m_dc;
+        std::vector<uint16_t> m_partitions;
+        std::vector<replicas_t> m_sets;
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_common_ring_index_h_
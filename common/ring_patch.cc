@@ -0,0 +1,177 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// consus
+#include "common/ring_patch.h"
+
+using consus::ring_patch;
+
+ring_patch :: ring_patch()
+    : dc()
+    , partitions()
+{
+}
+
+ring_patch :: ~ring_patch() throw ()
+{
+}
+
+bool
+consus :: diff_rings(const std::vector<ring>& base,
+                     const std::vector<ring>& current,
+                     std::vector<ring_patch>* patches)
+{
+    patches->clear();
+
+    if (base.size() != current.size())
+    {
+        return false;
+    }
+
+    patches->resize(current.size());
+
+    for (size_t i = 0; i < current.size(); ++i)
+    {
+        if (base[i].dc != current[i].dc)
+        {
+            patches->clear();
+            return false;
+        }
+
+        ring_patch* rp = &(*patches)[i];
+        rp->dc = current[i].dc;
+
+        for (unsigned p = 0; p < CONSUS_KVS_PARTITIONS; ++p)
+        {
+            if (base[i].partitions[p] != current[i].partitions[p])
+            {
+                rp->partitions.push_back(current[i].partitions[p]);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool
+consus :: patch_rings(const std::vector<ring_ptr>& base,
+                      const std::vector<ring_patch>& patches,
+                      std::vector<ring_ptr>* rings)
+{
+    rings->clear();
+
+    if (base.size() != patches.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < patches.size(); ++i)
+    {
+        const ring_patch& rp(patches[i]);
+
+        if (!base[i] || base[i]->dc != rp.dc)
+        {
+            rings->clear();
+            return false;
+        }
+
+        if (rp.partitions.empty())
+        {
+            rings->push_back(base[i]);
+            continue;
+        }
+
+        e::compat::shared_ptr<ring> r(new ring(*base[i]));
+
+        for (size_t p = 0; p < rp.partitions.size(); ++p)
+        {
+            // index is a uint16_t and so always within the ring
+            const partition& part(rp.partitions[p]);
+            r->partitions[part.index] = part;
+        }
+
+        rings->push_back(r);
+    }
+
+    return true;
+}
+
+size_t
+consus :: patched_partitions(const std::vector<ring_patch>& patches)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < patches.size(); ++i)
+    {
+        count += patches[i].partitions.size();
+    }
+
+    return count;
+}
+
+e::packer
+consus :: operator << (e::packer lhs, const ring_patch& rhs)
+{
+    return lhs << rhs.dc << rhs.partitions;
+}
+
+e::unpacker
+consus :: operator >> (e::unpacker lhs, ring_patch& rhs)
+{
+    return lhs >> rhs.dc >> rhs.partitions;
+}
+
+// same encoding as std::vector<ring>
+e::packer
+consus :: operator << (e::packer lhs, const std::vector<ring_ptr>& rhs)
+{
+    lhs = lhs << uint32_t(rhs.size());
+
+    for (size_t i = 0; i < rhs.size(); ++i)
+    {
+        lhs = lhs << *rhs[i];
+    }
+
+    return lhs;
+}
+
+e::unpacker
+consus :: operator >> (e::unpacker lhs, std::vector<ring_ptr>& rhs)
+{
+    uint32_t sz = 0;
+    lhs = lhs >> sz;
+    rhs.clear();
+
+    for (uint32_t i = 0; !lhs.error() && i < sz; ++i)
+    {
+        e::compat::shared_ptr<ring> r(new ring());
+        lhs = lhs >> *r;
+        rhs.push_back(r);
+    }
+
+    return lhs;
+}
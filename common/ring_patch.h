@@ -0,0 +1,87 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_common_ring_patch_h_
+#define consus_common_ring_patch_h_
+
+// STL
+#include <vector>
+
+// e
+#include <e/compat.h>
+
+// consus
+#include "namespace.h"
+#include "common/ids.h"
+#include "common/partition.h"
+#include "common/ring.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// Rings are immutable once built so that configurations may share the ones
+// that did not change between versions.
+typedef e::compat::shared_ptr<const ring> ring_ptr;
+
+// The partitions of one data center's ring that differ from a checkpoint.
+struct ring_patch
+{
+    ring_patch();
+    ~ring_patch() throw ();
+
+    data_center_id dc;
+    std::vector<partition> partitions;
+};
+
+// Compute one patch per ring that turns "base" into "current".  Fails if the
+// two do not cover the same data centers in the same order.
+bool
+diff_rings(const std::vector<ring>& base,
+           const std::vector<ring>& current,
+           std::vector<ring_patch>* patches);
+// Apply "patches" to "base".  Rings without changes are shared with "base";
+// the rest are copied before being patched.
+bool
+patch_rings(const std::vector<ring_ptr>& base,
+            const std::vector<ring_patch>& patches,
+            std::vector<ring_ptr>* rings);
+// the number of partitions all patches change
+size_t
+patched_partitions(const std::vector<ring_patch>& patches);
+
+e::packer
+operator << (e::packer lhs, const ring_patch& rhs);
+e::unpacker
+operator >> (e::unpacker lhs, ring_patch& rhs);
+
+e::packer
+operator << (e::packer lhs, const std::vector<ring_ptr>& rhs);
+e::unpacker
+operator >> (e::unpacker lhs, std::vector<ring_ptr>& rhs);
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_common_ring_patch_h_
@@ -0,0 +1,311 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef consus_common_timer_wheel_h_
+#define consus_common_timer_wheel_h_
+
+// C
+#include <assert.h>
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// A two-level hierarchical timer wheel.  The inner wheel has one slot per tick
+// and covers the next "slots" ticks; the outer wheel has one slot per
+// revolution of the inner wheel and is cascaded inward a revolution at a time.
+// Anything further out than the outer wheel reaches waits in its outer slot
+// and is placed again on each cascade.  Items are copied in and out, so T
+// should be small (e.g. a state_key).
+template <typename T>
+class timer_wheel
+{
+    public:
+        timer_wheel(uint64_t tick, size_t slots);
+        ~timer_wheel() throw ();
+
+    public:
+        uint64_t tick() const { return m_tick; }
+        // ask that "t" be returned by expire no earlier than "when"; returns
+        // the end of the tick in which it will actually come due
+        uint64_t schedule(uint64_t when, const T& t);
+        // append to "due" everything scheduled at or before "now"
+        void expire(uint64_t now, std::vector<T>* due);
+        size_t size();
+
+    private:
+        struct entry
+        {
+            entry() : tick(), t() {}
+            entry(uint64_t tk, const T& _t) : tick(tk), t(_t) {}
+            uint64_t tick;
+            T t;
+        };
+        typedef std::vector<entry> slot_t;
+
+    private:
+        void place(const entry& e);
+
+    private:
+        const uint64_t m_tick;
+        const uint64_t m_slots;
+        po6::threads::mutex m_mtx;
+        std::vector<slot_t> m_inner;
+        std::vector<slot_t> m_outer;
+        // every entry for ticks up to and including m_expired has been
+        // returned by expire
+        uint64_t m_expired;
+        size_t m_size;
+
+    private:
+        timer_wheel(const timer_wheel&);
+        timer_wheel& operator = (const timer_wheel&);
+};
+
+template <typename T>
+timer_wheel<T> :: timer_wheel(uint64_t t, size_t slots)
+    : m_tick(t)
+    , m_slots(slots)
+    , m_mtx()
+    , m_inner(slots)
+    , m_outer(slots)
+    , m_expired(0)
+    , m_size(0)
+{
+    assert(m_tick > 0);
+    assert(m_slots > 0);
+}
+
+template <typename T>
+timer_wheel<T> :: ~timer_wheel() throw ()
+{
+}
+
+template <typename T>
+uint64_t
+timer_wheel<T> :: schedule(uint64_t when, const T& t)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    // round up so that the entry never comes due before "when"
+    uint64_t tk = (when + m_tick - 1) / m_tick;
+
+    if (tk <= m_expired)
+    {
+        tk = m_expired + 1;
+    }
+
+    place(entry(tk, t));
+    ++m_size;
+    return tk * m_tick;
+}
+
+template <typename T>
+void
+timer_wheel<T> :: expire(uint64_t now, std::vector<T>* due)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    const uint64_t tk = now / m_tick;
+
+    if (tk <= m_expired)
+    {
+        return;
+    }
+
+    // Stepping tick by tick is only worthwhile when it is cheaper than
+    // visiting every entry.  After a long stall (or on the first call, when
+    // m_expired is still zero), redistribute everything relative to now.
+    if (tk - m_expired > m_slots)
+    {
+        slot_t all;
+
+        for (size_t i = 0; i < m_slots; ++i)
+        {
+            all.insert(all.end(), m_inner[i].begin(), m_inner[i].end());
+            all.insert(all.end(), m_outer[i].begin(), m_outer[i].end());
+            m_inner[i].clear();
+            m_outer[i].clear();
+        }
+
+        m_expired = tk;
+
+        for (size_t i = 0; i < all.size(); ++i)
+        {
+            if (all[i].tick <= tk)
+            {
+                due->push_back(all[i].t);
+                --m_size;
+            }
+            else
+            {
+                place(all[i]);
+            }
+        }
+
+        return;
+    }
+
+    while (m_expired < tk)
+    {
+        // before each revolution starts, pull its outer slot inward
+        if ((m_expired + 1) % m_slots == 0)
+        {
+            slot_t cascade;
+            cascade.swap(m_outer[((m_expired + 1) / m_slots) % m_slots]);
+
+            for (size_t i = 0; i < cascade.size(); ++i)
+            {
+                place(cascade[i]);
+            }
+        }
+
+        ++m_expired;
+
+        // everything placed in the inner wheel is exactly this tick
+        slot_t& slot(m_inner[m_expired % m_slots]);
+
+        for (size_t i = 0; i < slot.size(); ++i)
+        {
+            assert(slot[i].tick == m_expired);
+            due->push_back(slot[i].t);
+        }
+
+        m_size -= slot.size();
+        slot.clear();
+    }
+}
+
+template <typename T>
+size_t
+timer_wheel<T> :: size()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_size;
+}
+
+template <typename T>
+void
+timer_wheel<T> :: place(const entry& e)
+{
+    assert(e.tick > m_expired);
+
+    if (e.tick - m_expired <= m_slots)
+    {
+        m_inner[e.tick % m_slots].push_back(e);
+    }
+    else
+    {
+        m_outer[(e.tick / m_slots) % m_slots].push_back(e);
+    }
+}
+
+// The pump a state machine keeps scheduled on its daemon's timer wheel, so
+// that it gets to resend whatever goes unanswered.  D is the daemon; it must
+// provide "schedule_pump(P, const K&, uint64_t when)", which may
+// return the time the pump will actually come due.  P is the daemon's pump
+// type.
+class pump_wakeup
+{
+    public:
+        pump_wakeup() : m_when(0) {}
+
+    public:
+        uint64_t when() const { return m_when; }
+        // Have a pump come due by "when" unless a pending one already will.
+        // For state machines that reconsider every request when pumped and
+        // schedule their next wakeup from there.
+        template <typename D, typename P, typename K>
+        void no_later_than(D* d, P type, const K& key,
+                           uint64_t now, uint64_t when);
+        // Have a pump come due at or after "when" unless a pending one
+        // already will.  For state machines that, when pumped, act only on
+        // what is due and schedule nothing otherwise, so a pump that comes
+        // too early would leave them stalled.
+        template <typename D, typename P, typename K>
+        void no_earlier_than(D* d, P type, const K& key,
+                             uint64_t when);
+
+    private:
+        uint64_t m_when;
+};
+
+template <typename D, typename P, typename K>
+void
+pump_wakeup :: no_later_than(D* d, P type, const K& key,
+                             uint64_t now, uint64_t when)
+{
+    if (m_when <= now || when < m_when)
+    {
+        m_when = when;
+        d->schedule_pump(type, key, when);
+    }
+}
+
+template <typename D, typename P, typename K>
+void
+pump_wakeup :: no_earlier_than(D* d, P type, const K& key,
+                               uint64_t when)
+{
+    if (when > m_when)
+    {
+        m_when = d->schedule_pump(type, key, when);
+    }
+}
+
+// When the first of "requests" comes due for a resend, given that each is
+// resent "interval" after its last_request_time; never later than
+// "interval" from now.
+template <typename R>
+uint64_t
+next_resend(const std::vector<R>& requests, uint64_t now, uint64_t interval)
+{
+    uint64_t when = now + interval + 1;
+
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        const uint64_t t = requests[i].last_request_time + interval + 1;
+
+        if (t > now && t < when)
+        {
+            when = t;
+        }
+    }
+
+    return when;
+}
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_common_timer_wheel_h_
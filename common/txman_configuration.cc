@@ -26,6 +26,7 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 // STL
+#include <set>
 #include <sstream>
 
 // consus
@@ -36,26 +37,49 @@ consus :: txman_configuration(e::unpacker up,
                               cluster_id* cid,
                               version_id* vid,
                               uint64_t* flags,
+                              uint64_t* low_water,
                               std::vector<data_center>* dcs,
                               std::vector<txman_state>* txmans,
                               std::vector<paxos_group>* txman_groups,
-                              std::vector<kvs>* kvss)
+                              std::vector<kvs>* kvss,
+                              version_id* checkpoint,
+                              std::vector<ring_ptr>* rings,
+                              std::vector<ring_patch>* patches)
 {
-    return up >> *cid >> *vid >> *flags >> *dcs >> *txmans >> *txman_groups >> *kvss;
+    up = up >> *cid >> *vid >> *flags >> *low_water >> *dcs >> *txmans >> *txman_groups >> *kvss >> *checkpoint;
+    rings->clear();
+    patches->clear();
+
+    if (up.error())
+    {
+        return up;
+    }
+
+    if (*checkpoint == *vid)
+    {
+        return up >> *rings;
+    }
+    else
+    {
+        return up >> *patches;
+    }
 }
 
 std::string
 consus :: txman_configuration(const cluster_id& cid,
                               const version_id& vid,
                               uint64_t,
+                              uint64_t low_water,
                               const std::vector<data_center>& dcs,
                               const std::vector<txman_state>& txmans,
                               const std::vector<paxos_group>& txman_groups,
-                              const std::vector<kvs>& kvss)
+                              const std::vector<kvs>& kvss,
+                              const std::vector<ring_ptr>& rings)
 {
     std::ostringstream ostr;
     ostr << cid << "\n"
-         << vid << "\n";
+         << vid << "\n"
+         << "low water mark " << low_water << "\n";
 
     if (dcs.empty())
     {
@@ -129,5 +153,21 @@ consus :: txman_configuration(const cluster_id& cid,
         ostr << kvss[i] << "\n";
     }
 
+    for (size_t i = 0; i < rings.size(); ++i)
+    {
+        std::set<comm_id> owners;
+
+        for (size_t p = 0; p < CONSUS_KVS_PARTITIONS; ++p)
+        {
+            if (rings[i]->partitions[p].owner != comm_id())
+            {
+                owners.insert(rings[i]->partitions[p].owner);
+            }
+        }
+
+        ostr << "ring for " << rings[i]->dc << " spread across "
+             << owners.size() << " key value stores\n";
+    }
+
     return ostr.str();
 }
@@ -34,25 +34,36 @@
 #include "common/ids.h"
 #include "common/kvs.h"
 #include "common/paxos_group.h"
+#include "common/ring.h"
+#include "common/ring_patch.h"
 #include "common/txman_state.h"
 
 BEGIN_CONSUS_NAMESPACE
 
+// Rings are encoded as in kvs_configuration:  in full when the checkpoint is
+// this version, and otherwise as patches against the rings of the checkpoint,
+// which the coordinator also publishes as "txmanckpt".
 e::unpacker txman_configuration(e::unpacker up,
                                 cluster_id* cid,
                                 version_id* vid,
                                 uint64_t* flags,
+                                uint64_t* low_water,
                                 std::vector<data_center>* dcs,
                                 std::vector<txman_state>* txmans,
                                 std::vector<paxos_group>* txman_groups,
-                                std::vector<kvs>* kvss);
+                                std::vector<kvs>* kvss,
+                                version_id* checkpoint,
+                                std::vector<ring_ptr>* rings,
+                                std::vector<ring_patch>* patches);
 std::string txman_configuration(const cluster_id& cid,
                                 const version_id& vid,
                                 uint64_t flags,
+                                uint64_t low_water,
                                 const std::vector<data_center>& dcs,
                                 const std::vector<txman_state>& txmans,
                                 const std::vector<paxos_group>& txman_groups,
-                                const std::vector<kvs>& kvss);
+                                const std::vector<kvs>& kvss,
+                                const std::vector<ring_ptr>& rings);
 
 END_CONSUS_NAMESPACE
 
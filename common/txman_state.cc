@@ -48,6 +48,7 @@ txman_state :: txman_state()
     : tx()
     , state()
     , nonce()
+    , low_water()
 {
 }
 
@@ -55,6 +56,7 @@ txman_state :: txman_state(const txman& t)
     : tx(t)
     , state(REGISTERED)
     , nonce()
+    , low_water()
 {
 }
 
@@ -62,6 +64,7 @@ txman_state :: txman_state(const txman_state& other)
     : tx(other.tx)
     , state(other.state)
     , nonce(other.nonce)
+    , low_water(other.low_water)
 {
 }
 
@@ -77,6 +80,7 @@ txman_state :: operator = (const txman_state& rhs)
         tx = rhs.tx;
         state = rhs.state;
         nonce = rhs.nonce;
+        low_water = rhs.low_water;
     }
 
     return *this;
@@ -90,6 +94,7 @@ consus :: operator << (std::ostream& lhs, const txman_state& rhs)
                << ", dc=" << rhs.tx.dc.get()
                << ", state=" << rhs.state
                << ", nonce=" << rhs.nonce
+               << ", low_water=" << rhs.low_water
                << ")";
 }
 
@@ -111,13 +116,13 @@ consus :: operator << (std::ostream& lhs, const txman_state::state_t& rhs)
 e::packer
 consus :: operator << (e::packer lhs, const txman_state& rhs)
 {
-    return lhs << rhs.tx << rhs.state << rhs.nonce;
+    return lhs << rhs.tx << rhs.state << rhs.nonce << rhs.low_water;
 }
 
 e::unpacker
 consus :: operator >> (e::unpacker lhs, txman_state& rhs)
 {
-    return lhs >> rhs.tx >> rhs.state >> rhs.nonce;
+    return lhs >> rhs.tx >> rhs.state >> rhs.nonce >> rhs.low_water;
 }
 
 e::packer
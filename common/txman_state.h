@@ -65,6 +65,8 @@ class txman_state
         txman tx;
         state_t state;
         uint64_t nonce;
+        // the txman has no transaction in flight that began before this
+        uint64_t low_water;
 };
 
 std::ostream&
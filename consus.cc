@@ -45,6 +45,7 @@ main(int argc, const char* argv[])
     cmds.push_back(e::subcommand("create-data-center",  "Create a new data center"));
     cmds.push_back(e::subcommand("set-default-data-center", "Set the default data center for new servers"));
     cmds.push_back(e::subcommand("availability-check",  "Check that the cluster has sufficient availability"));
+    cmds.push_back(e::subcommand("upgrade-kvs-data",    "Convert a key value store's data to the current format"));
     cmds.push_back(e::subcommand("debug",             	"Debug tools for Consus developers"));
     return dispatch_to_subcommands(argc, argv,
                                    "consus", "Consus",
@@ -36,13 +36,18 @@
 #include <sstream>
 #include <string>
 
+// po6
+#include <po6/time.h>
+
 // e
 #include <e/strescape.h>
 
 // consus
 #include "common/coordinator_returncode.h"
 #include "common/macros.h"
+#include "common/ring_patch.h"
 #include "coordinator/coordinator.h"
+#include "coordinator/rebalance.h"
 #include "coordinator/util.h"
 
 #pragma GCC diagnostic ignored "-Wlarger-than="
@@ -99,6 +104,7 @@ coordinator :: coordinator()
     , m_version()
     , m_flags(0)
     , m_counter(1)
+    , m_low_water(0)
     , m_dc_default()
     , m_dcs()
     , m_txmans()
@@ -110,6 +116,8 @@ coordinator :: coordinator()
     , m_kvss_changed(false)
     , m_rings()
     , m_migrated()
+    , m_checkpoint()
+    , m_checkpoint_rings()
 {
 }
 
@@ -328,6 +336,7 @@ coordinator :: txman_online(rsm_context* ctx, comm_id id, const po6::net::locati
                      txman_state::to_string(txman_state::ONLINE), nonce);
         ts->state = txman_state::ONLINE;
         ts->nonce = nonce;
+        ts->low_water = 0;
         changed = true;
         txman_availability_changed();
     }
@@ -337,6 +346,7 @@ coordinator :: txman_online(rsm_context* ctx, comm_id id, const po6::net::locati
                      "'s nonce from %" PRIu64 " to %" PRIu64 "\n",
                      id.get(), ts->nonce, nonce);
         ts->nonce = nonce;
+        ts->low_water = 0;
         changed = true;
     }
 
@@ -393,6 +403,17 @@ coordinator :: txman_offline(rsm_context* ctx, comm_id id, const po6::net::locat
     return generate_response(ctx, COORD_SUCCESS);
 }
 
+void
+coordinator :: txman_low_water(rsm_context*, comm_id id, uint64_t timestamp)
+{
+    txman_state* ts = get_txman(id);
+
+    if (ts && ts->state == txman_state::ONLINE)
+    {
+        ts->low_water = timestamp;
+    }
+}
+
 consus::kvs_state*
 coordinator :: get_kvs(comm_id lk)
 {
@@ -584,6 +605,11 @@ coordinator :: tick(rsm_context* ctx)
         }
     }
 
+    if (advance_low_water(ctx))
+    {
+        changed = true;
+    }
+
     ++m_kvs_quiescence_counter;
 
     if (m_kvs_quiescence_counter >= KVS_TICK_LIMIT && m_kvss_changed)
@@ -627,7 +653,10 @@ coordinator :: recreate(rsm_context* /*ctx*/,
             >> c->m_kvs_quiescence_counter
             >> e::unpack_uint8<bool>(c->m_kvss_changed)
             >> c->m_rings
-            >> c->m_migrated;
+            >> c->m_migrated
+            >> c->m_low_water
+            >> c->m_checkpoint
+            >> c->m_checkpoint_rings;
 
     if (up.error())
     {
@@ -654,7 +683,10 @@ coordinator :: snapshot(rsm_context* /*ctx*/,
         << m_kvs_quiescence_counter
         << e::pack_uint8<bool>(m_kvss_changed)
         << m_rings
-        << m_migrated;
+        << m_migrated
+        << m_low_water
+        << m_checkpoint
+        << m_checkpoint_rings;
     char* ptr = static_cast<char*>(malloc(buf.size()));
     *data = ptr;
     *data_sz = buf.size();
@@ -692,6 +724,26 @@ coordinator :: generate_next_configuration(rsm_context* ctx)
         }
     }
 
+    // The rings go to transaction managers and key-value stores as the
+    // partitions that changed since the last checkpoint.  A new checkpoint
+    // goes out when the patches grow too large to be worth it, when the set of
+    // rings changes, or when none has been published yet.
+    const uint64_t KVS_CHECKPOINT_INTERVAL = 64;
+    const size_t KVS_CHECKPOINT_PARTITIONS = CONSUS_KVS_PARTITIONS / 4;
+    std::vector<ring_patch> patches;
+
+    if (m_checkpoint == version_id() ||
+        m_version.get() >= m_checkpoint.get() + KVS_CHECKPOINT_INTERVAL ||
+        !diff_rings(m_checkpoint_rings, m_rings, &patches) ||
+        patched_partitions(patches) > KVS_CHECKPOINT_PARTITIONS * m_rings.size())
+    {
+        m_checkpoint = m_version;
+        m_checkpoint_rings = m_rings;
+        patches.clear();
+    }
+
+    const bool checkpoint = m_checkpoint == m_version;
+
     // client configuration
     std::string clientconf;
     e::packer(&clientconf) << m_cluster << m_version << m_flags << txmans;
@@ -700,14 +752,37 @@ coordinator :: generate_next_configuration(rsm_context* ctx)
     // txman configuration
     std::string txmanconf;
     e::packer(&txmanconf)
-        << m_cluster << m_version << m_flags
-        << m_dcs << m_txmans << m_txman_groups << kvss;
+        << m_cluster << m_version << m_flags << m_low_water
+        << m_dcs << m_txmans << m_txman_groups << kvss << m_checkpoint;
+
+    if (checkpoint)
+    {
+        e::packer(&txmanconf) << m_rings;
+        rsm_cond_broadcast_data(ctx, "txmanckpt", txmanconf.data(), txmanconf.size());
+    }
+    else
+    {
+        e::packer(&txmanconf) << patches;
+    }
+
     rsm_cond_broadcast_data(ctx, "txmanconf", txmanconf.data(), txmanconf.size());
 
     // kvs configuration
     std::string kvsconf;
     e::packer(&kvsconf)
-        << m_cluster << m_version << m_flags << m_kvss << m_rings;
+        << m_cluster << m_version << m_flags << m_low_water
+        << m_kvss << m_checkpoint;
+
+    if (checkpoint)
+    {
+        e::packer(&kvsconf) << m_rings;
+        rsm_cond_broadcast_data(ctx, "kvsckpt", kvsconf.data(), kvsconf.size());
+    }
+    else
+    {
+        e::packer(&kvsconf) << patches;
+    }
+
     rsm_cond_broadcast_data(ctx, "kvsconf", kvsconf.data(), kvsconf.size());
 }
 
@@ -909,306 +984,6 @@ select_active_by_data_center(const std::vector<kvs_state>& kvss,
     }
 }
 
-template <typename T>
-unsigned
-compute_partition_count(T parts[CONSUS_KVS_PARTITIONS])
-{
-    unsigned idx = 0;
-    unsigned partitions = 0;
-
-    while (idx < CONSUS_KVS_PARTITIONS)
-    {
-        unsigned end = idx + 1;
-
-        while (end < CONSUS_KVS_PARTITIONS &&
-               parts[idx] == parts[end])
-        {
-            ++end;
-        }
-
-        ++partitions;
-        idx = end;
-    }
-
-    return partitions;
-}
-
-void
-map_owners_to_indices(comm_id owners[CONSUS_KVS_PARTITIONS],
-                      unsigned partitions[CONSUS_KVS_PARTITIONS])
-{
-    unsigned idx = 0;
-    unsigned count = 0;
-
-    while (idx < CONSUS_KVS_PARTITIONS)
-    {
-        unsigned end = idx;
-
-        while (end < CONSUS_KVS_PARTITIONS &&
-               owners[idx] == owners[end])
-        {
-            partitions[end] = count;
-            ++end;
-        }
-
-        ++count;
-        idx = end;
-    }
-}
-
-void
-evenly_distribute_indices(unsigned count,
-                          unsigned partitions[CONSUS_KVS_PARTITIONS])
-{
-    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
-    {
-        partitions[i] = 0;
-    }
-
-    const unsigned size = CONSUS_KVS_PARTITIONS / count;
-    const unsigned excess = CONSUS_KVS_PARTITIONS % count;
-    unsigned idx = 0;
-
-    for (size_t i = 0; i < count; ++i)
-    {
-        const unsigned this_size = size + (i < excess ? 1 : 0);
-
-        for (size_t j = 0; j < this_size; ++j)
-        {
-            partitions[idx + j] = i;
-        }
-
-        idx += this_size;
-    }
-
-    assert(partitions[CONSUS_KVS_PARTITIONS - 1] == count - 1);
-}
-
-void
-stable_marriage(comm_id current_owners[CONSUS_KVS_PARTITIONS],
-                comm_id new_owners[CONSUS_KVS_PARTITIONS],
-                unsigned new_partitions)
-{
-    // map CONSUS_KVS_PARTITIONS buckets onto a smaller number of buckets (the
-    // value of each element in the arrays)
-    unsigned part1[CONSUS_KVS_PARTITIONS];
-    unsigned part2[CONSUS_KVS_PARTITIONS];
-    // label each contiguous block of owners with a unique id
-    map_owners_to_indices(current_owners, part1);
-    // create an ideal distribution of N partitions
-    evenly_distribute_indices(new_partitions, part2);
-    const unsigned n1 = compute_partition_count(part1);
-    const unsigned n2 = new_partitions;
-    assert(n2 == compute_partition_count(part2));
-    // preference weights for the stable marriage algorithm
-    // prefs1: part1/current for part2/new
-    // prefs2: part2/new for part1/current
-    std::map<std::pair<unsigned, unsigned>, unsigned> prefs1;
-    std::map<std::pair<unsigned, unsigned>, unsigned> prefs2;
-
-    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
-    {
-        ++prefs1[std::make_pair(part1[i], part2[i])];
-        ++prefs2[std::make_pair(part2[i], part1[i])];
-    }
-
-    // who is assigned to whom; matches part1/part2
-    // assign1: values [0:n1] value CONSUS_KVS_PARTITIONS means unassigned
-    // assign2: values [0:n2] value CONSUS_KVS_PARTITIONS means unassigned
-    // it's sized CONSUS_KVS_PARTITIONS for static allocation
-    unsigned assign1[CONSUS_KVS_PARTITIONS];
-    unsigned assign2[CONSUS_KVS_PARTITIONS];
-
-    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
-    {
-        assign1[i] = CONSUS_KVS_PARTITIONS;
-        assign2[i] = CONSUS_KVS_PARTITIONS;
-    }
-
-    std::set<std::pair<unsigned, unsigned> > proposals;
-
-    while (true)
-    {
-        // if either assign1 or assign2 is completely mapped
-        if (std::find(assign1, assign1 + n1, CONSUS_KVS_PARTITIONS) == assign1 + n1 ||
-            std::find(assign2, assign2 + n2, CONSUS_KVS_PARTITIONS) == assign2 + n2)
-        {
-            break;
-        }
-
-        // consider everyone in the first group
-        for (unsigned idx1 = 0; idx1 < n1; ++idx1)
-        {
-            // if already matched
-            if (assign1[idx1] < CONSUS_KVS_PARTITIONS)
-            {
-                continue;
-            }
-
-            unsigned best_candidate = CONSUS_KVS_PARTITIONS;
-            unsigned best_preference = 0;
-
-            // consider everyone in the second group
-            for (unsigned idx2 = 0; idx2 < n2; ++idx2)
-            {
-                // if there's already a proposal from 1->2
-                if (proposals.find(std::make_pair(idx1, idx2)) != proposals.end())
-                {
-                    continue;
-                }
-
-                std::map<std::pair<unsigned, unsigned>, unsigned>::iterator it;
-                it = prefs1.find(std::make_pair(idx1, idx2));
-                // what's idx1's preference for idx2?
-                const unsigned preference = it != prefs1.end() ? it->second : 0;
-
-                // pick
-                if (best_candidate == CONSUS_KVS_PARTITIONS ||
-                    best_preference < preference)
-                {
-                    best_candidate = idx2;
-                    best_preference = preference;
-                }
-            }
-
-            // if no one to propose to
-            if (best_candidate == CONSUS_KVS_PARTITIONS)
-            {
-                continue;
-            }
-
-            proposals.insert(std::make_pair(idx1, best_candidate));
-
-            // if idx1's preference is unmatched, match them
-            if (assign2[best_candidate] == CONSUS_KVS_PARTITIONS)
-            {
-                assign1[idx1] = best_candidate;
-                assign2[best_candidate] = idx1;
-            }
-            else
-            {
-                std::map<std::pair<unsigned, unsigned>, unsigned>::iterator it;
-                it = prefs2.find(std::make_pair(best_candidate, assign2[best_candidate]));
-                // candidate's preference for its current match
-                const unsigned cur_preference = it != prefs2.end() ? it->second : 0;
-                it = prefs2.find(std::make_pair(best_candidate, idx1));
-                // candidate's preference for idx1
-                const unsigned new_preference = it != prefs2.end() ? it->second : 0;
-
-                // trade up
-                if (cur_preference < new_preference)
-                {
-                    assign1[assign2[best_candidate]] = CONSUS_KVS_PARTITIONS;
-                    assign1[idx1] = best_candidate;
-                    assign2[best_candidate] = idx1;
-                }
-            }
-        }
-    }
-
-    // fill in new owners
-    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
-    {
-        assert(part2[i] < n2);
-
-        // if this bucket is unassigned
-        if (assign2[part2[i]] == CONSUS_KVS_PARTITIONS)
-        {
-            new_owners[i] = comm_id();
-            continue;
-        }
-
-        // find an element in part1 with the value this partition matches
-        assert(assign2[part2[i]] < n1);
-        unsigned* const ptr = std::find(part1, part1 + CONSUS_KVS_PARTITIONS, assign2[part2[i]]);
-        const unsigned idx = ptr - part1;
-        assert(idx < CONSUS_KVS_PARTITIONS);
-        new_owners[i] = current_owners[idx];
-    }
-}
-
-void
-unassign_discontinuous(comm_id old_owners[CONSUS_KVS_PARTITIONS],
-                       comm_id new_owners[CONSUS_KVS_PARTITIONS])
-{
-    std::map<comm_id, unsigned> counts;
-    comm_id* ptr = new_owners;
-    comm_id* const end = ptr + CONSUS_KVS_PARTITIONS;
-
-    while (ptr < end)
-    {
-        // find the contiguous size of this assignment
-        comm_id* tmp = ptr;
-        // how many partitions are the same in old and new
-        unsigned maintained = 0;
-
-        while (tmp < end && *tmp == *ptr)
-        {
-            if (old_owners[tmp - new_owners] == *ptr)
-            {
-                ++maintained;
-            }
-
-            ++tmp;
-        }
-
-        // look for any previous range assigned to *ptr
-        std::map<comm_id, unsigned>::iterator it = counts.find(*ptr);
-
-        // if *ptr was previously assigned and previous assignment maintained
-        // fewer partitions
-        if (it != counts.end() && it->second < maintained)
-        {
-            for (comm_id* c = new_owners; c < ptr; ++c)
-            {
-                if (*c == *ptr)
-                {
-                    *c = comm_id();
-                }
-            }
-
-            it->second = maintained;
-        }
-        else if (it == counts.end())
-        {
-            counts.insert(std::make_pair(*ptr, maintained));
-        }
-
-        ptr = tmp;
-    }
-}
-
-void
-assign_unassigned(comm_id owners[CONSUS_KVS_PARTITIONS], comm_id* kvs, size_t kvs_sz)
-{
-    comm_id* const owners_end = owners + CONSUS_KVS_PARTITIONS;
-    unsigned part[CONSUS_KVS_PARTITIONS];
-    evenly_distribute_indices(kvs_sz, part);
-
-    for (size_t i = 0; i < kvs_sz; ++i)
-    {
-        if (std::find(owners, owners_end, kvs[i]) != owners_end)
-        {
-            continue;
-        }
-
-        unsigned fill = CONSUS_KVS_PARTITIONS;
-
-        for (size_t j = 0; j < CONSUS_KVS_PARTITIONS; ++j)
-        {
-            if (owners[j] == comm_id() && fill == CONSUS_KVS_PARTITIONS)
-            {
-                fill = part[j];
-            }
-
-            if (part[j] == fill && owners[j] == comm_id())
-            {
-                owners[j] = kvs[i];
-            }
-        }
-    }
-}
-
 struct assignment
 {
     assignment() : p(), t() {}
@@ -1338,9 +1113,7 @@ coordinator :: maintain_kvs_rings(rsm_context* ctx)
         comm_id current_owners[CONSUS_KVS_PARTITIONS];
         r->get_owners(current_owners);
         comm_id new_owners[CONSUS_KVS_PARTITIONS];
-        stable_marriage(current_owners, new_owners, kvss.size());
-        unassign_discontinuous(current_owners, new_owners);
-        assign_unassigned(new_owners, &kvss[0], kvss.size());
+        rebalance_ring(current_owners, &kvss[0], kvss.size(), new_owners);
         r->set_owners(new_owners, &m_counter);
         std::vector<assignment> assignments;
         std::vector<reassignment> reassignments;
@@ -1406,3 +1179,36 @@ coordinator :: finish_migrations(rsm_context* ctx)
     m_migrated.clear();
     return ret;
 }
+
+bool
+coordinator :: advance_low_water(rsm_context* ctx)
+{
+    // every new mark costs a configuration broadcast, so let it trail the
+    // transaction managers' reports by a coarse step
+    const uint64_t LOW_WATER_STEP = 30 * PO6_SECONDS;
+    uint64_t low_water = 0;
+    bool any = false;
+
+    for (size_t i = 0; i < m_txmans.size(); ++i)
+    {
+        if (m_txmans[i].state != txman_state::ONLINE)
+        {
+            continue;
+        }
+
+        // a transaction manager that has yet to report pins the mark
+        low_water = any ? std::min(low_water, m_txmans[i].low_water)
+                        : m_txmans[i].low_water;
+        any = true;
+    }
+
+    if (!any || low_water < m_low_water + LOW_WATER_STEP)
+    {
+        return false;
+    }
+
+    rsm_log(ctx, "advancing the low water mark from %" PRIu64 " to %" PRIu64 "\n",
+                 m_low_water, low_water);
+    m_low_water = low_water;
+    return true;
+}
@@ -73,6 +73,7 @@ class coordinator
         void txman_register(rsm_context* ctx, const txman& t, const std::string& data_center);
         void txman_online(rsm_context* ctx, comm_id id, const po6::net::location& bind_to, uint64_t nonce);
         void txman_offline(rsm_context* ctx, comm_id id, const po6::net::location& bind_to, uint64_t nonce);
+        void txman_low_water(rsm_context* ctx, comm_id id, uint64_t timestamp);
 
     // key value stores
     public:
@@ -104,6 +105,7 @@ class coordinator
         ring* get_or_create_ring(data_center_id id);
         void maintain_kvs_rings(rsm_context* ctx);
         bool finish_migrations(rsm_context* ctx);
+        bool advance_low_water(rsm_context* ctx);
 
     private:
         // meta state
@@ -111,6 +113,7 @@ class coordinator
         version_id m_version;
         uint64_t m_flags;
         uint64_t m_counter;
+        uint64_t m_low_water;
         // data centers
         data_center_id m_dc_default;
         std::vector<data_center> m_dcs;
@@ -127,6 +130,10 @@ class coordinator
         // rings
         std::vector<ring> m_rings;
         std::vector<partition_id> m_migrated;
+        // the rings of the last kvs and txman configurations sent in full;
+        // later ones are sent as patches against these
+        version_id m_checkpoint;
+        std::vector<ring> m_checkpoint_rings;
 
     private:
         coordinator(const coordinator&);
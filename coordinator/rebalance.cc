@@ -0,0 +1,476 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <assert.h>
+
+// STL
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+// consus
+#include "coordinator/rebalance.h"
+
+#pragma GCC diagnostic ignored "-Wlarger-than="
+
+using namespace consus;
+
+namespace
+{
+
+template <typename T>
+unsigned
+compute_partition_count(T parts[CONSUS_KVS_PARTITIONS])
+{
+    unsigned idx = 0;
+    unsigned partitions = 0;
+
+    while (idx < CONSUS_KVS_PARTITIONS)
+    {
+        unsigned end = idx + 1;
+
+        while (end < CONSUS_KVS_PARTITIONS &&
+               parts[idx] == parts[end])
+        {
+            ++end;
+        }
+
+        ++partitions;
+        idx = end;
+    }
+
+    return partitions;
+}
+
+void
+map_owners_to_indices(comm_id owners[CONSUS_KVS_PARTITIONS],
+                      unsigned partitions[CONSUS_KVS_PARTITIONS])
+{
+    unsigned idx = 0;
+    unsigned count = 0;
+
+    while (idx < CONSUS_KVS_PARTITIONS)
+    {
+        unsigned end = idx;
+
+        while (end < CONSUS_KVS_PARTITIONS &&
+               owners[idx] == owners[end])
+        {
+            partitions[end] = count;
+            ++end;
+        }
+
+        ++count;
+        idx = end;
+    }
+}
+
+void
+evenly_distribute_indices(unsigned count,
+                          unsigned partitions[CONSUS_KVS_PARTITIONS])
+{
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        partitions[i] = 0;
+    }
+
+    const unsigned size = CONSUS_KVS_PARTITIONS / count;
+    const unsigned excess = CONSUS_KVS_PARTITIONS % count;
+    unsigned idx = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const unsigned this_size = size + (i < excess ? 1 : 0);
+
+        for (size_t j = 0; j < this_size; ++j)
+        {
+            partitions[idx + j] = i;
+        }
+
+        idx += this_size;
+    }
+
+    assert(partitions[CONSUS_KVS_PARTITIONS - 1] == count - 1);
+}
+
+// how many partitions block "b1" of one labeling shares with block "b2" of
+// the other
+struct overlap
+{
+    overlap() : b1(), b2(), count() {}
+    overlap(unsigned _b1, unsigned _b2) : b1(_b1), b2(_b2), count(1) {}
+
+    unsigned b1;
+    unsigned b2;
+    unsigned count;
+};
+
+// b1's order of preference:  most shared partitions first, then lowest b2
+bool
+preferred(const overlap& lhs, const overlap& rhs)
+{
+    if (lhs.count != rhs.count)
+    {
+        return lhs.count > rhs.count;
+    }
+
+    return lhs.b2 < rhs.b2;
+}
+
+// Both labelings number their contiguous blocks in increasing order along the
+// ring, so every (b1, b2) pair that shares a partition shows up as exactly one
+// run, the runs come out sorted by (b1, b2), and the b2s overlapping any one b1
+// are themselves contiguous.
+class overlaps
+{
+    public:
+        overlaps(unsigned part1[CONSUS_KVS_PARTITIONS],
+                 unsigned part2[CONSUS_KVS_PARTITIONS],
+                 unsigned n1);
+
+    public:
+        // each side's preference for the other
+        unsigned preference(unsigned b1, unsigned b2) const;
+        // the "nth" choice of b1 among n2 blocks, or n2 if b1 has run out
+        unsigned choice(unsigned b1, unsigned nth, unsigned n2) const;
+
+    private:
+        // sorted by (b1, b2); m_offsets[b1] is where b1's pairs start
+        std::vector<overlap> m_by_block;
+        // the same pairs, with each b1's sorted by preference
+        std::vector<overlap> m_by_preference;
+        std::vector<size_t> m_offsets;
+};
+
+overlaps :: overlaps(unsigned part1[CONSUS_KVS_PARTITIONS],
+                     unsigned part2[CONSUS_KVS_PARTITIONS],
+                     unsigned n1)
+    : m_by_block()
+    , m_by_preference()
+    , m_offsets(n1 + 1, 0)
+{
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        if (i > 0 && part1[i] == part1[i - 1] && part2[i] == part2[i - 1])
+        {
+            ++m_by_block.back().count;
+        }
+        else
+        {
+            m_by_block.push_back(overlap(part1[i], part2[i]));
+        }
+    }
+
+    for (size_t i = m_by_block.size(); i > 0; --i)
+    {
+        m_offsets[m_by_block[i - 1].b1] = i - 1;
+    }
+
+    m_offsets[n1] = m_by_block.size();
+    m_by_preference = m_by_block;
+
+    for (unsigned b1 = 0; b1 < n1; ++b1)
+    {
+        std::sort(m_by_preference.begin() + m_offsets[b1],
+                  m_by_preference.begin() + m_offsets[b1 + 1],
+                  preferred);
+    }
+}
+
+unsigned
+overlaps :: preference(unsigned b1, unsigned b2) const
+{
+    const size_t start = m_offsets[b1];
+    const size_t limit = m_offsets[b1 + 1];
+
+    if (b2 < m_by_block[start].b2 || b2 > m_by_block[limit - 1].b2)
+    {
+        return 0;
+    }
+
+    return m_by_block[start + b2 - m_by_block[start].b2].count;
+}
+
+unsigned
+overlaps :: choice(unsigned b1, unsigned nth, unsigned n2) const
+{
+    const size_t start = m_offsets[b1];
+    const size_t shared = m_offsets[b1 + 1] - start;
+
+    if (nth < shared)
+    {
+        return m_by_preference[start + nth].b2;
+    }
+
+    // then every block b1 shares nothing with, lowest first
+    const unsigned lo = m_by_block[start].b2;
+    unsigned b2 = nth - shared;
+
+    if (b2 >= lo)
+    {
+        b2 += shared;
+    }
+
+    return std::min(b2, n2);
+}
+
+void
+stable_marriage(comm_id current_owners[CONSUS_KVS_PARTITIONS],
+                comm_id new_owners[CONSUS_KVS_PARTITIONS],
+                unsigned new_partitions)
+{
+    // map CONSUS_KVS_PARTITIONS buckets onto a smaller number of buckets (the
+    // value of each element in the arrays)
+    unsigned part1[CONSUS_KVS_PARTITIONS];
+    unsigned part2[CONSUS_KVS_PARTITIONS];
+    // label each contiguous block of owners with a unique id
+    map_owners_to_indices(current_owners, part1);
+    // create an ideal distribution of N partitions
+    evenly_distribute_indices(new_partitions, part2);
+    const unsigned n1 = compute_partition_count(part1);
+    const unsigned n2 = new_partitions;
+    assert(n2 == compute_partition_count(part2));
+    // preference weights for the stable marriage algorithm; the weight is
+    // symmetric, so one table serves both groups
+    const overlaps prefs(part1, part2, n1);
+
+    // who is assigned to whom; matches part1/part2
+    // assign1: values [0:n1] value CONSUS_KVS_PARTITIONS means unassigned
+    // assign2: values [0:n2] value CONSUS_KVS_PARTITIONS means unassigned
+    std::vector<unsigned> assign1(n1, CONSUS_KVS_PARTITIONS);
+    std::vector<unsigned> assign2(n2, CONSUS_KVS_PARTITIONS);
+    // how many proposals each of the first group has made; proposals go out
+    // in order of preference, so this is also the next one to make
+    std::vector<unsigned> proposed(n1, 0);
+    // matches only ever trade partners, so both groups have this many
+    // assigned
+    unsigned matched = 0;
+
+    // until either assign1 or assign2 is completely mapped
+    while (matched < n1 && matched < n2)
+    {
+        // consider everyone in the first group
+        for (unsigned idx1 = 0; idx1 < n1; ++idx1)
+        {
+            // if already matched
+            if (assign1[idx1] < CONSUS_KVS_PARTITIONS)
+            {
+                continue;
+            }
+
+            const unsigned best_candidate = prefs.choice(idx1, proposed[idx1], n2);
+
+            // if no one to propose to
+            if (best_candidate >= n2)
+            {
+                continue;
+            }
+
+            ++proposed[idx1];
+
+            // if idx1's preference is unmatched, match them
+            if (assign2[best_candidate] == CONSUS_KVS_PARTITIONS)
+            {
+                assign1[idx1] = best_candidate;
+                assign2[best_candidate] = idx1;
+                ++matched;
+            }
+            else
+            {
+                // candidate's preference for its current match
+                const unsigned cur_preference = prefs.preference(assign2[best_candidate], best_candidate);
+                // candidate's preference for idx1
+                const unsigned new_preference = prefs.preference(idx1, best_candidate);
+
+                // trade up
+                if (cur_preference < new_preference)
+                {
+                    assign1[assign2[best_candidate]] = CONSUS_KVS_PARTITIONS;
+                    assign1[idx1] = best_candidate;
+                    assign2[best_candidate] = idx1;
+                }
+            }
+        }
+    }
+
+    // where each block of part1 begins, so a match maps back to its owner
+    std::vector<unsigned> start1(n1, 0);
+
+    for (unsigned i = CONSUS_KVS_PARTITIONS; i > 0; --i)
+    {
+        start1[part1[i - 1]] = i - 1;
+    }
+
+    // fill in new owners
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        assert(part2[i] < n2);
+
+        // if this bucket is unassigned
+        if (assign2[part2[i]] == CONSUS_KVS_PARTITIONS)
+        {
+            new_owners[i] = comm_id();
+            continue;
+        }
+
+        assert(assign2[part2[i]] < n1);
+        new_owners[i] = current_owners[start1[assign2[part2[i]]]];
+    }
+}
+
+// every run of partitions the scan has passed for one owner, and the most
+// partitions any of those runs kept from before
+struct runs
+{
+    runs() : maintained(), ranges() {}
+
+    unsigned maintained;
+    std::vector<std::pair<size_t, size_t> > ranges;
+};
+
+void
+unassign_discontinuous(comm_id old_owners[CONSUS_KVS_PARTITIONS],
+                       comm_id new_owners[CONSUS_KVS_PARTITIONS])
+{
+    std::map<comm_id, runs> seen;
+    comm_id* ptr = new_owners;
+    comm_id* const end = ptr + CONSUS_KVS_PARTITIONS;
+
+    while (ptr < end)
+    {
+        // find the contiguous size of this assignment
+        comm_id* tmp = ptr;
+        // how many partitions are the same in old and new
+        unsigned maintained = 0;
+
+        while (tmp < end && *tmp == *ptr)
+        {
+            if (old_owners[tmp - new_owners] == *ptr)
+            {
+                ++maintained;
+            }
+
+            ++tmp;
+        }
+
+        // look for any previous range assigned to *ptr
+        std::map<comm_id, runs>::iterator it = seen.find(*ptr);
+
+        // if *ptr was previously assigned and previous assignment maintained
+        // fewer partitions, give up every earlier range; each range is
+        // cleared at most once, so this is linear overall
+        if (it != seen.end() && it->second.maintained < maintained)
+        {
+            for (size_t i = 0; i < it->second.ranges.size(); ++i)
+            {
+                std::fill(new_owners + it->second.ranges[i].first,
+                          new_owners + it->second.ranges[i].second,
+                          comm_id());
+            }
+
+            it->second.ranges.clear();
+            it->second.maintained = maintained;
+        }
+        else if (it == seen.end())
+        {
+            it = seen.insert(std::make_pair(*ptr, runs())).first;
+            it->second.maintained = maintained;
+        }
+
+        it->second.ranges.push_back(std::make_pair(ptr - new_owners, tmp - new_owners));
+        ptr = tmp;
+    }
+}
+
+void
+assign_unassigned(comm_id owners[CONSUS_KVS_PARTITIONS], comm_id* kvs, size_t kvs_sz)
+{
+    unsigned part[CONSUS_KVS_PARTITIONS];
+    evenly_distribute_indices(kvs_sz, part);
+    // owners come in runs, so only the start of each run need be considered
+    std::set<comm_id> owned;
+
+    for (size_t j = 0; j < CONSUS_KVS_PARTITIONS; ++j)
+    {
+        if (j == 0 || owners[j] != owners[j - 1])
+        {
+            owned.insert(owners[j]);
+        }
+    }
+
+    // filling never frees a partition, so the first free partition only ever
+    // moves forward
+    size_t first_free = 0;
+
+    for (size_t i = 0; i < kvs_sz; ++i)
+    {
+        if (owned.find(kvs[i]) != owned.end())
+        {
+            continue;
+        }
+
+        while (first_free < CONSUS_KVS_PARTITIONS && owners[first_free] != comm_id())
+        {
+            ++first_free;
+        }
+
+        if (first_free == CONSUS_KVS_PARTITIONS)
+        {
+            continue;
+        }
+
+        // the free partitions of the ideal block holding the first free one;
+        // blocks are contiguous, so the block ends where the label changes
+        const unsigned fill = part[first_free];
+
+        for (size_t j = first_free; j < CONSUS_KVS_PARTITIONS && part[j] == fill; ++j)
+        {
+            if (owners[j] == comm_id())
+            {
+                owners[j] = kvs[i];
+            }
+        }
+
+        owned.insert(kvs[i]);
+    }
+}
+
+} // namespace
+
+void
+consus :: rebalance_ring(comm_id current_owners[CONSUS_KVS_PARTITIONS],
+                         comm_id* kvss, size_t kvss_sz,
+                         comm_id new_owners[CONSUS_KVS_PARTITIONS])
+{
+    stable_marriage(current_owners, new_owners, kvss_sz);
+    unassign_discontinuous(current_owners, new_owners);
+    assign_unassigned(new_owners, kvss, kvss_sz);
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef consus_coordinator_rebalance_h_
+#define consus_coordinator_rebalance_h_
+
+// C
+#include <stddef.h>
+
+// consus
+#include "namespace.h"
+#include "common/constants.h"
+#include "common/ids.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// Choose the next owner of every partition of one data center's ring, given
+// its current owners and the key value stores active in the data center.
+// Stores are matched to evenly sized runs of partitions so that as many
+// partitions as the stable matching finds keep their current owners.  When
+// an owner is matched to more than one run, its earlier runs are cleared only
+// if a later one keeps more partitions in place, so it may still hold two.
+//
+// Every step is linear in the number of partitions (plus a term in the number
+// of stores), because this runs within the replicated coordinator's tick.
+void
+rebalance_ring(comm_id current_owners[CONSUS_KVS_PARTITIONS],
+               comm_id* kvss, size_t kvss_sz,
+               comm_id new_owners[CONSUS_KVS_PARTITIONS]);
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_coordinator_rebalance_h_
@@ -46,6 +46,7 @@ struct state_machine CONSUS_API rsm = {
      {"txman_register", consus_coordinator_txman_register},
      {"txman_online", consus_coordinator_txman_online},
      {"txman_offline", consus_coordinator_txman_offline},
+     {"txman_low_water", consus_coordinator_txman_low_water},
      {"kvs_register", consus_coordinator_kvs_register},
      {"kvs_online", consus_coordinator_kvs_online},
      {"kvs_offline", consus_coordinator_kvs_offline},
@@ -72,7 +72,9 @@ consus_coordinator_create(rsm_context* ctx)
 {
     rsm_cond_create(ctx, "clientconf");
     rsm_cond_create(ctx, "txmanconf");
+    rsm_cond_create(ctx, "txmanckpt");
     rsm_cond_create(ctx, "kvsconf");
+    rsm_cond_create(ctx, "kvsckpt");
     return new (std::nothrow) coordinator();
 }
 
@@ -163,6 +165,18 @@ consus_coordinator_txman_offline(rsm_context* ctx, void* obj, const char* data,
     c->txman_offline(ctx, id, bind_to, nonce);
 }
 
+CONSUS_API void
+consus_coordinator_txman_low_water(rsm_context* ctx, void* obj, const char* data, size_t data_sz)
+{
+    PROTECT_UNINITIALIZED;
+    comm_id id;
+    uint64_t timestamp;
+    e::unpacker up(data, data_sz);
+    up = up >> id >> timestamp;
+    CHECK_UNPACK(txman_low_water);
+    c->txman_low_water(ctx, id, timestamp);
+}
+
 CONSUS_API void
 consus_coordinator_kvs_register(rsm_context* ctx, void* obj, const char* data, size_t data_sz)
 {
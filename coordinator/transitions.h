@@ -60,6 +60,7 @@ TRANSITION(data_center_default);
 TRANSITION(txman_register);
 TRANSITION(txman_online);
 TRANSITION(txman_offline);
+TRANSITION(txman_low_water);
 
 TRANSITION(kvs_register);
 TRANSITION(kvs_online);
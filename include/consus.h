@@ -74,6 +74,14 @@ void consus_destroy(struct consus_client* client);
 
 int64_t consus_loop(struct consus_client* client, int timeout,
                     enum consus_returncode* status);
+/* returns up to n completed operations at once:  waits like consus_loop for
+ * the first, then takes only what is ready; ids[i] completed with statuses[i]
+ * and the return value is the number filled in, or -1 on error.  Only the
+ * last completion's error is kept:  consus_error_message and
+ * consus_error_location describe the last id filled in */
+int64_t consus_loop_many(struct consus_client* client, int timeout,
+                         int64_t* ids, enum consus_returncode* statuses, size_t n,
+                         enum consus_returncode* status);
 int64_t consus_wait(struct consus_client* client, int64_t id, int timeout,
                     enum consus_returncode* status);
 
@@ -87,6 +95,11 @@ const char* consus_returncode_to_string(enum consus_returncode);
 int64_t consus_begin_transaction(struct consus_client* client,
                                  enum consus_returncode* status,
                                  struct consus_transaction** xact);
+/* like consus_begin_transaction, but puts stay in the client until commit;
+ * gets of those keys see the buffered values */
+int64_t consus_begin_buffered_transaction(struct consus_client* client,
+                                          enum consus_returncode* status,
+                                          struct consus_transaction** xact);
 int64_t consus_commit_transaction(struct consus_transaction* xact,
                                   enum consus_returncode* status);
 int64_t consus_abort_transaction(struct consus_transaction* xact,
@@ -106,6 +119,34 @@ int64_t consus_put(struct consus_transaction* xact,
                    const char* value, size_t value_sz,
                    enum consus_returncode* status);
 
+/* keys and values are raw bytes passed through unconverted; a value read this
+ * way is NUL-terminated for convenience, but value_sz is authoritative */
+int64_t consus_get_binary(struct consus_transaction* xact,
+                          const char* table,
+                          const char* key, size_t key_sz,
+                          enum consus_returncode* status,
+                          char** value, size_t* value_sz);
+int64_t consus_put_binary(struct consus_transaction* xact,
+                          const char* table,
+                          const char* key, size_t key_sz,
+                          const char* value, size_t value_sz,
+                          enum consus_returncode* status);
+
+/* read or write "num" keys of one table as a single operation; values[i] is
+ * NULL when keys[i] is not found */
+int64_t consus_multi_get(struct consus_transaction* xact,
+                         const char* table,
+                         const char* const* keys, const size_t* keys_sz,
+                         size_t num,
+                         enum consus_returncode* status,
+                         char** values, size_t* values_sz);
+int64_t consus_multi_put(struct consus_transaction* xact,
+                         const char* table,
+                         const char* const* keys, const size_t* keys_sz,
+                         const char* const* values, const size_t* values_sz,
+                         size_t num,
+                         enum consus_returncode* status);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif /* __cplusplus */
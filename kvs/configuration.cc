@@ -25,10 +25,11 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
-// e
-#include <e/endian.h>
+// STL
+#include <algorithm>
 
 // consus
+#include "common/constants.h"
 #include "common/kvs_configuration.h"
 #include "kvs/configuration.h"
 
@@ -38,8 +39,14 @@ configuration :: configuration()
     : m_cluster()
     , m_version()
     , m_flags(0)
+    , m_low_water(0)
     , m_kvss()
+    , m_checkpoint()
+    , m_incomplete(false)
+    , m_patches()
     , m_rings()
+    , m_ring_indices()
+    , m_migrations()
 {
 }
 
@@ -111,55 +118,37 @@ configuration :: daemons() const
 
 bool
 configuration :: hash(data_center_id dc,
-                      const e::slice& /* table XXX */,
+                      const e::slice& table,
                       const e::slice& key,
                       replica_set* rs)
 {
-    // XXX use a better mapping scheme
-    char buf[sizeof(uint16_t)];
-    memset(buf, 0, sizeof(buf));
-    memmove(buf, key.data(), key.size() < 2 ? key.size() : 2);
-    uint16_t index;
-    e::unpack16be(buf, &index);
+    const ring_index* ri = NULL;
 
-    ring* r = NULL;
-
-    for (size_t i = 0; i < m_rings.size(); ++i)
+    for (size_t i = 0; i < m_ring_indices.size(); ++i)
     {
-        if (m_rings[i].dc == dc)
+        if (m_ring_indices[i]->dc() == dc)
         {
-            r = &m_rings[i];
+            ri = m_ring_indices[i].get();
             break;
         }
     }
 
-    if (!r)
+    if (!ri)
     {
         return false;
     }
 
-    rs->desired_replication = 5;//XXX
-    rs->num_replicas = 0;
-    rs->replicas[0] = comm_id();
+    const comm_id* owners;
+    const comm_id* next_owners;
+    unsigned num = ri->replicas(ring::partition_index(table, key), &owners, &next_owners);
+    *rs = replica_set();
+    rs->desired_replication = CONSUS_KVS_REPLICATION_FACTOR;
+    rs->num_replicas = std::min(num, rs->desired_replication);
 
-    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS && rs->num_replicas < CONSUS_MAX_REPLICATION_FACTOR; ++i)
+    for (unsigned i = 0; i < num; ++i)
     {
-        partition* p = &r->partitions[(index + i) % CONSUS_KVS_PARTITIONS];
-
-        // if the partition is assigned, we haven't wrapped around, and it's not
-        // the same as the previous partition
-        if (p->owner != comm_id() && p->owner != rs->replicas[0] &&
-            (rs->num_replicas == 0 || rs->replicas[rs->num_replicas - 1] != p->owner))
-        {
-            rs->replicas[rs->num_replicas] = p->owner;
-            rs->transitioning[rs->num_replicas] = p->next_owner;
-            ++rs->num_replicas;
-        }
-    }
-
-    if (rs->num_replicas > rs->desired_replication)
-    {
-        rs->num_replicas = rs->desired_replication;
+        rs->replicas[i] = owners[i];
+        rs->transitioning[i] = next_owners[i];
     }
 
     return true;
@@ -185,17 +174,17 @@ configuration :: migratable_partitions(comm_id id)
 
     for (size_t i = 0; i < m_rings.size(); ++i)
     {
-        migratable_partitions(id, &m_rings[i], &parts);
+        migratable_partitions(id, m_rings[i].get(), &parts);
     }
 
     return parts;
 }
 
 void
-configuration :: migratable_partitions(comm_id id, ring* r, std::vector<partition_id>* parts)
+configuration :: migratable_partitions(comm_id id, const ring* r, std::vector<partition_id>* parts)
 {
     const partition* end_of_ring = r->partitions + CONSUS_KVS_PARTITIONS;
-    partition* ptr = NULL;
+    const partition* ptr = NULL;
 
     for (unsigned p = 0; p < CONSUS_KVS_PARTITIONS; ++p)
     {
@@ -243,7 +232,7 @@ configuration :: migratable_partitions(comm_id id, ring* r, std::vector<partitio
         return;
     }
 
-    partition* boundary = NULL;
+    const partition* boundary = NULL;
 
     while (ptr < end_of_ring && ptr->next_owner == id)
     {
@@ -272,9 +261,9 @@ configuration :: owner_from_next_id(partition_id id)
     {
         for (unsigned p = 0; p < CONSUS_KVS_PARTITIONS; ++p)
         {
-            if (m_rings[i].partitions[p].next_id == id)
+            if (m_rings[i]->partitions[p].next_id == id)
             {
-                return m_rings[i].partitions[p].owner;
+                return m_rings[i]->partitions[p].owner;
             }
         }
     }
@@ -282,14 +271,134 @@ configuration :: owner_from_next_id(partition_id id)
     return comm_id();
 }
 
+unsigned
+configuration :: index_from_next_id(partition_id id)
+{
+    for (size_t i = 0; i < m_rings.size(); ++i)
+    {
+        for (unsigned p = 0; p < CONSUS_KVS_PARTITIONS; ++p)
+        {
+            if (m_rings[i]->partitions[p].next_id == id)
+            {
+                return m_rings[i]->partitions[p].index;
+            }
+        }
+    }
+
+    return CONSUS_KVS_PARTITIONS;
+}
+
+std::map<unsigned, std::vector<unsigned> >
+configuration :: outgoing_indices(comm_id id)
+{
+    std::map<unsigned, std::vector<unsigned> > indices;
+
+    for (size_t i = 0; i < m_rings.size() && i < m_migrations.size(); ++i)
+    {
+        const migrations_t& migrations(*m_migrations[i]);
+
+        for (migrations_t::const_iterator it = migrations.begin();
+                it != migrations.end(); ++it)
+        {
+            if (m_rings[i]->partitions[it->first].owner == id)
+            {
+                indices.insert(*it);
+            }
+        }
+    }
+
+    return indices;
+}
+
+bool
+configuration :: apply_patches(const configuration& base)
+{
+    if (!m_incomplete ||
+        base.m_incomplete ||
+        base.m_version != m_checkpoint ||
+        !patch_rings(base.m_rings, m_patches, &m_rings))
+    {
+        return false;
+    }
+
+    m_ring_indices.resize(m_rings.size());
+    m_migrations.resize(m_rings.size());
+
+    for (size_t i = 0; i < m_rings.size(); ++i)
+    {
+        if (m_rings[i] == base.m_rings[i])
+        {
+            m_ring_indices[i] = base.m_ring_indices[i];
+            m_migrations[i] = base.m_migrations[i];
+        }
+        else
+        {
+            e::compat::shared_ptr<ring_index> ri(new ring_index());
+            ri->init(*m_rings[i]);
+            m_ring_indices[i] = ri;
+            e::compat::shared_ptr<migrations_t> m(new migrations_t());
+            m_rings[i]->migrations(CONSUS_KVS_REPLICATION_FACTOR, m.get());
+            m_migrations[i] = m;
+        }
+    }
+
+    m_patches.clear();
+    m_incomplete = false;
+    return true;
+}
+
+void
+configuration :: share(const configuration& other)
+{
+    m_cluster = other.m_cluster;
+    m_version = other.m_version;
+    m_flags = other.m_flags;
+    m_low_water = other.m_low_water;
+    m_kvss = other.m_kvss;
+    m_checkpoint = other.m_checkpoint;
+    m_incomplete = other.m_incomplete;
+    m_patches = other.m_patches;
+    m_rings = other.m_rings;
+    m_ring_indices = other.m_ring_indices;
+    m_migrations = other.m_migrations;
+}
+
+void
+configuration :: index_rings()
+{
+    m_ring_indices.resize(m_rings.size());
+    m_migrations.resize(m_rings.size());
+
+    for (size_t i = 0; i < m_rings.size(); ++i)
+    {
+        e::compat::shared_ptr<ring_index> ri(new ring_index());
+        ri->init(*m_rings[i]);
+        m_ring_indices[i] = ri;
+        e::compat::shared_ptr<migrations_t> m(new migrations_t());
+        m_rings[i]->migrations(CONSUS_KVS_REPLICATION_FACTOR, m.get());
+        m_migrations[i] = m;
+    }
+}
+
 std::string
 configuration :: dump() const
 {
-    return kvs_configuration(m_cluster, m_version, m_flags, m_kvss, m_rings);
+    return kvs_configuration(m_cluster, m_version, m_flags, m_low_water, m_kvss, m_rings);
 }
 
 e::unpacker
 consus :: operator >> (e::unpacker up, configuration& c)
 {
-    return kvs_configuration(up, &c.m_cluster, &c.m_version, &c.m_flags, &c.m_kvss, &c.m_rings);
+    up = kvs_configuration(up, &c.m_cluster, &c.m_version, &c.m_flags, &c.m_low_water,
+                           &c.m_kvss, &c.m_checkpoint, &c.m_rings, &c.m_patches);
+    c.m_incomplete = c.m_checkpoint != c.m_version;
+    c.m_ring_indices.clear();
+    c.m_migrations.clear();
+
+    if (!up.error() && !c.m_incomplete)
+    {
+        c.index_rings();
+    }
+
+    return up;
 }
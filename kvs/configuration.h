@@ -28,11 +28,17 @@
 #ifndef consus_kvs_configuration_h_
 #define consus_kvs_configuration_h_
 
+// STL
+#include <map>
+#include <vector>
+
 // consus
 #include "namespace.h"
 #include "common/ids.h"
 #include "common/kvs_state.h"
 #include "common/ring.h"
+#include "common/ring_index.h"
+#include "common/ring_patch.h"
 #include "kvs/replica_set.h"
 
 BEGIN_CONSUS_NAMESPACE
@@ -47,6 +53,21 @@ class configuration
     public:
         cluster_id cluster() const { return m_cluster; }
         version_id version() const { return m_version; }
+        // reads never ask for a timestamp below this mark
+        uint64_t low_water() const { return m_low_water; }
+
+    // delta encoding
+    public:
+        // the version whose rings this configuration was encoded against
+        version_id checkpoint() const { return m_checkpoint; }
+        // true until a configuration sent as patches has had them applied
+        bool incomplete() const { return m_incomplete; }
+        // Apply this configuration's patches to "base", which must be its
+        // checkpoint.  Rings without changes keep the ring and ring_index of
+        // "base" rather than being copied and reindexed.
+        bool apply_patches(const configuration& base);
+        // Make this a copy of "other" that shares its rings and indices.
+        void share(const configuration& other);
 
     // kvs daemons
     public:
@@ -70,6 +91,13 @@ class configuration
         std::vector<comm_id> ids();
         std::vector<partition_id> migratable_partitions(comm_id id);
         comm_id owner_from_next_id(partition_id id);
+        // CONSUS_KVS_PARTITIONS if no partition is moving to "id"
+        unsigned index_from_next_id(partition_id id);
+        // For each partition "id" owns that is moving elsewhere, keyed by its
+        // ring index, the ring indices whose versions and locks go with it:
+        // its own, and those of the partitions ahead of it whose replicas
+        // gain its new owner.
+        std::map<unsigned, std::vector<unsigned> > outgoing_indices(comm_id id);
 
     // debug/internal
     public:
@@ -77,17 +105,28 @@ class configuration
 
     // XXX same as above xxx about APIs
     private:
-        void migratable_partitions(comm_id id, ring* r, std::vector<partition_id>* parts);
+        void migratable_partitions(comm_id id, const ring* r, std::vector<partition_id>* parts);
+        void index_rings();
 
     private:
+        typedef e::compat::shared_ptr<const ring_index> ring_index_ptr;
+        typedef std::map<unsigned, std::vector<unsigned> > migrations_t;
+        typedef e::compat::shared_ptr<const migrations_t> migrations_ptr;
         friend e::unpacker operator >> (e::unpacker, configuration& s);
 
     private:
         cluster_id m_cluster;
         version_id m_version;
         uint64_t m_flags;
+        uint64_t m_low_water;
         std::vector<kvs_state> m_kvss;
-        std::vector<ring> m_rings;
+        version_id m_checkpoint;
+        bool m_incomplete;
+        std::vector<ring_patch> m_patches;
+        std::vector<ring_ptr> m_rings;
+        std::vector<ring_index_ptr> m_ring_indices;
+        // per ring, what each moving partition carries; see ring::migrations
+        std::vector<migrations_ptr> m_migrations;
 
     private:
         configuration(const configuration& other);
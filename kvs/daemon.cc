@@ -69,9 +69,11 @@
 #include "common/background_thread.h"
 #include "common/constants.h"
 #include "common/consus.h"
+#include "common/crc32c.h"
 #include "common/lock.h"
 #include "common/macros.h"
 #include "common/network_msgtype.h"
+#include "common/nonce.h"
 #include "common/transaction_group.h"
 #include "kvs/daemon.h"
 #include "kvs/leveldb_datalayer.h"
@@ -90,6 +92,15 @@ using consus::daemon;
         } \
     } while (0)
 
+// replicators resend once per second; 10ms of slop on a resend is plenty, and
+// 256 slots puts every resend within a single revolution of the wheel
+#define PUMP_TICK (10 * PO6_MILLIS)
+#define PUMP_SLOTS 256
+
+// a migration chunk holds no more than this many bytes of versions, no matter
+// what the puller asks for
+#define MIGRATE_CHUNK_MAX (4ULL << 20)
+
 uint32_t s_interrupts = 0;
 bool s_debug_dump = false;
 bool s_debug_mode = false;
@@ -119,12 +130,17 @@ struct daemon::coordinator_callback : public coordinator_link::callback
     virtual ~coordinator_callback() throw ();
     virtual std::string prefix() { return "kvs"; }
     virtual bool new_config(const char* data, size_t data_sz);
+    virtual bool missing_checkpoint() { return m_missing_checkpoint; }
+    virtual bool new_checkpoint(const char* data, size_t data_sz);
     virtual bool has_id(comm_id id);
     virtual po6::net::location address(comm_id id);
     virtual bool is_steady_state(comm_id id);
 
     private:
         daemon* d;
+        // the most recent full configuration; deltas are applied to its rings
+        std::auto_ptr<configuration> m_checkpoint;
+        bool m_missing_checkpoint;
         coordinator_callback(const coordinator_callback&);
         coordinator_callback& operator = (const coordinator_callback&);
 };
@@ -152,8 +168,55 @@ class daemon::migration_bgthread : public consus::background_thread
         bool m_have_new_config;
 };
 
+class daemon::collection_bgthread : public consus::background_thread
+{
+    public:
+        collection_bgthread(daemon* d);
+        virtual ~collection_bgthread() throw ();
+
+    public:
+        void new_config(uint64_t low_water);
+
+    protected:
+        virtual const char* thread_name();
+        virtual bool have_work();
+        virtual void do_work();
+
+    private:
+        collection_bgthread(const collection_bgthread&);
+        collection_bgthread& operator = (const collection_bgthread&);
+
+    private:
+        daemon* m_d;
+        uint64_t m_low_water;
+        uint64_t m_collected;
+};
+
+class daemon::storage_op : public storage_executor::task
+{
+    public:
+        storage_op(daemon* d, comm_id id, network_msgtype mt,
+                   std::auto_ptr<e::buffer> msg);
+        virtual ~storage_op() throw ();
+
+    public:
+        virtual void run();
+
+    private:
+        storage_op(const storage_op&);
+        storage_op& operator = (const storage_op&);
+
+    private:
+        daemon* m_d;
+        comm_id m_id;
+        network_msgtype m_mt;
+        std::auto_ptr<e::buffer> m_msg;
+};
+
 daemon :: coordinator_callback :: coordinator_callback(daemon* _d)
     : d(_d)
+    , m_checkpoint()
+    , m_missing_checkpoint(false)
 {
 }
 
@@ -191,6 +254,7 @@ daemon :: coordinator_callback :: new_config(const char* data, size_t data_sz)
     std::auto_ptr<configuration> c(new configuration());
     e::unpacker up(data, data_sz);
     up = up >> *c;
+    m_missing_checkpoint = false;
 
     if (up.error() || up.remain())
     {
@@ -198,11 +262,31 @@ daemon :: coordinator_callback :: new_config(const char* data, size_t data_sz)
         return false;
     }
 
+    if (!c->incomplete())
+    {
+        m_checkpoint.reset(new configuration());
+        m_checkpoint->share(*c);
+    }
+    else if (!m_checkpoint.get() || m_checkpoint->version() != c->checkpoint())
+    {
+        LOG(INFO) << "configuration " << c->version() << " needs checkpoint "
+                  << c->checkpoint() << "; fetching it from the coordinator";
+        m_missing_checkpoint = true;
+        return false;
+    }
+    else if (!c->apply_patches(*m_checkpoint))
+    {
+        LOG(ERROR) << "received a configuration that does not apply to checkpoint "
+                   << c->checkpoint();
+        return false;
+    }
+
     configuration* old_config = d->get_config();
     d->m_us.dc = c->get_data_center(d->m_us.id);
     e::atomic::store_ptr_release(&d->m_config, c.release());
     d->m_gc.collect(old_config, e::garbage_collector::free_ptr<configuration>);
     d->m_migrate_thread->new_config();
+    d->m_collect_thread->new_config(d->get_config()->low_water());
     LOG(INFO) << "updating to configuration " << d->get_config()->version();
 
 #if 0
@@ -224,6 +308,23 @@ daemon :: coordinator_callback :: new_config(const char* data, size_t data_sz)
     return true;
 }
 
+bool
+daemon :: coordinator_callback :: new_checkpoint(const char* data, size_t data_sz)
+{
+    std::auto_ptr<configuration> c(new configuration());
+    e::unpacker up(data, data_sz);
+    up = up >> *c;
+
+    if (up.error() || up.remain() || c->incomplete())
+    {
+        LOG(ERROR) << "received a bad configuration checkpoint";
+        return false;
+    }
+
+    m_checkpoint = c;
+    return true;
+}
+
 bool
 daemon :: coordinator_callback :: has_id(comm_id id)
 {
@@ -331,6 +432,99 @@ daemon :: migration_bgthread :: do_work()
     }
 }
 
+daemon :: collection_bgthread :: collection_bgthread(daemon* d)
+    : background_thread(&d->m_gc)
+    , m_d(d)
+    , m_low_water(0)
+    , m_collected(0)
+{
+}
+
+daemon :: collection_bgthread :: ~collection_bgthread() throw ()
+{
+}
+
+void
+daemon :: collection_bgthread :: new_config(uint64_t low_water)
+{
+    po6::threads::mutex::hold hold(mtx());
+
+    if (low_water > m_low_water)
+    {
+        m_low_water = low_water;
+        wakeup();
+    }
+}
+
+const char*
+daemon :: collection_bgthread :: thread_name()
+{
+    return "garbage collection";
+}
+
+bool
+daemon :: collection_bgthread :: have_work()
+{
+    return m_low_water > m_collected;
+}
+
+void
+daemon :: collection_bgthread :: do_work()
+{
+    uint64_t low_water;
+
+    {
+        po6::threads::mutex::hold hold(mtx());
+        low_water = m_low_water;
+    }
+
+    // the coordinator advances the mark in coarse steps, so each pass
+    // covers a good deal of history; a failed pass waits for the next mark
+    m_d->m_data->collect_garbage(low_water);
+    po6::threads::mutex::hold hold(mtx());
+    m_collected = low_water;
+}
+
+daemon :: storage_op :: storage_op(daemon* d, comm_id id, network_msgtype mt,
+                                   std::auto_ptr<e::buffer> msg)
+    : storage_executor::task()
+    , m_d(d)
+    , m_id(id)
+    , m_mt(mt)
+    , m_msg(msg)
+{
+}
+
+daemon :: storage_op :: ~storage_op() throw ()
+{
+}
+
+void
+daemon :: storage_op :: run()
+{
+    // the network thread already checked the header
+    network_msgtype mt;
+    e::unpacker up = m_msg->unpack_from(BUSYBEE_HEADER_SIZE);
+    up = up >> mt;
+
+    switch (m_mt)
+    {
+        case KVS_RAW_RD:
+            return m_d->process_raw_rd(m_id, m_msg, up);
+        case KVS_RAW_WR:
+            return m_d->process_raw_wr(m_id, m_msg, up);
+        case KVS_RAW_LK:
+            return m_d->process_raw_lk(m_id, m_msg, up);
+        case KVS_MIGRATE_PULL:
+            return m_d->process_migrate_pull(m_id, m_msg, up);
+        case KVS_MIGRATE_DATA:
+            return m_d->process_migrate_data(m_id, m_msg, up);
+        default:
+            LOG(ERROR) << "storage executor received " << m_mt << " message";
+            return;
+    }
+}
+
 daemon :: daemon()
     : m_us()
     , m_gc()
@@ -347,6 +541,15 @@ daemon :: daemon()
     , m_repl_wr(&m_gc)
     , m_migrations(&m_gc)
     , m_migrate_thread(new migration_bgthread(this))
+    , m_collect_thread(new collection_bgthread(this))
+    , m_peer_latency()
+    , m_read_all(false)
+    , m_migration_rate(0)
+    , m_storage(&m_gc)
+    , m_transfers(&m_gc)
+    , m_migration_source()
+    , m_pump_timers(PUMP_TICK, PUMP_SLOTS)
+    , m_pumping_thread(po6::threads::make_obj_func(&daemon::pump, this))
 {
 }
 
@@ -366,7 +569,10 @@ daemon :: run(bool background,
               bool set_coordinator,
               const char* coordinator,
               const char* data_center,
-              unsigned threads)
+              unsigned threads,
+              unsigned storage_threads,
+              uint64_t migration_rate,
+              bool read_all)
 {
     if (!e::block_all_signals())
     {
@@ -390,6 +596,8 @@ daemon :: run(bool background,
         return EXIT_FAILURE;
     }
 
+    m_read_all = read_all;
+    m_migration_rate = migration_rate;
     m_data.reset(new leveldb_datalayer());
 
     if (!m_data->init(data))
@@ -449,6 +657,8 @@ daemon :: run(bool background,
     }
 
     m_busybee.reset(new busybee_mta(&m_gc, &m_busybee_mapper, bind_to, id, threads));
+    m_storage.start(storage_threads);
+    m_transfers.start(1);
 
     for (size_t i = 0; i < threads; ++i)
     {
@@ -459,6 +669,8 @@ daemon :: run(bool background,
     }
 
     m_migrate_thread->start();
+    m_collect_thread->start();
+    m_pumping_thread.start();
 
     while (e::atomic::increment_32_nobarrier(&s_interrupts, 0) == 0)
     {
@@ -499,6 +711,7 @@ daemon :: run(bool background,
 
     e::atomic::increment_32_nobarrier(&s_interrupts, 1);
     m_migrate_thread->shutdown();
+    m_collect_thread->shutdown();
     m_busybee->shutdown();
 
     for (size_t i = 0; i < m_threads.size(); ++i)
@@ -506,6 +719,9 @@ daemon :: run(bool background,
         m_threads[i]->join();
     }
 
+    m_storage.shutdown();
+    m_transfers.shutdown();
+    m_pumping_thread.join();
     LOG(INFO) << "consus is gracefully shutting down";
     return EXIT_SUCCESS;
 }
@@ -604,13 +820,13 @@ daemon :: loop(size_t thread)
                 process_rep_wr(id, msg, up);
                 break;
             case KVS_RAW_RD:
-                process_raw_rd(id, msg, up);
+                dispatch_storage(id, mt, msg, up);
                 break;
             case KVS_RAW_RD_RESP:
                 process_raw_rd_resp(id, msg, up);
                 break;
             case KVS_RAW_WR:
-                process_raw_wr(id, msg, up);
+                dispatch_storage(id, mt, msg, up);
                 break;
             case KVS_RAW_WR_RESP:
                 process_raw_wr_resp(id, msg, up);
@@ -619,7 +835,7 @@ daemon :: loop(size_t thread)
                 process_lock_op(id, msg, up);
                 break;
             case KVS_RAW_LK:
-                process_raw_lk(id, msg, up);
+                dispatch_storage(id, mt, msg, up);
                 break;
             case KVS_RAW_LK_RESP:
                 process_raw_lk_resp(id, msg, up);
@@ -633,6 +849,10 @@ daemon :: loop(size_t thread)
             case KVS_MIGRATE_ACK:
                 process_migrate_ack(id, msg, up);
                 break;
+            case KVS_MIGRATE_PULL:
+            case KVS_MIGRATE_DATA:
+                dispatch_storage(id, mt, msg, up);
+                break;
             case CONSUS_NOP:
                 break;
             case CLIENT_RESPONSE:
@@ -645,6 +865,8 @@ daemon :: loop(size_t thread)
             case TXMAN_COMMIT:
             case TXMAN_ABORT:
             case TXMAN_WOUND:
+            case TXMAN_MULTI_READ:
+            case TXMAN_MULTI_WRITE:
             case TXMAN_PAXOS_2A:
             case TXMAN_PAXOS_2B:
             case LV_VOTE_1A:
@@ -673,6 +895,43 @@ daemon :: loop(size_t thread)
     LOG(INFO) << "network thread shutting down";
 }
 
+void
+daemon :: dispatch_storage(comm_id id, network_msgtype mt, std::auto_ptr<e::buffer> msg, e::unpacker up)
+{
+    uint64_t nonce;
+    uint8_t flags;
+    e::slice table;
+    e::slice key;
+    partition_id partition;
+
+    if (mt == KVS_MIGRATE_PULL || mt == KVS_MIGRATE_DATA)
+    {
+        up = up >> partition;
+        CHECK_UNPACK(mt, up);
+        // one thread does all of the copying, so a walk of the data on behalf
+        // of one partition finds the others waiting to share it
+        std::auto_ptr<storage_executor::task> t(new storage_op(this, id, mt, msg));
+        m_transfers.enqueue(partition.get(), t);
+        return;
+    }
+
+    if (mt == KVS_RAW_WR)
+    {
+        up = up >> nonce >> flags >> table >> key;
+    }
+    else
+    {
+        up = up >> nonce >> table >> key;
+    }
+
+    CHECK_UNPACK(mt, up);
+    // every operation on a key queues behind the ones before it, so lock
+    // ops on one key never hold two storage threads at once
+    const uint64_t affinity = ring::partition_index(table, key);
+    std::auto_ptr<storage_executor::task> t(new storage_op(this, id, mt, msg));
+    m_storage.enqueue(affinity, t);
+}
+
 void
 daemon :: process_rep_rd(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up)
 {
@@ -738,7 +997,15 @@ daemon :: process_raw_rd(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
     e::slice table;
     e::slice key;
     uint64_t timestamp;
+    uint8_t flags = 0;
     up = up >> nonce >> table >> key >> timestamp;
+
+    // senders that predate digest reads send no flags
+    if (up.remain())
+    {
+        up = up >> flags;
+    }
+
     CHECK_UNPACK(KVS_RAW_RD, up);
     configuration* c = get_config();
     // XXX check table exists
@@ -759,6 +1026,16 @@ daemon :: process_raw_rd(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
     datalayer::reference* ref = NULL;
     consus_returncode rc = CONSUS_GARBAGE;
     rc = m_data->get(table, key, timestamp, &timestamp, &value, &ref);
+    // keeps the value alive until it's packed, then releases the iterator
+    std::auto_ptr<datalayer::reference> ref_guard(ref);
+
+    // the replicator compares the timestamp; only one replica sends the value
+    const uint8_t resp_flags = rc == CONSUS_SUCCESS ? flags & CONSUS_READ_DIGEST : 0;
+
+    if ((resp_flags & CONSUS_READ_DIGEST))
+    {
+        value = e::slice();
+    }
 
     const size_t sz = BUSYBEE_HEADER_SIZE
                     + pack_size(KVS_RAW_RD_RESP)
@@ -766,10 +1043,11 @@ daemon :: process_raw_rd(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
                     + pack_size(rc)
                     + sizeof(uint64_t)
                     + pack_size(value)
-                    + pack_size(rs);
+                    + pack_size(rs)
+                    + sizeof(uint8_t);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
     msg->pack_at(BUSYBEE_HEADER_SIZE)
-        << KVS_RAW_RD_RESP << nonce << rc << timestamp << value << rs;
+        << KVS_RAW_RD_RESP << nonce << rc << timestamp << value << rs << resp_flags;
     send(id, msg);
 
     if (s_debug_mode)
@@ -788,14 +1066,22 @@ daemon :: process_raw_rd_resp(comm_id id, std::auto_ptr<e::buffer> msg, e::unpac
     uint64_t timestamp;
     e::slice value;
     replica_set rs;
+    uint8_t flags = 0;
     up = up >> nonce >> rc >> timestamp >> value >> rs;
+
+    // replicas that predate digest reads always send the value
+    if (up.remain())
+    {
+        up = up >> flags;
+    }
+
     CHECK_UNPACK(KVS_RAW_RD_RESP, up);
     read_replicator_map_t::state_reference rsr;
     read_replicator* r = m_repl_rd.get_state(nonce, &rsr);
 
     if (r)
     {
-        r->response(id, rc, timestamp, value, rs, msg, this);
+        r->response(id, rc, timestamp, value, (flags & CONSUS_READ_DIGEST) != 0, rs, msg, this);
     }
     else
     {
@@ -1030,6 +1316,107 @@ daemon :: process_migrate_ack(comm_id, std::auto_ptr<e::buffer>, e::unpacker up)
     }
 }
 
+void
+daemon :: process_migrate_pull(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
+{
+    partition_id key;
+    version_id version;
+    uint64_t seqno;
+    uint16_t index;
+    e::slice position;
+    uint64_t budget;
+    up = up >> key >> version >> seqno >> index >> position >> budget;
+    CHECK_UNPACK(KVS_MIGRATE_PULL, up);
+    configuration* c = get_config();
+
+    if (c->version() < version)
+    {
+        LOG_IF(INFO, s_debug_mode) << "dropping migration pull for " << key << "/" << version;
+        return;
+    }
+
+    budget = std::min(budget, uint64_t(MIGRATE_CHUNK_MAX));
+    std::string entries;
+    std::string last;
+    bool done = false;
+    uint64_t scanned = 0;
+
+    // The new owner becomes a replica not only of partition "index" but of
+    // the partitions ahead of it whose replica sets reach it, and their
+    // versions and locks go along too.
+    typedef std::map<unsigned, std::vector<unsigned> > outgoing_t;
+    const outgoing_t outgoing(c->outgoing_indices(m_us.id));
+    outgoing_t::const_iterator oit = outgoing.find(index);
+
+    if (oit == outgoing.end())
+    {
+        LOG_IF(INFO, s_debug_mode) << "dropping migration pull for " << key
+                                   << "/" << version << ": partition not moving";
+        return;
+    }
+
+    if (m_migration_source.pull(m_data.get(), index, outgoing, position, budget,
+                                &entries, &last, &done, &scanned) != CONSUS_SUCCESS)
+    {
+        return;
+    }
+
+    // The locks go with the last chunk, so the new owner can check that it
+    // holds each of them too.  Lock operations made during the copy reach
+    // both replicas; only a lock taken before the copy began, and still held,
+    // is missing there, and the handoff waits for its release.
+    std::string locks;
+
+    if (done)
+    {
+        m_data->held_locks(oit->second, &locks);
+    }
+
+    uint32_t checksum = crc32c(0, reinterpret_cast<const unsigned char*>(entries.data()), entries.size());
+    checksum = crc32c(checksum, reinterpret_cast<const unsigned char*>(locks.data()), locks.size());
+    const e::slice l(last);
+    const e::slice ents(entries);
+    const e::slice lks(locks);
+    const size_t sz = BUSYBEE_HEADER_SIZE
+                    + pack_size(KVS_MIGRATE_DATA)
+                    + pack_size(key)
+                    + sizeof(uint64_t)
+                    + pack_size(l)
+                    + sizeof(uint8_t)
+                    + sizeof(uint64_t)
+                    + sizeof(uint32_t)
+                    + pack_size(ents)
+                    + pack_size(lks);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(BUSYBEE_HEADER_SIZE)
+        << KVS_MIGRATE_DATA << key << seqno << l << uint8_t(done ? 1 : 0)
+        << scanned << checksum << ents << lks;
+    send(id, msg);
+}
+
+void
+daemon :: process_migrate_data(comm_id, std::auto_ptr<e::buffer>, e::unpacker up)
+{
+    partition_id key;
+    uint64_t seqno;
+    e::slice position;
+    uint8_t done;
+    uint64_t scanned;
+    uint32_t checksum;
+    e::slice entries;
+    e::slice locks;
+    up = up >> key >> seqno >> position >> done >> scanned >> checksum >> entries >> locks;
+    CHECK_UNPACK(KVS_MIGRATE_DATA, up);
+
+    migrator_map_t::state_reference msr;
+    migrator* m = m_migrations.get_state(key, &msr);
+
+    if (m)
+    {
+        m->data(seqno, position, done != 0, scanned, checksum, entries, locks, this);
+    }
+}
+
 std::string
 daemon :: logid(const e::slice& table, const e::slice& key)
 {
@@ -1116,8 +1503,42 @@ daemon :: debug_dump()
         }
     }
 
+    LOG(INFO) << "---------------------------------- Data Layer ----------------------------------";
+
+    {
+        std::string debug = m_data->debug_dump();
+        std::vector<std::string> lines = split_by_newlines(debug);
+
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            LOG(INFO) << lines[i];
+        }
+    }
+
+    LOG(INFO) << "------------------------------- Storage Executor -------------------------------";
+
+    {
+        std::string debug = m_storage.debug_dump();
+        std::vector<std::string> lines = split_by_newlines(debug);
+
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            LOG(INFO) << lines[i];
+        }
+    }
+
     LOG(INFO) << "---------------------------------- Migrations ----------------------------------";
 
+    {
+        std::string debug = m_transfers.debug_dump() + "\n" + m_migration_source.debug_dump();
+        std::vector<std::string> lines = split_by_newlines(debug);
+
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            LOG(INFO) << lines[i];
+        }
+    }
+
     for (migrator_map_t::iterator it(&m_migrations); it.valid(); ++it)
     {
         migrator* m = *it;
@@ -1136,13 +1557,7 @@ daemon :: debug_dump()
 uint64_t
 daemon :: generate_id()
 {
-    // XXX copy of txman impl
-    // XXX don't go out of process
-    po6::io::fd fd(open("/dev/urandom", O_RDONLY));
-    uint64_t x;
-    int ret = fd.xread(&x, sizeof(x));
-    assert(ret == 8);
-    return x;
+    return consus::generate_nonce();
 }
 
 bool
@@ -1193,6 +1608,12 @@ daemon :: send(comm_id id, std::auto_ptr<e::buffer> msg)
     }
 }
 
+void
+daemon :: schedule_pump(pump_t type, uint64_t key, uint64_t when)
+{
+    m_pump_timers.schedule(when, pump_timer(type, key));
+}
+
 void
 daemon :: pump()
 {
@@ -1206,38 +1627,77 @@ daemon :: pump()
     }
 
     LOG(INFO) << "pumping thread started";
+    std::vector<pump_timer> due;
 
     while (true)
     {
-        sleep(PO6_MILLIS * 250);
+        po6::sleep(m_pump_timers.tick());
 
         if (e::atomic::increment_32_nobarrier(&s_interrupts, 0) > 0)
         {
             break;
         }
 
-        for (lock_replicator_map_t::iterator it(&m_repl_lk); it.valid(); ++it)
-        {
-            lock_replicator* lr = *it;
-            lr->externally_work_state_machine(this);
-        }
+        // only the state machines whose resend deadline has passed; everything
+        // else is driven by the messages it receives
+        due.clear();
+        m_pump_timers.expire(po6::monotonic_time(), &due);
 
-        for (read_replicator_map_t::iterator it(&m_repl_rd); it.valid(); ++it)
+        for (size_t i = 0; i < due.size(); ++i)
         {
-            read_replicator* rr = *it;
-            rr->externally_work_state_machine(this);
-        }
-
-        for (write_replicator_map_t::iterator it(&m_repl_wr); it.valid(); ++it)
-        {
-            write_replicator* wr = *it;
-            wr->externally_work_state_machine(this);
-        }
-
-        for (migrator_map_t::iterator it(&m_migrations); it.valid(); ++it)
-        {
-            migrator* m = *it;
-            m->externally_work_state_machine(this);
+            switch (due[i].type)
+            {
+                case PUMP_LOCK:
+                {
+                    lock_replicator_map_t::state_reference lrsr;
+                    lock_replicator* lr = m_repl_lk.get_state(due[i].key, &lrsr);
+
+                    if (lr)
+                    {
+                        lr->externally_work_state_machine(this);
+                    }
+
+                    break;
+                }
+                case PUMP_READ:
+                {
+                    read_replicator_map_t::state_reference rrsr;
+                    read_replicator* rr = m_repl_rd.get_state(due[i].key, &rrsr);
+
+                    if (rr)
+                    {
+                        rr->externally_work_state_machine(this);
+                    }
+
+                    break;
+                }
+                case PUMP_WRITE:
+                {
+                    write_replicator_map_t::state_reference wrsr;
+                    write_replicator* wr = m_repl_wr.get_state(due[i].key, &wrsr);
+
+                    if (wr)
+                    {
+                        wr->externally_work_state_machine(this);
+                    }
+
+                    break;
+                }
+                case PUMP_MIGRATE:
+                {
+                    migrator_map_t::state_reference msr;
+                    migrator* m = m_migrations.get_state(partition_id(due[i].key), &msr);
+
+                    if (m)
+                    {
+                        m->externally_work_state_machine(this);
+                    }
+
+                    break;
+                }
+                default:
+                    abort();
+            }
         }
     }
 
@@ -52,13 +52,18 @@
 #include "common/constants.h"
 #include "common/coordinator_link.h"
 #include "common/kvs.h"
+#include "common/network_msgtype.h"
+#include "common/timer_wheel.h"
 #include "kvs/configuration.h"
 #include "kvs/datalayer.h"
 #include "kvs/lock_manager.h"
 #include "kvs/lock_replicator.h"
 #include "kvs/mapper.h"
+#include "kvs/migration_source.h"
 #include "kvs/migrator.h"
+#include "kvs/peer_latency.h"
 #include "kvs/read_replicator.h"
+#include "kvs/storage_executor.h"
 #include "kvs/write_replicator.h"
 
 BEGIN_CONSUS_NAMESPACE
@@ -80,15 +85,28 @@ class daemon
                 bool set_coordinator,
                 const char* coordinator,
                 const char* data_center,
-                unsigned threads);
+                unsigned threads,
+                unsigned storage_threads,
+                uint64_t migration_rate,
+                bool read_all);
 
     private:
         struct coordinator_callback;
         class migration_bgthread;
+        class collection_bgthread;
+        class storage_op;
         typedef e::state_hash_table<uint64_t, lock_replicator> lock_replicator_map_t;
         typedef e::state_hash_table<uint64_t, read_replicator> read_replicator_map_t;
         typedef e::state_hash_table<uint64_t, write_replicator> write_replicator_map_t;
         typedef e::state_hash_table<partition_id, migrator> migrator_map_t;
+        enum pump_t { PUMP_LOCK, PUMP_READ, PUMP_WRITE, PUMP_MIGRATE };
+        struct pump_timer
+        {
+            pump_timer() : type(), key() {}
+            pump_timer(pump_t t, uint64_t k) : type(t), key(k) {}
+            pump_t type;
+            uint64_t key;
+        };
         friend class mapper;
         friend class lock_manager;
         friend class lock_replicator;
@@ -96,9 +114,12 @@ class daemon
         friend class read_replicator;
         friend class write_replicator;
         friend class migrator;
+        friend class pump_wakeup;
 
     private:
         void loop(size_t thread);
+        // hand a message that touches storage to the storage executor
+        void dispatch_storage(comm_id id, network_msgtype mt, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_read_lock(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_read_unlock(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_write_begin(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
@@ -119,6 +140,8 @@ class daemon
 
         void process_migrate_syn(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_migrate_ack(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_migrate_pull(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_migrate_data(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
 
     private:
         static std::string logid(const e::slice& table, const e::slice& key);
@@ -128,7 +151,10 @@ class daemon
         void debug_dump();
         uint64_t generate_id();
         uint64_t resend_interval() { return PO6_SECONDS; }
+        // bytes per second for each partition transfer; zero is unlimited
+        uint64_t migration_rate() { return m_migration_rate; }
         bool send(comm_id id, std::auto_ptr<e::buffer> msg);
+        void schedule_pump(pump_t type, uint64_t key, uint64_t when);
         void pump();
 
     private:
@@ -147,6 +173,17 @@ class daemon
         write_replicator_map_t m_repl_wr;
         migrator_map_t m_migrations;
         std::auto_ptr<migration_bgthread> m_migrate_thread;
+        std::auto_ptr<collection_bgthread> m_collect_thread;
+        peer_latency m_peer_latency;
+        bool m_read_all;
+        uint64_t m_migration_rate;
+        storage_executor m_storage;
+        // migration reads and writes whole chunks; keep them off the queues
+        // that serve client operations
+        storage_executor m_transfers;
+        migration_source m_migration_source;
+        timer_wheel<pump_timer> m_pump_timers;
+        po6::threads::thread m_pumping_thread;
 
     private:
         daemon(const daemon&);
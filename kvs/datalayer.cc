@@ -45,3 +45,11 @@ datalayer :: reference :: reference()
 datalayer :: reference :: ~reference() throw ()
 {
 }
+
+datalayer :: snapshot :: snapshot()
+{
+}
+
+datalayer :: snapshot :: ~snapshot() throw ()
+{
+}
@@ -28,6 +28,10 @@
 #ifndef consus_kvs_datalayer_h_
 #define consus_kvs_datalayer_h_
 
+// STL
+#include <string>
+#include <vector>
+
 // e
 #include <e/slice.h>
 
@@ -43,6 +47,8 @@ class datalayer
 {
     public:
         class reference;
+        class snapshot;
+        struct version;
 
     public:
         datalayer();
@@ -69,6 +75,21 @@ class datalayer
         virtual consus_returncode write_lock(const e::slice& table,
                                              const e::slice& key,
                                              const transaction_group& tg) = 0;
+        // discard every version that no read at or above "low_water" can
+        // observe
+        virtual consus_returncode collect_garbage(uint64_t low_water) = 0;
+        // Every version of every object, as of now, in a fixed order.  The
+        // snapshot begins strictly after "position", which is either empty or
+        // was taken from an earlier snapshot of this datalayer.
+        virtual snapshot* make_snapshot(const e::slice& position) = 0;
+        // durably write versions copied from another server; a version with
+        // an empty value is a tombstone
+        virtual consus_returncode import(const version* vs, size_t vs_sz) = 0;
+        // every lock held on an object in one of the sorted ring partitions
+        // "indices", packed as table, key, and holder
+        virtual void held_locks(const std::vector<unsigned>& indices,
+                                std::string* locks) = 0;
+        virtual std::string debug_dump() = 0;
 };
 
 class datalayer::reference
@@ -78,6 +99,35 @@ class datalayer::reference
         virtual ~reference() throw ();
 };
 
+class datalayer::snapshot
+{
+    public:
+        snapshot();
+        virtual ~snapshot() throw ();
+
+    public:
+        virtual bool valid() = 0;
+        virtual void next() = 0;
+        virtual consus_returncode status() = 0;
+        virtual e::slice table() = 0;
+        virtual e::slice key() = 0;
+        virtual uint64_t timestamp() = 0;
+        virtual e::slice value() = 0;
+        // where to resume a later snapshot so it picks up after this version
+        virtual e::slice position() = 0;
+};
+
+struct datalayer::version
+{
+    version() : table(), key(), timestamp(), value() {}
+    version(const e::slice& t, const e::slice& k, uint64_t ts, const e::slice& v)
+        : table(t), key(k), timestamp(ts), value(v) {}
+    e::slice table;
+    e::slice key;
+    uint64_t timestamp;
+    e::slice value;
+};
+
 END_CONSUS_NAMESPACE
 
 #endif // consus_kvs_datalayer_h_
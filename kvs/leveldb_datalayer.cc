@@ -25,126 +25,312 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <string.h>
+
+// STL
+#include <vector>
+
 // Google Log
 #include <glog/logging.h>
 
+// LevelDB
+#include <leveldb/write_batch.h>
+
+// po6
+#include <po6/path.h>
+#include <po6/threads/cond.h>
+
 // e
-#include <e/endian.h>
 #include <e/serialization.h>
-#include <e/strescape.h>
 
 // consus
 #include "kvs/leveldb_datalayer.h"
+#include "kvs/leveldb_encoding.h"
+#include "kvs/leveldb_filter.h"
 
 using consus::leveldb_datalayer;
 
-struct leveldb_datalayer::comparator : public leveldb::Comparator
+struct leveldb_datalayer::reference : public datalayer::reference
 {
-    comparator();
-    virtual ~comparator() throw ();
-    virtual int Compare(const leveldb::Slice& a, const leveldb::Slice& b) const;
-    virtual const char* Name() const { return "ConsusComparator"; }
-    virtual void FindShortestSeparator(std::string*,
-                                       const leveldb::Slice&) const {}
-    virtual void FindShortSuccessor(std::string*) const {}
+    reference(std::auto_ptr<leveldb::Iterator> it);
+    virtual ~reference() throw ();
+
+    std::auto_ptr<leveldb::Iterator> it;
 };
 
-leveldb_datalayer :: comparator :: comparator()
+leveldb_datalayer :: reference :: reference(std::auto_ptr<leveldb::Iterator> _it)
+    : datalayer::reference()
+    , it(_it)
 {
 }
 
-leveldb_datalayer :: comparator :: ~comparator() throw ()
+leveldb_datalayer :: reference :: ~reference() throw ()
 {
 }
 
-int
-leveldb_datalayer :: comparator :: Compare(const leveldb::Slice& a, const leveldb::Slice& b) const
+struct leveldb_datalayer::row_reference : public datalayer::reference
 {
-    static const leveldb::Slice lock_table_prefix("\x0bconsus.lock", 12);
+    row_reference(const row_cache::value_t& v);
+    virtual ~row_reference() throw ();
 
-    if (a.starts_with(lock_table_prefix) && b.starts_with(lock_table_prefix))
-    {
-        return a.compare(b);
-    }
-    else if (a.starts_with(lock_table_prefix))
-    {
-        return -1;
-    }
-    else if (b.starts_with(lock_table_prefix))
-    {
-        return 1;
-    }
+    row_cache::value_t value;
+};
 
-    assert(!a.starts_with(lock_table_prefix));
-    assert(!b.starts_with(lock_table_prefix));
+leveldb_datalayer :: row_reference :: row_reference(const row_cache::value_t& v)
+    : datalayer::reference()
+    , value(v)
+{
+}
 
-    if (a.size() < 8 || b.size() < 8)
-    {
-        return -1;
-    }
+leveldb_datalayer :: row_reference :: ~row_reference() throw ()
+{
+}
+
+struct leveldb_datalayer::snapshot : public datalayer::snapshot
+{
+    snapshot(leveldb::DB* db, const e::slice& position);
+    virtual ~snapshot() throw ();
+
+    virtual bool valid();
+    virtual void next();
+    virtual consus_returncode status();
+    virtual e::slice table();
+    virtual e::slice key();
+    virtual uint64_t timestamp();
+    virtual e::slice value();
+    virtual e::slice position();
+
+    // step over markers and stop at the end of the data keys
+    void settle();
+
+    leveldb::DB* db;
+    const leveldb::Snapshot* snap;
+    std::auto_ptr<leveldb::Iterator> it;
+    bool end;
+    bool corrupt;
+    // the object whose table and key are decoded below; every version of an
+    // object shares them, so they are decoded once per object
+    std::string obj;
+    std::string tbl;
+    std::string k;
+
+    private:
+        snapshot(const snapshot&);
+        snapshot& operator = (const snapshot&);
+};
 
-    e::slice x(a.data(), a.size() - 8);
-    e::slice y(b.data(), b.size() - 8);
-    size_t sz = std::min(x.size(), y.size());
-    int cmp = memcmp(x.data(), y.data(), sz);
+leveldb_datalayer :: snapshot :: snapshot(leveldb::DB* _db, const e::slice& pos)
+    : datalayer::snapshot()
+    , db(_db)
+    , snap(_db->GetSnapshot())
+    , it()
+    , end(false)
+    , corrupt(false)
+    , obj()
+    , tbl()
+    , k()
+{
+    leveldb::ReadOptions opts;
+    opts.snapshot = snap;
+    opts.fill_cache = false;
+    it.reset(db->NewIterator(opts));
+    const char data_prefix = LEVELDB_DATA_PREFIX;
 
-    if (cmp < 0)
+    if (pos.empty())
     {
-        return -1;
+        it->Seek(leveldb::Slice(&data_prefix, 1));
     }
-    if (cmp > 0)
+    else
     {
-        return 1;
+        const leveldb::Slice p(pos.cdata(), pos.size());
+        it->Seek(p);
+
+        if (it->Valid() && it->key() == p)
+        {
+            it->Next();
+        }
     }
-    // cmp == 0; order by size now
-    if (x.size() < y.size())
+
+    settle();
+}
+
+leveldb_datalayer :: snapshot :: ~snapshot() throw ()
+{
+    it.reset();
+    db->ReleaseSnapshot(snap);
+}
+
+bool
+leveldb_datalayer :: snapshot :: valid()
+{
+    return !end && it->Valid();
+}
+
+void
+leveldb_datalayer :: snapshot :: next()
+{
+    it->Next();
+    settle();
+}
+
+consus_returncode
+leveldb_datalayer :: snapshot :: status()
+{
+    if (!it->status().ok())
     {
-        return -1;
+        LOG(ERROR) << "leveldb error: " << it->status().ToString();
+        return CONSUS_SERVER_ERROR;
     }
-    if (x.size() > y.size())
+
+    return corrupt ? CONSUS_SERVER_ERROR : CONSUS_SUCCESS;
+}
+
+e::slice
+leveldb_datalayer :: snapshot :: table()
+{
+    return tbl;
+}
+
+e::slice
+leveldb_datalayer :: snapshot :: key()
+{
+    return k;
+}
+
+uint64_t
+leveldb_datalayer :: snapshot :: timestamp()
+{
+    return leveldb_data_key_timestamp(position());
+}
+
+e::slice
+leveldb_datalayer :: snapshot :: value()
+{
+    return e::slice(it->value().data(), it->value().size());
+}
+
+e::slice
+leveldb_datalayer :: snapshot :: position()
+{
+    return e::slice(it->key().data(), it->key().size());
+}
+
+void
+leveldb_datalayer :: snapshot :: settle()
+{
+    for (; it->Valid(); it->Next())
     {
-        return 1;
+        const e::slice x(it->key().data(), it->key().size());
+
+        if (x.empty() || x.data()[0] != LEVELDB_DATA_PREFIX)
+        {
+            end = true;
+            return;
+        }
+
+        const size_t obj_sz = leveldb_object_prefix(x);
+
+        if (obj_sz == x.size())
+        {
+            continue;
+        }
+
+        if (obj.size() == obj_sz && memcmp(obj.data(), x.data(), obj_sz) == 0)
+        {
+            return;
+        }
+
+        uint64_t ts;
+
+        if (!leveldb_decode_data_key(x, &tbl, &k, &ts))
+        {
+            LOG(ERROR) << "corrupt data key " << x.hex();
+            corrupt = true;
+            end = true;
+            return;
+        }
+
+        obj.assign(x.cdata(), obj_sz);
+        return;
     }
+}
 
-    uint64_t at;
-    uint64_t bt;
-    e::unpack64be(a.data() + a.size() - 8, &at);
-    e::unpack64be(b.data() + b.size() - 8, &bt);
+// position "it" at the version "k" names, or the next older one
+static consus_returncode
+seek_version(leveldb::Iterator* it, const std::string& k)
+{
+    it->Seek(k);
 
-    if (at > bt)
+    if (!it->status().ok())
     {
-        return -1;
+        LOG(ERROR) << "leveldb error: " << it->status().ToString();
+        return CONSUS_SERVER_ERROR;
     }
-    if (at < bt)
+    else if (!it->Valid() ||
+             !consus::leveldb_same_object(k, e::slice(it->key().data(), it->key().size())))
     {
-        return 1;
+        return CONSUS_NOT_FOUND;
     }
 
-    return 0;
+    return CONSUS_SUCCESS;
 }
 
-struct leveldb_datalayer::reference : public datalayer::reference
+// the latest versions of hot objects
+#define ROW_CACHE_BYTES (64ULL << 20)
+
+// garbage collection deletes in batches of this many bytes of keys
+#define GC_BATCH_BYTES (1ULL << 20)
+
+// don't let one group grow without bound; the leader always takes at least its
+// own write
+#define GROUP_COMMIT_MAX_BYTES (1ULL << 20)
+
+struct leveldb_datalayer::writer
 {
-    reference(std::auto_ptr<leveldb::Iterator> it);
-    virtual ~reference() throw ();
+    writer(po6::threads::mutex* mtx, const leveldb::Slice& k,
+           const leveldb::Slice& v, const leveldb::Slice& m);
+    ~writer() throw ();
+
+    const leveldb::Slice key;
+    const leveldb::Slice value;
+    const leveldb::Slice marker;
+    bool done;
+    consus_returncode rc;
+    po6::threads::cond cond;
 
-    std::auto_ptr<leveldb::Iterator> it;
+    private:
+        writer(const writer&);
+        writer& operator = (const writer&);
 };
 
-leveldb_datalayer :: reference :: reference(std::auto_ptr<leveldb::Iterator> _it)
-    : datalayer::reference()
-    , it(_it)
+leveldb_datalayer :: writer :: writer(po6::threads::mutex* mtx,
+                                      const leveldb::Slice& k,
+                                      const leveldb::Slice& v,
+                                      const leveldb::Slice& m)
+    : key(k)
+    , value(v)
+    , marker(m)
+    , done(false)
+    , rc(CONSUS_GARBAGE)
+    , cond(mtx)
 {
 }
 
-leveldb_datalayer :: reference :: ~reference() throw ()
+leveldb_datalayer :: writer :: ~writer() throw ()
 {
 }
 
 leveldb_datalayer :: leveldb_datalayer()
-    : m_cmp(new comparator())
-    , m_bf(NULL)
+    : m_bf(NULL)
     , m_db(NULL)
+    , m_markers(false)
+    , m_cache(ROW_CACHE_BYTES)
+    , m_locks()
+    , m_commit_mtx()
+    , m_commit_queue()
 {
 }
 
@@ -166,17 +352,72 @@ leveldb_datalayer :: init(std::string data)
 {
     leveldb::Options opts;
     opts.create_if_missing = true;
-    opts.filter_policy = m_bf = leveldb::NewBloomFilterPolicy(10);
+    opts.filter_policy = m_bf = new leveldb_filter(10);
     opts.max_open_files = std::max(sysconf(_SC_OPEN_MAX) >> 1, 1024L);
-    opts.comparator = m_cmp.get();
     leveldb::Status st = leveldb::DB::Open(opts, data, &m_db);
 
     if (!st.ok())
     {
         LOG(ERROR) << "could not open leveldb: " << st.ToString();
+
+        // data written with the old ConsusComparator won't open without it
+        if (st.ToString().find("comparator") != std::string::npos)
+        {
+            LOG(ERROR) << "this data directory predates the current key format; "
+                       << "upgrade it offline with \"consus upgrade-kvs-data\"";
+        }
+
+        return false;
+    }
+
+    // LevelDB leaves alone any file whose name it does not recognize, so the
+    // lock journal can share the data directory, as the identity file does
+    const std::string locks(po6::path::join(data, "locks"));
+    bool fresh = false;
+
+    if (!m_locks.open(locks, &fresh) || !import_locks(fresh))
+    {
         return false;
     }
 
+    const std::string meta(leveldb_meta_key("markers"));
+    std::string val;
+    st = m_db->Get(leveldb::ReadOptions(), meta, &val);
+
+    if (st.ok())
+    {
+        m_markers = true;
+        return true;
+    }
+    else if (!st.IsNotFound())
+    {
+        LOG(ERROR) << "leveldb error: " << st.ToString();
+        return false;
+    }
+
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(leveldb::ReadOptions()));
+    it->SeekToFirst();
+
+    if (it->Valid())
+    {
+        // markers are written regardless, but objects stored before this
+        // point have none, so a missing marker proves nothing
+        LOG(WARNING) << "data has no object markers; every read will seek "
+                     << "(\"consus upgrade-kvs-data\" adds them)";
+        return true;
+    }
+
+    leveldb::WriteOptions wopts;
+    wopts.sync = true;
+    st = m_db->Put(wopts, meta, leveldb::Slice());
+
+    if (!st.ok())
+    {
+        LOG(ERROR) << "leveldb error: " << st.ToString();
+        return false;
+    }
+
+    m_markers = true;
     return true;
 }
 
@@ -188,25 +429,63 @@ leveldb_datalayer :: get(const e::slice& table,
                          e::slice* value,
                          datalayer::reference** ref)
 {
-    std::string tmp = data_key(table, key, timestamp_le);
-    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(leveldb::ReadOptions()));
-    it->Seek(tmp);
     *timestamp = 0;
     *value = e::slice();
     *ref = NULL;
+    const std::string obj = leveldb_object_key(table, key);
+    row_cache::value_t cached;
 
-    if (!it->status().ok())
+    if (m_cache.get(obj, timestamp_le, timestamp, &cached))
     {
-        LOG(ERROR) << "leveldb error: " << it->status().ToString();
-        return CONSUS_SERVER_ERROR;
+        *value = e::slice(*cached);
+        *ref = new row_reference(cached);
+        return value->empty() ? CONSUS_NOT_FOUND : CONSUS_SUCCESS;
     }
-    else if (!it->Valid() || tmp.size() != it->key().size() ||
-             memcmp(tmp.data(), it->key().data(), tmp.size() - 8) != 0)
+
+    const uint64_t ticket = m_cache.ticket(obj);
+
+    if (m_markers)
     {
-        return CONSUS_NOT_FOUND;
+        // the filter hashes (table, key) alone, so for an object that was
+        // never written this returns without touching a data block
+        std::string ignored;
+        leveldb::Status st = m_db->Get(leveldb::ReadOptions(), obj, &ignored);
+
+        if (st.IsNotFound())
+        {
+            return CONSUS_NOT_FOUND;
+        }
+        else if (!st.ok())
+        {
+            LOG(ERROR) << "leveldb error: " << st.ToString();
+            return CONSUS_SERVER_ERROR;
+        }
     }
 
-    e::unpack64be(it->key().data() + it->key().size() - 8, timestamp);
+    // Look at the latest version first.  It's what the cache holds, and it's
+    // the answer whenever the read isn't of the past.
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(leveldb::ReadOptions()));
+    consus_returncode rc = seek_version(it.get(), leveldb_data_key(table, key, UINT64_MAX));
+
+    if (rc != CONSUS_SUCCESS)
+    {
+        return rc;
+    }
+
+    const uint64_t latest = leveldb_data_key_timestamp(e::slice(it->key().data(), it->key().size()));
+    m_cache.fill(obj, ticket, latest, e::slice(it->value().data(), it->value().size()));
+
+    if (latest > timestamp_le)
+    {
+        rc = seek_version(it.get(), leveldb_data_key(table, key, timestamp_le));
+
+        if (rc != CONSUS_SUCCESS)
+        {
+            return rc;
+        }
+    }
+
+    *timestamp = leveldb_data_key_timestamp(e::slice(it->key().data(), it->key().size()));
     *value = e::slice(it->value().data(), it->value().size());
     *ref = new reference(it);
 
@@ -227,23 +506,7 @@ leveldb_datalayer :: put(const e::slice& table,
                          const e::slice& value)
 {
     assert(!value.empty()); /* XXX */
-    std::string tmp = data_key(table, key, timestamp);
-    leveldb::WriteOptions opts;
-    opts.sync = true;
-    leveldb::Status st = m_db->Put(opts, tmp, leveldb::Slice(value.cdata(), value.size()));
-    consus_returncode rc;
-
-    if (st.ok())
-    {
-        rc = CONSUS_SUCCESS;
-    }
-    else
-    {
-        LOG(ERROR) << "leveldb error: " << st.ToString();
-        rc = CONSUS_SERVER_ERROR;
-    }
-
-    return rc;
+    return write_object(table, key, timestamp, leveldb::Slice(value.cdata(), value.size()));
 }
 
 consus_returncode
@@ -251,10 +514,78 @@ leveldb_datalayer :: del(const e::slice& table,
                          const e::slice& key,
                          uint64_t timestamp)
 {
-    std::string tmp = data_key(table, key, timestamp);
+    return write_object(table, key, timestamp, leveldb::Slice());
+}
+
+consus_returncode
+leveldb_datalayer :: read_lock(const e::slice& table,
+                               const e::slice& key,
+                               transaction_group* tg)
+{
+    *tg = m_locks.get(table, key);
+    return *tg == transaction_group() ? CONSUS_NOT_FOUND : CONSUS_SUCCESS;
+}
+
+consus_returncode
+leveldb_datalayer :: write_lock(const e::slice& table,
+                                const e::slice& key,
+                                const transaction_group& tg)
+{
+    return m_locks.put(table, key, tg) ? CONSUS_SUCCESS : CONSUS_SERVER_ERROR;
+}
+
+consus_returncode
+leveldb_datalayer :: group_commit(const leveldb::Slice& k,
+                                  const leveldb::Slice& v,
+                                  const leveldb::Slice& marker)
+{
+    writer w(&m_commit_mtx, k, v, marker);
+    m_commit_mtx.lock();
+    m_commit_queue.push_back(&w);
+
+    while (!w.done && m_commit_queue.front() != &w)
+    {
+        w.cond.wait();
+    }
+
+    if (w.done)
+    {
+        m_commit_mtx.unlock();
+        return w.rc;
+    }
+
+    // this thread is at the head of the queue, so it writes on behalf of
+    // everyone queued behind it
+    leveldb::WriteBatch batch;
+    size_t batch_sz = 0;
+    size_t group_sz = 0;
+
+    for (std::deque<writer*>::iterator it = m_commit_queue.begin();
+            it != m_commit_queue.end(); ++it)
+    {
+        writer* x = *it;
+
+        if (group_sz > 0 && batch_sz + x->key.size() + x->value.size() > GROUP_COMMIT_MAX_BYTES)
+        {
+            break;
+        }
+
+        batch.Put(x->key, x->value);
+        batch_sz += x->key.size() + x->value.size();
+
+        if (!x->marker.empty())
+        {
+            batch.Put(x->marker, leveldb::Slice());
+            batch_sz += x->marker.size();
+        }
+
+        ++group_sz;
+    }
+
+    m_commit_mtx.unlock();
     leveldb::WriteOptions opts;
     opts.sync = true;
-    leveldb::Status st = m_db->Put(opts, tmp, leveldb::Slice());
+    leveldb::Status st = m_db->Write(opts, &batch);
     consus_returncode rc;
 
     if (st.ok())
@@ -267,87 +598,263 @@ leveldb_datalayer :: del(const e::slice& table,
         rc = CONSUS_SERVER_ERROR;
     }
 
-    return rc;
+    m_commit_mtx.lock();
+
+    for (size_t i = 0; i < group_sz; ++i)
+    {
+        writer* x = m_commit_queue.front();
+        m_commit_queue.pop_front();
+        x->rc = rc;
+        x->done = true;
+
+        if (x != &w)
+        {
+            x->cond.signal();
+        }
+    }
+
+    if (!m_commit_queue.empty())
+    {
+        m_commit_queue.front()->cond.signal();
+    }
+
+    m_commit_mtx.unlock();
+    return w.rc;
 }
 
 consus_returncode
-leveldb_datalayer :: read_lock(const e::slice& table,
-                               const e::slice& key,
-                               transaction_group* tg)
+leveldb_datalayer :: write_object(const e::slice& table,
+                                  const e::slice& key,
+                                  uint64_t timestamp,
+                                  const leveldb::Slice& v)
 {
-    std::string tmp = lock_key(table, key);
-    std::string val;
-    leveldb::Status st = m_db->Get(leveldb::ReadOptions(), tmp, &val);
+    std::string tmp = leveldb_data_key(table, key, timestamp);
+    const size_t obj_sz = leveldb_object_prefix(tmp);
+    leveldb::Slice marker(tmp.data(), obj_sz);
+    consus_returncode rc = group_commit(tmp, v, marker);
+    // only now that the write is visible, or a concurrent reader could fill
+    // the cache with the version it replaces
+    m_cache.invalidate(std::string(tmp.data(), obj_sz));
+    return rc;
+}
 
-    if (st.IsNotFound())
+consus_returncode
+leveldb_datalayer :: collect_garbage(uint64_t low_water)
+{
+    // Versions of an object run newest to oldest.  Everything above the low
+    // water mark stays.  The newest version at or below the mark answers
+    // every read that isn't above the mark, and every version after it is
+    // dead.  If that version is a tombstone, it too can go, because a read
+    // that finds nothing at or below its timestamp is also told the object
+    // is not found.
+    //
+    // XXX Markers stay, even for objects with no versions left.  Removing
+    // one races with a concurrent write of a new version, which would leave
+    // that version unreachable.
+    leveldb::ReadOptions ropts;
+    ropts.fill_cache = false;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(ropts));
+    const char data_prefix = LEVELDB_DATA_PREFIX;
+    it->Seek(leveldb::Slice(&data_prefix, 1));
+    std::string obj;
+    bool answered = false;
+    leveldb::WriteBatch batch;
+    size_t batch_sz = 0;
+    uint64_t scanned = 0;
+    uint64_t dropped = 0;
+
+    for (; it->Valid() && it->key().size() > 0 && it->key()[0] == data_prefix; it->Next())
     {
-        *tg = transaction_group();
-        return CONSUS_NOT_FOUND;
+        const e::slice k(it->key().data(), it->key().size());
+        const size_t obj_sz = leveldb_object_prefix(k);
+
+        if (obj_sz == k.size())
+        {
+            continue;
+        }
+
+        if (obj.size() != obj_sz || memcmp(obj.data(), k.data(), obj_sz) != 0)
+        {
+            // Write only between objects:  a tombstone and the versions
+            // beneath it must go together, or a read between the two
+            // batches (or after a crash that loses the second) would find
+            // the older value again.  No sync; whatever a crash loses, the
+            // next pass collects.
+            if (batch_sz >= GC_BATCH_BYTES)
+            {
+                leveldb::Status st = m_db->Write(leveldb::WriteOptions(), &batch);
+
+                if (!st.ok())
+                {
+                    LOG(ERROR) << "leveldb error: " << st.ToString();
+                    return CONSUS_SERVER_ERROR;
+                }
+
+                batch.Clear();
+                batch_sz = 0;
+            }
+
+            obj.assign(k.cdata(), obj_sz);
+            answered = false;
+        }
+
+        ++scanned;
+
+        if (leveldb_data_key_timestamp(k) > low_water)
+        {
+            continue;
+        }
+
+        if (answered || it->value().empty())
+        {
+            batch.Delete(it->key());
+            batch_sz += it->key().size();
+            ++dropped;
+        }
+
+        answered = true;
     }
-    else if (!st.ok())
+
+    if (!it->status().ok())
     {
-        LOG(ERROR) << "leveldb error: " << st.ToString();
+        LOG(ERROR) << "leveldb error: " << it->status().ToString();
         return CONSUS_SERVER_ERROR;
     }
 
-    e::unpacker up(val);
-    up = up >> *tg;
+    leveldb::Status st = m_db->Write(leveldb::WriteOptions(), &batch);
 
-    if (up.error())
+    if (!st.ok())
     {
-        LOG(ERROR) << "corrupt lock (\""
-                   << e::strescape(table.str()) << "\", \""
-                   << e::strescape(key.str()) << "\")";
-        return CONSUS_INVALID;
+        LOG(ERROR) << "leveldb error: " << st.ToString();
+        return CONSUS_SERVER_ERROR;
     }
 
+    LOG(INFO) << "garbage collection below " << low_water << " dropped "
+              << dropped << "/" << scanned << " versions";
     return CONSUS_SUCCESS;
 }
 
+consus::datalayer::snapshot*
+leveldb_datalayer :: make_snapshot(const e::slice& position)
+{
+    return new snapshot(m_db, position);
+}
+
 consus_returncode
-leveldb_datalayer :: write_lock(const e::slice& table,
-                                const e::slice& key,
-                                const transaction_group& tg)
+leveldb_datalayer :: import(const version* vs, size_t vs_sz)
 {
-    std::string tmp = lock_key(table, key);
-    std::string val;
-    e::packer(&val) << tg;
+    // one synchronous batch for the lot, rather than a group commit apiece
+    leveldb::WriteBatch batch;
+    std::vector<std::string> objs;
+
+    for (size_t i = 0; i < vs_sz; ++i)
+    {
+        const std::string k = leveldb_data_key(vs[i].table, vs[i].key, vs[i].timestamp);
+        const size_t obj_sz = leveldb_object_prefix(k);
+        batch.Put(k, leveldb::Slice(vs[i].value.cdata(), vs[i].value.size()));
+        batch.Put(leveldb::Slice(k.data(), obj_sz), leveldb::Slice());
+
+        if (objs.empty() || objs.back().compare(0, std::string::npos, k.data(), obj_sz) != 0)
+        {
+            objs.push_back(std::string(k.data(), obj_sz));
+        }
+    }
+
     leveldb::WriteOptions opts;
     opts.sync = true;
-    leveldb::Status st = m_db->Put(opts, tmp, val);
+    leveldb::Status st = m_db->Write(opts, &batch);
 
-    if (st.ok())
+    for (size_t i = 0; i < objs.size(); ++i)
     {
-        return CONSUS_SUCCESS;
+        m_cache.invalidate(objs[i]);
     }
-    else
+
+    if (!st.ok())
     {
         LOG(ERROR) << "leveldb error: " << st.ToString();
         return CONSUS_SERVER_ERROR;
     }
+
+    return CONSUS_SUCCESS;
 }
 
-std::string
-leveldb_datalayer :: data_key(const e::slice& table,
-                              const e::slice& key,
-                              uint64_t timestamp)
+void
+leveldb_datalayer :: held_locks(const std::vector<unsigned>& indices,
+                                std::string* locks)
 {
-    std::string tmp;
-    e::packer(&tmp)
-        << table
-        << e::pack_array<uint8_t>(key.data(), key.size())
-        << timestamp;
-    return tmp;
+    m_locks.held(indices, locks);
+}
+
+bool
+leveldb_datalayer :: import_locks(bool fresh)
+{
+    // The journal is created only after every lock is imported, so a crash
+    // part way through imports again.  Once the journal exists, it is the
+    // authority and whatever remains in LevelDB is stale.
+    const char lock_prefix = LEVELDB_LOCK_PREFIX;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(leveldb::ReadOptions()));
+    leveldb::WriteBatch batch;
+    uint64_t imported = 0;
+
+    for (it->Seek(leveldb::Slice(&lock_prefix, 1));
+            it->Valid() && it->key().size() > 0 && it->key()[0] == lock_prefix;
+            it->Next())
+    {
+        batch.Delete(it->key());
+
+        if (!fresh)
+        {
+            continue;
+        }
+
+        std::string table;
+        std::string key;
+        transaction_group tg;
+        e::unpacker up(it->value().data(), it->value().size());
+        up = up >> tg;
+
+        if (!leveldb_decode_lock_key(e::slice(it->key().data(), it->key().size()), &table, &key) ||
+            up.error())
+        {
+            LOG(ERROR) << "corrupt lock record " << e::slice(it->key().data(), it->key().size()).hex();
+            return false;
+        }
+
+        m_locks.import(table, key, tg);
+        ++imported;
+    }
+
+    if (!it->status().ok())
+    {
+        LOG(ERROR) << "leveldb error: " << it->status().ToString();
+        return false;
+    }
+
+    if (fresh && !m_locks.checkpoint())
+    {
+        return false;
+    }
+
+    if (imported > 0)
+    {
+        LOG(INFO) << "moved " << imported << " locks out of leveldb into the lock journal";
+    }
+
+    leveldb::WriteOptions opts;
+    opts.sync = true;
+    leveldb::Status st = m_db->Write(opts, &batch);
+
+    if (!st.ok())
+    {
+        LOG(ERROR) << "leveldb error: " << st.ToString();
+        return false;
+    }
+
+    return true;
 }
 
 std::string
-leveldb_datalayer :: lock_key(const e::slice& table,
-                              const e::slice& key)
-{
-    std::string tmp;
-    e::packer(&tmp)
-        << e::slice("consus.lock")
-        << table
-        << e::pack_array<uint8_t>(key.data(), key.size());
-    return tmp;
+leveldb_datalayer :: debug_dump()
+{
+    return m_cache.debug_dump() + m_locks.debug_dump();
 }
@@ -29,13 +29,15 @@
 #define consus_kvs_leveldb_datalayer_h_
 
 // STL
-#include <memory>
+#include <deque>
 
 // LevelDB
-#include <leveldb/comparator.h>
 #include <leveldb/db.h>
 #include <leveldb/filter_policy.h>
 
+// po6
+#include <po6/threads/mutex.h>
+
 // e
 #include <e/slice.h>
 
@@ -43,6 +45,8 @@
 #include <consus.h>
 #include "namespace.h"
 #include "kvs/datalayer.h"
+#include "kvs/lock_store.h"
+#include "kvs/row_cache.h"
 
 BEGIN_CONSUS_NAMESPACE
 
@@ -73,22 +77,43 @@ class leveldb_datalayer : public datalayer
         virtual consus_returncode write_lock(const e::slice& table,
                                              const e::slice& key,
                                              const transaction_group& tg);
+        virtual consus_returncode collect_garbage(uint64_t low_water);
+        virtual datalayer::snapshot* make_snapshot(const e::slice& position);
+        virtual consus_returncode import(const version* vs, size_t vs_sz);
+        virtual void held_locks(const std::vector<unsigned>& indices,
+                                std::string* locks);
+        virtual std::string debug_dump();
 
     private:
-        struct comparator;
         struct reference;
+        struct row_reference;
+        struct snapshot;
+        struct writer;
 
     private:
-        std::string data_key(const e::slice& table,
-                             const e::slice& key,
-                             uint64_t timestamp);
-        std::string lock_key(const e::slice& table,
-                             const e::slice& key);
+        // Durably write k->v, and an empty "marker" too if it is non-empty.
+        // Concurrent callers are grouped together into a single WriteBatch and
+        // share one synchronous write.  Returns once the batch containing this
+        // write is durable.
+        consus_returncode group_commit(const leveldb::Slice& k,
+                                       const leveldb::Slice& v,
+                                       const leveldb::Slice& marker);
+        consus_returncode write_object(const e::slice& table,
+                                       const e::slice& key,
+                                       uint64_t timestamp,
+                                       const leveldb::Slice& v);
+        // move locks left in LevelDB by older versions into m_locks
+        bool import_locks(bool fresh);
 
     private:
-        std::auto_ptr<comparator> m_cmp;
         const leveldb::FilterPolicy* m_bf;
         leveldb::DB* m_db;
+        // every object has a marker, so a missing marker means a missing object
+        bool m_markers;
+        row_cache m_cache;
+        lock_store m_locks;
+        po6::threads::mutex m_commit_mtx;
+        std::deque<writer*> m_commit_queue;
 
     private:
         leveldb_datalayer(const leveldb_datalayer&);
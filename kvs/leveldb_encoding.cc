@@ -0,0 +1,242 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <assert.h>
+#include <string.h>
+
+// e
+#include <e/endian.h>
+
+// consus
+#include "kvs/leveldb_encoding.h"
+
+static void
+escape(const e::slice& s, std::string* out)
+{
+    const char* ptr = s.cdata();
+    const char* const end = ptr + s.size();
+
+    while (ptr < end)
+    {
+        const char* nul = static_cast<const char*>(memchr(ptr, 0, end - ptr));
+
+        if (!nul)
+        {
+            out->append(ptr, end - ptr);
+            break;
+        }
+
+        out->append(ptr, nul - ptr);
+        out->push_back('\x00');
+        out->push_back('\xff');
+        ptr = nul + 1;
+    }
+
+    out->push_back('\x00');
+    out->push_back('\x01');
+}
+
+// parse one escaped string from [*ptr, end), advancing *ptr past its terminator
+static bool
+unescape(const char** ptr, const char* end, std::string* out)
+{
+    out->clear();
+
+    while (*ptr < end)
+    {
+        if (**ptr != '\x00')
+        {
+            out->push_back(**ptr);
+            ++*ptr;
+            continue;
+        }
+
+        if (*ptr + 1 >= end)
+        {
+            return false;
+        }
+
+        const char c = (*ptr)[1];
+        *ptr += 2;
+
+        if (c == '\x01')
+        {
+            return true;
+        }
+        else if (c == '\xff')
+        {
+            out->push_back('\x00');
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+static void
+encode_object(char prefix, const e::slice& table, const e::slice& key, std::string* out)
+{
+    // assume no NUL bytes need escaping; append grows the string if they do
+    out->reserve(1 + table.size() + 2 + key.size() + 2 + sizeof(uint64_t));
+    out->push_back(prefix);
+    escape(table, out);
+    escape(key, out);
+}
+
+std::string
+consus :: leveldb_object_key(const e::slice& table,
+                             const e::slice& key)
+{
+    std::string tmp;
+    encode_object(LEVELDB_DATA_PREFIX, table, key, &tmp);
+    return tmp;
+}
+
+std::string
+consus :: leveldb_data_key(const e::slice& table,
+                           const e::slice& key,
+                           uint64_t timestamp)
+{
+    std::string tmp;
+    encode_object(LEVELDB_DATA_PREFIX, table, key, &tmp);
+    uint8_t buf[sizeof(uint64_t)];
+    e::pack64be(~timestamp, buf);
+    tmp.append(reinterpret_cast<const char*>(buf), sizeof(buf));
+    return tmp;
+}
+
+std::string
+consus :: leveldb_lock_key(const e::slice& table,
+                           const e::slice& key)
+{
+    std::string tmp;
+    encode_object(LEVELDB_LOCK_PREFIX, table, key, &tmp);
+    return tmp;
+}
+
+std::string
+consus :: leveldb_meta_key(const char* name)
+{
+    std::string tmp;
+    tmp.push_back(LEVELDB_META_PREFIX);
+    tmp.append(name);
+    return tmp;
+}
+
+size_t
+consus :: leveldb_object_prefix(const e::slice& k)
+{
+    if (k.empty() || k.data()[0] != LEVELDB_DATA_PREFIX)
+    {
+        return k.size();
+    }
+
+    const char* const start = k.cdata();
+    const char* const end = start + k.size();
+    const char* ptr = start + 1;
+    unsigned terminators = 0;
+
+    // skip escaped NULs until the table's and key's terminators
+    while (terminators < 2 && ptr < end)
+    {
+        const char* nul = static_cast<const char*>(memchr(ptr, 0, end - ptr));
+
+        if (!nul || nul + 1 >= end)
+        {
+            return k.size();
+        }
+
+        terminators += nul[1] == '\x01' ? 1 : 0;
+        ptr = nul + 2;
+    }
+
+    return terminators == 2 ? ptr - start : k.size();
+}
+
+bool
+consus :: leveldb_same_object(const e::slice& a, const e::slice& b)
+{
+    return a.size() == b.size() &&
+           a.size() > sizeof(uint64_t) &&
+           a.data()[0] == LEVELDB_DATA_PREFIX &&
+           memcmp(a.data(), b.data(), a.size() - sizeof(uint64_t)) == 0;
+}
+
+uint64_t
+consus :: leveldb_data_key_timestamp(const e::slice& k)
+{
+    assert(k.size() >= sizeof(uint64_t));
+    uint64_t timestamp;
+    e::unpack64be(k.data() + k.size() - sizeof(uint64_t), &timestamp);
+    return ~timestamp;
+}
+
+bool
+consus :: leveldb_decode_data_key(const e::slice& k,
+                                  std::string* table,
+                                  std::string* key,
+                                  uint64_t* timestamp)
+{
+    if (k.size() < 1 + 2 + 2 + sizeof(uint64_t) || k.data()[0] != LEVELDB_DATA_PREFIX)
+    {
+        return false;
+    }
+
+    const char* ptr = k.cdata() + 1;
+    const char* end = k.cdata() + k.size() - sizeof(uint64_t);
+
+    if (!unescape(&ptr, end, table) ||
+        !unescape(&ptr, end, key) ||
+        ptr != end)
+    {
+        return false;
+    }
+
+    *timestamp = leveldb_data_key_timestamp(k);
+    return true;
+}
+
+bool
+consus :: leveldb_decode_lock_key(const e::slice& k,
+                                  std::string* table,
+                                  std::string* key)
+{
+    if (k.empty() || k.data()[0] != LEVELDB_LOCK_PREFIX)
+    {
+        return false;
+    }
+
+    const char* ptr = k.cdata() + 1;
+    const char* end = k.cdata() + k.size();
+    return unescape(&ptr, end, table) &&
+           unescape(&ptr, end, key) &&
+           ptr == end;
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_kvs_leveldb_encoding_h_
+#define consus_kvs_leveldb_encoding_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <string>
+
+// e
+#include <e/slice.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// Keys written by the leveldb_datalayer.  They sort correctly under LevelDB's
+// default bytewise comparator:
+//
+//      object: 'd' escape(table) escape(key)
+//      data:   'd' escape(table) escape(key) ~timestamp
+//      lock:   'l' escape(table) escape(key)
+//      meta:   'm' name
+//
+// escape() rewrites every 0x00 as 0x00 0xff and appends the terminator
+// 0x00 0x01, so the table and key are self-delimiting and a string sorts
+// before every string it prefixes.  The timestamp is stored big-endian and
+// inverted so that the newest version of an object comes first.
+//
+// The object key is an empty marker written alongside every version.  It
+// sorts immediately before the versions and is what point lookups probe.
+#define LEVELDB_DATA_PREFIX 'd'
+#define LEVELDB_LOCK_PREFIX 'l'
+#define LEVELDB_META_PREFIX 'm'
+
+std::string
+leveldb_object_key(const e::slice& table,
+                   const e::slice& key);
+
+std::string
+leveldb_data_key(const e::slice& table,
+                 const e::slice& key,
+                 uint64_t timestamp);
+std::string
+leveldb_lock_key(const e::slice& table,
+                 const e::slice& key);
+std::string
+leveldb_meta_key(const char* name);
+// The length of the object key that "k" begins with, or k.size() if "k" is
+// not an object or data key.  Every version of an object shares the prefix.
+size_t
+leveldb_object_prefix(const e::slice& k);
+// true if "a" and "b" are data keys for the same (table, key)
+bool
+leveldb_same_object(const e::slice& a, const e::slice& b);
+// the timestamp of a well-formed data key
+uint64_t
+leveldb_data_key_timestamp(const e::slice& k);
+bool
+leveldb_decode_data_key(const e::slice& k,
+                        std::string* table,
+                        std::string* key,
+                        uint64_t* timestamp);
+bool
+leveldb_decode_lock_key(const e::slice& k,
+                        std::string* table,
+                        std::string* key);
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_kvs_leveldb_encoding_h_
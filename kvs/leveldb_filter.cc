@@ -0,0 +1,87 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <vector>
+
+// e
+#include <e/slice.h>
+
+// consus
+#include "kvs/leveldb_encoding.h"
+#include "kvs/leveldb_filter.h"
+
+using consus::leveldb_filter;
+
+static leveldb::Slice
+prefix(const leveldb::Slice& k)
+{
+    return leveldb::Slice(k.data(), consus::leveldb_object_prefix(e::slice(k.data(), k.size())));
+}
+
+leveldb_filter :: leveldb_filter(int bits_per_key)
+    : m_bloom(leveldb::NewBloomFilterPolicy(bits_per_key))
+{
+}
+
+leveldb_filter :: ~leveldb_filter() throw ()
+{
+}
+
+const char*
+leveldb_filter :: Name() const
+{
+    return "consus.PrefixBloomFilter";
+}
+
+void
+leveldb_filter :: CreateFilter(const leveldb::Slice* keys, int n,
+                               std::string* dst) const
+{
+    std::vector<leveldb::Slice> prefixes;
+    prefixes.reserve(n);
+
+    for (int i = 0; i < n; ++i)
+    {
+        leveldb::Slice p = prefix(keys[i]);
+
+        // keys arrive sorted, so the versions of one object are adjacent
+        if (prefixes.empty() || prefixes.back() != p)
+        {
+            prefixes.push_back(p);
+        }
+    }
+
+    m_bloom->CreateFilter(prefixes.empty() ? NULL : &prefixes[0], prefixes.size(), dst);
+}
+
+bool
+leveldb_filter :: KeyMayMatch(const leveldb::Slice& key,
+                              const leveldb::Slice& filter) const
+{
+    return m_bloom->KeyMayMatch(prefix(key), filter);
+}
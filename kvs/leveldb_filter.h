@@ -0,0 +1,69 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_kvs_leveldb_filter_h_
+#define consus_kvs_leveldb_filter_h_
+
+// STL
+#include <memory>
+
+// LevelDB
+#include <leveldb/filter_policy.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// A Bloom filter over the (table, key) prefix of data keys instead of the
+// whole key.  Every version of an object, and its object marker, hash the same,
+// so a Get of the marker for an object that was never written is answered from
+// the filters without reading a data block.  Other keys are hashed whole.
+class leveldb_filter : public leveldb::FilterPolicy
+{
+    public:
+        leveldb_filter(int bits_per_key);
+        virtual ~leveldb_filter() throw ();
+
+    public:
+        virtual const char* Name() const;
+        virtual void CreateFilter(const leveldb::Slice* keys, int n,
+                                  std::string* dst) const;
+        virtual bool KeyMayMatch(const leveldb::Slice& key,
+                                 const leveldb::Slice& filter) const;
+
+    private:
+        std::auto_ptr<const leveldb::FilterPolicy> m_bloom;
+
+    private:
+        leveldb_filter(const leveldb_filter&);
+        leveldb_filter& operator = (const leveldb_filter&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_kvs_leveldb_filter_h_
@@ -121,6 +121,7 @@ lock_replicator :: lock_replicator(uint64_t key)
     , m_mtx()
     , m_init(false)
     , m_finished(false)
+    , m_wakeup()
     , m_id()
     , m_nonce()
     , m_table()
@@ -391,6 +392,10 @@ lock_replicator :: work_state_machine(daemon* d)
             LOG(INFO) << logid() << " response=" << rc << " id=" << m_id;
         }
     }
+    else
+    {
+        schedule_wakeup(now, d);
+    }
 }
 
 void
@@ -414,3 +419,10 @@ lock_replicator :: send_lock_request(lock_stub* stub, uint64_t now, daemon* d)
     d->send(stub->target, msg);
     stub->last_request_time = now;
 }
+
+void
+lock_replicator :: schedule_wakeup(uint64_t now, daemon* d)
+{
+    const uint64_t when = next_resend(m_requests, now, d->resend_interval());
+    m_wakeup.no_later_than(d, daemon::PUMP_LOCK, m_state_key, now, when);
+}
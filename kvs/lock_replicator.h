@@ -39,6 +39,7 @@
 #include "namespace.h"
 #include "common/ids.h"
 #include "common/lock.h"
+#include "common/timer_wheel.h"
 #include "common/transaction_group.h"
 
 BEGIN_CONSUS_NAMESPACE
@@ -76,12 +77,14 @@ class lock_replicator
         void ensure_stub_exists(comm_id id) { get_or_create_stub(id); }
         void work_state_machine(daemon* d);
         void send_lock_request(lock_stub* stub, uint64_t now, daemon* d);
+        void schedule_wakeup(uint64_t now, daemon* d);
 
     private:
         const uint64_t m_state_key;
         po6::threads::mutex m_mtx;
         bool m_init;
         bool m_finished;
+        pump_wakeup m_wakeup;
         comm_id m_id;
         uint64_t m_nonce;
         e::slice m_table;
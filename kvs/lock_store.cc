@@ -0,0 +1,498 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+// POSIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// STL
+#include <algorithm>
+#include <sstream>
+
+// Google Log
+#include <glog/logging.h>
+
+// po6
+#include <po6/threads/cond.h>
+
+// e
+#include <e/endian.h>
+#include <e/serialization.h>
+
+// consus
+#include "common/crc32c.h"
+#include "common/ring.h"
+#include "kvs/lock_store.h"
+
+using consus::lock_store;
+
+#define JOURNAL_FILE "lock-journal"
+#define JOURNAL_TEMP "lock-journal.tmp"
+// every record is a length, a payload, and the CRC of both
+#define RECORD_OVERHEAD (2 * sizeof(uint32_t))
+// rewrite once the journal is this large and mostly superseded records
+#define REWRITE_MIN_BYTES (4ULL << 20)
+#define REWRITE_RATIO 4
+// the leader always takes at least its own record
+#define GROUP_COMMIT_MAX_BYTES (1ULL << 20)
+
+static std::string
+encode_record(const std::string& name, const consus::transaction_group& tg)
+{
+    std::string payload;
+    e::packer(&payload) << e::slice(name) << tg;
+    std::string record(RECORD_OVERHEAD + payload.size(), '\0');
+    unsigned char* ptr = reinterpret_cast<unsigned char*>(&record[0]);
+    e::pack32be(payload.size(), ptr);
+    memmove(ptr + sizeof(uint32_t), payload.data(), payload.size());
+    const size_t body_sz = sizeof(uint32_t) + payload.size();
+    e::pack32be(consus::crc32c(0, ptr, body_sz), ptr + body_sz);
+    return record;
+}
+
+struct lock_store::writer
+{
+    writer(po6::threads::mutex* mtx, const std::string& n,
+           const transaction_group& t);
+    ~writer() throw ();
+
+    const std::string name;
+    const transaction_group tg;
+    const std::string record;
+    bool done;
+    bool ok;
+    po6::threads::cond cond;
+
+    private:
+        writer(const writer&);
+        writer& operator = (const writer&);
+};
+
+lock_store :: writer :: writer(po6::threads::mutex* mtx,
+                               const std::string& n,
+                               const transaction_group& t)
+    : name(n)
+    , tg(t)
+    , record(encode_record(n, t))
+    , done(false)
+    , ok(false)
+    , cond(mtx)
+{
+}
+
+lock_store :: writer :: ~writer() throw ()
+{
+}
+
+lock_store :: lock_store()
+    : m_dir()
+    , m_journal()
+    , m_mtx()
+    , m_locks()
+    , m_queue()
+    , m_journal_bytes(0)
+    , m_live_bytes(0)
+    , m_commits(0)
+    , m_syncs(0)
+    , m_checkpoints(0)
+{
+}
+
+lock_store :: ~lock_store() throw ()
+{
+}
+
+static bool
+ensure_dir(const std::string& dir)
+{
+    if (mkdir(dir.c_str(), S_IRWXU) < 0 && errno != EEXIST)
+    {
+        PLOG(ERROR) << "could not create " << dir;
+        return false;
+    }
+
+    return true;
+}
+
+bool
+lock_store :: open(const std::string& dir, bool* fresh)
+{
+    *fresh = false;
+
+    if (!ensure_dir(dir))
+    {
+        return false;
+    }
+
+    m_dir = ::open(dir.c_str(), O_RDONLY);
+
+    if (m_dir.get() < 0)
+    {
+        PLOG(ERROR) << "could not open " << dir;
+        return false;
+    }
+
+    m_journal = openat(m_dir.get(), JOURNAL_FILE, O_RDWR);
+
+    if (m_journal.get() < 0 && errno == ENOENT)
+    {
+        *fresh = true;
+        return true;
+    }
+    else if (m_journal.get() < 0)
+    {
+        PLOG(ERROR) << "could not open the lock journal";
+        return false;
+    }
+
+    return replay();
+}
+
+void
+lock_store :: import(const e::slice& table, const e::slice& key,
+                     const transaction_group& tg)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    apply(name(table, key), tg);
+}
+
+bool
+lock_store :: checkpoint()
+{
+    return rewrite_journal();
+}
+
+consus::transaction_group
+lock_store :: get(const e::slice& table, const e::slice& key)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    lock_map_t::iterator it = m_locks.find(name(table, key));
+
+    if (it == m_locks.end())
+    {
+        return transaction_group();
+    }
+
+    return it->second;
+}
+
+bool
+lock_store :: put(const e::slice& table, const e::slice& key,
+                  const transaction_group& tg)
+{
+    writer w(&m_mtx, name(table, key), tg);
+    m_mtx.lock();
+    m_queue.push_back(&w);
+
+    while (!w.done && m_queue.front() != &w)
+    {
+        w.cond.wait();
+    }
+
+    if (w.done)
+    {
+        m_mtx.unlock();
+        return w.ok;
+    }
+
+    // this thread is at the head of the queue; it appends everyone queued
+    // behind it and stays at the head until the journal is settled
+    std::string batch;
+    size_t group_sz = 0;
+
+    for (std::deque<writer*>::iterator it = m_queue.begin();
+            it != m_queue.end(); ++it)
+    {
+        writer* x = *it;
+
+        if (group_sz > 0 && batch.size() + x->record.size() > GROUP_COMMIT_MAX_BYTES)
+        {
+            break;
+        }
+
+        batch += x->record;
+        ++group_sz;
+    }
+
+    const uint64_t offset = m_journal_bytes;
+    m_mtx.unlock();
+    bool ok = pwrite(m_journal.get(), batch.data(), batch.size(), offset) == ssize_t(batch.size()) &&
+              fdatasync(m_journal.get()) == 0;
+
+    if (!ok)
+    {
+        PLOG(ERROR) << "could not append to the lock journal";
+
+        // a partially written batch must not resurface on replay
+        if (ftruncate(m_journal.get(), offset) < 0)
+        {
+            PLOG(ERROR) << "could not truncate the lock journal";
+        }
+    }
+
+    m_mtx.lock();
+
+    if (ok)
+    {
+        m_journal_bytes += batch.size();
+        m_commits += group_sz;
+        ++m_syncs;
+    }
+
+    for (size_t i = 0; i < group_sz; ++i)
+    {
+        writer* x = m_queue[i];
+
+        if (ok)
+        {
+            apply(x->name, x->tg);
+        }
+
+        x->ok = ok;
+        x->done = true;
+
+        if (x != &w)
+        {
+            x->cond.signal();
+        }
+    }
+
+    m_queue.erase(m_queue.begin() + 1, m_queue.begin() + group_sz);
+    const bool rewrite = ok &&
+                         m_journal_bytes > REWRITE_MIN_BYTES &&
+                         m_journal_bytes > REWRITE_RATIO * m_live_bytes;
+    m_mtx.unlock();
+
+    // a failed rewrite leaves the old journal in place, which is still good
+    if (rewrite)
+    {
+        rewrite_journal();
+    }
+
+    m_mtx.lock();
+    assert(m_queue.front() == &w);
+    m_queue.pop_front();
+
+    if (!m_queue.empty())
+    {
+        m_queue.front()->cond.signal();
+    }
+
+    m_mtx.unlock();
+    return w.ok;
+}
+
+void
+lock_store :: held(const std::vector<unsigned>& indices, std::string* out)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    for (lock_map_t::iterator it = m_locks.begin(); it != m_locks.end(); ++it)
+    {
+        e::slice table;
+        e::slice key;
+        e::unpacker up(it->first);
+        up = up >> table >> key;
+
+        if (!up.error() &&
+            std::binary_search(indices.begin(), indices.end(),
+                               ring::partition_index(table, key)))
+        {
+            e::packer(out) << table << key << it->second;
+        }
+    }
+}
+
+std::string
+lock_store :: debug_dump()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    std::ostringstream ostr;
+    ostr << "lock store: " << m_locks.size() << " held"
+         << " journal=" << m_journal_bytes << "B"
+         << " live=" << m_live_bytes << "B"
+         << " commits=" << m_commits
+         << " syncs=" << m_syncs
+         << " checkpoints=" << m_checkpoints << "\n";
+    return ostr.str();
+}
+
+std::string
+lock_store :: name(const e::slice& table, const e::slice& key)
+{
+    std::string n;
+    e::packer(&n) << table << key;
+    return n;
+}
+
+void
+lock_store :: apply(const std::string& n, const transaction_group& tg)
+{
+    lock_map_t::iterator it = m_locks.find(n);
+
+    if (it != m_locks.end())
+    {
+        m_live_bytes -= encode_record(n, it->second).size();
+        m_locks.erase(it);
+    }
+
+    if (tg != transaction_group())
+    {
+        m_live_bytes += encode_record(n, tg).size();
+        m_locks.insert(std::make_pair(n, tg));
+    }
+}
+
+bool
+lock_store :: replay()
+{
+    struct stat st;
+
+    if (fstat(m_journal.get(), &st) < 0)
+    {
+        PLOG(ERROR) << "could not stat the lock journal";
+        return false;
+    }
+
+    std::string buf(st.st_size, '\0');
+
+    if (!buf.empty() &&
+        pread(m_journal.get(), &buf[0], buf.size(), 0) != ssize_t(buf.size()))
+    {
+        PLOG(ERROR) << "could not read the lock journal";
+        return false;
+    }
+
+    const unsigned char* const base = reinterpret_cast<const unsigned char*>(buf.data());
+    size_t offset = 0;
+    uint64_t records = 0;
+
+    while (buf.size() - offset >= RECORD_OVERHEAD)
+    {
+        const unsigned char* ptr = base + offset;
+        uint32_t payload_sz;
+        e::unpack32be(ptr, &payload_sz);
+
+        if (payload_sz > buf.size() - offset - RECORD_OVERHEAD)
+        {
+            break;
+        }
+
+        const size_t body_sz = sizeof(uint32_t) + payload_sz;
+        uint32_t stored;
+        e::unpack32be(ptr + body_sz, &stored);
+
+        if (crc32c(0, ptr, body_sz) != stored)
+        {
+            break;
+        }
+
+        e::slice n;
+        transaction_group tg;
+        e::unpacker up(reinterpret_cast<const char*>(ptr + sizeof(uint32_t)), payload_sz);
+        up = up >> n >> tg;
+
+        if (up.error())
+        {
+            break;
+        }
+
+        apply(n.str(), tg);
+        offset += body_sz + sizeof(uint32_t);
+        ++records;
+    }
+
+    // only the tail can be torn; what follows the last intact record was
+    // never acknowledged
+    if (offset < buf.size())
+    {
+        LOG(WARNING) << "discarding " << buf.size() - offset
+                     << " bytes from the end of the lock journal";
+
+        if (ftruncate(m_journal.get(), offset) < 0)
+        {
+            PLOG(ERROR) << "could not truncate the lock journal";
+            return false;
+        }
+    }
+
+    m_journal_bytes = offset;
+    LOG(INFO) << "recovered " << m_locks.size() << " held locks from "
+              << records << " lock journal records";
+    return true;
+}
+
+bool
+lock_store :: rewrite_journal()
+{
+    std::string buf;
+
+    {
+        po6::threads::mutex::hold hold(&m_mtx);
+
+        for (lock_map_t::iterator it = m_locks.begin(); it != m_locks.end(); ++it)
+        {
+            buf += encode_record(it->first, it->second);
+        }
+    }
+
+    // write-then-rename so a crash leaves either the old or the new journal
+    po6::io::fd fd(openat(m_dir.get(), JOURNAL_TEMP, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR));
+
+    if (fd.get() < 0 ||
+        fd.xwrite(buf.data(), buf.size()) != ssize_t(buf.size()) ||
+        fsync(fd.get()) < 0 ||
+        renameat(m_dir.get(), JOURNAL_TEMP, m_dir.get(), JOURNAL_FILE) < 0)
+    {
+        PLOG(ERROR) << "could not checkpoint the lock journal";
+        return false;
+    }
+
+    // Past the rename, the old descriptor names an unlinked file.  If the
+    // new one won't open, every later put fails rather than append to it.
+    int journal = openat(m_dir.get(), JOURNAL_FILE, O_RDWR);
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_journal = journal;
+    m_journal_bytes = buf.size();
+
+    if (journal < 0 || fsync(m_dir.get()) < 0)
+    {
+        PLOG(ERROR) << "could not checkpoint the lock journal";
+        return false;
+    }
+
+    ++m_checkpoints;
+    return true;
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef consus_kvs_lock_store_h_
+#define consus_kvs_lock_store_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <deque>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/io/fd.h>
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/compat.h>
+#include <e/slice.h>
+
+// consus
+#include "namespace.h"
+#include "common/transaction_group.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The durable holder of every lock, kept apart from the data so that lock
+// churn neither fills the memtable nor waits behind large value writes.
+//
+// Every held lock is in memory.  Changes append to a journal of checksummed
+// records, and concurrent callers share a single fdatasync.  Once the journal
+// is mostly superseded records, it is rewritten with just the held locks and
+// renamed into place; the rewrite is the checkpoint.
+class lock_store
+{
+    public:
+        lock_store();
+        ~lock_store() throw ();
+
+    public:
+        // Recover the journal in "dir", creating the directory if it does
+        // not exist.  If there was no journal, "fresh" is set,
+        // and the caller may "import" locks before calling "checkpoint" to
+        // create the journal; the journal must exist before the first "put".
+        bool open(const std::string& dir, bool* fresh);
+        void import(const e::slice& table, const e::slice& key,
+                    const transaction_group& tg);
+        bool checkpoint();
+        // the holder of (table, key), or transaction_group() if it is unlocked
+        transaction_group get(const e::slice& table, const e::slice& key);
+        // Durably record "tg" as the holder of (table, key); an empty "tg"
+        // releases the lock.  Returns once the change is on disk.
+        bool put(const e::slice& table, const e::slice& key,
+                 const transaction_group& tg);
+        // Append every lock held on an object in one of the ring partitions
+        // "indices", which are sorted, to "out", packed as table, key, and
+        // holder.
+        void held(const std::vector<unsigned>& indices, std::string* out);
+        std::string debug_dump();
+
+    private:
+        struct writer;
+        typedef e::compat::unordered_map<std::string, transaction_group> lock_map_t;
+        static std::string name(const e::slice& table, const e::slice& key);
+        void apply(const std::string& n, const transaction_group& tg);
+        bool replay();
+        bool rewrite_journal();
+
+    private:
+        po6::io::fd m_dir;
+        po6::io::fd m_journal;
+        po6::threads::mutex m_mtx;
+        lock_map_t m_locks;
+        std::deque<writer*> m_queue;
+        // the next append goes here; everything before it is durable
+        uint64_t m_journal_bytes;
+        // the size of the journal were it rewritten right now
+        uint64_t m_live_bytes;
+        uint64_t m_commits;
+        uint64_t m_syncs;
+        uint64_t m_checkpoints;
+
+    private:
+        lock_store(const lock_store&);
+        lock_store& operator = (const lock_store&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_kvs_lock_store_h_
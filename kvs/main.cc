@@ -68,6 +68,9 @@ main(int argc, const char* argv[])
     const char* pidfile = "";
     bool has_pidfile = false;
     long threads = 0;
+    long storage_threads = 0;
+    long migration_rate = 64;
+    bool read_all = false;
     bool log_immediate = false;
     sigset_t ss;
 
@@ -108,6 +111,15 @@ main(int argc, const char* argv[])
     ap.arg().name('t', "threads")
             .description("the number of threads which will handle network traffic")
             .metavar("N").as_long(&threads);
+    ap.arg().long_name("storage-threads")
+            .description("the number of threads which will read and write storage (default: --threads)")
+            .metavar("N").as_long(&storage_threads);
+    ap.arg().long_name("migration-rate")
+            .description("copy each migrating partition at no more than this many MB/s, or 0 for no limit (default: 64)")
+            .metavar("MB").as_long(&migration_rate);
+    ap.arg().long_name("read-all-replicas")
+            .description("send every read to every replica instead of the fastest quorum")
+            .set_true(&read_all);
     ap.arg().long_name("log-immediate")
             .description("immediately flush all log output")
             .set_true(&log_immediate).hidden();
@@ -204,6 +216,22 @@ main(int argc, const char* argv[])
         return EXIT_FAILURE;
     }
 
+    if (storage_threads <= 0)
+    {
+        storage_threads = threads;
+    }
+    else if (storage_threads > 512)
+    {
+        std::cerr << "refusing to create more than 512 storage threads" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (migration_rate < 0)
+    {
+        std::cerr << "cannot migrate at a negative rate" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     try
     {
         consus::daemon d;
@@ -213,7 +241,8 @@ main(int argc, const char* argv[])
                      std::string(pidfile), has_pidfile,
                      listen, bind_to,
                      conn.isset(), conn.conn_str(),
-                     data_center, threads);
+                     data_center, threads, storage_threads,
+                     uint64_t(migration_rate) << 20, read_all);
     }
     catch (std::exception& e)
     {
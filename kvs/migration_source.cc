@@ -0,0 +1,395 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+#include <deque>
+#include <set>
+#include <sstream>
+
+// po6
+#include <po6/time.h>
+
+// e
+#include <e/serialization.h>
+
+// consus
+#include "common/ring.h"
+#include "kvs/migration_source.h"
+
+using consus::migration_source;
+
+// one pull reads no more than this much of the data
+#define MIGRATE_SCAN_MAX (64ULL << 20)
+// versions buffered for partitions other than the one being pulled stop
+// accumulating past this many bytes
+#define MIGRATE_BUFFER_MAX (64ULL << 20)
+// a partition that has not been pulled for this long has moved or given up
+#define MIGRATE_IDLE (60ULL * PO6_SECONDS)
+
+struct migration_source::entry
+{
+    entry() : position(), packed() {}
+    ~entry() throw () {}
+
+    std::string position;
+    std::string packed;
+};
+
+struct migration_source::stream
+{
+    stream(const e::slice& p, const std::vector<unsigned>& i)
+        : indices(i), reset(false),
+          begin(p.cdata(), p.size()), end(p.cdata(), p.size()), done(false),
+          entries(), bytes(0), served(), served_count(0), last_pull(0) {}
+    ~stream() throw () {}
+
+    // the sorted ring indices whose versions the stream carries
+    std::vector<unsigned> indices;
+    // "indices" grew, and the next pull starts over
+    bool reset;
+    // the buffered versions follow "begin" and cover everything up to and
+    // including "end"
+    std::string begin;
+    std::string end;
+    // nothing follows "end"
+    bool done;
+    std::deque<entry> entries;
+    uint64_t bytes;
+    // the last chunk ended at "served" and held the first "served_count"
+    // entries; the puller's next position is either that or "begin" again
+    std::string served;
+    size_t served_count;
+    uint64_t last_pull;
+};
+
+migration_source :: migration_source()
+    : m_mtx()
+    , m_streams()
+    , m_buffered(0)
+    , m_pulls(0)
+    , m_shared(0)
+    , m_scanned(0)
+{
+}
+
+migration_source :: ~migration_source() throw ()
+{
+    for (stream_map_t::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+    {
+        delete it->second;
+    }
+}
+
+static bool
+covers(const std::vector<unsigned>& have, const std::vector<unsigned>& want)
+{
+    return std::includes(have.begin(), have.end(), want.begin(), want.end());
+}
+
+consus_returncode
+migration_source :: pull(datalayer* data, unsigned index,
+                         const std::map<unsigned, std::vector<unsigned> >& outgoing,
+                         const e::slice& position, uint64_t budget,
+                         std::string* entries, std::string* last,
+                         bool* done, uint64_t* scanned)
+{
+    typedef std::map<unsigned, std::vector<unsigned> > outgoing_t;
+    po6::threads::mutex::hold hold(&m_mtx);
+    const uint64_t now = po6::monotonic_time();
+    expire(now);
+    outgoing_t::const_iterator oit = outgoing.find(index);
+    const std::vector<unsigned> indices(oit != outgoing.end() ?
+                                        oit->second :
+                                        std::vector<unsigned>(1, index));
+
+    // A copy that now carries more indices than it began with has already
+    // passed some of their versions, and starts over on its next pull.
+    for (stream_map_t::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+    {
+        stream* t = it->second;
+        const std::vector<unsigned>* want = &t->indices;
+        oit = outgoing.find(it->first);
+
+        if (it->first == index)
+        {
+            want = &indices;
+        }
+        else if (oit != outgoing.end())
+        {
+            want = &oit->second;
+        }
+
+        if (!covers(t->indices, *want))
+        {
+            t->reset = true;
+            t->indices = *want;
+        }
+    }
+
+    stream_map_t::iterator it = m_streams.find(index);
+    stream* s = NULL;
+
+    if (it == m_streams.end())
+    {
+        s = new stream(position, indices);
+        m_streams.insert(std::make_pair(index, s));
+
+        for (oit = outgoing.begin(); position.empty() && oit != outgoing.end(); ++oit)
+        {
+            if (m_streams.find(oit->first) == m_streams.end())
+            {
+                stream* o = new stream(position, oit->second);
+                o->last_pull = now;
+                m_streams.insert(std::make_pair(oit->first, o));
+            }
+        }
+    }
+    else if (it->second->reset)
+    {
+        s = it->second;
+        s->reset = false;
+        restart(s, e::slice());
+    }
+    else
+    {
+        s = it->second;
+        advance(s, position);
+    }
+
+    s->last_pull = now;
+    ++m_pulls;
+    *scanned = 0;
+
+    if (s->bytes < budget && !s->done)
+    {
+        consus_returncode rc = scan(data, s, budget, scanned);
+
+        if (rc != CONSUS_SUCCESS)
+        {
+            return rc;
+        }
+    }
+
+    if (*scanned == 0)
+    {
+        ++m_shared;
+    }
+
+    entries->clear();
+    size_t taken = 0;
+
+    while (taken < s->entries.size() && entries->size() < budget)
+    {
+        entries->append(s->entries[taken].packed);
+        ++taken;
+    }
+
+    s->served_count = taken;
+
+    if (taken == s->entries.size())
+    {
+        *last = s->end;
+        *done = s->done;
+    }
+    else if (taken > 0)
+    {
+        *last = s->entries[taken - 1].position;
+        *done = false;
+    }
+    else
+    {
+        *last = s->begin;
+        *done = false;
+    }
+
+    // the buffered versions stay until the puller asks for what follows them,
+    // in case this chunk is lost and pulled again
+    s->served = *last;
+    return CONSUS_SUCCESS;
+}
+
+std::string
+migration_source :: debug_dump()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    std::ostringstream ostr;
+    ostr << "migration source: streams=" << m_streams.size()
+         << " buffered=" << m_buffered
+         << " pulls=" << m_pulls
+         << " shared=" << m_shared
+         << " scanned=" << m_scanned;
+    return ostr.str();
+}
+
+void
+migration_source :: advance(stream* s, const e::slice& position)
+{
+    if (position == e::slice(s->begin))
+    {
+        return;
+    }
+
+    // Anything else is a puller that restarted somewhere else, so start over
+    // from there.  Other copies may have read past "s->end" since the last
+    // chunk, so "served" need not be the end of the buffer.
+    if (position != e::slice(s->served))
+    {
+        return restart(s, position);
+    }
+
+    for (size_t i = 0; i < s->served_count; ++i)
+    {
+        s->bytes -= s->entries.front().packed.size();
+        m_buffered -= s->entries.front().packed.size();
+        s->entries.pop_front();
+    }
+
+    s->begin.assign(position.cdata(), position.size());
+    s->served = s->begin;
+    s->served_count = 0;
+}
+
+void
+migration_source :: restart(stream* s, const e::slice& position)
+{
+    m_buffered -= s->bytes;
+    s->entries.clear();
+    s->bytes = 0;
+    s->begin.assign(position.cdata(), position.size());
+    s->end = s->begin;
+    s->done = false;
+    s->served = s->begin;
+    s->served_count = 0;
+}
+
+consus_returncode
+migration_source :: scan(datalayer* data, stream* s, uint64_t budget,
+                         uint64_t* scanned)
+{
+    // every stream that ends where this one does rides along; a copy that
+    // has yet to pull since its indices changed may still share one with
+    // another, so an index can have more than one
+    const std::string from(s->end);
+    std::vector<stream*> riders;
+    std::map<unsigned, std::vector<stream*> > by_index;
+    std::set<stream*> stalled;
+
+    for (stream_map_t::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+    {
+        stream* t = it->second;
+
+        if (!t->done && t->end == from && (t == s || !t->reset))
+        {
+            riders.push_back(t);
+
+            for (size_t i = 0; i < t->indices.size(); ++i)
+            {
+                by_index[t->indices[i]].push_back(t);
+            }
+        }
+    }
+
+    std::auto_ptr<datalayer::snapshot> snap(data->make_snapshot(from));
+    std::string prev(from);
+
+    while (snap->valid() &&
+           s->bytes < budget &&
+           *scanned < MIGRATE_SCAN_MAX)
+    {
+        const e::slice table = snap->table();
+        const e::slice key = snap->key();
+        const e::slice value = snap->value();
+        const e::slice pos = snap->position();
+        *scanned += pos.size() + value.size();
+        std::map<unsigned, std::vector<stream*> >::iterator it;
+        it = by_index.find(ring::partition_index(table, key));
+
+        for (size_t i = 0; it != by_index.end() && i < it->second.size(); ++i)
+        {
+            stream* t = it->second[i];
+
+            if (stalled.find(t) != stalled.end())
+            {
+                continue;
+            }
+
+            if (t != s && m_buffered >= MIGRATE_BUFFER_MAX)
+            {
+                // "t" is complete only up to here, and falls out of step
+                t->end = prev;
+                stalled.insert(t);
+            }
+            else
+            {
+                t->entries.push_back(entry());
+                entry* e = &t->entries.back();
+                e->position.assign(pos.cdata(), pos.size());
+                e::packer(&e->packed) << table << key << snap->timestamp() << value;
+                t->bytes += e->packed.size();
+                m_buffered += e->packed.size();
+            }
+        }
+
+        prev.assign(pos.cdata(), pos.size());
+        snap->next();
+    }
+
+    m_scanned += *scanned;
+    const consus_returncode rc = snap->status();
+
+    for (size_t i = 0; i < riders.size(); ++i)
+    {
+        if (stalled.find(riders[i]) == stalled.end())
+        {
+            riders[i]->end = prev;
+            riders[i]->done = rc == CONSUS_SUCCESS && !snap->valid();
+        }
+    }
+
+    return rc;
+}
+
+void
+migration_source :: expire(uint64_t now)
+{
+    stream_map_t::iterator it = m_streams.begin();
+
+    while (it != m_streams.end())
+    {
+        if (it->second->last_pull + MIGRATE_IDLE < now)
+        {
+            m_buffered -= it->second->bytes;
+            delete it->second;
+            m_streams.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
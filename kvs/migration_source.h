@@ -0,0 +1,113 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_kvs_migration_source_h_
+#define consus_kvs_migration_source_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <map>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/slice.h>
+
+// consus
+#include <consus.h>
+#include "namespace.h"
+#include "kvs/datalayer.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The outgoing side of partition migration.  Keys hash to partitions, so
+// every partition leaving this server is strewn across the whole key space,
+// as are the partitions ahead of it whose replicas gain its new owner and whose
+// versions go with it.
+// Rather than walk it once per partition, a walk on behalf of one partition
+// also buffers the versions of every other partition whose copy has reached
+// the same point, and their next pulls are answered from the buffer.  When the
+// pullers keep pace with one another, the data is read once no matter how
+// many partitions move.
+class migration_source
+{
+    public:
+        migration_source();
+        ~migration_source() throw ();
+
+    public:
+        // Pack up to "budget" bytes of the versions that go with partition
+        // "index" and follow "position" into "entries".  "outgoing" maps
+        // each partition leaving this server to the sorted ring indices whose
+        // versions go with it (see configuration::outgoing_indices); "index"
+        // alone goes with itself if it is missing.  "last" is where the next
+        // pull picks up, "done" is set if nothing follows it, and "scanned"
+        // counts the bytes this call read from "data".  A copy starting from
+        // the beginning brings the rest of "outgoing" along with it, so that
+        // the copies that are about to start find their first chunks waiting.
+        // A copy whose indices grew since it began starts over from the
+        // beginning, whatever "position" says.
+        consus_returncode pull(datalayer* data, unsigned index,
+                               const std::map<unsigned, std::vector<unsigned> >& outgoing,
+                               const e::slice& position, uint64_t budget,
+                               std::string* entries, std::string* last,
+                               bool* done, uint64_t* scanned);
+        std::string debug_dump();
+
+    private:
+        struct entry;
+        struct stream;
+        typedef std::map<unsigned, stream*> stream_map_t;
+        // make "s" begin after "position", keeping what it buffered past it
+        void advance(stream* s, const e::slice& position);
+        // drop everything "s" buffered and begin again after "position"
+        void restart(stream* s, const e::slice& position);
+        consus_returncode scan(datalayer* data, stream* s, uint64_t budget,
+                               uint64_t* scanned);
+        void expire(uint64_t now);
+
+    private:
+        po6::threads::mutex m_mtx;
+        stream_map_t m_streams;
+        uint64_t m_buffered;
+        uint64_t m_pulls;
+        uint64_t m_shared;
+        uint64_t m_scanned;
+
+    private:
+        migration_source(const migration_source&);
+        migration_source& operator = (const migration_source&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_kvs_migration_source_h_
@@ -25,6 +25,14 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// C
+#include <stdint.h>
+
+// STL
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
 // BusyBee
 #include <busybee_constants.h>
 
@@ -32,6 +40,7 @@
 #include <glog/logging.h>
 
 // consus
+#include "common/crc32c.h"
 #include "common/network_msgtype.h"
 #include "kvs/daemon.h"
 #include "kvs/migrator.h"
@@ -40,6 +49,9 @@ using consus::migrator;
 
 extern bool s_debug_mode;
 
+// the most bytes of versions the owner packs into one chunk
+#define MIGRATE_CHUNK_BYTES (1ULL << 20)
+
 migrator :: migrator(partition_id key)
     : m_state_key(key)
     , m_mtx()
@@ -47,6 +59,21 @@ migrator :: migrator(partition_id key)
     , m_state(UNINITIALIZED)
     , m_last_handshake(0)
     , m_last_coord_call(0)
+    , m_position()
+    , m_seqno(1)
+    , m_outstanding(false)
+    , m_copied(false)
+    , m_last_pull(0)
+    , m_next_pull(0)
+    , m_wakeup()
+    , m_started(0)
+    , m_chunks(0)
+    , m_versions(0)
+    , m_bytes(0)
+    , m_scanned(0)
+    , m_lock_waits(0)
+    , m_retries(0)
+    , m_rejected(0)
 {
 }
 
@@ -78,10 +105,80 @@ migrator :: ack(version_id version, daemon* d)
     {
         LOG_IF(INFO, s_debug_mode) << "received migration ACK for " << m_state_key << "/" << m_version;
         m_state = TRANSFER_DATA;
+        m_started = po6::monotonic_time();
         work_state_machine(d);
     }
 }
 
+void
+migrator :: data(uint64_t seqno, const e::slice& position, bool done,
+                 uint64_t scanned, uint32_t checksum,
+                 const e::slice& entries, const e::slice& locks, daemon* d)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    // a chunk that was resent after it was presumed lost may still arrive;
+    // only the answer to the outstanding pull moves the copy forward
+    if (m_state != TRANSFER_DATA || !m_outstanding || seqno != m_seqno)
+    {
+        return;
+    }
+
+    m_outstanding = false;
+
+    if (crc32c(crc32c(0, entries.data(), entries.size()), locks.data(), locks.size()) != checksum ||
+        !apply(entries, d))
+    {
+        // pull the same chunk again, after a pause in case the failure is
+        // local and persistent
+        ++m_rejected;
+        m_next_pull = po6::monotonic_time() + d->resend_interval();
+        schedule_wakeup(m_next_pull, d);
+        return;
+    }
+
+    m_position.assign(position.cdata(), position.size());
+    ++m_seqno;
+    ++m_chunks;
+    m_bytes += entries.size();
+    m_scanned += scanned;
+    const uint64_t rate = d->migration_rate();
+
+    // Pace pulls so that the owner's reads average out to the configured
+    // rate.  A chunk answered from what the owner buffered while reading for
+    // another partition costs it no reads, but is still bounded by its size.
+    if (rate > 0)
+    {
+        const uint64_t cost = std::max(scanned, uint64_t(entries.size()));
+        m_next_pull = m_last_pull + cost * PO6_SECONDS / rate;
+    }
+
+    // The owner may still hold locks taken before the copy began; the
+    // partition can't change hands until each has been released, or shows up
+    // here because it was taken during the copy.  Pull the (empty) tail again
+    // to get a fresh list.
+    if (done && !locks_mirrored(locks, d))
+    {
+        ++m_lock_waits;
+        LOG_IF(INFO, s_debug_mode) << "migration of " << m_state_key
+                                   << " waiting on locks held by the owner";
+        m_next_pull = std::max(m_next_pull, po6::monotonic_time() + d->resend_interval());
+        done = false;
+    }
+
+    m_copied = done;
+
+    if (m_copied)
+    {
+        LOG(INFO) << "copied partition " << m_state_key << ": " << m_versions
+                  << " versions in " << m_chunks << " chunks ("
+                  << m_bytes << " bytes, " << m_scanned << " bytes read by the owner) over "
+                  << (po6::monotonic_time() - m_started) / PO6_MILLIS << "ms";
+    }
+
+    work_state_machine(d);
+}
+
 void
 migrator :: externally_work_state_machine(daemon* d)
 {
@@ -100,7 +197,40 @@ migrator :: terminate()
 std::string
 migrator :: debug_dump()
 {
-    return "XXX"; // XXX
+    po6::threads::mutex::hold hold(&m_mtx);
+    std::ostringstream ostr;
+    ostr << "version=" << m_version.get() << " state=";
+
+    switch (m_state)
+    {
+        case UNINITIALIZED:
+            ostr << "uninitialized";
+            break;
+        case CHECK_CONFIG:
+            ostr << "check-config";
+            break;
+        case TRANSFER_DATA:
+            ostr << (m_copied ? "transferred" : "transfer-data");
+            break;
+        case TERMINATED:
+            ostr << "terminated";
+            break;
+        default:
+            ostr << "unknown";
+            break;
+    }
+
+    ostr << "\n"
+         << "chunks=" << m_chunks
+         << " versions=" << m_versions
+         << " bytes=" << m_bytes
+         << " scanned=" << m_scanned
+         << " lock_waits=" << m_lock_waits
+         << " retries=" << m_retries
+         << " rejected=" << m_rejected
+         << " outstanding=" << (m_outstanding ? "yes" : "no")
+         << " position=" << e::slice(m_position).hex();
+    return ostr.str();
 }
 
 void
@@ -154,13 +284,35 @@ migrator :: work_state_machine_check_config(daemon* d)
 void
 migrator :: work_state_machine_transfer_data(daemon* d)
 {
-    bool done = true;
-    // XXX
-
     const uint64_t now = po6::monotonic_time();
 
-    if (done &&
-        m_last_coord_call + d->resend_interval() < now)
+    if (!m_copied)
+    {
+        if (m_outstanding && m_last_pull + d->resend_interval() < now)
+        {
+            ++m_retries;
+            m_outstanding = false;
+            LOG_IF(INFO, s_debug_mode) << "migration pull " << m_seqno << " for "
+                                       << m_state_key << " timed out; resending";
+        }
+
+        if (m_outstanding)
+        {
+            schedule_wakeup(m_last_pull + d->resend_interval() + 1, d);
+        }
+        else if (m_next_pull > now)
+        {
+            schedule_wakeup(m_next_pull, d);
+        }
+        else
+        {
+            send_pull(now, d);
+        }
+
+        return;
+    }
+
+    if (m_last_coord_call + d->resend_interval() < now)
     {
         std::string msg;
         e::packer(&msg) << m_state_key;
@@ -168,3 +320,102 @@ migrator :: work_state_machine_transfer_data(daemon* d)
         m_last_coord_call = now;
     }
 }
+
+void
+migrator :: send_pull(uint64_t now, daemon* d)
+{
+    configuration* c = d->get_config();
+    const unsigned index = c->index_from_next_id(m_state_key);
+
+    if (index >= CONSUS_KVS_PARTITIONS)
+    {
+        return;
+    }
+
+    // keep one chunk from exceeding a second's worth of the rate limit
+    const uint64_t rate = d->migration_rate();
+    uint64_t budget = MIGRATE_CHUNK_BYTES;
+
+    if (rate > 0 && rate < budget)
+    {
+        budget = rate;
+    }
+
+    const e::slice position(m_position);
+    const size_t sz = BUSYBEE_HEADER_SIZE
+                    + pack_size(KVS_MIGRATE_PULL)
+                    + pack_size(m_state_key)
+                    + sizeof(uint64_t)
+                    + sizeof(uint64_t)
+                    + sizeof(uint16_t)
+                    + pack_size(position)
+                    + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(BUSYBEE_HEADER_SIZE)
+        << KVS_MIGRATE_PULL << m_state_key << m_version << m_seqno
+        << uint16_t(index) << position << budget;
+    d->send(c->owner_from_next_id(m_state_key), msg);
+    m_outstanding = true;
+    m_last_pull = now;
+    schedule_wakeup(now + d->resend_interval() + 1, d);
+}
+
+bool
+migrator :: apply(const e::slice& entries, daemon* d)
+{
+    std::vector<datalayer::version> vs;
+    e::unpacker up(entries);
+
+    while (up.remain() && !up.error())
+    {
+        datalayer::version v;
+        up = up >> v.table >> v.key >> v.timestamp >> v.value;
+        vs.push_back(v);
+    }
+
+    if (up.error())
+    {
+        LOG(ERROR) << "received corrupt migration chunk for " << m_state_key;
+        return false;
+    }
+
+    if (!vs.empty() &&
+        d->m_data->import(&vs[0], vs.size()) != CONSUS_SUCCESS)
+    {
+        return false;
+    }
+
+    m_versions += vs.size();
+    return true;
+}
+
+bool
+migrator :: locks_mirrored(const e::slice& locks, daemon* d)
+{
+    e::unpacker up(locks);
+
+    while (up.remain() && !up.error())
+    {
+        e::slice table;
+        e::slice key;
+        transaction_group tg;
+        transaction_group here;
+        up = up >> table >> key >> tg;
+
+        if (up.error() ||
+            d->m_data->read_lock(table, key, &here) != CONSUS_SUCCESS ||
+            here != tg)
+        {
+            return false;
+        }
+    }
+
+    return !up.error();
+}
+
+void
+migrator :: schedule_wakeup(uint64_t when, daemon* d)
+{
+    const uint64_t now = po6::monotonic_time();
+    m_wakeup.no_later_than(d, daemon::PUMP_MIGRATE, m_state_key.get(), now, when);
+}
@@ -28,6 +28,9 @@
 #ifndef consus_kvs_migrator_h_
 #define consus_kvs_migrator_h_
 
+// STL
+#include <string>
+
 // po6
 #include <po6/threads/mutex.h>
 
@@ -38,6 +41,7 @@
 #include <consus.h>
 #include "namespace.h"
 #include "common/ids.h"
+#include "common/timer_wheel.h"
 
 BEGIN_CONSUS_NAMESPACE
 class daemon;
@@ -54,6 +58,11 @@ class migrator
 
     public:
         void ack(version_id version, daemon* d);
+        // one chunk of the partition, answering pull "seqno"; the last chunk
+        // carries the locks the owner holds in the partition
+        void data(uint64_t seqno, const e::slice& position, bool done,
+                  uint64_t scanned, uint32_t checksum,
+                  const e::slice& entries, const e::slice& locks, daemon* d);
         void externally_work_state_machine(daemon* d);
         void terminate();
         std::string debug_dump();
@@ -72,6 +81,11 @@ class migrator
         void work_state_machine(daemon* d);
         void work_state_machine_check_config(daemon* d);
         void work_state_machine_transfer_data(daemon* d);
+        void send_pull(uint64_t now, daemon* d);
+        bool apply(const e::slice& entries, daemon* d);
+        // true if every lock in "locks" is held here by the same holder
+        bool locks_mirrored(const e::slice& locks, daemon* d);
+        void schedule_wakeup(uint64_t when, daemon* d);
 
     private:
         const partition_id m_state_key;
@@ -80,6 +94,28 @@ class migrator
         state_t m_state;
         uint64_t m_last_handshake;
         uint64_t m_last_coord_call;
+        // The data copy pulls one chunk at a time from the current owner.
+        // "m_position" is where the last chunk this server applied ended, so
+        // a lost chunk or a restarted owner picks up from there.
+        std::string m_position;
+        uint64_t m_seqno;
+        bool m_outstanding;
+        bool m_copied;
+        uint64_t m_last_pull;
+        uint64_t m_next_pull;
+        pump_wakeup m_wakeup;
+        uint64_t m_started;
+        uint64_t m_chunks;
+        uint64_t m_versions;
+        uint64_t m_bytes;
+        uint64_t m_scanned;
+        uint64_t m_lock_waits;
+        uint64_t m_retries;
+        uint64_t m_rejected;
+
+    private:
+        migrator(const migrator&);
+        migrator& operator = (const migrator&);
 };
 
 END_CONSUS_NAMESPACE
@@ -0,0 +1,141 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// STL
+#include <algorithm>
+
+// consus
+#include "kvs/peer_latency.h"
+
+using consus::peer_latency;
+
+// how many of the most recent samples each peer keeps
+#define SAMPLES 64
+// recompute the percentile after this many new samples
+#define RECOMPUTE 8
+// EWMA weight of 1/8, as for TCP's smoothed RTT
+#define EWMA_SHIFT 3
+
+struct peer_latency::peer
+{
+    peer() : samples(), next(0), fresh(0), mean(0), p95(0) {}
+    ~peer() throw () {}
+
+    std::vector<uint64_t> samples;
+    size_t next;
+    unsigned fresh;
+    uint64_t mean;
+    uint64_t p95;
+};
+
+peer_latency :: peer_latency()
+    : m_mtx()
+    , m_peers()
+{
+}
+
+peer_latency :: ~peer_latency() throw ()
+{
+}
+
+void
+peer_latency :: record(comm_id id, uint64_t latency)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    peer& p(m_peers[id]);
+
+    if (p.samples.size() < SAMPLES)
+    {
+        p.samples.push_back(latency);
+    }
+    else
+    {
+        p.samples[p.next] = latency;
+        p.next = (p.next + 1) % SAMPLES;
+    }
+
+    if (p.mean == 0)
+    {
+        p.mean = latency;
+    }
+    else
+    {
+        p.mean = p.mean - (p.mean >> EWMA_SHIFT) + (latency >> EWMA_SHIFT);
+    }
+
+    ++p.fresh;
+
+    if (p.fresh >= RECOMPUTE || p.p95 == 0)
+    {
+        std::vector<uint64_t> tmp(p.samples);
+        std::vector<uint64_t>::iterator nth = tmp.begin() + tmp.size() * 95 / 100;
+        std::nth_element(tmp.begin(), nth, tmp.end());
+        p.p95 = *nth;
+        p.fresh = 0;
+    }
+}
+
+uint64_t
+peer_latency :: typical(comm_id id)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    peer_map_t::iterator it = m_peers.find(id);
+    return it != m_peers.end() ? it->second.mean : 0;
+}
+
+uint64_t
+peer_latency :: slow(comm_id id, uint64_t otherwise)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    peer_map_t::iterator it = m_peers.find(id);
+
+    if (it == m_peers.end() || it->second.samples.size() < RECOMPUTE)
+    {
+        return otherwise;
+    }
+
+    return it->second.p95;
+}
+
+void
+peer_latency :: rank(comm_id* ids, size_t ids_sz)
+{
+    std::vector<std::pair<uint64_t, comm_id> > order;
+
+    for (size_t i = 0; i < ids_sz; ++i)
+    {
+        order.push_back(std::make_pair(typical(ids[i]), ids[i]));
+    }
+
+    std::stable_sort(order.begin(), order.end());
+
+    for (size_t i = 0; i < ids_sz; ++i)
+    {
+        ids[i] = order[i].second;
+    }
+}
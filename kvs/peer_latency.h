@@ -0,0 +1,82 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef consus_kvs_peer_latency_h_
+#define consus_kvs_peer_latency_h_
+
+// STL
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/compat.h>
+
+// consus
+#include "namespace.h"
+#include "common/ids.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// Tracks how long recent requests to each peer took to answer.  Replicators
+// use it to send reads to the fastest replicas first and to decide how long to
+// wait on a straggler before hedging to another replica.
+class peer_latency
+{
+    public:
+        peer_latency();
+        ~peer_latency() throw ();
+
+    public:
+        void record(comm_id id, uint64_t latency);
+        // smoothed mean latency; 0 for a peer never heard from, so that
+        // unknown peers get tried
+        uint64_t typical(comm_id id);
+        // the latency under which the 95th percentile of recent responses
+        // arrived; "otherwise" for a peer with too few samples
+        uint64_t slow(comm_id id, uint64_t otherwise);
+        // reorder ids from lowest to highest typical latency
+        void rank(comm_id* ids, size_t ids_sz);
+
+    private:
+        struct peer;
+        typedef e::compat::unordered_map<comm_id, peer> peer_map_t;
+
+    private:
+        po6::threads::mutex m_mtx;
+        peer_map_t m_peers;
+
+    private:
+        peer_latency(const peer_latency&);
+        peer_latency& operator = (const peer_latency&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_kvs_peer_latency_h_
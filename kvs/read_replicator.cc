@@ -27,6 +27,9 @@
 
 #define __STDC_LIMIT_MACROS
 
+// STL
+#include <algorithm>
+
 // Google Log
 #include <glog/logging.h>
 
@@ -47,6 +50,11 @@ using consus::read_replicator;
 
 extern bool s_debug_mode;
 
+// how long to wait on a replica before hedging, until its latency is known
+#define HEDGE_DEFAULT (20 * PO6_MILLIS)
+// never hedge faster than this, however quick a replica usually is
+#define HEDGE_MIN (2 * PO6_MILLIS)
+
 struct read_replicator :: read_stub
 {
     read_stub(comm_id t);
@@ -55,12 +63,22 @@ struct read_replicator :: read_stub
     comm_id target;
     replica_set rs;
     uint64_t last_request_time;
+    // ask only for the timestamp, not the value
+    bool digest;
+    // another replica has been asked in this one's stead
+    bool hedged;
+    consus_returncode status;
+    uint64_t timestamp;
 };
 
 read_replicator :: read_stub :: read_stub(comm_id t)
     : target(t)
     , rs()
     , last_request_time(0)
+    , digest(false)
+    , hedged(false)
+    , status(CONSUS_GARBAGE)
+    , timestamp(0)
 {
 }
 
@@ -69,6 +87,7 @@ read_replicator :: read_replicator(uint64_t key)
     , m_mtx()
     , m_init(false)
     , m_finished(false)
+    , m_wakeup()
     , m_id()
     , m_nonce()
     , m_table()
@@ -78,6 +97,7 @@ read_replicator :: read_replicator(uint64_t key)
     , m_value()
     , m_vbacking()
     , m_timestamp(0)
+    , m_value_requested(false)
     , m_requests()
 {
 }
@@ -123,7 +143,7 @@ read_replicator :: init(comm_id id, uint64_t nonce,
 void
 read_replicator :: response(comm_id id, consus_returncode rc,
                             uint64_t timestamp, const e::slice& value,
-                            const replica_set& rs,
+                            bool digest, const replica_set& rs,
                             std::auto_ptr<e::buffer> backing, daemon* d)
 {
     po6::threads::mutex::hold hold(&m_mtx);
@@ -139,9 +159,27 @@ read_replicator :: response(comm_id id, consus_returncode rc,
         return;
     }
 
-    if (returncode_is_final(rc))
+    if (stub->last_request_time > 0)
+    {
+        d->m_peer_latency.record(id, po6::monotonic_time() - stub->last_request_time);
+    }
+
+    // The replica marks a digest explicitly; it may answer a digest request
+    // that has since been upgraded to a full read.
+    if (returncode_is_final(rc) && digest)
     {
         stub->rs = rs;
+        stub->status = rc;
+        stub->timestamp = timestamp;
+        LOG_IF(INFO, s_debug_mode) << logid() << " digest rc=" << rc
+                                   << " timestamp=" << timestamp
+                                   << " from=" << id;
+    }
+    else if (returncode_is_final(rc))
+    {
+        stub->rs = rs;
+        stub->status = rc;
+        stub->timestamp = timestamp;
 
         if (m_timestamp == 0 || timestamp > m_timestamp)
         {
@@ -226,20 +264,46 @@ read_replicator :: work_state_machine(daemon* d)
         // XXX
     }
 
+    if (rs.desired_replication > rs.num_replicas)
+    {
+        LOG_EVERY_N(WARNING, 1000) << "too few kvs daemons to achieve desired replication factor: "
+                                   << rs.desired_replication - rs.num_replicas
+                                   << " more daemons needed";
+        rs.desired_replication = rs.num_replicas;
+    }
+
     const uint64_t now = po6::monotonic_time();
+    const unsigned quorum = rs.desired_replication / 2 + 1;
     unsigned complete = 0;
+    unsigned contacted = 0;
+    unsigned straggling = 0;
+    bool need_value = false;
 
     for (unsigned i = 0; i < rs.num_replicas; ++i)
     {
         read_stub* stub = get_stub(rs.replicas[i]);
 
-        if (!stub)
+        if (!stub || stub->last_request_time == 0)
         {
-            m_requests.push_back(read_stub(rs.replicas[i]));
-            stub = &m_requests.back();
+            continue;
         }
 
-        if (replica_sets_agree(rs.replicas[i], rs, stub->rs))
+        ++contacted;
+
+        if (stub->status == CONSUS_SUCCESS && stub->timestamp > m_timestamp)
+        {
+            // this replica holds a newer version than any value in hand, but
+            // only sent its digest; go back for the value itself
+            need_value = true;
+
+            if (stub->digest ||
+                stub->last_request_time + d->resend_interval() < now)
+            {
+                stub->digest = false;
+                send_read_request(stub, now, d);
+            }
+        }
+        else if (replica_sets_agree(rs.replicas[i], rs, stub->rs))
         {
             ++complete;
         }
@@ -247,19 +311,57 @@ read_replicator :: work_state_machine(daemon* d)
         {
             send_read_request(stub, now, d);
         }
+        else if (stub->status == CONSUS_GARBAGE &&
+                 (stub->hedged || hedge_deadline(stub, d) < now))
+        {
+            stub->hedged = true;
+            ++straggling;
+        }
     }
 
-    if (rs.desired_replication > rs.num_replicas)
+    // Ask the fastest replicas not yet asked until a quorum is outstanding,
+    // plus one more for each replica that has been slow to answer.
+    unsigned want = d->m_read_all ? rs.num_replicas : quorum + straggling;
+    want = std::min(want, rs.num_replicas);
+
+    if (contacted < want)
     {
-        LOG_EVERY_N(WARNING, 1000) << "too few kvs daemons to achieve desired replication factor: "
-                                   << rs.desired_replication - rs.num_replicas
-                                   << " more daemons needed";
-        rs.desired_replication = rs.num_replicas;
-    }
+        comm_id candidates[CONSUS_MAX_REPLICATION_FACTOR];
+        size_t candidates_sz = 0;
 
-    const unsigned quorum = rs.desired_replication / 2 + 1;
+        for (unsigned i = 0; i < rs.num_replicas; ++i)
+        {
+            read_stub* stub = get_stub(rs.replicas[i]);
 
-    if (complete >= quorum)
+            if (!stub || stub->last_request_time == 0)
+            {
+                candidates[candidates_sz] = rs.replicas[i];
+                ++candidates_sz;
+            }
+        }
+
+        d->m_peer_latency.rank(candidates, candidates_sz);
+
+        for (size_t i = 0; i < candidates_sz && contacted < want; ++i)
+        {
+            read_stub* stub = get_stub(candidates[i]);
+
+            if (!stub)
+            {
+                m_requests.push_back(read_stub(candidates[i]));
+                stub = &m_requests.back();
+            }
+
+            // the value needs to cross the network once; everyone else
+            // returns just a timestamp to compare against it
+            stub->digest = m_value_requested;
+            m_value_requested = true;
+            send_read_request(stub, now, d);
+            ++contacted;
+        }
+    }
+
+    if (complete >= quorum && !need_value)
     {
         m_finished = true;
         const size_t sz = BUSYBEE_HEADER_SIZE
@@ -275,6 +377,10 @@ read_replicator :: work_state_machine(daemon* d)
         LOG_IF(INFO, s_debug_mode) << "sending read response " << m_status
                                    << " nonce=" << m_nonce << " to " << m_id;
     }
+    else
+    {
+        schedule_wakeup(now, d);
+    }
 }
 
 // It's tempting to dedupe this with {write,lock}-replicator.  Reads and writes
@@ -324,8 +430,45 @@ read_replicator :: send_read_request(read_stub* stub, uint64_t now, daemon* d)
                     + sizeof(uint64_t)
                     + pack_size(m_value);
     std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    const uint8_t flags = stub->digest ? CONSUS_READ_DIGEST : 0;
     msg->pack_at(BUSYBEE_HEADER_SIZE)
-        << KVS_RAW_RD << m_state_key << m_table << m_key << uint64_t(UINT64_MAX);
+        << KVS_RAW_RD << m_state_key << m_table << m_key << uint64_t(UINT64_MAX) << flags;
     d->send(stub->target, msg);
     stub->last_request_time = now;
+    stub->hedged = false;
+}
+
+uint64_t
+read_replicator :: hedge_deadline(read_stub* stub, daemon* d)
+{
+    const uint64_t slow = d->m_peer_latency.slow(stub->target, HEDGE_DEFAULT);
+    return stub->last_request_time + std::max(slow, uint64_t(HEDGE_MIN));
+}
+
+// Arrange for the pumping thread to revisit this state machine when the oldest
+// outstanding request becomes eligible for a resend, or a straggler for a
+// hedge.
+void
+read_replicator :: schedule_wakeup(uint64_t now, daemon* d)
+{
+    uint64_t when = next_resend(m_requests, now, d->resend_interval());
+
+    for (size_t i = 0; i < m_requests.size(); ++i)
+    {
+        if (m_requests[i].last_request_time == 0 ||
+            m_requests[i].status != CONSUS_GARBAGE ||
+            m_requests[i].hedged)
+        {
+            continue;
+        }
+
+        const uint64_t h = hedge_deadline(&m_requests[i], d) + 1;
+
+        if (h > now && h < when)
+        {
+            when = h;
+        }
+    }
+
+    m_wakeup.no_later_than(d, daemon::PUMP_READ, m_state_key, now, when);
 }
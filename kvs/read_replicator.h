@@ -38,6 +38,7 @@
 #include <consus.h>
 #include "namespace.h"
 #include "common/ids.h"
+#include "common/timer_wheel.h"
 
 BEGIN_CONSUS_NAMESPACE
 class daemon;
@@ -58,7 +59,7 @@ class read_replicator
                   std::auto_ptr<e::buffer> backing);
         void response(comm_id id, consus_returncode rc,
                       uint64_t timestamp, const e::slice& value,
-                      const replica_set& rs,
+                      bool digest, const replica_set& rs,
                       std::auto_ptr<e::buffer> backing, daemon* d);
         void externally_work_state_machine(daemon* d);
         std::string debug_dump();
@@ -72,12 +73,15 @@ class read_replicator
         void work_state_machine(daemon* d);
         bool returncode_is_final(consus_returncode rc);
         void send_read_request(read_stub* stub, uint64_t now, daemon* d);
+        uint64_t hedge_deadline(read_stub* stub, daemon* d);
+        void schedule_wakeup(uint64_t now, daemon* d);
 
     private:
         const uint64_t m_state_key;
         po6::threads::mutex m_mtx;
         bool m_init;
         bool m_finished;
+        pump_wakeup m_wakeup;
         comm_id m_id;
         uint64_t m_nonce;
         e::slice m_table;
@@ -87,6 +91,7 @@ class read_replicator
         e::slice m_value;
         std::auto_ptr<e::buffer> m_vbacking;
         uint64_t m_timestamp;
+        bool m_value_requested;
         std::vector<read_stub> m_requests;
 };
 
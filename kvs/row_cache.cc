@@ -0,0 +1,222 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <sstream>
+
+// consus
+#include "kvs/row_cache.h"
+
+using consus::row_cache;
+
+// enough that readers of different hot keys rarely share a lock
+#define SHARDS 32
+// what a row costs beyond its key and value: list node, hash node, and the
+// value's shared_ptr control block
+#define ROW_OVERHEAD 128
+
+struct row_cache::row
+{
+    row(const std::string& o, uint64_t ts, const value_t& v)
+        : obj(o), timestamp(ts), value(v) {}
+    ~row() throw () {}
+
+    std::string obj;
+    uint64_t timestamp;
+    value_t value;
+};
+
+struct row_cache::shard
+{
+    typedef std::list<row> lru_t;
+    typedef e::compat::unordered_map<std::string, lru_t::iterator> index_t;
+
+    shard() : mtx(), lru(), index(), bytes(0), generation(0),
+              hits(0), misses(0), evictions(0) {}
+    ~shard() throw () {}
+
+    static uint64_t cost(const row& r)
+    { return ROW_OVERHEAD + 2 * r.obj.size() + r.value->size(); }
+    void erase(index_t::iterator it);
+
+    po6::threads::mutex mtx;
+    // most recently used first
+    lru_t lru;
+    index_t index;
+    uint64_t bytes;
+    // bumped by every invalidation; fills check it to avoid caching a row
+    // that was read before a write and would outlive it
+    uint64_t generation;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+
+    private:
+        shard(const shard&);
+        shard& operator = (const shard&);
+};
+
+void
+row_cache :: shard :: erase(index_t::iterator it)
+{
+    bytes -= cost(*it->second);
+    lru.erase(it->second);
+    index.erase(it);
+}
+
+row_cache :: row_cache(uint64_t budget)
+    : m_shard_budget(budget / SHARDS)
+    , m_shards()
+{
+    for (size_t i = 0; i < SHARDS; ++i)
+    {
+        m_shards.push_back(e::compat::shared_ptr<shard>(new shard()));
+    }
+}
+
+row_cache :: ~row_cache() throw ()
+{
+}
+
+bool
+row_cache :: get(const std::string& obj, uint64_t timestamp_le,
+                 uint64_t* timestamp, value_t* value)
+{
+    shard* s = get_shard(obj);
+    po6::threads::mutex::hold hold(&s->mtx);
+    shard::index_t::iterator it = s->index.find(obj);
+
+    if (it == s->index.end() || it->second->timestamp > timestamp_le)
+    {
+        ++s->misses;
+        return false;
+    }
+
+    s->lru.splice(s->lru.begin(), s->lru, it->second);
+    *timestamp = it->second->timestamp;
+    *value = it->second->value;
+    ++s->hits;
+    return true;
+}
+
+uint64_t
+row_cache :: ticket(const std::string& obj)
+{
+    shard* s = get_shard(obj);
+    po6::threads::mutex::hold hold(&s->mtx);
+    return s->generation;
+}
+
+void
+row_cache :: fill(const std::string& obj, uint64_t ticket,
+                  uint64_t timestamp, const e::slice& value)
+{
+    // build the copy outside the lock
+    value_t v(new std::string(value.cdata(), value.size()));
+    row r(obj, timestamp, v);
+    shard* s = get_shard(obj);
+
+    if (shard::cost(r) > m_shard_budget)
+    {
+        return;
+    }
+
+    po6::threads::mutex::hold hold(&s->mtx);
+
+    if (s->generation != ticket)
+    {
+        return;
+    }
+
+    shard::index_t::iterator it = s->index.find(obj);
+
+    if (it != s->index.end())
+    {
+        s->erase(it);
+    }
+
+    s->lru.push_front(r);
+    s->index[obj] = s->lru.begin();
+    s->bytes += shard::cost(r);
+
+    while (s->bytes > m_shard_budget)
+    {
+        it = s->index.find(s->lru.back().obj);
+        s->erase(it);
+        ++s->evictions;
+    }
+}
+
+void
+row_cache :: invalidate(const std::string& obj)
+{
+    shard* s = get_shard(obj);
+    po6::threads::mutex::hold hold(&s->mtx);
+    ++s->generation;
+    shard::index_t::iterator it = s->index.find(obj);
+
+    if (it != s->index.end())
+    {
+        s->erase(it);
+    }
+}
+
+std::string
+row_cache :: debug_dump()
+{
+    uint64_t rows = 0;
+    uint64_t bytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+
+    for (size_t i = 0; i < m_shards.size(); ++i)
+    {
+        shard* s = m_shards[i].get();
+        po6::threads::mutex::hold hold(&s->mtx);
+        rows += s->index.size();
+        bytes += s->bytes;
+        hits += s->hits;
+        misses += s->misses;
+        evictions += s->evictions;
+    }
+
+    std::ostringstream ostr;
+    ostr << "row cache: rows=" << rows
+         << " bytes=" << bytes << "/" << m_shard_budget * m_shards.size()
+         << " hits=" << hits
+         << " misses=" << misses
+         << " evictions=" << evictions << "\n";
+    return ostr.str();
+}
+
+row_cache::shard*
+row_cache :: get_shard(const std::string& obj)
+{
+    e::compat::hash<std::string> h;
+    return m_shards[h(obj) % m_shards.size()].get();
+}
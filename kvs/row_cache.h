@@ -0,0 +1,96 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_kvs_row_cache_h_
+#define consus_kvs_row_cache_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <list>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/compat.h>
+#include <e/slice.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The latest version of recently read objects, so that reads of hot keys
+// skip LevelDB altogether.  Objects are named by their encoded object key and
+// spread over independently locked shards, each evicting its least recently
+// used rows to stay within its share of the byte budget.
+class row_cache
+{
+    public:
+        typedef e::compat::shared_ptr<const std::string> value_t;
+
+    public:
+        row_cache(uint64_t budget);
+        ~row_cache() throw ();
+
+    public:
+        // If the cached latest version is no newer than "timestamp_le", it's
+        // the answer; hand it back and count a hit.
+        bool get(const std::string& obj, uint64_t timestamp_le,
+                 uint64_t* timestamp, value_t* value);
+        // Take before reading the latest version from disk and pass to fill,
+        // which drops the row if "obj" was invalidated in between.
+        uint64_t ticket(const std::string& obj);
+        void fill(const std::string& obj, uint64_t ticket,
+                  uint64_t timestamp, const e::slice& value);
+        // call after the write to "obj" is durable
+        void invalidate(const std::string& obj);
+        std::string debug_dump();
+
+    private:
+        struct row;
+        struct shard;
+
+    private:
+        shard* get_shard(const std::string& obj);
+
+    private:
+        const uint64_t m_shard_budget;
+        std::vector<e::compat::shared_ptr<shard> > m_shards;
+
+    private:
+        row_cache(const row_cache&);
+        row_cache& operator = (const row_cache&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_kvs_row_cache_h_
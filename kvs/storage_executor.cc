@@ -0,0 +1,258 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <assert.h>
+
+// POSIX
+#include <signal.h>
+
+// STL
+#include <algorithm>
+#include <sstream>
+
+// Google Log
+#include <glog/logging.h>
+
+// po6
+#include <po6/time.h>
+
+// consus
+#include "kvs/storage_executor.h"
+
+using consus::storage_executor;
+
+struct storage_executor::queue
+{
+    queue();
+    ~queue() throw ();
+
+    po6::threads::mutex mtx;
+    po6::threads::cond cond;
+    std::deque<task*> tasks;
+    bool shutdown;
+    // metrics, all guarded by mtx
+    uint64_t max_depth;
+    uint64_t completed;
+    uint64_t wait_time;
+    uint64_t service_time;
+    uint64_t max_service_time;
+
+    private:
+        queue(const queue&);
+        queue& operator = (const queue&);
+};
+
+storage_executor :: queue :: queue()
+    : mtx()
+    , cond(&mtx)
+    , tasks()
+    , shutdown(false)
+    , max_depth(0)
+    , completed(0)
+    , wait_time(0)
+    , service_time(0)
+    , max_service_time(0)
+{
+}
+
+storage_executor :: queue :: ~queue() throw ()
+{
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        delete tasks[i];
+    }
+}
+
+storage_executor :: task :: task()
+    : m_enqueued(0)
+{
+}
+
+storage_executor :: task :: ~task() throw ()
+{
+}
+
+storage_executor :: storage_executor(e::garbage_collector* gc)
+    : m_gc(gc)
+    , m_queues()
+    , m_threads()
+{
+}
+
+storage_executor :: ~storage_executor() throw ()
+{
+    shutdown();
+}
+
+void
+storage_executor :: start(unsigned threads)
+{
+    assert(m_queues.empty());
+    threads = std::max(threads, 1U);
+
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        m_queues.push_back(e::compat::shared_ptr<queue>(new queue()));
+    }
+
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        using namespace po6::threads;
+        e::compat::shared_ptr<thread> t(new thread(make_obj_func(&storage_executor::run, this, size_t(i))));
+        m_threads.push_back(t);
+        t->start();
+    }
+}
+
+void
+storage_executor :: shutdown()
+{
+    for (size_t i = 0; i < m_queues.size(); ++i)
+    {
+        po6::threads::mutex::hold hold(&m_queues[i]->mtx);
+        m_queues[i]->shutdown = true;
+        m_queues[i]->cond.broadcast();
+    }
+
+    for (size_t i = 0; i < m_threads.size(); ++i)
+    {
+        m_threads[i]->join();
+    }
+
+    m_threads.clear();
+}
+
+void
+storage_executor :: enqueue(uint64_t affinity, std::auto_ptr<task> t)
+{
+    assert(!m_queues.empty());
+    queue* q = m_queues[affinity % m_queues.size()].get();
+    po6::threads::mutex::hold hold(&q->mtx);
+
+    if (q->shutdown)
+    {
+        return;
+    }
+
+    t->m_enqueued = po6::monotonic_time();
+    q->tasks.push_back(t.release());
+    q->max_depth = std::max(q->max_depth, uint64_t(q->tasks.size()));
+
+    if (q->tasks.size() == 1)
+    {
+        q->cond.signal();
+    }
+}
+
+std::string
+storage_executor :: debug_dump()
+{
+    std::ostringstream ostr;
+
+    for (size_t i = 0; i < m_queues.size(); ++i)
+    {
+        queue* q = m_queues[i].get();
+        po6::threads::mutex::hold hold(&q->mtx);
+        const uint64_t n = std::max(q->completed, uint64_t(1));
+        ostr << "queue[" << i << "]"
+             << " depth=" << q->tasks.size()
+             << " max_depth=" << q->max_depth
+             << " completed=" << q->completed
+             << " avg_wait=" << q->wait_time / n / PO6_MICROS << "us"
+             << " avg_service=" << q->service_time / n / PO6_MICROS << "us"
+             << " max_service=" << q->max_service_time / PO6_MICROS << "us\n";
+    }
+
+    return ostr.str();
+}
+
+void
+storage_executor :: run(size_t idx)
+{
+    LOG(INFO) << "storage thread " << idx << " started";
+    block_signals();
+    e::garbage_collector::thread_state ts;
+    m_gc->register_thread(&ts);
+    queue* q = m_queues[idx].get();
+
+    while (true)
+    {
+        task* t = NULL;
+
+        {
+            po6::threads::mutex::hold hold(&q->mtx);
+
+            while (q->tasks.empty() && !q->shutdown)
+            {
+                m_gc->offline(&ts);
+                q->cond.wait();
+                m_gc->online(&ts);
+            }
+
+            if (q->shutdown)
+            {
+                break;
+            }
+
+            t = q->tasks.front();
+            q->tasks.pop_front();
+        }
+
+        const uint64_t start = po6::monotonic_time();
+        t->run();
+        const uint64_t end = po6::monotonic_time();
+
+        {
+            po6::threads::mutex::hold hold(&q->mtx);
+            ++q->completed;
+            q->wait_time += start - t->m_enqueued;
+            q->service_time += end - start;
+            q->max_service_time = std::max(q->max_service_time, end - start);
+        }
+
+        delete t;
+        m_gc->quiescent_state(&ts);
+    }
+
+    m_gc->deregister_thread(&ts);
+    LOG(INFO) << "storage thread " << idx << " stopped";
+}
+
+void
+storage_executor :: block_signals()
+{
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0 ||
+        pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        PLOG(ERROR) << "could not block signals";
+        LOG(ERROR) << "could not successfully block signals; this could result in undefined behavior";
+    }
+}
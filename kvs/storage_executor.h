@@ -0,0 +1,109 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef consus_kvs_storage_executor_h_
+#define consus_kvs_storage_executor_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <deque>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/cond.h>
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
+
+// e
+#include <e/compat.h>
+#include <e/garbage_collector.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// Runs storage work off the network threads.  Each worker thread drains its
+// own queue, and a task's affinity picks the queue, so that work on one key
+// runs in order on one thread.  Tasks report their own completion (e.g., by
+// sending the response) from within "run".
+class storage_executor
+{
+    public:
+        class task;
+
+    public:
+        storage_executor(e::garbage_collector* gc);
+        ~storage_executor() throw ();
+
+    public:
+        void start(unsigned threads);
+        // stops the workers; tasks still queued are dropped
+        void shutdown();
+        void enqueue(uint64_t affinity, std::auto_ptr<task> t);
+        std::string debug_dump();
+
+    private:
+        struct queue;
+        void run(size_t idx);
+        void block_signals();
+
+    private:
+        e::garbage_collector* m_gc;
+        std::vector<e::compat::shared_ptr<queue> > m_queues;
+        std::vector<e::compat::shared_ptr<po6::threads::thread> > m_threads;
+
+    private:
+        storage_executor(const storage_executor&);
+        storage_executor& operator = (const storage_executor&);
+};
+
+class storage_executor::task
+{
+    public:
+        task();
+        virtual ~task() throw ();
+
+    public:
+        virtual void run() = 0;
+
+    private:
+        friend class storage_executor;
+        uint64_t m_enqueued;
+
+    private:
+        task(const task&);
+        task& operator = (const task&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_kvs_storage_executor_h_
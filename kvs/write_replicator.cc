@@ -68,6 +68,7 @@ write_replicator :: write_replicator(uint64_t key)
     , m_mtx()
     , m_init(false)
     , m_finished(false)
+    , m_wakeup()
     , m_id()
     , m_nonce()
     , m_flags()
@@ -379,6 +380,10 @@ write_replicator :: work_state_machine(daemon* d)
             LOG(INFO) << logid() << " response=" << status;
         }
     }
+    else if (!m_finished)
+    {
+        schedule_wakeup(now, d);
+    }
 }
 
 bool
@@ -431,3 +436,10 @@ write_replicator :: send_write_request(write_stub* stub, uint64_t now, daemon* d
     d->send(stub->target, msg);
     stub->last_request_time = now;
 }
+
+void
+write_replicator :: schedule_wakeup(uint64_t now, daemon* d)
+{
+    const uint64_t when = next_resend(m_requests, now, d->resend_interval());
+    m_wakeup.no_later_than(d, daemon::PUMP_WRITE, m_state_key, now, when);
+}
@@ -38,6 +38,7 @@
 #include <consus.h>
 #include "namespace.h"
 #include "common/ids.h"
+#include "common/timer_wheel.h"
 
 BEGIN_CONSUS_NAMESPACE
 class daemon;
@@ -78,12 +79,14 @@ class write_replicator
         void work_state_machine(daemon* d);
         bool returncode_is_final(consus_returncode rc);
         void send_write_request(write_stub* stub, uint64_t now, daemon* d);
+        void schedule_wakeup(uint64_t now, daemon* d);
 
     private:
         const uint64_t m_state_key;
         po6::threads::mutex m_mtx;
         bool m_init;
         bool m_finished;
+        pump_wakeup m_wakeup;
         comm_id m_id;
         uint64_t m_nonce;
         unsigned m_flags;
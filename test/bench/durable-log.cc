@@ -0,0 +1,220 @@
+// Copyright (c) 2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// STL
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
+#include <po6/time.h>
+
+// e
+#include <e/compat.h>
+#include <e/popt.h>
+
+// consus
+#include "txman/durable_log.h"
+
+// Measures the transaction manager's durable log the way the daemon uses it:
+// each thread appends a record and then waits for it to become durable before
+// appending the next.  Reports appends per second and the time from append
+// to durability for 1-32 threads.
+
+struct benchmark
+{
+    benchmark(consus::durable_log* l, long i, long s)
+        : log(l), iterations(i), entry(s, 'x'), mtx(), latencies() {}
+
+    void worker();
+
+    consus::durable_log* log;
+    long iterations;
+    std::string entry;
+    po6::threads::mutex mtx;
+    std::vector<uint64_t> latencies;
+};
+
+void
+benchmark :: worker()
+{
+    std::vector<uint64_t> lats;
+    lats.reserve(iterations);
+
+    for (long i = 0; i < iterations; ++i)
+    {
+        const uint64_t start = po6::monotonic_time();
+        int64_t recno = log->append(entry.data(), entry.size());
+
+        if (recno < 0)
+        {
+            std::cerr << "append failed" << std::endl;
+            abort();
+        }
+
+        // everything below the durable bound is on disk
+        int64_t bound = -1;
+
+        while (bound <= recno && log->error() == 0)
+        {
+            bound = log->wait(bound);
+        }
+
+        lats.push_back(po6::monotonic_time() - start);
+    }
+
+    po6::threads::mutex::hold hold(&mtx);
+    latencies.insert(latencies.end(), lats.begin(), lats.end());
+}
+
+static double
+percentile(const std::vector<uint64_t>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+
+    size_t idx = p * (sorted.size() - 1);
+    return double(sorted[idx]) / PO6_MILLIS;
+}
+
+static bool
+run(const std::string& dir, long segments, long threads, long iterations, long size)
+{
+    using namespace po6::threads;
+    consus::durable_log log;
+
+    if (!log.open(dir, segments))
+    {
+        std::cerr << "could not open log in " << dir << std::endl;
+        return false;
+    }
+
+    // nothing is ever replayed, so whatever earlier runs left behind can go
+    log.truncate(INT64_MAX);
+
+    benchmark b(&log, iterations, size);
+    std::vector<e::compat::shared_ptr<thread> > ts;
+    const uint64_t start = po6::monotonic_time();
+
+    for (long i = 0; i < threads; ++i)
+    {
+        e::compat::shared_ptr<thread> t(new thread(make_obj_func(&benchmark::worker, &b)));
+        ts.push_back(t);
+        t->start();
+    }
+
+    for (size_t i = 0; i < ts.size(); ++i)
+    {
+        ts[i]->join();
+    }
+
+    const uint64_t end = po6::monotonic_time();
+    log.close();
+    const double secs = double(end - start) / PO6_SECONDS;
+    std::sort(b.latencies.begin(), b.latencies.end());
+    printf("segments=%-2ld threads=%-3ld appends=%-8ld rate=%9.0f appends/s  durable p50=%7.3fms p99=%7.3fms\n",
+           segments, threads, threads * iterations, b.latencies.size() / secs,
+           percentile(b.latencies, 0.50), percentile(b.latencies, 0.99));
+    return true;
+}
+
+int
+main(int argc, const char* argv[])
+{
+    const char* dir = "durable-log-bench";
+    long threads = 0;
+    long iterations = 1000;
+    long size = 256;
+    long segments = 2;
+    e::argparser ap;
+    ap.autohelp();
+    ap.arg().name('d', "data")
+            .description("directory for the log (default: durable-log-bench)")
+            .metavar("dir").as_string(&dir);
+    ap.arg().name('t', "threads")
+            .description("run with only this many threads (default: 1, 2, 4, 8, 16, 32)")
+            .as_long(&threads);
+    ap.arg().name('n', "iterations")
+            .description("how many records each thread appends (default: 1000)")
+            .as_long(&iterations);
+    ap.arg().name('s', "size")
+            .description("size of each record in bytes (default: 256)")
+            .as_long(&size);
+    ap.arg().name('S', "segments")
+            .description("number of log segments (default: 2)")
+            .as_long(&segments);
+
+    if (!ap.parse(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (threads < 0 || iterations <= 0 || size < 0)
+    {
+        std::cerr << "must specify a positive number of threads and iterations\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    if (segments < 2)
+    {
+        std::cerr << "must specify at least two segments\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    for (long t = 1; t <= 32; t *= 2)
+    {
+        if (threads > 0 && t != threads)
+        {
+            continue;
+        }
+
+        if (!run(dir, segments, t, iterations, size))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (threads > 32 && !run(dir, segments, threads, iterations, size))
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// STL
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/time.h>
+
+// e
+#include <e/popt.h>
+#include <e/serialization.h>
+
+// consus
+#include "kvs/configuration.h"
+
+// Measures configuration::hash, which the key value store calls on every raw
+// read, raw write, lock response, and replicator pass.  Compares the
+// precomputed replica-set table against walking the ring on each call.
+
+#define KEYS 65536
+
+using namespace consus;
+
+static uint64_t s_sink = 0;
+
+static void
+build(long stores, std::vector<ring>* rings)
+{
+    rings->resize(1);
+    ring* r = &(*rings)[0];
+    r->dc = data_center_id(1);
+
+    for (unsigned i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        // contiguous runs, as the coordinator assigns them, with one store's
+        // run half way through handing off to the next store
+        const uint64_t owner = 1 + uint64_t(i) * stores / CONSUS_KVS_PARTITIONS;
+        r->partitions[i].owner = comm_id(owner);
+
+        if (owner == 1 && i % 2 == 0)
+        {
+            r->partitions[i].next_owner = comm_id(2);
+        }
+    }
+}
+
+static double
+run_table(configuration* c, const std::vector<std::string>& keys, long iterations)
+{
+    const e::slice table("bench");
+    const uint64_t start = po6::monotonic_time();
+
+    for (long i = 0; i < iterations; ++i)
+    {
+        replica_set rs;
+        c->hash(data_center_id(1), table, keys[i % keys.size()], &rs);
+        s_sink += rs.replicas[0].get();
+    }
+
+    return double(po6::monotonic_time() - start) / iterations;
+}
+
+static double
+run_walk(const std::vector<ring>& rings, const std::vector<std::string>& keys, long iterations)
+{
+    const e::slice table("bench");
+    const uint64_t start = po6::monotonic_time();
+
+    for (long i = 0; i < iterations; ++i)
+    {
+        const ring* r = NULL;
+
+        for (size_t j = 0; j < rings.size(); ++j)
+        {
+            if (rings[j].dc == data_center_id(1))
+            {
+                r = &rings[j];
+            }
+        }
+
+        replica_set rs;
+        rs.desired_replication = 5;
+        rs.num_replicas = r->replicas(ring::partition_index(table, keys[i % keys.size()]),
+                                      CONSUS_MAX_REPLICATION_FACTOR,
+                                      rs.replicas, rs.transitioning);
+        rs.num_replicas = std::min(rs.num_replicas, rs.desired_replication);
+        s_sink += rs.replicas[0].get();
+    }
+
+    return double(po6::monotonic_time() - start) / iterations;
+}
+
+int
+main(int argc, const char* argv[])
+{
+    long iterations = 1000000;
+    long walk_iterations = 10000;
+    long stores = 16;
+    e::argparser ap;
+    ap.autohelp();
+    ap.arg().name('n', "iterations")
+            .description("how many times to hash a key (default: 1,000,000)")
+            .as_long(&iterations);
+    ap.arg().name('w', "walk-iterations")
+            .description("how many times to hash a key by walking the ring, which is far slower (default: 10,000)")
+            .as_long(&walk_iterations);
+    ap.arg().name('s', "stores")
+            .description("how many key value stores share the ring (default: 16)")
+            .as_long(&stores);
+
+    if (!ap.parse(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (iterations <= 0 || walk_iterations <= 0 ||
+        stores <= 0 || stores > CONSUS_KVS_PARTITIONS)
+    {
+        std::cerr << "must specify a positive number of iterations and stores\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    std::vector<ring> rings;
+    build(stores, &rings);
+    std::vector<kvs_state> kvss;
+    std::string packed;
+    e::packer(&packed) << cluster_id(1) << version_id(1) << uint64_t(0) << uint64_t(0) << kvss << version_id(1) << rings;
+    configuration c;
+    e::unpacker up(packed);
+    up = up >> c;
+
+    if (up.error())
+    {
+        std::cerr << "could not construct configuration" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> keys;
+
+    for (unsigned i = 0; i < KEYS; ++i)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "\"user%08u\"", i);
+        keys.push_back(buf);
+    }
+
+    const double walk = run_walk(rings, keys, walk_iterations);
+    const double table = run_table(&c, keys, iterations);
+    printf("stores=%ld\n", stores);
+    printf("walk the ring:     %10.1f ns/hash over %ld hashes\n", walk, walk_iterations);
+    printf("precomputed table: %10.1f ns/hash over %ld hashes\n", table, iterations);
+    printf("speedup: %.1fx (checksum %llu)\n", walk / table,
+           static_cast<unsigned long long>(s_sink));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,290 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// STL
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
+#include <po6/time.h>
+
+// e
+#include <e/compat.h>
+#include <e/popt.h>
+
+// consus
+#include "kvs/leveldb_datalayer.h"
+
+// Measures put and get throughput of the key value store's LevelDB data layer.
+// The load phase fills the store from many threads (puts are synchronous and
+// group committed, as in the daemon); the read phases then issue random gets
+// for the newest version of objects that exist, and for objects that were never
+// written.  The defaults build a ~2GB store; pass --no-load to rerun the read
+// phases against a store from an earlier run.
+
+using consus::datalayer;
+using consus::leveldb_datalayer;
+
+struct benchmark
+{
+    benchmark(datalayer* d, long o, long v, long s, long t)
+        : data(d), objects(o), versions(v), threads(t), value(s, 'v'),
+          mtx(), latencies(), failures(0) {}
+
+    void load(long tid);
+    void read(long tid, long gets, bool miss);
+    void record(const std::vector<uint64_t>& lats, uint64_t failed);
+
+    datalayer* data;
+    long objects;
+    long versions;
+    long threads;
+    std::string value;
+    po6::threads::mutex mtx;
+    std::vector<uint64_t> latencies;
+    uint64_t failures;
+
+    private:
+        benchmark(const benchmark&);
+        benchmark& operator = (const benchmark&);
+};
+
+static std::string
+object_key(uint64_t i)
+{
+    // scatter consecutive objects across the keyspace so loads aren't sorted
+    char buf[24];
+    int sz = sprintf(buf, "%016llx", (unsigned long long)(i * 0x9e3779b97f4a7c15ULL));
+    return std::string(buf, sz);
+}
+
+void
+benchmark :: load(long tid)
+{
+    std::vector<uint64_t> lats;
+    uint64_t failed = 0;
+
+    for (long i = tid; i < objects; i += threads)
+    {
+        const std::string key(object_key(i));
+
+        for (long v = 1; v <= versions; ++v)
+        {
+            const uint64_t start = po6::monotonic_time();
+
+            if (data->put("bench", key, v, value) != CONSUS_SUCCESS)
+            {
+                ++failed;
+            }
+
+            lats.push_back(po6::monotonic_time() - start);
+        }
+    }
+
+    record(lats, failed);
+}
+
+void
+benchmark :: read(long tid, long gets, bool miss)
+{
+    std::vector<uint64_t> lats;
+    lats.reserve(gets);
+    uint64_t failed = 0;
+    unsigned seed = tid;
+
+    for (long i = 0; i < gets; ++i)
+    {
+        const uint64_t idx = rand_r(&seed) % objects;
+        const std::string key(object_key(miss ? objects + idx : idx));
+        uint64_t timestamp = 0;
+        e::slice val;
+        datalayer::reference* ref = NULL;
+        const uint64_t start = po6::monotonic_time();
+        consus_returncode rc = data->get("bench", key, UINT64_MAX, &timestamp, &val, &ref);
+        std::auto_ptr<datalayer::reference> ref_guard(ref);
+
+        if (miss ? rc != CONSUS_NOT_FOUND :
+            rc != CONSUS_SUCCESS || timestamp != uint64_t(versions) ||
+            val.size() != value.size())
+        {
+            ++failed;
+        }
+
+        lats.push_back(po6::monotonic_time() - start);
+    }
+
+    record(lats, failed);
+}
+
+void
+benchmark :: record(const std::vector<uint64_t>& lats, uint64_t failed)
+{
+    po6::threads::mutex::hold hold(&mtx);
+    latencies.insert(latencies.end(), lats.begin(), lats.end());
+    failures += failed;
+}
+
+static double
+percentile(const std::vector<uint64_t>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+
+    size_t idx = p * (sorted.size() - 1);
+    return double(sorted[idx]) / PO6_MICROS;
+}
+
+struct worker
+{
+    enum mode_t { LOAD, HIT, MISS };
+    worker(benchmark* _b, long _tid, mode_t _mode, long _gets)
+        : b(_b), tid(_tid), mode(_mode), gets(_gets) {}
+    void run() { if (mode == LOAD) b->load(tid); else b->read(tid, gets, mode == MISS); }
+    benchmark* b;
+    long tid;
+    mode_t mode;
+    long gets;
+};
+
+static void
+phase(const char* name, benchmark* b, worker::mode_t mode, long gets)
+{
+    using namespace po6::threads;
+    b->latencies.clear();
+    b->failures = 0;
+    std::vector<e::compat::shared_ptr<worker> > ws;
+    std::vector<e::compat::shared_ptr<thread> > ts;
+    const uint64_t start = po6::monotonic_time();
+
+    for (long i = 0; i < b->threads; ++i)
+    {
+        e::compat::shared_ptr<worker> w(new worker(b, i, mode, (gets + i) / b->threads));
+        e::compat::shared_ptr<thread> t(new thread(make_obj_func(&worker::run, w.get())));
+        ws.push_back(w);
+        ts.push_back(t);
+        t->start();
+    }
+
+    for (size_t i = 0; i < ts.size(); ++i)
+    {
+        ts[i]->join();
+    }
+
+    const uint64_t end = po6::monotonic_time();
+    const double secs = double(end - start) / PO6_SECONDS;
+    std::sort(b->latencies.begin(), b->latencies.end());
+    printf("%-4s threads=%-3ld ops=%-9zu rate=%9.0f ops/s  p50=%8.1fus p99=%8.1fus  failures=%llu\n",
+           name, b->threads, b->latencies.size(), b->latencies.size() / secs,
+           percentile(b->latencies, 0.50), percentile(b->latencies, 0.99),
+           (unsigned long long)b->failures);
+}
+
+int
+main(int argc, const char* argv[])
+{
+    const char* dir = "leveldb-datalayer-bench";
+    long objects = 2000000;
+    long versions = 1;
+    long size = 1024;
+    long threads = 16;
+    long gets = 1000000;
+    bool no_load = false;
+    e::argparser ap;
+    ap.autohelp();
+    ap.arg().name('d', "data")
+            .description("directory for the store (default: leveldb-datalayer-bench)")
+            .metavar("dir").as_string(&dir);
+    ap.arg().name('o', "objects")
+            .description("number of distinct objects (default: 2000000)")
+            .as_long(&objects);
+    ap.arg().name('V', "versions")
+            .description("versions written per object (default: 1)")
+            .as_long(&versions);
+    ap.arg().name('s', "size")
+            .description("size of each value in bytes (default: 1024)")
+            .as_long(&size);
+    ap.arg().name('t', "threads")
+            .description("concurrent clients of the data layer (default: 16)")
+            .as_long(&threads);
+    ap.arg().name('g', "gets")
+            .description("random gets in each read phase (default: 1000000)")
+            .as_long(&gets);
+    ap.arg().long_name("no-load")
+            .description("skip the load phase and read an existing store")
+            .set_true(&no_load);
+
+    if (!ap.parse(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (objects <= 0 || versions <= 0 || size <= 0 || threads <= 0 || gets < 0)
+    {
+        std::cerr << "must specify positive objects, versions, size, and threads\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    leveldb_datalayer data;
+
+    if (!data.init(dir))
+    {
+        std::cerr << "could not open the store in " << dir << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    benchmark b(&data, objects, versions, size, threads);
+
+    if (!no_load)
+    {
+        phase("put", &b, worker::LOAD, 0);
+    }
+
+    if (gets > 0)
+    {
+        phase("hit", &b, worker::HIT, gets);
+        phase("miss", &b, worker::MISS, gets);
+    }
+
+    std::cout << data.debug_dump() << std::flush;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,207 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// STL
+#include <iostream>
+#include <vector>
+
+// po6
+#include <po6/time.h>
+
+// e
+#include <e/popt.h>
+
+// consus
+#include "common/ring.h"
+#include "coordinator/rebalance.h"
+
+#pragma GCC diagnostic ignored "-Wlarger-than="
+
+// Times the coordinator's ring maintenance: for every data center, read the
+// ring's owners, rebalance them over the data center's active stores, and
+// write them back.  This is the work coordinator::maintain_kvs_rings does on
+// a membership change, without the replicated state machine around it.
+//
+// Each configuration is timed three ways:  assigning empty rings, a store
+// joining one data center, and a store leaving it.
+
+using namespace consus;
+
+static comm_id s_current[CONSUS_KVS_PARTITIONS];
+static comm_id s_next[CONSUS_KVS_PARTITIONS];
+
+static void
+maintain(std::vector<ring>* rings,
+         std::vector<std::vector<comm_id> >* dcs,
+         uint64_t* counter)
+{
+    for (size_t i = 0; i < rings->size(); ++i)
+    {
+        std::vector<comm_id>* kvss = &(*dcs)[i];
+
+        if (kvss->empty())
+        {
+            continue;
+        }
+
+        ring* r = &(*rings)[i];
+        r->get_owners(s_current);
+        rebalance_ring(s_current, &(*kvss)[0], kvss->size(), s_next);
+        r->set_owners(s_next, counter);
+    }
+}
+
+// pretend every migration the last pass started has finished
+static void
+settle(std::vector<ring>* rings)
+{
+    for (size_t i = 0; i < rings->size(); ++i)
+    {
+        for (unsigned p = 0; p < CONSUS_KVS_PARTITIONS; ++p)
+        {
+            partition* part = &(*rings)[i].partitions[p];
+
+            if (part->next_owner != comm_id())
+            {
+                part->id = part->next_id;
+                part->owner = part->next_owner;
+                part->next_id = partition_id();
+                part->next_owner = comm_id();
+            }
+        }
+    }
+}
+
+static double
+timed_maintain(std::vector<ring>* rings,
+               std::vector<std::vector<comm_id> >* dcs,
+               uint64_t* counter)
+{
+    const uint64_t start = po6::monotonic_time();
+    maintain(rings, dcs, counter);
+    const uint64_t end = po6::monotonic_time();
+    settle(rings);
+    return double(end - start) / PO6_MILLIS;
+}
+
+static void
+run(long stores, long data_centers, long iterations)
+{
+    double assign = 0;
+    double join = 0;
+    double leave = 0;
+
+    for (long it = 0; it < iterations; ++it)
+    {
+        std::vector<ring> rings;
+        std::vector<std::vector<comm_id> > dcs(data_centers);
+        uint64_t counter = 1;
+
+        for (long d = 0; d < data_centers; ++d)
+        {
+            rings.push_back(ring(data_center_id(d + 1)));
+        }
+
+        // deal the stores out across the data centers
+        for (long s = 0; s < stores; ++s)
+        {
+            dcs[s % data_centers].push_back(comm_id(s + 1));
+        }
+
+        assign += timed_maintain(&rings, &dcs, &counter);
+        dcs[0].push_back(comm_id(stores + 1));
+        join += timed_maintain(&rings, &dcs, &counter);
+        dcs[0].erase(dcs[0].begin());
+        leave += timed_maintain(&rings, &dcs, &counter);
+    }
+
+    printf("%6ld stores %2ld dcs: assign %9.2fms join %9.2fms leave %9.2fms\n",
+           stores, data_centers,
+           assign / iterations, join / iterations, leave / iterations);
+}
+
+int
+main(int argc, const char* argv[])
+{
+    long iterations = 3;
+    long max_stores = 500;
+    long max_data_centers = 7;
+    e::argparser ap;
+    ap.autohelp();
+    ap.arg().name('n', "iterations")
+            .description("how many times to time each configuration (default: 3)")
+            .as_long(&iterations);
+    ap.arg().name('s', "stores")
+            .description("the most key value stores to try (default: 500)")
+            .as_long(&max_stores);
+    ap.arg().name('d', "data-centers")
+            .description("the most data centers to try (default: 7)")
+            .as_long(&max_data_centers);
+
+    if (!ap.parse(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (iterations <= 0 || max_stores <= 0 || max_data_centers <= 0 ||
+        max_stores > CONSUS_KVS_PARTITIONS)
+    {
+        std::cerr << "must specify a positive number of iterations, stores, and data centers\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    const long store_counts[] = {1, 2, 5, 10, 20, 50, 100, 200, 500};
+    const long dc_counts[] = {1, 2, 3, 5, 7};
+
+    for (size_t d = 0; d < sizeof(dc_counts) / sizeof(dc_counts[0]); ++d)
+    {
+        if (dc_counts[d] > max_data_centers)
+        {
+            continue;
+        }
+
+        for (size_t s = 0; s < sizeof(store_counts) / sizeof(store_counts[0]); ++s)
+        {
+            // give every data center at least one store
+            if (store_counts[s] > max_stores || store_counts[s] < dc_counts[d])
+            {
+                continue;
+            }
+
+            run(store_counts[s], dc_counts[d], iterations);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
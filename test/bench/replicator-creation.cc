@@ -0,0 +1,187 @@
+// Copyright (c) 2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// POSIX
+#include <fcntl.h>
+
+// STL
+#include <iostream>
+#include <vector>
+
+// po6
+#include <po6/io/fd.h>
+#include <po6/threads/thread.h>
+#include <po6/time.h>
+
+// e
+#include <e/compat.h>
+#include <e/garbage_collector.h>
+#include <e/popt.h>
+#include <e/state_hash_table.h>
+
+// consus
+#include "common/nonce.h"
+
+// Measures how quickly the daemons can register new replicators in their
+// state hash tables, which is dominated by generating the replicator's id.
+// Compares the old per-call /dev/urandom read against consus::generate_nonce.
+
+struct stub_replicator
+{
+    stub_replicator(uint64_t key) : m_key(key) {}
+    ~stub_replicator() throw () {}
+    uint64_t state_key() { return m_key; }
+    bool finished() { return true; }
+
+    private:
+        const uint64_t m_key;
+};
+
+typedef e::state_hash_table<uint64_t, stub_replicator> replicator_map_t;
+
+static uint64_t
+urandom_id()
+{
+    po6::io::fd fd(open("/dev/urandom", O_RDONLY));
+    uint64_t x;
+    int ret = fd.xread(&x, sizeof(x));
+    assert(ret == 8);
+    return x;
+}
+
+static uint64_t
+in_process_id()
+{
+    return consus::generate_nonce();
+}
+
+struct benchmark
+{
+    benchmark(uint64_t (*g)(), long i)
+        : gc(), map(&gc), generate(g), iterations(i) {}
+
+    void worker();
+
+    e::garbage_collector gc;
+    replicator_map_t map;
+    uint64_t (*generate)();
+    long iterations;
+};
+
+void
+benchmark :: worker()
+{
+    e::garbage_collector::thread_state ts;
+    gc.register_thread(&ts);
+
+    for (long i = 0; i < iterations; ++i)
+    {
+        while (true)
+        {
+            replicator_map_t::state_reference sr;
+            stub_replicator* r = map.create_state(generate(), &sr);
+
+            if (r)
+            {
+                break;
+            }
+        }
+
+        if (i % 1024 == 0)
+        {
+            gc.quiescent_state(&ts);
+        }
+    }
+
+    gc.deregister_thread(&ts);
+}
+
+static double
+run(const char* name, uint64_t (*g)(), long threads, long iterations)
+{
+    using namespace po6::threads;
+    benchmark b(g, iterations);
+    std::vector<e::compat::shared_ptr<thread> > ts;
+    const uint64_t start = po6::monotonic_time();
+
+    for (long i = 0; i < threads; ++i)
+    {
+        e::compat::shared_ptr<thread> t(new thread(make_obj_func(&benchmark::worker, &b)));
+        ts.push_back(t);
+        t->start();
+    }
+
+    for (size_t i = 0; i < ts.size(); ++i)
+    {
+        ts[i]->join();
+    }
+
+    const uint64_t end = po6::monotonic_time();
+    const double secs = double(end - start) / PO6_SECONDS;
+    const double ops = double(threads) * iterations / secs;
+    printf("%-12s threads=%ld ops=%ld time=%.3fs rate=%.0f ops/s\n",
+           name, threads, threads * iterations, secs, ops);
+    return ops;
+}
+
+int
+main(int argc, const char* argv[])
+{
+    long threads = 1;
+    long iterations = 1000000;
+    e::argparser ap;
+    ap.autohelp();
+    ap.arg().name('t', "threads")
+            .description("how many threads create replicators (default: 1)")
+            .as_long(&threads);
+    ap.arg().name('n', "iterations")
+            .description("how many replicators each thread creates (default: 1,000,000)")
+            .as_long(&iterations);
+
+    if (!ap.parse(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (threads <= 0 || iterations <= 0)
+    {
+        std::cerr << "must specify a positive number of threads and iterations\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    double before = run("/dev/urandom", urandom_id, threads, iterations);
+    double after = run("in-process", in_process_id, threads, iterations);
+    printf("speedup: %.1fx\n", after / before);
+    return EXIT_SUCCESS;
+}
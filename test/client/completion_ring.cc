@@ -0,0 +1,191 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <string>
+
+// consus
+#include "client/completion_ring.h"
+#include "test/th.h"
+
+using namespace consus;
+
+// completion_ring starts with 16 slots
+#define INITIAL_SLOTS 16
+
+static int s_live = 0;
+
+class fake_pending : public pending
+{
+    public:
+        fake_pending(int64_t id) : pending(id, &m_st), m_st(CONSUS_SUCCESS) { ++s_live; }
+        virtual ~fake_pending() throw () { --s_live; }
+
+    public:
+        virtual std::string describe() { return "fake_pending"; }
+        virtual void kickstart_state_machine(client*) {}
+
+    private:
+        consus_returncode m_st;
+};
+
+static void
+push_range(completion_ring* r, int64_t first, int64_t last)
+{
+    for (int64_t i = first; i <= last; ++i)
+    {
+        r->push(new fake_pending(i));
+    }
+}
+
+static void
+pop_range(completion_ring* r, int64_t first, int64_t last)
+{
+    for (int64_t i = first; i <= last; ++i)
+    {
+        ASSERT_FALSE(r->empty());
+        ASSERT_EQ(r->pop()->client_id(), i);
+    }
+}
+
+TEST(CompletionRing, FIFO)
+{
+    {
+        completion_ring r;
+        ASSERT_TRUE(r.empty());
+        push_range(&r, 1, 5);
+        ASSERT_EQ(r.size(), 5U);
+        ASSERT_EQ(r.at(0)->client_id(), 1);
+        ASSERT_EQ(r.at(4)->client_id(), 5);
+        pop_range(&r, 1, 5);
+        ASSERT_TRUE(r.empty());
+    }
+
+    ASSERT_EQ(s_live, 0);
+}
+
+TEST(CompletionRing, Wraparound)
+{
+    {
+        completion_ring r;
+
+        // walk the head around the array several times without growing
+        for (int64_t round = 0; round < 5; ++round)
+        {
+            const int64_t base = round * 100;
+            push_range(&r, base + 1, base + INITIAL_SLOTS - 3);
+            pop_range(&r, base + 1, base + INITIAL_SLOTS - 3);
+            ASSERT_TRUE(r.empty());
+        }
+
+        // a full ring whose contents straddle the end of the array
+        push_range(&r, 1, 10);
+        pop_range(&r, 1, 10);
+        push_range(&r, 11, 10 + INITIAL_SLOTS);
+        ASSERT_EQ(r.size(), size_t(INITIAL_SLOTS));
+
+        for (size_t i = 0; i < r.size(); ++i)
+        {
+            ASSERT_EQ(r.at(i)->client_id(), int64_t(11 + i));
+        }
+
+        pop_range(&r, 11, 10 + INITIAL_SLOTS);
+    }
+
+    ASSERT_EQ(s_live, 0);
+}
+
+TEST(CompletionRing, GrowWhileWrapped)
+{
+    {
+        completion_ring r;
+        // move the head to the middle, then fill so the contents wrap
+        push_range(&r, 1, 9);
+        pop_range(&r, 1, 9);
+        push_range(&r, 10, 9 + INITIAL_SLOTS);
+        // one more forces grow() with the head mid-array
+        push_range(&r, 10 + INITIAL_SLOTS, 9 + 3 * INITIAL_SLOTS);
+        ASSERT_EQ(r.size(), size_t(3 * INITIAL_SLOTS));
+
+        for (size_t i = 0; i < r.size(); ++i)
+        {
+            ASSERT_EQ(r.at(i)->client_id(), int64_t(10 + i));
+        }
+
+        // interleave so the grown array wraps as well
+        pop_range(&r, 10, 29);
+        push_range(&r, 10 + 3 * INITIAL_SLOTS, 29 + 3 * INITIAL_SLOTS);
+        pop_range(&r, 30, 29 + 3 * INITIAL_SLOTS);
+        ASSERT_TRUE(r.empty());
+    }
+
+    ASSERT_EQ(s_live, 0);
+}
+
+TEST(CompletionRing, RemovePreservesOrder)
+{
+    {
+        completion_ring r;
+        // wrap first so remove() has to shift across the end of the array
+        push_range(&r, 1, 12);
+        pop_range(&r, 1, 12);
+        push_range(&r, 1, 10);
+
+        ASSERT_EQ(r.remove(0)->client_id(), 1);
+        ASSERT_EQ(r.remove(8)->client_id(), 10);
+        ASSERT_EQ(r.remove(3)->client_id(), 5);
+        ASSERT_EQ(r.size(), 7U);
+        ASSERT_EQ(r.at(0)->client_id(), 2);
+        ASSERT_EQ(r.at(1)->client_id(), 3);
+        ASSERT_EQ(r.at(2)->client_id(), 4);
+        ASSERT_EQ(r.at(3)->client_id(), 6);
+
+        // the freed slots are reused in order
+        push_range(&r, 11, 13);
+        const int64_t expect[] = {2, 3, 4, 6, 7, 8, 9, 11, 12, 13};
+
+        for (size_t i = 0; i < sizeof(expect) / sizeof(expect[0]); ++i)
+        {
+            ASSERT_EQ(r.pop()->client_id(), expect[i]);
+        }
+
+        ASSERT_TRUE(r.empty());
+    }
+
+    ASSERT_EQ(s_live, 0);
+}
+
+TEST(CompletionRing, DestructorReleases)
+{
+    {
+        completion_ring r;
+        push_range(&r, 1, 3 * INITIAL_SLOTS);
+        ASSERT_EQ(s_live, 3 * INITIAL_SLOTS);
+    }
+
+    ASSERT_EQ(s_live, 0);
+}
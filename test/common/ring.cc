@@ -0,0 +1,198 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <stdio.h>
+
+// STL
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+// e
+#include <e/endian.h>
+
+// consus
+#include "common/ring.h"
+#include "test/th.h"
+
+using namespace consus;
+
+#define KEYS 100000
+// the coordinator hands each key value store a contiguous run of partitions;
+// 64 stores is plenty to expose a skewed mapping
+#define STORES 64
+
+static void
+assert_balanced(const char* table, const std::vector<std::string>& keys)
+{
+    std::vector<unsigned> counts(STORES, 0);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        unsigned idx = ring::partition_index(e::slice(table), e::slice(keys[i]));
+        ASSERT_LT(idx, unsigned(CONSUS_KVS_PARTITIONS));
+        ++counts[idx / (CONSUS_KVS_PARTITIONS / STORES)];
+    }
+
+    // with 100k keys each store expects ~1562 +/- 40; allow 15%
+    const unsigned mean = keys.size() / STORES;
+    const unsigned slack = mean * 15 / 100;
+
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        ASSERT_GE(counts[i], mean - slack);
+        ASSERT_LE(counts[i], mean + slack);
+    }
+}
+
+TEST(Ring, BalancedJSONStrings)
+{
+    std::vector<std::string> keys;
+
+    for (unsigned i = 0; i < KEYS; ++i)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "\"user%08u\"", i);
+        keys.push_back(buf);
+    }
+
+    assert_balanced("users", keys);
+}
+
+TEST(Ring, BalancedDecimalStrings)
+{
+    std::vector<std::string> keys;
+
+    for (unsigned i = 0; i < KEYS; ++i)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%u", i);
+        keys.push_back(buf);
+    }
+
+    assert_balanced("counters", keys);
+}
+
+TEST(Ring, BalancedBigEndianIntegers)
+{
+    std::vector<std::string> keys;
+
+    for (uint64_t i = 0; i < KEYS; ++i)
+    {
+        char buf[sizeof(uint64_t)];
+        e::pack64be(i, buf);
+        keys.push_back(std::string(buf, sizeof(buf)));
+    }
+
+    assert_balanced("ids", keys);
+}
+
+TEST(Ring, BalancedSharedPrefix)
+{
+    std::vector<std::string> keys;
+
+    for (unsigned i = 0; i < KEYS; ++i)
+    {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "{\"type\":\"order\",\"id\":%u}", i);
+        keys.push_back(buf);
+    }
+
+    assert_balanced("orders", keys);
+
+    // 100k keys into 65536 partitions should touch ~51k of them
+    std::vector<bool> seen(CONSUS_KVS_PARTITIONS, false);
+    unsigned distinct = 0;
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        unsigned idx = ring::partition_index(e::slice("orders"), e::slice(keys[i]));
+        distinct += seen[idx] ? 0 : 1;
+        seen[idx] = true;
+    }
+
+    ASSERT_GT(distinct, 48000U);
+}
+
+TEST(Ring, TableMatters)
+{
+    unsigned same = 0;
+
+    for (unsigned i = 0; i < KEYS; ++i)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "key%u", i);
+        same += ring::partition_index(e::slice("a"), e::slice(buf)) ==
+                ring::partition_index(e::slice("b"), e::slice(buf)) ? 1 : 0;
+    }
+
+    ASSERT_LT(same, unsigned(KEYS / 1000));
+    ASSERT_NE(ring::partition_index(e::slice("ab"), e::slice("c")),
+              ring::partition_index(e::slice("a"), e::slice("bc")));
+}
+
+TEST(Ring, MigrationsReachBack)
+{
+    // six owners in equal runs; the last partition of owner 3 moves to 7
+    const unsigned run = CONSUS_KVS_PARTITIONS / 6;
+    ring r;
+
+    for (unsigned p = 0; p < CONSUS_KVS_PARTITIONS; ++p)
+    {
+        r.partitions[p].owner = comm_id(std::min(p / run, 5U) + 1);
+    }
+
+    const unsigned moving = 3 * run - 1;
+    r.partitions[moving].next_id = partition_id(1);
+    r.partitions[moving].next_owner = comm_id(7);
+    std::map<unsigned, std::vector<unsigned> > migrations;
+    r.migrations(CONSUS_KVS_REPLICATION_FACTOR, &migrations);
+    ASSERT_EQ(migrations.size(), 1U);
+    const std::vector<unsigned>& indices(migrations[moving]);
+
+    // owners 6, 1, 2 and 3 have 7 among their first five replicas once the
+    // move is done; owners 4 and 5 do not
+    for (unsigned p = 0; p < CONSUS_KVS_PARTITIONS; ++p)
+    {
+        const comm_id owner(r.partitions[p].owner);
+        const bool gains = owner != comm_id(4) && owner != comm_id(5);
+        ASSERT_EQ(std::binary_search(indices.begin(), indices.end(), p), gains);
+    }
+
+    // and writes to those partitions reach 7 while it moves
+    comm_id owners[CONSUS_MAX_REPLICATION_FACTOR];
+    comm_id next_owners[CONSUS_MAX_REPLICATION_FACTOR];
+    const unsigned num = r.replicas(0, CONSUS_KVS_REPLICATION_FACTOR, owners, next_owners);
+    ASSERT_EQ(num, 5U);
+    ASSERT_TRUE(std::find(owners, owners + num, comm_id(7)) == owners + num);
+    ASSERT_TRUE(std::find(next_owners, next_owners + num, comm_id(7)) != next_owners + num);
+    r.replicas(3 * run, CONSUS_KVS_REPLICATION_FACTOR, owners, next_owners);
+    ASSERT_TRUE(std::find(next_owners, next_owners + num, comm_id(7)) == next_owners + num);
+}
@@ -0,0 +1,170 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <string>
+#include <vector>
+
+// e
+#include <e/serialization.h>
+
+// consus
+#include "common/ring_patch.h"
+#include "test/th.h"
+
+using namespace consus;
+
+#define STORES 8
+
+static void
+assign(ring* r, uint64_t first_store, uint64_t* counter)
+{
+    comm_id owners[CONSUS_KVS_PARTITIONS];
+
+    for (unsigned i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        owners[i] = comm_id(first_store + uint64_t(i) * STORES / CONSUS_KVS_PARTITIONS);
+    }
+
+    r->set_owners(owners, counter);
+}
+
+static bool
+same_ring(const ring& lhs, const ring& rhs)
+{
+    if (lhs.dc != rhs.dc)
+    {
+        return false;
+    }
+
+    for (unsigned i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        if (lhs.partitions[i] != rhs.partitions[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+TEST(RingPatch, RoundTrip)
+{
+    uint64_t counter = 1;
+    std::vector<ring> base;
+    base.push_back(ring(data_center_id(1)));
+    base.push_back(ring(data_center_id(2)));
+    assign(&base[0], 100, &counter);
+    assign(&base[1], 200, &counter);
+
+    // hand the first store's partitions in one data center to a new store
+    // and leave the other data center alone
+    std::vector<ring> current(base);
+    comm_id owners[CONSUS_KVS_PARTITIONS];
+    current[0].get_owners(owners);
+
+    for (unsigned i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        if (owners[i] == comm_id(100))
+        {
+            owners[i] = comm_id(150);
+        }
+    }
+
+    current[0].set_owners(owners, &counter);
+
+    std::vector<ring_patch> patches;
+    ASSERT_TRUE(diff_rings(base, current, &patches));
+    ASSERT_EQ(patches.size(), 2U);
+    ASSERT_EQ(patches[0].partitions.size(), size_t(CONSUS_KVS_PARTITIONS / STORES));
+    ASSERT_EQ(patches[1].partitions.size(), 0U);
+    ASSERT_EQ(patched_partitions(patches), patches[0].partitions.size());
+
+    std::string packed;
+    e::packer(&packed) << patches;
+    std::vector<ring_patch> unpacked;
+    e::unpacker up(packed);
+    up = up >> unpacked;
+    ASSERT_FALSE(up.error());
+    ASSERT_EQ(up.remain(), 0U);
+
+    std::vector<ring_ptr> base_ptrs;
+    base_ptrs.push_back(ring_ptr(new ring(base[0])));
+    base_ptrs.push_back(ring_ptr(new ring(base[1])));
+    std::vector<ring_ptr> patched;
+    ASSERT_TRUE(patch_rings(base_ptrs, unpacked, &patched));
+    ASSERT_EQ(patched.size(), 2U);
+    ASSERT_TRUE(same_ring(*patched[0], current[0]));
+    ASSERT_TRUE(same_ring(*patched[1], current[1]));
+    // copy on write:  only the changed ring is new
+    ASSERT_TRUE(patched[0] != base_ptrs[0]);
+    ASSERT_TRUE(patched[1] == base_ptrs[1]);
+    ASSERT_TRUE(same_ring(*base_ptrs[0], base[0]));
+}
+
+TEST(RingPatch, Mismatch)
+{
+    std::vector<ring> one;
+    one.push_back(ring(data_center_id(1)));
+    std::vector<ring> two(one);
+    two.push_back(ring(data_center_id(2)));
+    std::vector<ring> other;
+    other.push_back(ring(data_center_id(3)));
+    std::vector<ring_patch> patches;
+
+    ASSERT_FALSE(diff_rings(one, two, &patches));
+    ASSERT_FALSE(diff_rings(one, other, &patches));
+    ASSERT_TRUE(diff_rings(one, one, &patches));
+
+    std::vector<ring_ptr> base;
+    base.push_back(ring_ptr(new ring(data_center_id(3))));
+    std::vector<ring_ptr> patched;
+    ASSERT_FALSE(patch_rings(base, patches, &patched));
+    ASSERT_TRUE(patched.empty());
+}
+
+TEST(RingPatch, PackedRings)
+{
+    uint64_t counter = 1;
+    std::vector<ring> rings;
+    rings.push_back(ring(data_center_id(7)));
+    assign(&rings[0], 1, &counter);
+
+    // a vector of ring_ptr has the same encoding as a vector of ring
+    std::string packed;
+    e::packer(&packed) << rings;
+    std::vector<ring_ptr> ptrs;
+    e::unpacker up(packed);
+    up = up >> ptrs;
+    ASSERT_FALSE(up.error());
+    ASSERT_EQ(ptrs.size(), 1U);
+    ASSERT_TRUE(same_ring(*ptrs[0], rings[0]));
+
+    std::string repacked;
+    e::packer(&repacked) << ptrs;
+    ASSERT_TRUE(packed == repacked);
+}
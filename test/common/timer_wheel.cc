@@ -0,0 +1,254 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <stdlib.h>
+
+// STL
+#include <algorithm>
+#include <vector>
+
+// consus
+#include "common/timer_wheel.h"
+#include "test/th.h"
+
+using namespace consus;
+
+TEST(TimerWheel, NothingBeforeDeadline)
+{
+    timer_wheel<unsigned> tw(10, 8);
+    std::vector<unsigned> due;
+    tw.schedule(1005, 1);
+    tw.expire(1000, &due);
+    ASSERT_TRUE(due.empty());
+    tw.expire(1004, &due);
+    ASSERT_TRUE(due.empty());
+    tw.expire(1005, &due);
+    ASSERT_TRUE(due.empty());
+    // the tick containing 1005 ends at 1009; it fires on the next tick
+    tw.expire(1010, &due);
+    ASSERT_EQ(due.size(), 1U);
+    ASSERT_EQ(due[0], 1U);
+    ASSERT_EQ(tw.size(), 0U);
+}
+
+TEST(TimerWheel, OnTickBoundary)
+{
+    timer_wheel<unsigned> tw(10, 8);
+    std::vector<unsigned> due;
+    tw.expire(1000, &due);
+    tw.schedule(1010, 1);
+    tw.expire(1009, &due);
+    ASSERT_TRUE(due.empty());
+    tw.expire(1010, &due);
+    ASSERT_EQ(due.size(), 1U);
+}
+
+TEST(TimerWheel, PastDeadlineFiresNextTick)
+{
+    timer_wheel<unsigned> tw(10, 8);
+    std::vector<unsigned> due;
+    tw.expire(1000, &due);
+    tw.schedule(500, 1);
+    tw.expire(1009, &due);
+    ASSERT_TRUE(due.empty());
+    tw.expire(1010, &due);
+    ASSERT_EQ(due.size(), 1U);
+}
+
+TEST(TimerWheel, BeyondOneRevolution)
+{
+    timer_wheel<unsigned> tw(10, 8);
+    std::vector<unsigned> due;
+    tw.expire(1000, &due);
+    // 8 slots of 10 cover 80; this wraps around the wheel twice
+    tw.schedule(1200, 1);
+    tw.schedule(1040, 2);
+
+    for (unsigned now = 1010; now < 1200; now += 10)
+    {
+        tw.expire(now, &due);
+
+        if (now < 1040)
+        {
+            ASSERT_TRUE(due.empty());
+        }
+        else
+        {
+            ASSERT_EQ(due.size(), 1U);
+            ASSERT_EQ(due[0], 2U);
+        }
+    }
+
+    tw.expire(1200, &due);
+    ASSERT_EQ(due.size(), 2U);
+    ASSERT_EQ(due[1], 1U);
+    ASSERT_EQ(tw.size(), 0U);
+}
+
+TEST(TimerWheel, LongStall)
+{
+    timer_wheel<unsigned> tw(10, 8);
+    std::vector<unsigned> due;
+    tw.expire(1000, &due);
+
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        tw.schedule(1000 + i * 7, i);
+    }
+
+    ASSERT_EQ(tw.size(), 100U);
+    // the expiring thread falls far behind and skips many revolutions
+    tw.expire(100000, &due);
+    ASSERT_EQ(due.size(), 100U);
+    ASSERT_EQ(tw.size(), 0U);
+    std::sort(due.begin(), due.end());
+
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        ASSERT_EQ(due[i], i);
+    }
+}
+
+TEST(TimerWheel, MatchesReference)
+{
+    // 16 ticks of 10 in each wheel: the outer wheel reaches 2560 out, so the
+    // deadlines below exercise the inner wheel, the cascade, and the wrap
+    const uint64_t tick = 10;
+    timer_wheel<unsigned> tw(tick, 16);
+    std::vector<uint64_t> deadlines;
+    std::vector<bool> fired;
+    std::vector<unsigned> due;
+    uint64_t now = 1000;
+    tw.expire(now, &due);
+    srand(0x5eed);
+
+    for (unsigned iter = 0; iter < 20000; ++iter)
+    {
+        if (rand() % 2 == 0)
+        {
+            const uint64_t when = now + rand() % 8000;
+            tw.schedule(when, deadlines.size());
+            deadlines.push_back(when);
+            fired.push_back(false);
+            continue;
+        }
+
+        // mostly single ticks, occasionally a stall of many revolutions
+        now += (rand() % 100 == 0) ? rand() % 10000 : rand() % (2 * tick);
+        due.clear();
+        tw.expire(now, &due);
+
+        for (size_t i = 0; i < due.size(); ++i)
+        {
+            ASSERT_LT(due[i], deadlines.size());
+            ASSERT_FALSE(fired[due[i]]);
+            ASSERT_LE(deadlines[due[i]], now);
+            fired[due[i]] = true;
+        }
+
+        for (size_t i = 0; i < deadlines.size(); ++i)
+        {
+            // every deadline in a tick that has fully passed is out
+            if ((deadlines[i] + tick - 1) / tick <= now / tick)
+            {
+                ASSERT_TRUE(fired[i]);
+            }
+        }
+    }
+}
+
+namespace
+{
+
+// stands in for a daemon; records each pump and rounds it up to a 10ns tick
+struct fake_daemon
+{
+    enum pump_t { PUMP_A };
+    fake_daemon() : pumps() {}
+    uint64_t schedule_pump(pump_t, unsigned, uint64_t when)
+    {
+        pumps.push_back(when);
+        return (when + 9) / 10 * 10;
+    }
+    std::vector<uint64_t> pumps;
+};
+
+struct fake_request
+{
+    fake_request(uint64_t t) : last_request_time(t) {}
+    uint64_t last_request_time;
+};
+
+} // namespace
+
+TEST(PumpWakeup, NoLaterThan)
+{
+    fake_daemon d;
+    pump_wakeup w;
+    w.no_later_than(&d, fake_daemon::PUMP_A, 0U, 100, 150);
+    ASSERT_EQ(d.pumps.size(), 1U);
+    // a pending pump already comes due by then
+    w.no_later_than(&d, fake_daemon::PUMP_A, 0U, 110, 160);
+    ASSERT_EQ(d.pumps.size(), 1U);
+    // an earlier deadline pulls the pump in
+    w.no_later_than(&d, fake_daemon::PUMP_A, 0U, 110, 130);
+    ASSERT_EQ(d.pumps.size(), 2U);
+    ASSERT_EQ(w.when(), 130U);
+    // once the pending pump has passed, anything schedules a new one
+    w.no_later_than(&d, fake_daemon::PUMP_A, 0U, 130, 200);
+    ASSERT_EQ(d.pumps.size(), 3U);
+    ASSERT_EQ(d.pumps[2], 200U);
+}
+
+TEST(PumpWakeup, NoEarlierThan)
+{
+    fake_daemon d;
+    pump_wakeup w;
+    w.no_earlier_than(&d, fake_daemon::PUMP_A, 0U, 151);
+    ASSERT_EQ(d.pumps.size(), 1U);
+    ASSERT_EQ(w.when(), 160U);
+    // the pending pump comes late enough
+    w.no_earlier_than(&d, fake_daemon::PUMP_A, 0U, 140);
+    w.no_earlier_than(&d, fake_daemon::PUMP_A, 0U, 160);
+    ASSERT_EQ(d.pumps.size(), 1U);
+    w.no_earlier_than(&d, fake_daemon::PUMP_A, 0U, 161);
+    ASSERT_EQ(d.pumps.size(), 2U);
+    ASSERT_EQ(w.when(), 170U);
+}
+
+TEST(PumpWakeup, NextResend)
+{
+    std::vector<fake_request> reqs;
+    ASSERT_EQ(next_resend(reqs, 1000, 100), 1101U);
+    reqs.push_back(fake_request(950));
+    reqs.push_back(fake_request(920));
+    // already due; it waits for a fresh interval
+    reqs.push_back(fake_request(800));
+    ASSERT_EQ(next_resend(reqs, 1000, 100), 1021U);
+}
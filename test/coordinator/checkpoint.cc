@@ -0,0 +1,234 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stddef.h>
+
+// STL
+#include <map>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/net/location.h>
+
+// e
+#include <e/serialization.h>
+
+// Replicant
+#include <rsm.h>
+
+// consus
+#include "common/kvs_configuration.h"
+#include "common/ring_patch.h"
+#include "common/txman_configuration.h"
+#include "coordinator/coordinator.h"
+#include "test/th.h"
+
+using namespace consus;
+
+// Just enough of Replicant to run the coordinator:  each condition keeps the
+// data it was last broadcast with.
+static std::map<std::string, std::string> s_conds;
+
+extern "C"
+{
+
+void
+rsm_log(rsm_context*, const char*, ...)
+{
+}
+
+void
+rsm_set_output(rsm_context*, const char*, size_t)
+{
+}
+
+int
+rsm_cond_broadcast_data(rsm_context*, const char* cond, const char* data, size_t data_sz)
+{
+    s_conds[cond] = std::string(data, data_sz);
+    return 0;
+}
+
+void
+rsm_tick_interval(rsm_context*, const char*, uint64_t)
+{
+}
+
+} // extern "C"
+
+// the rings of the most recent "kvsconf", with its patches applied to
+// "kvsckpt"; fails the test if they don't apply
+static void
+kvs_rings(version_id* vid, version_id* ckpt, std::vector<ring_ptr>* rings)
+{
+    cluster_id cid;
+    uint64_t flags;
+    uint64_t low_water;
+    std::vector<kvs_state> kvss;
+    std::vector<ring_patch> patches;
+    e::unpacker up(s_conds["kvsconf"]);
+    up = kvs_configuration(up, &cid, vid, &flags, &low_water, &kvss, ckpt, rings, &patches);
+    ASSERT_FALSE(up.error());
+
+    if (*ckpt == *vid)
+    {
+        return;
+    }
+
+    version_id ckpt_vid;
+    version_id ckpt_ckpt;
+    std::vector<ring_ptr> ckpt_rings;
+    std::vector<ring_patch> ckpt_patches;
+    up = e::unpacker(s_conds["kvsckpt"]);
+    up = kvs_configuration(up, &cid, &ckpt_vid, &flags, &low_water, &kvss,
+                           &ckpt_ckpt, &ckpt_rings, &ckpt_patches);
+    ASSERT_FALSE(up.error());
+    ASSERT_EQ(ckpt_vid, *ckpt);
+    ASSERT_EQ(ckpt_ckpt, ckpt_vid);
+    ASSERT_TRUE(patch_rings(ckpt_rings, patches, rings));
+}
+
+// as kvs_rings, for "txmanconf" and "txmanckpt"
+static void
+txman_rings(version_id* vid, version_id* ckpt, std::vector<ring_ptr>* rings)
+{
+    cluster_id cid;
+    uint64_t flags;
+    uint64_t low_water;
+    std::vector<data_center> dcs;
+    std::vector<txman_state> txmans;
+    std::vector<paxos_group> groups;
+    std::vector<kvs> kvss;
+    std::vector<ring_patch> patches;
+    e::unpacker up(s_conds["txmanconf"]);
+    up = txman_configuration(up, &cid, vid, &flags, &low_water, &dcs, &txmans,
+                             &groups, &kvss, ckpt, rings, &patches);
+    ASSERT_FALSE(up.error());
+
+    if (*ckpt == *vid)
+    {
+        return;
+    }
+
+    version_id ckpt_vid;
+    version_id ckpt_ckpt;
+    std::vector<ring_ptr> ckpt_rings;
+    std::vector<ring_patch> ckpt_patches;
+    up = e::unpacker(s_conds["txmanckpt"]);
+    up = txman_configuration(up, &cid, &ckpt_vid, &flags, &low_water, &dcs, &txmans,
+                             &groups, &kvss, &ckpt_ckpt, &ckpt_rings, &ckpt_patches);
+    ASSERT_FALSE(up.error());
+    ASSERT_EQ(ckpt_vid, *ckpt);
+    ASSERT_EQ(ckpt_ckpt, ckpt_vid);
+    ASSERT_TRUE(patch_rings(ckpt_rings, patches, rings));
+}
+
+static std::string
+pack_rings(const std::vector<ring_ptr>& rings)
+{
+    std::string s;
+    e::packer(&s) << rings;
+    return s;
+}
+
+// both configurations resolve against their published checkpoints to the
+// same rings; returns the version and the checkpoint it was encoded against
+static void
+check_latest(version_id* vid, version_id* ckpt)
+{
+    version_id tx_vid;
+    version_id tx_ckpt;
+    std::vector<ring_ptr> kv;
+    std::vector<ring_ptr> tx;
+    kvs_rings(vid, ckpt, &kv);
+    txman_rings(&tx_vid, &tx_ckpt, &tx);
+    ASSERT_EQ(*vid, tx_vid);
+    ASSERT_EQ(*ckpt, tx_ckpt);
+    ASSERT_TRUE(pack_rings(kv) == pack_rings(tx));
+}
+
+TEST(Coordinator, FirstConfigurationIsCheckpoint)
+{
+    s_conds.clear();
+    coordinator c;
+    c.init(NULL, 42);
+    version_id vid;
+    version_id ckpt;
+    check_latest(&vid, &ckpt);
+    ASSERT_EQ(vid, version_id(1));
+    ASSERT_EQ(ckpt, vid);
+    ASSERT_FALSE(s_conds["kvsckpt"].empty());
+    ASSERT_FALSE(s_conds["txmanckpt"].empty());
+}
+
+TEST(Coordinator, CheckpointRollover)
+{
+    s_conds.clear();
+    coordinator c;
+    c.init(NULL, 42);
+    c.data_center_create(NULL, "dc");
+    const po6::net::location loc("127.0.0.1", 2000);
+    c.kvs_register(NULL, kvs(comm_id(1000), loc), "dc");
+    c.kvs_online(NULL, comm_id(1000), loc, 1);
+
+    // let availability quiesce so the coordinator builds the ring
+    for (unsigned i = 0; i < 5; ++i)
+    {
+        c.tick(NULL);
+    }
+
+    version_id vid;
+    version_id ckpt;
+    check_latest(&vid, &ckpt);
+    // the ring is new, so it can't be a patch
+    ASSERT_EQ(ckpt, vid);
+    const version_id first(vid);
+    unsigned checkpoints = 0;
+
+    // every nonce change issues a configuration; none changes the rings
+    for (uint64_t nonce = 2; nonce < 2 + 130; ++nonce)
+    {
+        c.kvs_online(NULL, comm_id(1000), loc, nonce);
+        version_id prev(vid);
+        check_latest(&vid, &ckpt);
+        ASSERT_EQ(vid.get(), prev.get() + 1);
+
+        if (ckpt == vid)
+        {
+            ++checkpoints;
+            ASSERT_EQ((vid.get() - first.get()) % 64, 0U);
+        }
+        else
+        {
+            ASSERT_LT(vid.get() - ckpt.get(), 64U);
+        }
+    }
+
+    ASSERT_EQ(checkpoints, 2U);
+}
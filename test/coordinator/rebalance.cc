@@ -0,0 +1,483 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <assert.h>
+#include <stdlib.h>
+
+// STL
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+// consus
+#include "coordinator/rebalance.h"
+#include "test/th.h"
+
+using namespace consus;
+
+// The rebalancing the coordinator did before rebalance_ring replaced it,
+// kept verbatim (but for the wrapper at the end) as the reference the new
+// code must agree with, partition for partition.
+namespace reference
+{
+template <typename T>
+unsigned
+compute_partition_count(T parts[CONSUS_KVS_PARTITIONS])
+{
+    unsigned idx = 0;
+    unsigned partitions = 0;
+
+    while (idx < CONSUS_KVS_PARTITIONS)
+    {
+        unsigned end = idx + 1;
+
+        while (end < CONSUS_KVS_PARTITIONS &&
+               parts[idx] == parts[end])
+        {
+            ++end;
+        }
+
+        ++partitions;
+        idx = end;
+    }
+
+    return partitions;
+}
+
+void
+map_owners_to_indices(comm_id owners[CONSUS_KVS_PARTITIONS],
+                      unsigned partitions[CONSUS_KVS_PARTITIONS])
+{
+    unsigned idx = 0;
+    unsigned count = 0;
+
+    while (idx < CONSUS_KVS_PARTITIONS)
+    {
+        unsigned end = idx;
+
+        while (end < CONSUS_KVS_PARTITIONS &&
+               owners[idx] == owners[end])
+        {
+            partitions[end] = count;
+            ++end;
+        }
+
+        ++count;
+        idx = end;
+    }
+}
+
+void
+evenly_distribute_indices(unsigned count,
+                          unsigned partitions[CONSUS_KVS_PARTITIONS])
+{
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        partitions[i] = 0;
+    }
+
+    const unsigned size = CONSUS_KVS_PARTITIONS / count;
+    const unsigned excess = CONSUS_KVS_PARTITIONS % count;
+    unsigned idx = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const unsigned this_size = size + (i < excess ? 1 : 0);
+
+        for (size_t j = 0; j < this_size; ++j)
+        {
+            partitions[idx + j] = i;
+        }
+
+        idx += this_size;
+    }
+
+    assert(partitions[CONSUS_KVS_PARTITIONS - 1] == count - 1);
+}
+
+void
+stable_marriage(comm_id current_owners[CONSUS_KVS_PARTITIONS],
+                comm_id new_owners[CONSUS_KVS_PARTITIONS],
+                unsigned new_partitions)
+{
+    // map CONSUS_KVS_PARTITIONS buckets onto a smaller number of buckets (the
+    // value of each element in the arrays)
+    unsigned part1[CONSUS_KVS_PARTITIONS];
+    unsigned part2[CONSUS_KVS_PARTITIONS];
+    // label each contiguous block of owners with a unique id
+    map_owners_to_indices(current_owners, part1);
+    // create an ideal distribution of N partitions
+    evenly_distribute_indices(new_partitions, part2);
+    const unsigned n1 = compute_partition_count(part1);
+    const unsigned n2 = new_partitions;
+    assert(n2 == compute_partition_count(part2));
+    // preference weights for the stable marriage algorithm
+    // prefs1: part1/current for part2/new
+    // prefs2: part2/new for part1/current
+    std::map<std::pair<unsigned, unsigned>, unsigned> prefs1;
+    std::map<std::pair<unsigned, unsigned>, unsigned> prefs2;
+
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        ++prefs1[std::make_pair(part1[i], part2[i])];
+        ++prefs2[std::make_pair(part2[i], part1[i])];
+    }
+
+    // who is assigned to whom; matches part1/part2
+    // assign1: values [0:n1] value CONSUS_KVS_PARTITIONS means unassigned
+    // assign2: values [0:n2] value CONSUS_KVS_PARTITIONS means unassigned
+    // it's sized CONSUS_KVS_PARTITIONS for static allocation
+    unsigned assign1[CONSUS_KVS_PARTITIONS];
+    unsigned assign2[CONSUS_KVS_PARTITIONS];
+
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        assign1[i] = CONSUS_KVS_PARTITIONS;
+        assign2[i] = CONSUS_KVS_PARTITIONS;
+    }
+
+    std::set<std::pair<unsigned, unsigned> > proposals;
+
+    while (true)
+    {
+        // if either assign1 or assign2 is completely mapped
+        if (std::find(assign1, assign1 + n1, CONSUS_KVS_PARTITIONS) == assign1 + n1 ||
+            std::find(assign2, assign2 + n2, CONSUS_KVS_PARTITIONS) == assign2 + n2)
+        {
+            break;
+        }
+
+        // consider everyone in the first group
+        for (unsigned idx1 = 0; idx1 < n1; ++idx1)
+        {
+            // if already matched
+            if (assign1[idx1] < CONSUS_KVS_PARTITIONS)
+            {
+                continue;
+            }
+
+            unsigned best_candidate = CONSUS_KVS_PARTITIONS;
+            unsigned best_preference = 0;
+
+            // consider everyone in the second group
+            for (unsigned idx2 = 0; idx2 < n2; ++idx2)
+            {
+                // if there's already a proposal from 1->2
+                if (proposals.find(std::make_pair(idx1, idx2)) != proposals.end())
+                {
+                    continue;
+                }
+
+                std::map<std::pair<unsigned, unsigned>, unsigned>::iterator it;
+                it = prefs1.find(std::make_pair(idx1, idx2));
+                // what's idx1's preference for idx2?
+                const unsigned preference = it != prefs1.end() ? it->second : 0;
+
+                // pick
+                if (best_candidate == CONSUS_KVS_PARTITIONS ||
+                    best_preference < preference)
+                {
+                    best_candidate = idx2;
+                    best_preference = preference;
+                }
+            }
+
+            // if no one to propose to
+            if (best_candidate == CONSUS_KVS_PARTITIONS)
+            {
+                continue;
+            }
+
+            proposals.insert(std::make_pair(idx1, best_candidate));
+
+            // if idx1's preference is unmatched, match them
+            if (assign2[best_candidate] == CONSUS_KVS_PARTITIONS)
+            {
+                assign1[idx1] = best_candidate;
+                assign2[best_candidate] = idx1;
+            }
+            else
+            {
+                std::map<std::pair<unsigned, unsigned>, unsigned>::iterator it;
+                it = prefs2.find(std::make_pair(best_candidate, assign2[best_candidate]));
+                // candidate's preference for its current match
+                const unsigned cur_preference = it != prefs2.end() ? it->second : 0;
+                it = prefs2.find(std::make_pair(best_candidate, idx1));
+                // candidate's preference for idx1
+                const unsigned new_preference = it != prefs2.end() ? it->second : 0;
+
+                // trade up
+                if (cur_preference < new_preference)
+                {
+                    assign1[assign2[best_candidate]] = CONSUS_KVS_PARTITIONS;
+                    assign1[idx1] = best_candidate;
+                    assign2[best_candidate] = idx1;
+                }
+            }
+        }
+    }
+
+    // fill in new owners
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        assert(part2[i] < n2);
+
+        // if this bucket is unassigned
+        if (assign2[part2[i]] == CONSUS_KVS_PARTITIONS)
+        {
+            new_owners[i] = comm_id();
+            continue;
+        }
+
+        // find an element in part1 with the value this partition matches
+        assert(assign2[part2[i]] < n1);
+        unsigned* const ptr = std::find(part1, part1 + CONSUS_KVS_PARTITIONS, assign2[part2[i]]);
+        const unsigned idx = ptr - part1;
+        assert(idx < CONSUS_KVS_PARTITIONS);
+        new_owners[i] = current_owners[idx];
+    }
+}
+
+void
+unassign_discontinuous(comm_id old_owners[CONSUS_KVS_PARTITIONS],
+                       comm_id new_owners[CONSUS_KVS_PARTITIONS])
+{
+    std::map<comm_id, unsigned> counts;
+    comm_id* ptr = new_owners;
+    comm_id* const end = ptr + CONSUS_KVS_PARTITIONS;
+
+    while (ptr < end)
+    {
+        // find the contiguous size of this assignment
+        comm_id* tmp = ptr;
+        // how many partitions are the same in old and new
+        unsigned maintained = 0;
+
+        while (tmp < end && *tmp == *ptr)
+        {
+            if (old_owners[tmp - new_owners] == *ptr)
+            {
+                ++maintained;
+            }
+
+            ++tmp;
+        }
+
+        // look for any previous range assigned to *ptr
+        std::map<comm_id, unsigned>::iterator it = counts.find(*ptr);
+
+        // if *ptr was previously assigned and previous assignment maintained
+        // fewer partitions
+        if (it != counts.end() && it->second < maintained)
+        {
+            for (comm_id* c = new_owners; c < ptr; ++c)
+            {
+                if (*c == *ptr)
+                {
+                    *c = comm_id();
+                }
+            }
+
+            it->second = maintained;
+        }
+        else if (it == counts.end())
+        {
+            counts.insert(std::make_pair(*ptr, maintained));
+        }
+
+        ptr = tmp;
+    }
+}
+
+void
+assign_unassigned(comm_id owners[CONSUS_KVS_PARTITIONS], comm_id* kvs, size_t kvs_sz)
+{
+    comm_id* const owners_end = owners + CONSUS_KVS_PARTITIONS;
+    unsigned part[CONSUS_KVS_PARTITIONS];
+    evenly_distribute_indices(kvs_sz, part);
+
+    for (size_t i = 0; i < kvs_sz; ++i)
+    {
+        if (std::find(owners, owners_end, kvs[i]) != owners_end)
+        {
+            continue;
+        }
+
+        unsigned fill = CONSUS_KVS_PARTITIONS;
+
+        for (size_t j = 0; j < CONSUS_KVS_PARTITIONS; ++j)
+        {
+            if (owners[j] == comm_id() && fill == CONSUS_KVS_PARTITIONS)
+            {
+                fill = part[j];
+            }
+
+            if (part[j] == fill && owners[j] == comm_id())
+            {
+                owners[j] = kvs[i];
+            }
+        }
+    }
+}
+
+
+void
+rebalance_ring(comm_id current_owners[CONSUS_KVS_PARTITIONS],
+               comm_id* kvss, size_t kvss_sz,
+               comm_id new_owners[CONSUS_KVS_PARTITIONS])
+{
+    stable_marriage(current_owners, new_owners, kvss_sz);
+    unassign_discontinuous(current_owners, new_owners);
+    assign_unassigned(new_owners, kvss, kvss_sz);
+}
+
+} // namespace reference
+
+static comm_id s_current[CONSUS_KVS_PARTITIONS];
+static comm_id s_expected[CONSUS_KVS_PARTITIONS];
+static comm_id s_actual[CONSUS_KVS_PARTITIONS];
+
+// rebalance s_current for kvss with both algorithms and compare
+static void
+check(std::vector<comm_id> kvss)
+{
+    assert(!kvss.empty());
+    reference::rebalance_ring(s_current, &kvss[0], kvss.size(), s_expected);
+    rebalance_ring(s_current, &kvss[0], kvss.size(), s_actual);
+
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        ASSERT_EQ(s_actual[i], s_expected[i]);
+    }
+
+    // a ring with at least one store leaves no partition unowned
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        ASSERT_NE(s_actual[i], comm_id());
+    }
+}
+
+// s_current becomes k evenly sized runs owned by first, first + 1, ...
+static void
+even_ring(unsigned k, uint64_t first)
+{
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        s_current[i] = k ? comm_id(first + uint64_t(i) * k / CONSUS_KVS_PARTITIONS) : comm_id();
+    }
+}
+
+static std::vector<comm_id>
+stores(uint64_t first, uint64_t last)
+{
+    std::vector<comm_id> kvss;
+
+    for (uint64_t i = first; i <= last; ++i)
+    {
+        kvss.push_back(comm_id(i));
+    }
+
+    return kvss;
+}
+
+TEST(Rebalance, FirstRing)
+{
+    even_ring(0, 0);
+    check(stores(1, 1));
+    check(stores(1, 7));
+}
+
+TEST(Rebalance, Unchanged)
+{
+    even_ring(5, 1);
+    check(stores(1, 5));
+
+    for (size_t i = 0; i < CONSUS_KVS_PARTITIONS; ++i)
+    {
+        ASSERT_EQ(s_actual[i], s_current[i]);
+    }
+}
+
+TEST(Rebalance, AddAndRemoveStores)
+{
+    even_ring(5, 1);
+    check(stores(1, 6));
+    check(stores(1, 9));
+    check(stores(2, 5));
+    check(stores(3, 3));
+    // replace every store at once
+    check(stores(10, 14));
+}
+
+TEST(Rebalance, StoreOrderMatters)
+{
+    even_ring(4, 1);
+    std::vector<comm_id> kvss = stores(1, 8);
+    std::reverse(kvss.begin(), kvss.end());
+    check(kvss);
+}
+
+TEST(Rebalance, FragmentedRing)
+{
+    srand(0xc0ffee);
+
+    for (unsigned trial = 0; trial < 6; ++trial)
+    {
+        even_ring(1 + rand() % 30, 1);
+
+        // scribble runs of other owners, and holes, over the ring
+        for (unsigned j = 0; j < 20; ++j)
+        {
+            const unsigned start = rand() % CONSUS_KVS_PARTITIONS;
+            const unsigned len = rand() % 4096;
+            const comm_id owner(trial % 2 == 0 ? rand() % 40 : 0);
+
+            for (unsigned x = start; x < start + len && x < CONSUS_KVS_PARTITIONS; ++x)
+            {
+                s_current[x] = owner;
+            }
+        }
+
+        std::vector<comm_id> kvss;
+        std::set<uint64_t> used;
+        const unsigned k = 1 + rand() % 40;
+
+        while (kvss.size() < k)
+        {
+            const uint64_t id = 1 + rand() % 50;
+
+            if (used.insert(id).second)
+            {
+                kvss.push_back(comm_id(id));
+            }
+        }
+
+        check(kvss);
+    }
+}
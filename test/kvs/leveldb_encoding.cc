@@ -0,0 +1,159 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+#include <stdlib.h>
+
+// STL
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// consus
+#include "kvs/leveldb_encoding.h"
+#include "test/th.h"
+
+using namespace consus;
+
+namespace
+{
+
+struct object
+{
+    object(const std::string& t, const std::string& k, uint64_t ts)
+        : table(t), key(k), timestamp(ts) {}
+
+    // the order the old ConsusComparator imposed within the data keys
+    bool operator < (const object& rhs) const
+    {
+        if (table != rhs.table) return table < rhs.table;
+        if (key != rhs.key) return key < rhs.key;
+        return timestamp > rhs.timestamp;
+    }
+
+    std::string table;
+    std::string key;
+    uint64_t timestamp;
+};
+
+std::string
+random_string()
+{
+    // small alphabet with NUL and 0xff so escaping and prefixes get exercised
+    static const char alphabet[] = {'\x00', '\x01', 'a', 'b', '\xff'};
+    std::string s;
+    size_t sz = rand() % 5;
+
+    for (size_t i = 0; i < sz; ++i)
+    {
+        s.push_back(alphabet[rand() % sizeof(alphabet)]);
+    }
+
+    return s;
+}
+
+} // namespace
+
+TEST(LevelDBEncoding, RoundTrip)
+{
+    const std::string table("t\x00\xff", 3);
+    const std::string key("\x00\x00k\x01", 4);
+    std::string t;
+    std::string k;
+    uint64_t ts;
+    std::string dk = leveldb_data_key(table, key, 42);
+    ASSERT_TRUE(leveldb_decode_data_key(dk, &t, &k, &ts));
+    ASSERT_TRUE(t == table);
+    ASSERT_TRUE(k == key);
+    ASSERT_EQ(ts, 42U);
+    ASSERT_EQ(leveldb_data_key_timestamp(dk), 42U);
+    std::string lk = leveldb_lock_key(table, key);
+    ASSERT_TRUE(leveldb_decode_lock_key(lk, &t, &k));
+    ASSERT_TRUE(t == table);
+    ASSERT_TRUE(k == key);
+    ASSERT_FALSE(leveldb_decode_data_key(lk, &t, &k, &ts));
+    ASSERT_FALSE(leveldb_decode_lock_key(dk, &t, &k));
+}
+
+TEST(LevelDBEncoding, ObjectPrefix)
+{
+    const std::string table("t\x00", 2);
+    const std::string key("\x00\x01", 2);
+    std::string obj = leveldb_object_key(table, key);
+    std::string dk = leveldb_data_key(table, key, 7);
+    ASSERT_EQ(leveldb_object_prefix(obj), obj.size());
+    ASSERT_EQ(leveldb_object_prefix(dk), obj.size());
+    ASSERT_TRUE(dk.compare(0, obj.size(), obj) == 0);
+    ASSERT_LT(obj.compare(dk), 0);
+    std::string lk = leveldb_lock_key(table, key);
+    ASSERT_EQ(leveldb_object_prefix(lk), lk.size());
+    std::string mk = leveldb_meta_key("markers");
+    ASSERT_EQ(leveldb_object_prefix(mk), mk.size());
+}
+
+TEST(LevelDBEncoding, SameObject)
+{
+    std::string a = leveldb_data_key("t", "k", 1);
+    std::string b = leveldb_data_key("t", "k", 2);
+    std::string c = leveldb_data_key("t", "kk", 2);
+    std::string d = leveldb_data_key("tk", "", 2);
+    ASSERT_TRUE(leveldb_same_object(a, b));
+    ASSERT_FALSE(leveldb_same_object(a, c));
+    ASSERT_FALSE(leveldb_same_object(a, d));
+}
+
+TEST(LevelDBEncoding, BytewiseOrder)
+{
+    srand(0x5eed);
+    std::vector<object> objs;
+
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        uint64_t ts = rand() % 4;
+        ts = ts == 3 ? UINT64_MAX : ts;
+        objs.push_back(object(random_string(), random_string(), ts));
+    }
+
+    std::sort(objs.begin(), objs.end());
+    std::vector<std::string> keys;
+
+    for (size_t i = 0; i < objs.size(); ++i)
+    {
+        keys.push_back(leveldb_data_key(objs[i].table, objs[i].key, objs[i].timestamp));
+    }
+
+    for (size_t i = 1; i < keys.size(); ++i)
+    {
+        ASSERT_LE(keys[i - 1].compare(keys[i]), 0);
+        const bool same = objs[i - 1].table == objs[i].table &&
+                          objs[i - 1].key == objs[i].key;
+        ASSERT_EQ(same, leveldb_same_object(keys[i - 1], keys[i]));
+    }
+}
@@ -0,0 +1,444 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// C
+#include <stdio.h>
+#include <stdlib.h>
+
+// POSIX
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// STL
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/path.h>
+#include <po6/threads/thread.h>
+
+// e
+#include <e/compat.h>
+#include <e/serialization.h>
+
+// consus
+#include "common/ring.h"
+#include "kvs/lock_store.h"
+#include "test/th.h"
+
+using namespace consus;
+
+static int
+remove_one(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+// a fresh directory, removed with everything in it when this goes out of
+// scope, failed assertion or not
+class scratch_dir
+{
+    public:
+        scratch_dir()
+            : m_path()
+        {
+            char buf[] = "/tmp/consus-lock-store-XXXXXX";
+            char* dir = mkdtemp(buf);
+            m_path = dir ? std::string(dir) : std::string();
+        }
+        ~scratch_dir() throw ()
+        {
+            if (!m_path.empty())
+            {
+                nftw(m_path.c_str(), remove_one, 16, FTW_DEPTH|FTW_PHYS);
+            }
+        }
+
+    public:
+        const std::string& path() const { return m_path; }
+
+    private:
+        std::string m_path;
+
+    private:
+        scratch_dir(const scratch_dir&);
+        scratch_dir& operator = (const scratch_dir&);
+};
+
+static uint64_t
+journal_size(const std::string& dir)
+{
+    struct stat st;
+
+    if (stat(po6::path::join(dir, "lock-journal").c_str(), &st) < 0)
+    {
+        return 0;
+    }
+
+    return st.st_size;
+}
+
+// one of the counters lock_store::debug_dump reports, e.g. "syncs"
+static uint64_t
+counter(lock_store* ls, const char* name)
+{
+    const std::string dump = ls->debug_dump();
+    const std::string needle = std::string(" ") + name + "=";
+    const size_t idx = dump.find(needle);
+    return idx == std::string::npos ? 0 : strtoull(dump.c_str() + idx + needle.size(), NULL, 10);
+}
+
+static transaction_group
+make_tg(uint64_t x)
+{
+    return transaction_group(transaction_id(paxos_group_id(x), x, x));
+}
+
+TEST(LockStore, FreshImportAndReopen)
+{
+    scratch_dir scratch;
+    const std::string& dir(scratch.path());
+    ASSERT_FALSE(dir.empty());
+
+    {
+        lock_store ls;
+        bool fresh = false;
+        ASSERT_TRUE(ls.open(dir, &fresh));
+        ASSERT_TRUE(fresh);
+        ls.import("table", "imported", make_tg(1));
+        ASSERT_TRUE(ls.checkpoint());
+        ASSERT_TRUE(ls.put("table", "key", make_tg(2)));
+        ASSERT_TRUE(ls.get("table", "key") == make_tg(2));
+        ASSERT_TRUE(ls.get("table", "other") == transaction_group());
+    }
+
+    lock_store ls;
+    bool fresh = true;
+    ASSERT_TRUE(ls.open(dir, &fresh));
+    ASSERT_FALSE(fresh);
+    ASSERT_TRUE(ls.get("table", "imported") == make_tg(1));
+    ASSERT_TRUE(ls.get("table", "key") == make_tg(2));
+}
+
+TEST(LockStore, UnlockSurvivesReopen)
+{
+    scratch_dir scratch;
+    const std::string& dir(scratch.path());
+    ASSERT_FALSE(dir.empty());
+
+    {
+        lock_store ls;
+        bool fresh = false;
+        ASSERT_TRUE(ls.open(dir, &fresh));
+        ASSERT_TRUE(ls.checkpoint());
+        ASSERT_TRUE(ls.put("table", "key", make_tg(1)));
+        ASSERT_TRUE(ls.put("table", "key", make_tg(2)));
+        ASSERT_TRUE(ls.put("table", "key", transaction_group()));
+    }
+
+    lock_store ls;
+    bool fresh = true;
+    ASSERT_TRUE(ls.open(dir, &fresh));
+    ASSERT_TRUE(ls.get("table", "key") == transaction_group());
+}
+
+TEST(LockStore, TornTailDiscarded)
+{
+    scratch_dir scratch;
+    const std::string& dir(scratch.path());
+    ASSERT_FALSE(dir.empty());
+
+    {
+        lock_store ls;
+        bool fresh = false;
+        ASSERT_TRUE(ls.open(dir, &fresh));
+        ASSERT_TRUE(ls.checkpoint());
+        ASSERT_TRUE(ls.put("table", "a", make_tg(1)));
+    }
+
+    // half a record, as a crash mid-append would leave
+    const std::string journal = po6::path::join(dir, "lock-journal");
+    int fd = open(journal.c_str(), O_WRONLY|O_APPEND);
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_EQ(write(fd, "\x00\x00\x00\x40garbage", 11), 11);
+    close(fd);
+
+    {
+        lock_store ls;
+        bool fresh = true;
+        ASSERT_TRUE(ls.open(dir, &fresh));
+        ASSERT_TRUE(ls.get("table", "a") == make_tg(1));
+        // appends go where the garbage was
+        ASSERT_TRUE(ls.put("table", "b", make_tg(2)));
+    }
+
+    lock_store ls;
+    bool fresh = true;
+    ASSERT_TRUE(ls.open(dir, &fresh));
+    ASSERT_TRUE(ls.get("table", "a") == make_tg(1));
+    ASSERT_TRUE(ls.get("table", "b") == make_tg(2));
+}
+
+TEST(LockStore, OpenCreatesDirectory)
+{
+    scratch_dir scratch;
+    ASSERT_FALSE(scratch.path().empty());
+    const std::string dir = po6::path::join(scratch.path(), "locks");
+
+    {
+        lock_store ls;
+        bool fresh = false;
+        ASSERT_TRUE(ls.open(dir, &fresh));
+        ASSERT_TRUE(fresh);
+        ASSERT_TRUE(ls.checkpoint());
+        ASSERT_TRUE(ls.put("table", "key", make_tg(1)));
+    }
+
+    lock_store ls;
+    bool fresh = true;
+    ASSERT_TRUE(ls.open(dir, &fresh));
+    ASSERT_FALSE(fresh);
+    ASSERT_TRUE(ls.get("table", "key") == make_tg(1));
+}
+
+struct concurrent_puts
+{
+    concurrent_puts(lock_store* l, unsigned p) : ls(l), puts(p), next(0), failures(0), mtx() {}
+    void worker();
+
+    lock_store* ls;
+    unsigned puts;
+    unsigned next;
+    unsigned failures;
+    po6::threads::mutex mtx;
+};
+
+void
+concurrent_puts :: worker()
+{
+    unsigned id;
+
+    {
+        po6::threads::mutex::hold hold(&mtx);
+        id = next++;
+    }
+
+    for (unsigned i = 0; i < puts; ++i)
+    {
+        char key[32];
+        sprintf(key, "%u-%u", id, i);
+
+        if (!ls->put("table", key, make_tg(1 + id * puts + i)))
+        {
+            po6::threads::mutex::hold hold(&mtx);
+            ++failures;
+        }
+    }
+}
+
+// Many threads putting at once share fdatasyncs, and every put is durable
+// when it returns.
+TEST(LockStore, ConcurrentGroupCommit)
+{
+    using namespace po6::threads;
+    scratch_dir scratch;
+    const std::string& dir(scratch.path());
+    ASSERT_FALSE(dir.empty());
+    const unsigned threads = 16;
+    const unsigned puts = 64;
+
+    {
+        lock_store ls;
+        bool fresh = false;
+        ASSERT_TRUE(ls.open(dir, &fresh));
+        ASSERT_TRUE(ls.checkpoint());
+        concurrent_puts cp(&ls, puts);
+        std::vector<e::compat::shared_ptr<thread> > ts;
+
+        for (unsigned i = 0; i < threads; ++i)
+        {
+            e::compat::shared_ptr<thread> t(new thread(make_obj_func(&concurrent_puts::worker, &cp)));
+            ts.push_back(t);
+            t->start();
+        }
+
+        for (size_t i = 0; i < ts.size(); ++i)
+        {
+            ts[i]->join();
+        }
+
+        ASSERT_EQ(cp.failures, 0U);
+        ASSERT_EQ(counter(&ls, "commits"), uint64_t(threads * puts));
+        ASSERT_LE(counter(&ls, "syncs"), uint64_t(threads * puts));
+        ASSERT_GT(counter(&ls, "syncs"), 0U);
+    }
+
+    lock_store ls;
+    bool fresh = true;
+    ASSERT_TRUE(ls.open(dir, &fresh));
+
+    for (unsigned id = 0; id < threads; ++id)
+    {
+        for (unsigned i = 0; i < puts; ++i)
+        {
+            char key[32];
+            sprintf(key, "%u-%u", id, i);
+            ASSERT_TRUE(ls.get("table", key) == make_tg(1 + id * puts + i));
+        }
+    }
+}
+
+// lock_store.cc rewrites once the journal is over 4MB and over 4x the bytes
+// a rewrite would keep
+#define REWRITE_MIN_BYTES (4ULL << 20)
+
+static std::string
+big_key(unsigned i)
+{
+    char buf[16];
+    sprintf(buf, "%u", i);
+    return std::string(8192, 'k') + buf;
+}
+
+TEST(LockStore, RewriteNeedsMinimumSize)
+{
+    scratch_dir scratch;
+    const std::string& dir(scratch.path());
+    ASSERT_FALSE(dir.empty());
+    lock_store ls;
+    bool fresh = false;
+    ASSERT_TRUE(ls.open(dir, &fresh));
+    ASSERT_TRUE(ls.checkpoint());
+    ASSERT_EQ(counter(&ls, "checkpoints"), 1U);
+    const std::string key = big_key(0);
+    unsigned i = 0;
+
+    // one lock churned:  mostly superseded, but not yet large
+    for (; journal_size(dir) + 2 * key.size() < REWRITE_MIN_BYTES; ++i)
+    {
+        ASSERT_TRUE(ls.put("table", key, make_tg(1 + i)));
+    }
+
+    ASSERT_EQ(counter(&ls, "checkpoints"), 1U);
+
+    for (unsigned j = 0; j < 4; ++j, ++i)
+    {
+        ASSERT_TRUE(ls.put("table", key, make_tg(1 + i)));
+    }
+
+    ASSERT_EQ(counter(&ls, "checkpoints"), 2U);
+    ASSERT_LT(journal_size(dir), REWRITE_MIN_BYTES);
+
+    lock_store reopened;
+    ASSERT_TRUE(reopened.open(dir, &fresh));
+    ASSERT_TRUE(reopened.get("table", key) == make_tg(i));
+}
+
+TEST(LockStore, RewriteNeedsMostlySuperseded)
+{
+    scratch_dir scratch;
+    const std::string& dir(scratch.path());
+    ASSERT_FALSE(dir.empty());
+    lock_store ls;
+    bool fresh = false;
+    ASSERT_TRUE(ls.open(dir, &fresh));
+    ASSERT_TRUE(ls.checkpoint());
+    const unsigned held = 200;
+
+    // ~1.6MB of held locks, each then taken over once:  past 4MB, but a
+    // rewrite would keep more than a quarter of it
+    for (unsigned i = 0; i < held; ++i)
+    {
+        ASSERT_TRUE(ls.put("table", big_key(i), make_tg(1 + i)));
+    }
+
+    for (unsigned i = 0; i < 2 * held; ++i)
+    {
+        ASSERT_TRUE(ls.put("table", big_key(i % held), make_tg(1000 + i)));
+    }
+
+    ASSERT_GT(journal_size(dir), REWRITE_MIN_BYTES);
+    ASSERT_EQ(counter(&ls, "checkpoints"), 1U);
+
+    // releasing locks shrinks what a rewrite would keep until it pays off
+    for (unsigned i = 1; i < held; ++i)
+    {
+        ASSERT_TRUE(ls.put("table", big_key(i), transaction_group()));
+    }
+
+    ASSERT_EQ(counter(&ls, "checkpoints"), 2U);
+    ASSERT_LT(journal_size(dir), REWRITE_MIN_BYTES);
+
+    lock_store reopened;
+    ASSERT_TRUE(reopened.open(dir, &fresh));
+    ASSERT_TRUE(reopened.get("table", big_key(0)) == make_tg(1000 + held));
+
+    for (unsigned i = 1; i < held; ++i)
+    {
+        ASSERT_TRUE(reopened.get("table", big_key(i)) == transaction_group());
+    }
+}
+
+TEST(LockStore, HeldByPartition)
+{
+    scratch_dir scratch;
+    const std::string& dir(scratch.path());
+    ASSERT_FALSE(dir.empty());
+    lock_store ls;
+    bool fresh = false;
+    ASSERT_TRUE(ls.open(dir, &fresh));
+    ASSERT_TRUE(ls.checkpoint());
+    ASSERT_TRUE(ls.put("table", "a", make_tg(1)));
+    ASSERT_TRUE(ls.put("table", "b", make_tg(2)));
+    ASSERT_TRUE(ls.put("table", "c", make_tg(3)));
+    ASSERT_TRUE(ls.put("table", "c", transaction_group()));
+    const unsigned index = ring::partition_index("table", "a");
+    std::string out;
+    ls.held(std::vector<unsigned>(1, index), &out);
+
+    e::unpacker up(out);
+    unsigned found = 0;
+
+    while (up.remain() && !up.error())
+    {
+        e::slice table;
+        e::slice key;
+        transaction_group tg;
+        up = up >> table >> key >> tg;
+        ASSERT_FALSE(up.error());
+        ASSERT_EQ(ring::partition_index(table, key), index);
+        ASSERT_TRUE(key != e::slice("c"));
+        ASSERT_TRUE(ls.get(table, key) == tg);
+        ++found;
+    }
+
+    const unsigned expected = ring::partition_index("table", "b") == index ? 2 : 1;
+    ASSERT_EQ(found, expected);
+}
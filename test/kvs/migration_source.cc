@@ -0,0 +1,349 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdio.h>
+#include <string.h>
+
+// STL
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// e
+#include <e/serialization.h>
+
+// consus
+#include "common/ring.h"
+#include "kvs/datalayer.h"
+#include "kvs/migration_source.h"
+#include "test/th.h"
+
+using namespace consus;
+
+typedef std::map<unsigned, std::vector<unsigned> > outgoing_t;
+
+// Just enough of a datalayer to walk:  one version per key, in key order, with
+// the key doubling as the position.
+class fake_datalayer : public datalayer
+{
+    public:
+        fake_datalayer(size_t n) : m_keys()
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                char buf[32];
+                sprintf(buf, "key%06lu", static_cast<unsigned long>(i));
+                m_keys.push_back(buf);
+            }
+        }
+        virtual ~fake_datalayer() throw () {}
+
+    public:
+        virtual bool init(std::string) { return true; }
+        virtual consus_returncode get(const e::slice&, const e::slice&, uint64_t,
+                                      uint64_t*, e::slice*, reference**)
+        { return CONSUS_NOT_FOUND; }
+        virtual consus_returncode put(const e::slice&, const e::slice&, uint64_t,
+                                      const e::slice&)
+        { return CONSUS_SERVER_ERROR; }
+        virtual consus_returncode del(const e::slice&, const e::slice&, uint64_t)
+        { return CONSUS_SERVER_ERROR; }
+        virtual consus_returncode read_lock(const e::slice&, const e::slice&,
+                                            transaction_group*)
+        { return CONSUS_SERVER_ERROR; }
+        virtual consus_returncode write_lock(const e::slice&, const e::slice&,
+                                             const transaction_group&)
+        { return CONSUS_SERVER_ERROR; }
+        virtual consus_returncode collect_garbage(uint64_t) { return CONSUS_SUCCESS; }
+        virtual snapshot* make_snapshot(const e::slice& position);
+        virtual consus_returncode import(const version*, size_t)
+        { return CONSUS_SERVER_ERROR; }
+        virtual void held_locks(const std::vector<unsigned>&, std::string*) {}
+        virtual std::string debug_dump() { return ""; }
+
+    public:
+        const std::vector<std::string>& keys() const { return m_keys; }
+
+    private:
+        class fake_snapshot;
+        std::vector<std::string> m_keys;
+};
+
+class fake_datalayer::fake_snapshot : public datalayer::snapshot
+{
+    public:
+        fake_snapshot(const std::vector<std::string>* keys, size_t idx)
+            : m_keys(keys), m_idx(idx) {}
+        virtual ~fake_snapshot() throw () {}
+
+    public:
+        virtual bool valid() { return m_idx < m_keys->size(); }
+        virtual void next() { ++m_idx; }
+        virtual consus_returncode status() { return CONSUS_SUCCESS; }
+        virtual e::slice table() { return e::slice("table"); }
+        virtual e::slice key() { return e::slice((*m_keys)[m_idx]); }
+        virtual uint64_t timestamp() { return 1; }
+        virtual e::slice value() { return e::slice("value"); }
+        virtual e::slice position() { return e::slice((*m_keys)[m_idx]); }
+
+    private:
+        const std::vector<std::string>* m_keys;
+        size_t m_idx;
+};
+
+datalayer::snapshot*
+fake_datalayer :: make_snapshot(const e::slice& position)
+{
+    std::vector<std::string>::const_iterator it;
+    it = std::upper_bound(m_keys.begin(), m_keys.end(), position.str());
+    return new fake_snapshot(&m_keys, it - m_keys.begin());
+}
+
+// the keys of the partitions "indices", in order
+static std::vector<std::string>
+partition_keys(const fake_datalayer& dl, const std::vector<unsigned>& indices)
+{
+    std::vector<std::string> keys;
+
+    for (size_t i = 0; i < dl.keys().size(); ++i)
+    {
+        const unsigned index = ring::partition_index("table", dl.keys()[i]);
+
+        if (std::find(indices.begin(), indices.end(), index) != indices.end())
+        {
+            keys.push_back(dl.keys()[i]);
+        }
+    }
+
+    return keys;
+}
+
+static std::vector<std::string>
+partition_keys(const fake_datalayer& dl, unsigned index)
+{
+    return partition_keys(dl, std::vector<unsigned>(1, index));
+}
+
+// two distinct partitions with keys in "dl", in index order
+static void
+two_partitions(const fake_datalayer& dl, unsigned* a, unsigned* b)
+{
+    *a = ring::partition_index("table", dl.keys()[0]);
+    *b = *a;
+
+    for (size_t i = 1; *b == *a && i < dl.keys().size(); ++i)
+    {
+        *b = ring::partition_index("table", dl.keys()[i]);
+    }
+
+    if (*b < *a)
+    {
+        std::swap(*a, *b);
+    }
+}
+
+static void
+unpack_keys(const std::string& entries, std::vector<std::string>* keys)
+{
+    e::unpacker up(entries);
+
+    while (up.remain() && !up.error())
+    {
+        e::slice table;
+        e::slice key;
+        uint64_t timestamp;
+        e::slice value;
+        up = up >> table >> key >> timestamp >> value;
+        keys->push_back(key.str());
+    }
+
+    ASSERT_FALSE(up.error());
+}
+
+TEST(MigrationSource, CopiesOnePartition)
+{
+    fake_datalayer dl(4096);
+    migration_source ms;
+    const unsigned index = ring::partition_index("table", dl.keys()[0]);
+    std::vector<std::string> copied;
+    std::string position;
+    bool done = false;
+    unsigned chunks = 0;
+
+    while (!done)
+    {
+        std::string entries;
+        std::string last;
+        uint64_t scanned = 0;
+        ASSERT_EQ(ms.pull(&dl, index, outgoing_t(), position, 64, &entries, &last, &done, &scanned), CONSUS_SUCCESS);
+        unpack_keys(entries, &copied);
+        position = last;
+        ++chunks;
+        ASSERT_LT(chunks, 10000U);
+    }
+
+    ASSERT_TRUE(copied == partition_keys(dl, index));
+}
+
+TEST(MigrationSource, LostChunkPulledAgain)
+{
+    fake_datalayer dl(4096);
+    migration_source ms;
+    const unsigned index = ring::partition_index("table", dl.keys()[0]);
+    std::string first;
+    std::string again;
+    std::string last1;
+    std::string last2;
+    bool done = false;
+    uint64_t scanned = 0;
+    ASSERT_EQ(ms.pull(&dl, index, outgoing_t(), "", 64, &first, &last1, &done, &scanned), CONSUS_SUCCESS);
+    ASSERT_GT(scanned, 0U);
+    ASSERT_EQ(ms.pull(&dl, index, outgoing_t(), "", 64, &again, &last2, &done, &scanned), CONSUS_SUCCESS);
+    ASSERT_TRUE(first == again);
+    ASSERT_TRUE(last1 == last2);
+}
+
+TEST(MigrationSource, PartitionsShareOneWalk)
+{
+    fake_datalayer dl(4096);
+    migration_source ms;
+    unsigned a;
+    unsigned b;
+    two_partitions(dl, &a, &b);
+    ASSERT_NE(a, b);
+    const unsigned parts[] = {a, b};
+    outgoing_t outgoing;
+    outgoing[a].push_back(a);
+    outgoing[b].push_back(b);
+    std::string position[2];
+    bool done[2] = {false, false};
+    std::vector<std::string> copied[2];
+    uint64_t total = 0;
+    uint64_t per_pass = 0;
+
+    for (size_t i = 0; i < dl.keys().size(); ++i)
+    {
+        per_pass += dl.keys()[i].size() + strlen("value");
+    }
+
+    // the two copies keep in step, so the data is read once between them
+    for (unsigned round = 0; !done[0] || !done[1]; ++round)
+    {
+        ASSERT_LT(round, 10000U);
+
+        for (unsigned p = 0; p < 2; ++p)
+        {
+            if (done[p])
+            {
+                continue;
+            }
+
+            std::string entries;
+            std::string last;
+            uint64_t scanned = 0;
+            ASSERT_EQ(ms.pull(&dl, parts[p], outgoing, position[p], 64, &entries, &last, &done[p], &scanned), CONSUS_SUCCESS);
+            unpack_keys(entries, &copied[p]);
+            position[p] = last;
+            total += scanned;
+        }
+    }
+
+    ASSERT_TRUE(copied[0] == partition_keys(dl, a));
+    ASSERT_TRUE(copied[1] == partition_keys(dl, b));
+    ASSERT_LE(total, per_pass);
+}
+
+TEST(MigrationSource, CarriesPartitionsAhead)
+{
+    fake_datalayer dl(4096);
+    migration_source ms;
+    unsigned a;
+    unsigned b;
+    two_partitions(dl, &a, &b);
+    ASSERT_NE(a, b);
+    outgoing_t outgoing;
+    outgoing[b].push_back(a);
+    outgoing[b].push_back(b);
+    std::vector<std::string> copied;
+    std::string position;
+    bool done = false;
+
+    for (unsigned chunks = 0; !done; ++chunks)
+    {
+        ASSERT_LT(chunks, 10000U);
+        std::string entries;
+        std::string last;
+        uint64_t scanned = 0;
+        ASSERT_EQ(ms.pull(&dl, b, outgoing, position, 64, &entries, &last, &done, &scanned), CONSUS_SUCCESS);
+        unpack_keys(entries, &copied);
+        position = last;
+    }
+
+    ASSERT_TRUE(copied == partition_keys(dl, outgoing[b]));
+}
+
+TEST(MigrationSource, RestartsWhenIndicesGrow)
+{
+    fake_datalayer dl(4096);
+    migration_source ms;
+    unsigned a;
+    unsigned b;
+    two_partitions(dl, &a, &b);
+    ASSERT_NE(a, b);
+    outgoing_t outgoing;
+    outgoing[b].push_back(b);
+    std::set<std::string> copied;
+    std::string position;
+    bool done = false;
+
+    for (unsigned chunks = 0; !done; ++chunks)
+    {
+        ASSERT_LT(chunks, 10000U);
+
+        // after the first chunk, partition "a" starts going along with "b"
+        if (chunks == 1)
+        {
+            outgoing[b].insert(outgoing[b].begin(), a);
+        }
+
+        std::string entries;
+        std::string last;
+        uint64_t scanned = 0;
+        std::vector<std::string> keys;
+        ASSERT_EQ(ms.pull(&dl, b, outgoing, position, 1, &entries, &last, &done, &scanned), CONSUS_SUCCESS);
+        unpack_keys(entries, &keys);
+        copied.insert(keys.begin(), keys.end());
+        position = last;
+    }
+
+    const std::vector<std::string> expected(partition_keys(dl, outgoing[b]));
+    ASSERT_EQ(outgoing[b].size(), 2U);
+    ASSERT_TRUE(copied == std::set<std::string>(expected.begin(), expected.end()));
+}
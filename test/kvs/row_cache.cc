@@ -0,0 +1,112 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <string>
+
+// consus
+#include "kvs/row_cache.h"
+#include "test/th.h"
+
+using namespace consus;
+
+TEST(RowCache, HitAndMiss)
+{
+    row_cache rc(1 << 20);
+    uint64_t ts = 0;
+    row_cache::value_t v;
+    ASSERT_FALSE(rc.get("obj", 100, &ts, &v));
+    rc.fill("obj", rc.ticket("obj"), 50, e::slice("value"));
+    ASSERT_TRUE(rc.get("obj", 100, &ts, &v));
+    ASSERT_EQ(ts, 50U);
+    ASSERT_TRUE(*v == "value");
+    ASSERT_TRUE(rc.get("obj", 50, &ts, &v));
+    // a read of the past can't be answered by the latest version
+    ASSERT_FALSE(rc.get("obj", 49, &ts, &v));
+}
+
+TEST(RowCache, Invalidate)
+{
+    row_cache rc(1 << 20);
+    uint64_t ts = 0;
+    row_cache::value_t v;
+    rc.fill("obj", rc.ticket("obj"), 50, e::slice("old"));
+    rc.invalidate("obj");
+    ASSERT_FALSE(rc.get("obj", 100, &ts, &v));
+}
+
+TEST(RowCache, StaleFillDropped)
+{
+    row_cache rc(1 << 20);
+    uint64_t ts = 0;
+    row_cache::value_t v;
+    // a reader takes its ticket, then a write lands before it fills
+    uint64_t ticket = rc.ticket("obj");
+    rc.invalidate("obj");
+    rc.fill("obj", ticket, 50, e::slice("old"));
+    ASSERT_FALSE(rc.get("obj", 100, &ts, &v));
+    rc.fill("obj", rc.ticket("obj"), 60, e::slice("new"));
+    ASSERT_TRUE(rc.get("obj", 100, &ts, &v));
+    ASSERT_EQ(ts, 60U);
+}
+
+TEST(RowCache, ValueOutlivesEviction)
+{
+    row_cache rc(1 << 20);
+    uint64_t ts = 0;
+    row_cache::value_t v;
+    rc.fill("obj", rc.ticket("obj"), 50, e::slice("value"));
+    ASSERT_TRUE(rc.get("obj", 100, &ts, &v));
+    rc.invalidate("obj");
+    ASSERT_TRUE(*v == "value");
+}
+
+TEST(RowCache, Bounded)
+{
+    // each shard holds well under 100 of these rows
+    row_cache rc(32 * 4096);
+    const std::string value(100, 'v');
+
+    for (unsigned i = 0; i < 10000; ++i)
+    {
+        std::string obj(std::string("obj") + char('a' + i % 26) + std::string(i / 26, 'x'));
+        rc.fill(obj, rc.ticket(obj), 1, value);
+    }
+
+    unsigned found = 0;
+
+    for (unsigned i = 0; i < 10000; ++i)
+    {
+        std::string obj(std::string("obj") + char('a' + i % 26) + std::string(i / 26, 'x'));
+        uint64_t ts = 0;
+        row_cache::value_t v;
+        found += rc.get(obj, 1, &ts, &v) ? 1 : 0;
+    }
+
+    ASSERT_GT(found, 0U);
+    ASSERT_LT(found, 32U * 4096U / 100U);
+}
@@ -0,0 +1,289 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdlib.h>
+
+// POSIX
+#include <ftw.h>
+#include <stdio.h>
+
+// STL
+#include <string>
+#include <vector>
+
+// e
+#include <e/serialization.h>
+
+// consus
+#include "txman/batch_entry.h"
+#include "txman/durable_log.h"
+#include "test/th.h"
+
+using namespace consus;
+
+static std::string
+temp_dir()
+{
+    char buf[] = "/tmp/consus-batch-entry-XXXXXX";
+    char* dir = mkdtemp(buf);
+    return dir ? std::string(dir) : std::string();
+}
+
+static int
+remove_one(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+static void
+remove_dir(const std::string& dir)
+{
+    nftw(dir.c_str(), remove_one, 16, FTW_DEPTH|FTW_PHYS);
+}
+
+static transaction_group
+make_tg(uint64_t x)
+{
+    return transaction_group(transaction_id(paxos_group_id(x), x, x));
+}
+
+// the same layout transaction::generate_log_entry produces
+static std::string
+read_entry(const transaction_group& tg, uint64_t seqno,
+           const char* table, const char* key, uint64_t timestamp)
+{
+    std::string entry;
+    e::packer pa(&entry);
+    pa = pa << LOG_ENTRY_TX_READ << tg << seqno
+            << e::slice(table) << e::slice(key) << timestamp;
+    return entry;
+}
+
+static std::string
+write_entry(const transaction_group& tg, uint64_t seqno,
+            const char* table, const char* key, const char* value)
+{
+    std::string entry;
+    e::packer pa(&entry);
+    pa = pa << LOG_ENTRY_TX_WRITE << tg << seqno
+            << e::slice(table) << e::slice(key) << e::slice(value);
+    return entry;
+}
+
+static std::string
+batch_entry(const transaction_group& tg, uint64_t seqno,
+            const std::vector<std::string>& ops)
+{
+    std::string entry;
+    e::packer pa(&entry);
+    pa = pa << LOG_ENTRY_TX_BATCH << tg << seqno;
+
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        pa = pa << e::slice(ops[i]);
+    }
+
+    return entry;
+}
+
+// parse a whole batch entry the way daemon::replay and transaction::replay
+// take it apart
+static bool
+parse(const std::string& entry, const transaction_group& tg,
+      std::vector<batch_operation>* ops)
+{
+    e::unpacker up(entry.data(), entry.size());
+    log_entry_t t;
+    transaction_group etg;
+    uint64_t seqno;
+    up = up >> t >> etg >> seqno;
+
+    if (up.error() || t != LOG_ENTRY_TX_BATCH || etg != tg)
+    {
+        return false;
+    }
+
+    return parse_batch_entry(up, tg, seqno, ops);
+}
+
+struct replayed
+{
+    std::vector<std::string> entries;
+};
+
+static void
+replay_one(void* p, int64_t, const unsigned char* entry, size_t entry_sz)
+{
+    replayed* r = static_cast<replayed*>(p);
+    r->entries.push_back(std::string(reinterpret_cast<const char*>(entry), entry_sz));
+}
+
+TEST(BatchEntry, RoundTrip)
+{
+    const transaction_group tg = make_tg(1);
+    std::vector<std::string> ops;
+    ops.push_back(read_entry(tg, 3, "table", "a", 42));
+    ops.push_back(write_entry(tg, 4, "table", "b", "B"));
+    ops.push_back(write_entry(tg, 5, "other", "c", ""));
+    std::vector<batch_operation> parsed;
+    ASSERT_TRUE(parse(batch_entry(tg, 3, ops), tg, &parsed));
+    ASSERT_EQ(parsed.size(), 3U);
+    ASSERT_EQ(parsed[0].type, LOG_ENTRY_TX_READ);
+    ASSERT_EQ(parsed[0].seqno, 3U);
+    ASSERT_TRUE(parsed[0].table == e::slice("table"));
+    ASSERT_TRUE(parsed[0].key == e::slice("a"));
+    ASSERT_EQ(parsed[0].timestamp, 42U);
+    ASSERT_EQ(parsed[1].type, LOG_ENTRY_TX_WRITE);
+    ASSERT_EQ(parsed[1].seqno, 4U);
+    ASSERT_TRUE(parsed[1].key == e::slice("b"));
+    ASSERT_TRUE(parsed[1].value == e::slice("B"));
+    ASSERT_EQ(parsed[2].seqno, 5U);
+    ASSERT_TRUE(parsed[2].table == e::slice("other"));
+    ASSERT_EQ(parsed[2].value.size(), 0U);
+}
+
+TEST(BatchEntry, Rejects)
+{
+    const transaction_group tg = make_tg(1);
+    std::vector<batch_operation> parsed;
+    std::vector<std::string> ops;
+
+    // empty
+    ASSERT_FALSE(parse(batch_entry(tg, 0, ops), tg, &parsed));
+
+    // a gap in the slots
+    ops.push_back(write_entry(tg, 0, "t", "a", "A"));
+    ops.push_back(write_entry(tg, 2, "t", "b", "B"));
+    ASSERT_FALSE(parse(batch_entry(tg, 0, ops), tg, &parsed));
+
+    // an operation of another transaction
+    ops.clear();
+    ops.push_back(write_entry(tg, 0, "t", "a", "A"));
+    ops.push_back(write_entry(make_tg(2), 1, "t", "b", "B"));
+    ASSERT_FALSE(parse(batch_entry(tg, 0, ops), tg, &parsed));
+
+    // a batch does not start where it claims to
+    ops.clear();
+    ops.push_back(write_entry(tg, 1, "t", "a", "A"));
+    ASSERT_FALSE(parse(batch_entry(tg, 0, ops), tg, &parsed));
+
+    // only reads and writes may be batched
+    ops.clear();
+    ops.push_back(write_entry(tg, 0, "t", "a", "A"));
+    std::string prepare;
+    e::packer pa(&prepare);
+    pa = pa << LOG_ENTRY_TX_PREPARE << tg << uint64_t(1);
+    ops.push_back(prepare);
+    ASSERT_FALSE(parse(batch_entry(tg, 0, ops), tg, &parsed));
+
+    // trailing bytes inside an operation
+    ops.clear();
+    ops.push_back(write_entry(tg, 0, "t", "a", "A") + "x");
+    ASSERT_FALSE(parse(batch_entry(tg, 0, ops), tg, &parsed));
+
+    // a truncated batch
+    ops.clear();
+    ops.push_back(write_entry(tg, 0, "t", "a", "A"));
+    ops.push_back(write_entry(tg, 1, "t", "b", "B"));
+    std::string entry = batch_entry(tg, 0, ops);
+    entry.resize(entry.size() - 1);
+    ASSERT_FALSE(parse(entry, tg, &parsed));
+}
+
+// A batch written to the durable log comes back from replay intact, next
+// to the single-operation entries around it.
+TEST(BatchEntry, ReplayFromDurableLog)
+{
+    const std::string dir = temp_dir();
+    ASSERT_FALSE(dir.empty());
+    const transaction_group tg = make_tg(7);
+    std::vector<std::string> written;
+    written.push_back(write_entry(tg, 0, "table", "single", "S"));
+    std::vector<std::string> ops;
+
+    for (uint64_t i = 0; i < 16; ++i)
+    {
+        const std::string key(1, 'a' + i);
+        ops.push_back(write_entry(tg, 1 + i, "table", key.c_str(), "value"));
+    }
+
+    written.push_back(batch_entry(tg, 1, ops));
+    written.push_back(read_entry(tg, 17, "table", "single", 9));
+
+    {
+        durable_log log;
+        ASSERT_TRUE(log.open(dir, 2));
+        int64_t recno = -1;
+
+        for (size_t i = 0; i < written.size(); ++i)
+        {
+            recno = log.append(written[i].data(), written[i].size());
+            ASSERT_GE(recno, 0);
+        }
+
+        int64_t bound = -1;
+
+        while (bound <= recno && log.error() == 0)
+        {
+            bound = log.wait(bound);
+        }
+
+        log.close();
+    }
+
+    replayed r;
+
+    {
+        durable_log log;
+        ASSERT_TRUE(log.open(dir, 2));
+        ASSERT_EQ(log.replay(replay_one, &r), int64_t(written.size()));
+        log.close();
+    }
+
+    ASSERT_EQ(r.entries.size(), written.size());
+
+    for (size_t i = 0; i < written.size(); ++i)
+    {
+        ASSERT_TRUE(r.entries[i] == written[i]);
+    }
+
+    std::vector<batch_operation> parsed;
+    ASSERT_TRUE(parse(r.entries[1], tg, &parsed));
+    ASSERT_EQ(parsed.size(), ops.size());
+
+    for (size_t i = 0; i < parsed.size(); ++i)
+    {
+        const std::string key(1, 'a' + i);
+        ASSERT_EQ(parsed[i].type, LOG_ENTRY_TX_WRITE);
+        ASSERT_EQ(parsed[i].seqno, 1 + i);
+        ASSERT_TRUE(parsed[i].key == e::slice(key));
+        ASSERT_TRUE(parsed[i].value == e::slice("value"));
+    }
+
+    remove_dir(dir);
+}
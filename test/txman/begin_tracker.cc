@@ -0,0 +1,127 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+#include <vector>
+
+// consus
+#include "txman/begin_tracker.h"
+#include "test/th.h"
+
+using namespace consus;
+
+static transaction_group
+make_tg(uint64_t x)
+{
+    return transaction_group(transaction_id(paxos_group_id(x), x, x));
+}
+
+// stands in for the daemon's dispositions
+static bool
+in_set(void* p, const transaction_group& tg)
+{
+    std::vector<transaction_group>* v = static_cast<std::vector<transaction_group>*>(p);
+    return std::find(v->begin(), v->end(), tg) != v->end();
+}
+
+TEST(BeginTracker, EmptyIsNow)
+{
+    begin_tracker bt;
+    std::vector<transaction_group> done;
+    std::vector<transaction_group> expired;
+    ASSERT_EQ(bt.low_water(1000, 0, in_set, &done, &expired), 1000U);
+    ASSERT_TRUE(expired.empty());
+}
+
+TEST(BeginTracker, FirstBeginSticks)
+{
+    begin_tracker bt;
+    std::vector<transaction_group> done;
+    std::vector<transaction_group> expired;
+    bt.track(make_tg(1), 100);
+    // a replayed or retransmitted begin doesn't move it
+    bt.track(make_tg(1), 500);
+    ASSERT_EQ(bt.low_water(1000, 0, in_set, &done, &expired), 100U);
+    ASSERT_EQ(bt.size(), 1U);
+}
+
+TEST(BeginTracker, ResolvedGroupsReleaseTheMark)
+{
+    begin_tracker bt;
+    std::vector<transaction_group> done;
+    std::vector<transaction_group> expired;
+    bt.track(make_tg(1), 100);
+    bt.track(make_tg(2), 200);
+    bt.track(make_tg(3), 300);
+    ASSERT_EQ(bt.low_water(1000, 0, in_set, &done, &expired), 100U);
+    done.push_back(make_tg(1));
+    ASSERT_EQ(bt.low_water(1000, 0, in_set, &done, &expired), 200U);
+    done.push_back(make_tg(3));
+    ASSERT_EQ(bt.low_water(1000, 0, in_set, &done, &expired), 200U);
+    done.push_back(make_tg(2));
+    ASSERT_EQ(bt.low_water(2000, 0, in_set, &done, &expired), 2000U);
+    ASSERT_EQ(bt.size(), 0U);
+    ASSERT_TRUE(expired.empty());
+}
+
+TEST(BeginTracker, UnresolvedGroupsExpire)
+{
+    begin_tracker bt;
+    std::vector<transaction_group> done;
+    std::vector<transaction_group> expired;
+    // never learns its outcome, as with a group seen only through a commit
+    // record, or one replayed without a disposition
+    bt.track(make_tg(1), 100);
+    bt.track(make_tg(2), 900);
+    ASSERT_EQ(bt.low_water(1000, 50, in_set, &done, &expired), 100U);
+    ASSERT_TRUE(expired.empty());
+    ASSERT_EQ(bt.low_water(1500, 500, in_set, &done, &expired), 900U);
+    ASSERT_EQ(expired.size(), 1U);
+    ASSERT_TRUE(expired[0] == make_tg(1));
+    expired.clear();
+    // the mark keeps moving as time passes
+    ASSERT_EQ(bt.low_water(2500, 1500, in_set, &done, &expired), 2500U);
+    ASSERT_EQ(expired.size(), 1U);
+    ASSERT_TRUE(expired[0] == make_tg(2));
+    ASSERT_EQ(bt.size(), 0U);
+}
+
+TEST(BeginTracker, BeginUntilResolved)
+{
+    begin_tracker bt;
+    std::vector<transaction_group> done;
+    std::vector<transaction_group> expired;
+    uint64_t timestamp = 0;
+    ASSERT_FALSE(bt.begin(make_tg(1), &timestamp));
+    bt.track(make_tg(1), 100);
+    ASSERT_TRUE(bt.begin(make_tg(1), &timestamp));
+    ASSERT_EQ(timestamp, 100U);
+    done.push_back(make_tg(1));
+    bt.low_water(1000, 0, in_set, &done, &expired);
+    ASSERT_FALSE(bt.begin(make_tg(1), &timestamp));
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// POSIX
+#include <ftw.h>
+
+// STL
+#include <string>
+
+// consus
+#include "txman/durable_log.h"
+#include "test/th.h"
+
+using namespace consus;
+
+static int
+remove_one(const char* path, const struct stat*, int, struct FTW*)
+{
+    return remove(path);
+}
+
+// a fresh directory, removed with everything in it when this goes out of
+// scope, failed assertion or not
+class scratch_dir
+{
+    public:
+        scratch_dir()
+            : m_path()
+        {
+            char buf[] = "/tmp/consus-durable-log-XXXXXX";
+            char* dir = mkdtemp(buf);
+            m_path = dir ? std::string(dir) : std::string();
+        }
+        ~scratch_dir() throw ()
+        {
+            if (!m_path.empty())
+            {
+                nftw(m_path.c_str(), remove_one, 16, FTW_DEPTH|FTW_PHYS);
+            }
+        }
+
+    public:
+        const std::string& path() const { return m_path; }
+
+    private:
+        std::string m_path;
+
+    private:
+        scratch_dir(const scratch_dir&);
+        scratch_dir& operator = (const scratch_dir&);
+};
+
+static void
+replay_none(void*, int64_t, const unsigned char*, size_t)
+{
+}
+
+// open the log, append "count" records, and close it once they're durable;
+// every segment it wrote is sealed when the log is next opened
+static void
+append_session(const std::string& dir, unsigned count)
+{
+    durable_log log;
+    ASSERT_TRUE(log.open(dir, 2));
+    ASSERT_GE(log.replay(replay_none, NULL), 0);
+    int64_t recno = -1;
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        recno = log.append("record", 6);
+        ASSERT_GE(recno, 0);
+    }
+
+    int64_t bound = -1;
+
+    while (bound <= recno && log.error() == 0)
+    {
+        bound = log.wait(bound);
+    }
+
+    ASSERT_EQ(log.error(), 0);
+    log.close();
+}
+
+TEST(DurableLog, TruncationLimit)
+{
+    scratch_dir dir;
+    ASSERT_FALSE(dir.path().empty());
+    append_session(dir.path(), 10);
+    append_session(dir.path(), 10);
+    durable_log log;
+    ASSERT_TRUE(log.open(dir.path(), 2));
+    ASSERT_EQ(log.replay(replay_none, NULL), 20);
+    // only whole segments go, and each session's last segment ends on its
+    // last record; records are numbered from 1
+    ASSERT_LT(log.truncation_limit(10), 1);
+    ASSERT_EQ(log.truncation_limit(11), 10);
+    ASSERT_EQ(log.truncation_limit(20), 10);
+    ASSERT_EQ(log.truncation_limit(21), 20);
+
+    for (int64_t lb = 0; lb <= 21; ++lb)
+    {
+        ASSERT_LT(log.truncation_limit(lb), lb);
+    }
+
+    log.close();
+}
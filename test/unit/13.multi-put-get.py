@@ -0,0 +1,35 @@
+import consus
+
+c = consus.Client()
+keys = ['key %d' % i for i in range(8)]
+
+# a multi-put is visible to single gets
+t = c.begin_transaction()
+assert t.multi_put('the table', [(k, 'multi ' + k) for k in keys])
+t.commit()
+
+t = c.begin_transaction()
+for k in keys:
+    assert t.get('the table', k) == 'multi ' + k
+t.commit()
+
+# single puts are visible to a multi-get, which reports absent keys as None
+t = c.begin_transaction()
+for k in keys[:4]:
+    assert t.put('the table', k, 'single ' + k)
+t.commit()
+
+t = c.begin_transaction()
+values = t.multi_get('the table', keys + ['absent'])
+assert values[:4] == ['single ' + k for k in keys[:4]]
+assert values[4:8] == ['multi ' + k for k in keys[4:]]
+assert values[8] is None
+t.commit()
+
+# mixing the two within one transaction sees the transaction's own writes
+t = c.begin_transaction()
+assert t.multi_put('the table', [(keys[0], 'mixed')])
+assert t.get('the table', keys[0]) == 'mixed'
+assert t.put('the table', keys[1], 'mixed')
+assert t.multi_get('the table', keys[:2]) == ['mixed', 'mixed']
+t.commit()
@@ -0,0 +1,29 @@
+import consus
+
+c = consus.Client()
+
+t = c.begin_transaction()
+assert t.put('the table', 'committed', 'before')
+t.commit()
+
+# the transaction reads its own buffered writes, singly and in a multi-get
+t = c.begin_buffered_transaction()
+assert t.put('the table', 'the key', 'first')
+assert t.put('the table', 'the key', 'second')
+assert t.get('the table', 'the key') == 'second'
+assert t.multi_put('the table', [('a', 'A'), ('b', 'B')])
+assert t.multi_get('the table', ['a', 'b']) == ['A', 'B']
+assert t.multi_get('the table', ['a', 'committed', 'absent', 'the key']) == ['A', 'before', None, 'second']
+
+# nothing is shipped until commit
+u = c.begin_transaction()
+assert u.get('the table', 'a') is None
+u.commit()
+
+t.commit()
+
+# the writes arrive with the commit, last write winning
+t = c.begin_transaction()
+assert t.get('the table', 'the key') == 'second'
+assert t.multi_get('the table', ['a', 'b', 'committed']) == ['A', 'B', 'before']
+t.commit()
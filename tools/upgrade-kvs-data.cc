@@ -0,0 +1,473 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdlib.h>
+
+// POSIX
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// STL
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// LevelDB
+#include <leveldb/comparator.h>
+#include <leveldb/db.h>
+#include <leveldb/filter_policy.h>
+#include <leveldb/write_batch.h>
+
+// po6
+#include <po6/errno.h>
+#include <po6/path.h>
+
+// e
+#include <e/endian.h>
+#include <e/popt.h>
+#include <e/serialization.h>
+
+// consus
+#include "kvs/leveldb_encoding.h"
+#include "kvs/leveldb_filter.h"
+
+// Rewrites a key value store's data directory from the original key format,
+// which needed a custom comparator, into the bytewise format of
+// kvs/leveldb_encoding.h.  The daemon must not be running.
+//
+// The new database is built in a subdirectory and moved into place only after
+// it is complete, so an interrupted upgrade can simply be run again.  Data
+// already in the bytewise format but written before object markers existed
+// gets its markers added in place.
+
+#define UPGRADE_DIR "upgrade-kvs-data"
+#define UPGRADE_BATCH_BYTES (4ULL << 20)
+
+// the comparator the data was written with; LevelDB checks it by name
+struct legacy_comparator : public leveldb::Comparator
+{
+    legacy_comparator() {}
+    virtual ~legacy_comparator() throw () {}
+    virtual int Compare(const leveldb::Slice& a, const leveldb::Slice& b) const;
+    virtual const char* Name() const { return "ConsusComparator"; }
+    virtual void FindShortestSeparator(std::string*,
+                                       const leveldb::Slice&) const {}
+    virtual void FindShortSuccessor(std::string*) const {}
+};
+
+static const leveldb::Slice legacy_lock_prefix("\x0bconsus.lock", 12);
+
+int
+legacy_comparator :: Compare(const leveldb::Slice& a, const leveldb::Slice& b) const
+{
+    if (a.starts_with(legacy_lock_prefix) && b.starts_with(legacy_lock_prefix))
+    {
+        return a.compare(b);
+    }
+    else if (a.starts_with(legacy_lock_prefix))
+    {
+        return -1;
+    }
+    else if (b.starts_with(legacy_lock_prefix))
+    {
+        return 1;
+    }
+
+    if (a.size() < 8 || b.size() < 8)
+    {
+        return -1;
+    }
+
+    leveldb::Slice x(a.data(), a.size() - 8);
+    leveldb::Slice y(b.data(), b.size() - 8);
+    int cmp = x.compare(y);
+
+    if (cmp != 0)
+    {
+        return cmp < 0 ? -1 : 1;
+    }
+
+    uint64_t at;
+    uint64_t bt;
+    e::unpack64be(a.data() + a.size() - 8, &at);
+    e::unpack64be(b.data() + b.size() - 8, &bt);
+
+    if (at > bt)
+    {
+        return -1;
+    }
+    if (at < bt)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+static bool
+exists(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+static bool
+convert_key(const leveldb::Slice& old, std::string* out)
+{
+    e::unpacker up(old.data(), old.size());
+    e::slice table;
+
+    if (old.starts_with(legacy_lock_prefix))
+    {
+        e::slice lock;
+        up = up >> lock >> table;
+
+        if (up.error())
+        {
+            return false;
+        }
+
+        e::slice key(old.data() + old.size() - up.remain(), up.remain());
+        *out = consus::leveldb_lock_key(table, key);
+        return true;
+    }
+
+    up = up >> table;
+
+    if (up.error() || up.remain() < sizeof(uint64_t))
+    {
+        return false;
+    }
+
+    e::slice key(old.data() + old.size() - up.remain(), up.remain() - sizeof(uint64_t));
+    uint64_t timestamp;
+    e::unpack64be(old.data() + old.size() - sizeof(uint64_t), &timestamp);
+    *out = consus::leveldb_data_key(table, key, timestamp);
+    return true;
+}
+
+static bool
+write_batch(leveldb::DB* db, leveldb::WriteBatch* batch, bool sync)
+{
+    leveldb::WriteOptions opts;
+    opts.sync = sync;
+    leveldb::Status st = db->Write(opts, batch);
+
+    if (!st.ok())
+    {
+        std::cerr << "could not write upgraded data: " << st.ToString() << std::endl;
+        return false;
+    }
+
+    batch->Clear();
+    return true;
+}
+
+// add the marker for "key" unless the previous key already did
+static void
+add_marker(const std::string& key, std::string* last, leveldb::WriteBatch* batch, size_t* batch_sz)
+{
+    const size_t sz = consus::leveldb_object_prefix(key);
+
+    if (sz == key.size() || last->compare(0, std::string::npos, key, 0, sz) == 0)
+    {
+        return;
+    }
+
+    last->assign(key.data(), sz);
+    batch->Put(*last, leveldb::Slice());
+    *batch_sz += last->size();
+}
+
+static bool
+convert(const std::string& data, const std::string& upgrade, bool* legacy, uint64_t* count)
+{
+    legacy_comparator cmp;
+    leveldb::Options old_opts;
+    old_opts.comparator = &cmp;
+    leveldb::DB* old_db = NULL;
+    leveldb::Status st = leveldb::DB::Open(old_opts, data, &old_db);
+    *legacy = true;
+
+    if (!st.ok() && st.ToString().find("comparator") != std::string::npos)
+    {
+        *legacy = false;
+        return false;
+    }
+    else if (!st.ok())
+    {
+        std::cerr << "could not open " << data << ": " << st.ToString() << std::endl;
+        return false;
+    }
+
+    std::auto_ptr<leveldb::DB> old_guard(old_db);
+    // anything here is left over from an interrupted run
+    leveldb::DestroyDB(upgrade, leveldb::Options());
+    consus::leveldb_filter bf(10);
+    leveldb::Options new_opts;
+    new_opts.create_if_missing = true;
+    new_opts.error_if_exists = true;
+    new_opts.filter_policy = &bf;
+    leveldb::DB* new_db = NULL;
+    st = leveldb::DB::Open(new_opts, upgrade, &new_db);
+
+    if (!st.ok())
+    {
+        std::cerr << "could not create " << upgrade << ": " << st.ToString() << std::endl;
+        return false;
+    }
+
+    std::auto_ptr<leveldb::DB> new_guard(new_db);
+    leveldb::ReadOptions ropts;
+    ropts.fill_cache = false;
+    std::auto_ptr<leveldb::Iterator> it(old_db->NewIterator(ropts));
+    leveldb::WriteBatch batch;
+    size_t batch_sz = 0;
+    std::string key;
+    std::string last;
+    *count = 0;
+
+    for (it->SeekToFirst(); it->Valid(); it->Next())
+    {
+        if (!convert_key(it->key(), &key))
+        {
+            std::cerr << "corrupt key in " << data << "; refusing to upgrade" << std::endl;
+            return false;
+        }
+
+        batch.Put(key, it->value());
+        batch_sz += key.size() + it->value().size();
+        add_marker(key, &last, &batch, &batch_sz);
+        ++*count;
+
+        if (batch_sz >= UPGRADE_BATCH_BYTES)
+        {
+            if (!write_batch(new_db, &batch, false))
+            {
+                return false;
+            }
+
+            batch_sz = 0;
+        }
+    }
+
+    if (!it->status().ok())
+    {
+        std::cerr << "could not read " << data << ": " << it->status().ToString() << std::endl;
+        return false;
+    }
+
+    // the last write is synchronous and makes everything before it durable
+    batch.Put(consus::leveldb_meta_key("markers"), leveldb::Slice());
+    return write_batch(new_db, &batch, true);
+}
+
+static bool
+add_markers(const std::string& data, uint64_t* count)
+{
+    consus::leveldb_filter bf(10);
+    leveldb::Options opts;
+    opts.filter_policy = &bf;
+    leveldb::DB* db = NULL;
+    leveldb::Status st = leveldb::DB::Open(opts, data, &db);
+
+    if (!st.ok())
+    {
+        std::cerr << "could not open " << data << ": " << st.ToString() << std::endl;
+        return false;
+    }
+
+    std::auto_ptr<leveldb::DB> guard(db);
+    leveldb::ReadOptions ropts;
+    ropts.fill_cache = false;
+    // the iterator reads a snapshot, so it never sees the markers going in
+    std::auto_ptr<leveldb::Iterator> it(db->NewIterator(ropts));
+    leveldb::WriteBatch batch;
+    size_t batch_sz = 0;
+    std::string last;
+    *count = 0;
+
+    for (it->SeekToFirst(); it->Valid(); it->Next())
+    {
+        const size_t before = batch_sz;
+        add_marker(it->key().ToString(), &last, &batch, &batch_sz);
+        *count += batch_sz > before ? 1 : 0;
+
+        if (batch_sz >= UPGRADE_BATCH_BYTES)
+        {
+            if (!write_batch(db, &batch, false))
+            {
+                return false;
+            }
+
+            batch_sz = 0;
+        }
+    }
+
+    if (!it->status().ok())
+    {
+        std::cerr << "could not read " << data << ": " << it->status().ToString() << std::endl;
+        return false;
+    }
+
+    batch.Put(consus::leveldb_meta_key("markers"), leveldb::Slice());
+    return write_batch(db, &batch, true);
+}
+
+static bool
+move_into_place(const std::string& data, const std::string& upgrade)
+{
+    DIR* dir = opendir(upgrade.c_str());
+
+    if (!dir)
+    {
+        std::cerr << "could not open " << upgrade << ": " << po6::strerror(errno) << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> names;
+    struct dirent* ent;
+
+    while ((ent = readdir(dir)))
+    {
+        std::string name(ent->d_name);
+
+        if (name != "." && name != ".." && name != "CURRENT")
+        {
+            names.push_back(name);
+        }
+    }
+
+    closedir(dir);
+    // CURRENT goes last so that the data directory has no database until
+    // every file it refers to is present
+    names.push_back("CURRENT");
+
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        std::string from(po6::path::join(upgrade, names[i]));
+        std::string to(po6::path::join(data, names[i]));
+
+        if (!exists(from))
+        {
+            continue;
+        }
+
+        if (rename(from.c_str(), to.c_str()) < 0)
+        {
+            std::cerr << "could not move " << from << " to " << to << ": "
+                      << po6::strerror(errno) << std::endl;
+            return false;
+        }
+    }
+
+    if (rmdir(upgrade.c_str()) < 0)
+    {
+        std::cerr << "could not remove " << upgrade << ": " << po6::strerror(errno) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int
+main(int argc, const char* argv[])
+{
+    const char* data = ".";
+    e::argparser ap;
+    ap.autohelp();
+    ap.option_string("[OPTIONS]");
+    ap.arg().name('D', "data")
+            .description("upgrade the key value store data in this directory (default: .)")
+            .metavar("dir").as_string(&data);
+
+    if (!ap.parse(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (ap.args_sz() != 0)
+    {
+        std::cerr << "consus-upgrade-kvs-data takes zero positional arguments\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    const std::string upgrade(po6::path::join(data, UPGRADE_DIR));
+    const bool have_old = exists(po6::path::join(data, "CURRENT"));
+    const bool have_new = exists(po6::path::join(upgrade, "CURRENT"));
+
+    if (have_old)
+    {
+        bool legacy = true;
+        uint64_t count = 0;
+
+        if (!convert(data, upgrade, &legacy, &count) && legacy)
+        {
+            return EXIT_FAILURE;
+        }
+        else if (!legacy)
+        {
+            if (!add_markers(data, &count))
+            {
+                return EXIT_FAILURE;
+            }
+
+            std::cout << "added markers for " << count << " objects in " << data << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        std::cout << "converted " << count << " keys" << std::endl;
+        leveldb::Status st = leveldb::DestroyDB(data, leveldb::Options());
+
+        if (!st.ok())
+        {
+            std::cerr << "could not remove the old data: " << st.ToString() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    else if (!have_new)
+    {
+        std::cerr << "consus-upgrade-kvs-data: no key value store data in " << data << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // if there was no old database, a previous run died after removing it
+    if (!move_into_place(data, upgrade))
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "upgraded " << data << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// consus
+#include "txman/batch_entry.h"
+
+using consus::batch_operation;
+
+batch_operation :: batch_operation()
+    : type(LOG_ENTRY_NOP)
+    , seqno(0)
+    , table()
+    , key()
+    , value()
+    , timestamp(0)
+{
+}
+
+batch_operation :: ~batch_operation() throw ()
+{
+}
+
+bool
+consus :: parse_batch_entry(e::unpacker up, const transaction_group& tg, uint64_t seqno,
+                            std::vector<batch_operation>* ops)
+{
+    ops->clear();
+
+    while (!up.error() && up.remain())
+    {
+        e::slice entry;
+        up = up >> entry;
+
+        if (up.error())
+        {
+            return false;
+        }
+
+        batch_operation op;
+        transaction_group etg;
+        e::unpacker eup(entry);
+        eup = eup >> op.type >> etg >> op.seqno;
+
+        if (eup.error() || etg != tg || op.seqno != seqno + ops->size())
+        {
+            return false;
+        }
+
+        if (op.type == LOG_ENTRY_TX_READ)
+        {
+            eup = eup >> op.table >> op.key >> op.timestamp;
+        }
+        else if (op.type == LOG_ENTRY_TX_WRITE)
+        {
+            eup = eup >> op.table >> op.key >> op.value;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (eup.error() || eup.remain())
+        {
+            return false;
+        }
+
+        ops->push_back(op);
+    }
+
+    return !up.error() && !ops->empty();
+}
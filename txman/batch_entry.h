@@ -0,0 +1,74 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_batch_entry_h_
+#define consus_txman_batch_entry_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// e
+#include <e/serialization.h>
+#include <e/slice.h>
+
+// consus
+#include "namespace.h"
+#include "common/transaction_group.h"
+#include "txman/log_entry_t.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// One read or write recovered from a LOG_ENTRY_TX_BATCH entry.  The slices
+// point into the entry that was parsed.
+struct batch_operation
+{
+    batch_operation();
+    ~batch_operation() throw ();
+
+    log_entry_t type;
+    uint64_t seqno;
+    e::slice table;
+    e::slice key;
+    // LOG_ENTRY_TX_WRITE only
+    e::slice value;
+    // LOG_ENTRY_TX_READ only
+    uint64_t timestamp;
+};
+
+// Split the body of a batch entry (what follows its type, group and seqno)
+// into its operations.  A batch holds only reads and writes of "tg" that
+// fill consecutive slots from "seqno"; anything else fails the parse.
+bool
+parse_batch_entry(e::unpacker up, const transaction_group& tg, uint64_t seqno,
+                  std::vector<batch_operation>* ops);
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_batch_entry_h_
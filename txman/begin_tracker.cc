@@ -0,0 +1,107 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+
+// consus
+#include "txman/begin_tracker.h"
+
+using consus::begin_tracker;
+
+begin_tracker :: begin_tracker()
+    : m_mtx()
+    , m_begins()
+{
+}
+
+begin_tracker :: ~begin_tracker() throw ()
+{
+}
+
+void
+begin_tracker :: track(const transaction_group& tg, uint64_t timestamp)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (m_begins.find(tg) == m_begins.end())
+    {
+        m_begins[tg] = timestamp;
+    }
+}
+
+bool
+begin_tracker :: begin(const transaction_group& tg, uint64_t* timestamp)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    begin_map_t::iterator it = m_begins.find(tg);
+
+    if (it == m_begins.end())
+    {
+        return false;
+    }
+
+    *timestamp = it->second;
+    return true;
+}
+
+uint64_t
+begin_tracker :: low_water(uint64_t now, uint64_t expire_before,
+                           bool (*resolved)(void*, const transaction_group&), void* p,
+                           std::vector<transaction_group>* expired)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    uint64_t lw = now;
+
+    for (begin_map_t::iterator it = m_begins.begin();
+            it != m_begins.end(); )
+    {
+        if (resolved(p, it->first))
+        {
+            m_begins.erase(it++);
+        }
+        else if (it->second < expire_before)
+        {
+            expired->push_back(it->first);
+            m_begins.erase(it++);
+        }
+        else
+        {
+            lw = std::min(lw, it->second);
+            ++it;
+        }
+    }
+
+    return lw;
+}
+
+size_t
+begin_tracker :: size()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_begins.size();
+}
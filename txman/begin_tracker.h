@@ -0,0 +1,82 @@
+// Copyright (c) 2015-2016, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_begin_tracker_h_
+#define consus_txman_begin_tracker_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/compat.h>
+
+// consus
+#include "namespace.h"
+#include "common/transaction_group.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The begin timestamp of each transaction group this server takes part in,
+// until the group is resolved.  The earliest is the low water mark this
+// server reports to the coordinator.
+class begin_tracker
+{
+    public:
+        begin_tracker();
+        ~begin_tracker() throw ();
+
+    public:
+        void track(const transaction_group& tg, uint64_t timestamp);
+        // the begin timestamp of "tg", if it is tracked
+        bool begin(const transaction_group& tg, uint64_t* timestamp);
+        // Forget every group "resolved" reports done, and every group that
+        // began before "expire_before", which is appended to "expired".
+        // Returns the earliest begin among the rest, or "now" if none remain.
+        uint64_t low_water(uint64_t now, uint64_t expire_before,
+                           bool (*resolved)(void*, const transaction_group&), void* p,
+                           std::vector<transaction_group>* expired);
+        size_t size();
+
+    private:
+        typedef e::compat::unordered_map<transaction_group, uint64_t, e::compat::hash<transaction_group> > begin_map_t;
+        po6::threads::mutex m_mtx;
+        begin_map_t m_begins;
+
+    private:
+        begin_tracker(const begin_tracker&);
+        begin_tracker& operator = (const begin_tracker&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_begin_tracker_h_
@@ -26,9 +26,11 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 // STL
+#include <algorithm>
 #include <set>
 
 // consus
+#include "common/constants.h"
 #include "common/txman_configuration.h"
 #include "txman/configuration.h"
 
@@ -38,10 +40,16 @@ configuration :: configuration()
     : m_cluster()
     , m_version()
     , m_flags(0)
+    , m_low_water(0)
     , m_dcs()
     , m_txmans()
     , m_paxos_groups()
     , m_kvss()
+    , m_checkpoint()
+    , m_incomplete(false)
+    , m_patches()
+    , m_rings()
+    , m_ring_indices()
 {
 }
 
@@ -219,14 +227,116 @@ configuration :: choose_kvs(data_center_id dc) const
     return comm_id();
 }
 
+consus::comm_id
+configuration :: choose_kvs(data_center_id dc,
+                            const e::slice& table,
+                            const e::slice& key,
+                            uint64_t spread) const
+{
+    for (size_t i = 0; i < m_ring_indices.size(); ++i)
+    {
+        if (m_ring_indices[i]->dc() != dc)
+        {
+            continue;
+        }
+
+        const comm_id* owners;
+        const comm_id* next_owners;
+        unsigned num = m_ring_indices[i]->replicas(ring::partition_index(table, key),
+                                                   &owners, &next_owners);
+        num = std::min(num, unsigned(CONSUS_KVS_REPLICATION_FACTOR));
+
+        if (num > 0)
+        {
+            return owners[spread % num];
+        }
+    }
+
+    return choose_kvs(dc);
+}
+
+bool
+configuration :: apply_patches(const configuration& base)
+{
+    if (!m_incomplete ||
+        base.m_incomplete ||
+        base.m_version != m_checkpoint ||
+        !patch_rings(base.m_rings, m_patches, &m_rings))
+    {
+        return false;
+    }
+
+    m_ring_indices.resize(m_rings.size());
+
+    for (size_t i = 0; i < m_rings.size(); ++i)
+    {
+        if (m_rings[i] == base.m_rings[i])
+        {
+            m_ring_indices[i] = base.m_ring_indices[i];
+        }
+        else
+        {
+            e::compat::shared_ptr<ring_index> ri(new ring_index());
+            ri->init(*m_rings[i]);
+            m_ring_indices[i] = ri;
+        }
+    }
+
+    m_patches.clear();
+    m_incomplete = false;
+    return true;
+}
+
+void
+configuration :: share(const configuration& other)
+{
+    m_cluster = other.m_cluster;
+    m_version = other.m_version;
+    m_flags = other.m_flags;
+    m_low_water = other.m_low_water;
+    m_dcs = other.m_dcs;
+    m_txmans = other.m_txmans;
+    m_paxos_groups = other.m_paxos_groups;
+    m_kvss = other.m_kvss;
+    m_checkpoint = other.m_checkpoint;
+    m_incomplete = other.m_incomplete;
+    m_patches = other.m_patches;
+    m_rings = other.m_rings;
+    m_ring_indices = other.m_ring_indices;
+}
+
+void
+configuration :: index_rings()
+{
+    m_ring_indices.resize(m_rings.size());
+
+    for (size_t i = 0; i < m_rings.size(); ++i)
+    {
+        e::compat::shared_ptr<ring_index> ri(new ring_index());
+        ri->init(*m_rings[i]);
+        m_ring_indices[i] = ri;
+    }
+}
+
 std::string
 configuration :: dump() const
 {
-    return txman_configuration(m_cluster, m_version, m_flags, m_dcs, m_txmans, m_paxos_groups, m_kvss);
+    return txman_configuration(m_cluster, m_version, m_flags, m_low_water, m_dcs, m_txmans, m_paxos_groups, m_kvss, m_rings);
 }
 
 e::unpacker
 consus :: operator >> (e::unpacker up, configuration& c)
 {
-    return txman_configuration(up, &c.m_cluster, &c.m_version, &c.m_flags, &c.m_dcs, &c.m_txmans, &c.m_paxos_groups, &c.m_kvss);
+    up = txman_configuration(up, &c.m_cluster, &c.m_version, &c.m_flags, &c.m_low_water,
+                             &c.m_dcs, &c.m_txmans, &c.m_paxos_groups, &c.m_kvss,
+                             &c.m_checkpoint, &c.m_rings, &c.m_patches);
+    c.m_incomplete = c.m_checkpoint != c.m_version;
+    c.m_ring_indices.clear();
+
+    if (!up.error() && !c.m_incomplete)
+    {
+        c.index_rings();
+    }
+
+    return up;
 }
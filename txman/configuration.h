@@ -34,6 +34,9 @@
 #include "common/ids.h"
 #include "common/kvs.h"
 #include "common/paxos_group.h"
+#include "common/ring.h"
+#include "common/ring_index.h"
+#include "common/ring_patch.h"
 #include "common/txman.h"
 #include "common/txman_state.h"
 
@@ -49,7 +52,22 @@ class configuration
     public:
         cluster_id cluster() const { return m_cluster; }
         version_id version() const { return m_version; }
-        uint64_t timestamp_bottom() const { return 0; /* XXX */ }
+        // every transaction begins above this timestamp, and key-value stores
+        // may discard versions it shadows
+        uint64_t timestamp_bottom() const { return m_low_water; }
+
+    // delta encoding
+    public:
+        // the version whose rings this configuration was encoded against
+        version_id checkpoint() const { return m_checkpoint; }
+        // true until a configuration sent as patches has had them applied
+        bool incomplete() const { return m_incomplete; }
+        // Apply this configuration's patches to "base", which must be its
+        // checkpoint.  Rings without changes keep the ring and ring_index of
+        // "base".
+        bool apply_patches(const configuration& base);
+        // Make this a copy of "other" that shares its rings and indices.
+        void share(const configuration& other);
 
     // transaction managers
     public:
@@ -69,22 +87,36 @@ class configuration
     // key-value stores
     public:
         comm_id choose_kvs(data_center_id dc) const;
+        // choose one of the replicas for (table, key) within dc; "spread"
+        // picks among them so that load is shared across the replica set
+        comm_id choose_kvs(data_center_id dc,
+                           const e::slice& table,
+                           const e::slice& key,
+                           uint64_t spread) const;
 
     // debug/internal
     public:
         std::string dump() const;
 
     private:
+        typedef e::compat::shared_ptr<const ring_index> ring_index_ptr;
         friend e::unpacker operator >> (e::unpacker, configuration& s);
+        void index_rings();
 
     private:
         cluster_id m_cluster;
         version_id m_version;
         uint64_t m_flags;
+        uint64_t m_low_water;
         std::vector<data_center> m_dcs;
         std::vector<txman_state> m_txmans;
         std::vector<paxos_group> m_paxos_groups;
         std::vector<kvs> m_kvss;
+        version_id m_checkpoint;
+        bool m_incomplete;
+        std::vector<ring_patch> m_patches;
+        std::vector<ring_ptr> m_rings;
+        std::vector<ring_index_ptr> m_ring_indices;
 
     private:
         configuration(const configuration& other);
@@ -51,6 +51,7 @@
 #include <po6/errno.h>
 #include <po6/io/fd.h>
 #include <po6/path.h>
+#include <po6/time.h>
 
 // e
 #include <e/atomic.h>
@@ -65,6 +66,7 @@
 // consus
 #include "common/coordinator_returncode.h"
 #include "common/macros.h"
+#include "common/nonce.h"
 #include "txman/daemon.h"
 #include "txman/log_entry_t.h"
 
@@ -87,6 +89,20 @@ using consus::daemon;
         } \
     } while (0)
 
+// how many send_when_durable latencies debug_dump summarizes
+#define DURABLE_LATENCY_SAMPLES 4096
+
+// resends wait five seconds; the inner wheel covers 2.56s at 10ms a tick, and
+// the outer wheel everything out to about eleven minutes
+#define PUMP_TICK (10 * PO6_MILLIS)
+#define PUMP_SLOTS 256
+
+// a group that never learns its outcome here (e.g. one this server only saw
+// through a commit record, or one abandoned before a restart) must not pin the
+// low water mark forever; past this age it's pushed to abort and let go, and
+// no one asks after its disposition any more
+#define BEGIN_EXPIRY (10 * 60 * PO6_SECONDS)
+
 uint32_t s_interrupts = 0;
 bool s_debug_dump = false;
 bool s_debug_mode = false;
@@ -116,18 +132,25 @@ struct daemon::coordinator_callback : public coordinator_link::callback
     virtual ~coordinator_callback() throw ();
     virtual std::string prefix() { return "txman"; }
     virtual bool new_config(const char* data, size_t data_sz);
+    virtual bool missing_checkpoint() { return m_missing_checkpoint; }
+    virtual bool new_checkpoint(const char* data, size_t data_sz);
     virtual bool has_id(comm_id id);
     virtual po6::net::location address(comm_id id);
     virtual bool is_steady_state(comm_id id);
 
     private:
         daemon* d;
+        // the most recent full configuration; deltas are applied to its rings
+        std::auto_ptr<configuration> m_checkpoint;
+        bool m_missing_checkpoint;
         coordinator_callback(const coordinator_callback&);
         coordinator_callback& operator = (const coordinator_callback&);
 };
 
 daemon :: coordinator_callback :: coordinator_callback(daemon* _d)
     : d(_d)
+    , m_checkpoint()
+    , m_missing_checkpoint(false)
 {
 }
 
@@ -165,6 +188,7 @@ daemon :: coordinator_callback :: new_config(const char* data, size_t data_sz)
     std::auto_ptr<configuration> c(new configuration());
     e::unpacker up(data, data_sz);
     up = up >> *c;
+    m_missing_checkpoint = false;
 
     if (up.error() || up.remain())
     {
@@ -172,6 +196,25 @@ daemon :: coordinator_callback :: new_config(const char* data, size_t data_sz)
         return false;
     }
 
+    if (!c->incomplete())
+    {
+        m_checkpoint.reset(new configuration());
+        m_checkpoint->share(*c);
+    }
+    else if (!m_checkpoint.get() || m_checkpoint->version() != c->checkpoint())
+    {
+        LOG(INFO) << "configuration " << c->version() << " needs checkpoint "
+                  << c->checkpoint() << "; fetching it from the coordinator";
+        m_missing_checkpoint = true;
+        return false;
+    }
+    else if (!c->apply_patches(*m_checkpoint))
+    {
+        LOG(ERROR) << "received a configuration that does not apply to checkpoint "
+                   << c->checkpoint();
+        return false;
+    }
+
     configuration* old_config = d->get_config();
     d->m_us.dc = c->get_data_center(d->m_us.id);
     e::atomic::store_ptr_release(&d->m_config, c.release());
@@ -205,6 +248,23 @@ daemon :: coordinator_callback :: new_config(const char* data, size_t data_sz)
     return true;
 }
 
+bool
+daemon :: coordinator_callback :: new_checkpoint(const char* data, size_t data_sz)
+{
+    std::auto_ptr<configuration> c(new configuration());
+    e::unpacker up(data, data_sz);
+    up = up >> *c;
+
+    if (up.error() || up.remain() || c->incomplete())
+    {
+        LOG(ERROR) << "received a bad configuration checkpoint";
+        return false;
+    }
+
+    m_checkpoint = c;
+    return true;
+}
+
 bool
 daemon :: coordinator_callback :: has_id(comm_id id)
 {
@@ -266,6 +326,16 @@ daemon :: daemon()
     , m_durable_up_to(-1)
     , m_durable_msgs()
     , m_durable_cbs()
+    , m_durable_latencies()
+    , m_durable_latencies_idx(0)
+    , m_log_refs_mtx()
+    , m_log_refs()
+    , m_disposition_log()
+    , m_carried_forward(-1)
+    , m_log_collected(0)
+    , m_begins()
+    , m_low_water_reported(0)
+    , m_pump_timers(PUMP_TICK, PUMP_SLOTS)
     , m_pumping_thread(po6::threads::make_obj_func(&daemon::pump, this))
 {
 }
@@ -286,7 +356,8 @@ daemon :: run(bool background,
               bool set_coordinator,
               const char* coordinator,
               const char* data_center,
-              unsigned threads)
+              unsigned threads,
+              unsigned log_segments)
 {
     if (!e::block_all_signals())
     {
@@ -310,7 +381,7 @@ daemon :: run(bool background,
         return EXIT_FAILURE;
     }
 
-    if (!m_log.open(data))
+    if (!m_log.open(data, log_segments))
     {
         LOG(ERROR) << "could not open log: " << po6::strerror(m_log.error());
         return EXIT_FAILURE;
@@ -361,6 +432,11 @@ daemon :: run(bool background,
 
     assert(get_config());
 
+    if (!replay_log())
+    {
+        return EXIT_FAILURE;
+    }
+
     if (!e::save_identity(po6::path::join(data, "TXMAN").c_str(), id, bind_to, rendezvous))
     {
         LOG(ERROR) << "could not save identity; exiting";
@@ -378,6 +454,27 @@ daemon :: run(bool background,
         t->start();
     }
 
+    // state rebuilt from the log could not talk to anyone until now
+    for (transaction_map_t::iterator it(&m_transactions); it.valid(); ++it)
+    {
+        transaction* xact = *it;
+        xact->externally_work_state_machine(this);
+    }
+
+    for (local_voter_map_t::iterator it(&m_local_voters); it.valid(); ++it)
+    {
+        local_voter* lv = *it;
+        lv->externally_work_state_machine(this);
+    }
+
+    for (global_voter_map_t::iterator it(&m_global_voters); it.valid(); ++it)
+    {
+        global_voter* gv = *it;
+        gv->externally_work_state_machine(this);
+    }
+
+    m_pumping_thread.start();
+
     while (e::atomic::increment_32_nobarrier(&s_interrupts, 0) == 0)
     {
         bool debug_mode = s_debug_mode;
@@ -423,6 +520,7 @@ daemon :: run(bool background,
         m_threads[i]->join();
     }
 
+    m_pumping_thread.join();
     m_log.close();
     m_durable_thread.join();
     LOG(ERROR) << "consus is gracefully shutting down";
@@ -534,6 +632,12 @@ daemon :: loop(size_t thread)
             case TXMAN_WRITE:
                 process_write(id, msg, up);
                 break;
+            case TXMAN_MULTI_READ:
+                process_multi_read(id, msg, up);
+                break;
+            case TXMAN_MULTI_WRITE:
+                process_multi_write(id, msg, up);
+                break;
             case TXMAN_COMMIT:
                 process_commit(id, msg, up);
                 break;
@@ -606,6 +710,8 @@ daemon :: loop(size_t thread)
             case KVS_WOUND_XACT:
             case KVS_MIGRATE_SYN:
             case KVS_MIGRATE_ACK:
+            case KVS_MIGRATE_PULL:
+            case KVS_MIGRATE_DATA:
             default:
                 LOG(INFO) << "received " << mt << " message which transaction-managers do not process";
                 break;
@@ -673,7 +779,8 @@ daemon :: process_unsafe_write(comm_id id, std::auto_ptr<e::buffer>, e::unpacker
     write_map_t::state_reference sr;
     kvs_write* kv = create_write(&sr);
     kv->callback_client(id, client_nonce);
-    const uint64_t timestamp = po6::wallclock_time();
+    configuration* c = get_config();
+    const uint64_t timestamp = std::max(po6::wallclock_time(), c->timestamp_bottom() + 1);
     kv->write(flags, table, key, timestamp, value, this);
 }
 
@@ -772,7 +879,9 @@ daemon :: process_begin(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
             return;
         }
 
-        uint64_t ts = po6::wallclock_time();
+        // a clock running behind the cluster must not begin a transaction
+        // beneath versions the key-value stores may have already discarded
+        uint64_t ts = std::max(po6::wallclock_time(), c->timestamp_bottom() + 1);
         xact->begin(id, nonce, ts, *group, dcs, this);
         break;
     }
@@ -843,7 +952,108 @@ daemon :: process_write(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up
 }
 
 void
-daemon :: process_commit(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
+daemon :: process_multi_read(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up)
+{
+    transaction_id txid;
+    uint64_t nonce;
+    uint64_t seqno;
+    e::slice table;
+    uint64_t count = 0;
+    up = up >> txid
+            >> e::unpack_varint(nonce)
+            >> e::unpack_varint(seqno)
+            >> table >> e::unpack_varint(count);
+    std::vector<e::slice> keys;
+
+    for (uint64_t i = 0; !up.error() && i < count; ++i)
+    {
+        e::slice key;
+        up = up >> key;
+        keys.push_back(key);
+    }
+
+    if (count == 0)
+    {
+        up = up.error_out();
+    }
+
+    CHECK_UNPACK(TXMAN_MULTI_READ, up);
+    configuration* c = get_config();
+
+    if (!c->get_group(txid.group))
+    {
+        LOG_IF(INFO, s_debug_mode) << "dropping multi-read for " << txid
+                                   << " because the group is not in the configuration";
+        return;
+    }
+
+    if (!c->is_member(txid.group, m_us.id))
+    {
+        LOG_IF(INFO, s_debug_mode) << "dropping multi-read for " << txid
+                                   << " this server is not part of the group";
+        return;
+    }
+
+    transaction_map_t::state_reference tsr;
+    transaction* xact = m_transactions.get_or_create_state(transaction_group(txid), &tsr);
+    assert(xact);
+    xact->multi_read(id, nonce, seqno, table, keys, msg, this);
+}
+
+void
+daemon :: process_multi_write(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up)
+{
+    transaction_id txid;
+    uint64_t nonce;
+    uint64_t seqno;
+    e::slice table;
+    uint64_t count = 0;
+    up = up >> txid
+            >> e::unpack_varint(nonce)
+            >> e::unpack_varint(seqno)
+            >> table >> e::unpack_varint(count);
+    std::vector<e::slice> keys;
+    std::vector<e::slice> values;
+
+    for (uint64_t i = 0; !up.error() && i < count; ++i)
+    {
+        e::slice key;
+        e::slice value;
+        up = up >> key >> value;
+        keys.push_back(key);
+        values.push_back(value);
+    }
+
+    if (count == 0)
+    {
+        up = up.error_out();
+    }
+
+    CHECK_UNPACK(TXMAN_MULTI_WRITE, up);
+    configuration* c = get_config();
+
+    if (!c->get_group(txid.group))
+    {
+        LOG_IF(INFO, s_debug_mode) << "dropping multi-write for " << txid
+                                   << " because the group is not in the configuration";
+        return;
+    }
+
+    if (!c->is_member(txid.group, m_us.id))
+    {
+        LOG_IF(INFO, s_debug_mode) << "dropping multi-write for " << txid
+                                   << " this server is not part of the group";
+        return;
+    }
+
+    transaction_map_t::state_reference tsr;
+    transaction* xact = m_transactions.get_or_create_state(transaction_group(txid), &tsr);
+    assert(xact);
+    xact->multi_write(id, nonce, seqno, table, keys, values, msg, this);
+}
+
+void
+daemon :: process_commit(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up)
 {
     transaction_id txid;
     uint64_t nonce;
@@ -851,6 +1061,28 @@ daemon :: process_commit(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
     up = up >> txid
             >> e::unpack_varint(nonce)
             >> e::unpack_varint(seqno);
+    std::vector<e::slice> tables;
+    std::vector<e::slice> keys;
+    std::vector<e::slice> values;
+
+    // a client that buffers its writes ships them with the commit
+    if (!up.error() && up.remain())
+    {
+        uint64_t count = 0;
+        up = up >> e::unpack_varint(count);
+
+        for (uint64_t i = 0; !up.error() && i < count; ++i)
+        {
+            e::slice table;
+            e::slice key;
+            e::slice value;
+            up = up >> table >> key >> value;
+            tables.push_back(table);
+            keys.push_back(key);
+            values.push_back(value);
+        }
+    }
+
     CHECK_UNPACK(TXMAN_COMMIT, up);
 
     if (!get_config()->get_group(txid.group))
@@ -863,7 +1095,7 @@ daemon :: process_commit(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
     transaction_map_t::state_reference tsr;
     transaction* xact = m_transactions.get_or_create_state(transaction_group(txid), &tsr);
     assert(xact);
-    xact->prepare(id, nonce, seqno, this);
+    xact->prepare(id, nonce, seqno, tables, keys, values, msg, this);
 }
 
 void
@@ -1293,6 +1525,23 @@ daemon :: debug_dump()
         }
     }
 
+    LOG(INFO) << "---------------------------------- Durability ----------------------------------";
+    LOG(INFO) << "log " << m_log.debug_dump();
+    std::vector<uint64_t> latencies;
+
+    {
+        po6::threads::mutex::hold hold(&m_durable_mtx);
+        latencies = m_durable_latencies;
+    }
+
+    if (!latencies.empty())
+    {
+        std::sort(latencies.begin(), latencies.end());
+        LOG(INFO) << "send_when_durable over the last " << latencies.size() << " messages:"
+                  << " p50=" << latencies[latencies.size() / 2] / PO6_MICROS << "us"
+                  << " p99=" << latencies[latencies.size() * 99 / 100] / PO6_MICROS << "us";
+    }
+
 #if 0
     // XXX
     LOG(INFO) << "--------------------------------- Local Voters ---------------------------------";
@@ -1301,7 +1550,6 @@ daemon :: debug_dump()
     LOG(INFO) << "-------------------------------- Read Operations -------------------------------";
     LOG(INFO) << "------------------------------- Write Operations -------------------------------";
     LOG(INFO) << "-------------------------------- Lock Operations -------------------------------";
-    LOG(INFO) << "---------------------------------- Durability ----------------------------------";
 #endif
     LOG(INFO) << "================================ End Debug Dump ================================";
 }
@@ -1309,12 +1557,7 @@ daemon :: debug_dump()
 uint64_t
 daemon :: generate_nonce()
 {
-    // XXX don't go out of process
-    po6::io::fd fd(open("/dev/urandom", O_RDONLY));
-    uint64_t x;
-    int ret = fd.xread(&x, sizeof(x));
-    assert(ret == 8);
-    return x;
+    return consus::generate_nonce();
 }
 
 consus::transaction_id
@@ -1444,10 +1687,11 @@ daemon :: send(const paxos_group& g, std::auto_ptr<e::buffer> msg)
 
 struct daemon::durable_msg
 {
-    durable_msg() : recno(), client(), msg(NULL) {}
-    durable_msg(int64_t r, comm_id c, e::buffer* m) : recno(r), client(c), msg(m) {}
+    durable_msg() : recno(), client(), msg(NULL), start() {}
+    durable_msg(int64_t r, comm_id c, e::buffer* m, uint64_t s)
+        : recno(r), client(c), msg(m), start(s) {}
     durable_msg(const durable_msg& other)
-        : recno(other.recno), client(other.client), msg(other.msg) {}
+        : recno(other.recno), client(other.client), msg(other.msg), start(other.start) {}
     ~durable_msg() throw () {}
     durable_msg& operator = (const durable_msg& rhs)
     {
@@ -1455,12 +1699,14 @@ struct daemon::durable_msg
         recno = rhs.recno;
         client = rhs.client;
         msg = rhs.msg;
+        start = rhs.start;
         return *this;
     }
     bool operator < (const durable_msg& rhs) { return rhs.recno > recno; }
     int64_t recno;
     comm_id client;
     e::buffer* msg;
+    uint64_t start;
 };
 
 void
@@ -1473,7 +1719,7 @@ daemon :: send_when_durable(const std::string& entry, comm_id id, std::auto_ptr<
 void
 daemon :: send_when_durable(const std::string& entry, const comm_id* ids, e::buffer** msgs, size_t sz)
 {
-    int64_t x = m_log.append(entry.data(), entry.size());
+    int64_t x = append_to_log(entry);
     send_when_durable(x, ids, msgs, sz);
 }
 
@@ -1518,6 +1764,7 @@ daemon :: send_when_durable(int64_t idx, const comm_id* ids, e::buffer** msgs, s
         return;
     }
 
+    const uint64_t now = po6::monotonic_time();
     bool wake = false;
 
     {
@@ -1526,7 +1773,7 @@ daemon :: send_when_durable(int64_t idx, const comm_id* ids, e::buffer** msgs, s
 
         for (size_t i = 0; i < sz; ++i)
         {
-            durable_msg d(idx, ids[i], msgs[i]);
+            durable_msg d(idx, ids[i], msgs[i], now);
             m_durable_msgs.push_back(d);
             std::push_heap(m_durable_msgs.begin(), m_durable_msgs.end());
         }
@@ -1562,7 +1809,7 @@ struct daemon::durable_cb
 void
 daemon :: callback_when_durable(const std::string& entry, const transaction_group& tg, uint64_t seqno)
 {
-    int64_t x = m_log.append(entry.data(), entry.size());
+    int64_t x = append_to_log(entry);
 
     if (x < 0)
     {
@@ -1618,12 +1865,26 @@ daemon :: durable()
             po6::threads::mutex::hold hold(&m_durable_mtx);
             m_durable_up_to = x;
 
+            const uint64_t now = po6::monotonic_time();
+
             while (!m_durable_msgs.empty() &&
                    m_durable_msgs[0].recno < x)
             {
                 msgs.push_back(m_durable_msgs[0]);
                 std::pop_heap(m_durable_msgs.begin(), m_durable_msgs.end());
                 m_durable_msgs.pop_back();
+                const uint64_t latency = now - msgs.back().start;
+
+                if (m_durable_latencies.size() < DURABLE_LATENCY_SAMPLES)
+                {
+                    m_durable_latencies.push_back(latency);
+                }
+                else
+                {
+                    m_durable_latencies[m_durable_latencies_idx] = latency;
+                }
+
+                m_durable_latencies_idx = (m_durable_latencies_idx + 1) % DURABLE_LATENCY_SAMPLES;
             }
 
             while (!m_durable_cbs.empty() &&
@@ -1651,11 +1912,328 @@ daemon :: durable()
                 xact->callback_durable(cbs[i].seqno, this);
             }
         }
+
+        const uint64_t now = po6::monotonic_time();
+
+        if (m_log_collected + PO6_SECONDS < now)
+        {
+            collect_log();
+            m_log_collected = now;
+        }
+
+        if (m_low_water_reported + 5 * PO6_SECONDS < now)
+        {
+            report_low_water();
+            m_low_water_reported = now;
+        }
     }
 
     LOG(INFO) << "durability monitor shutting down";
 }
 
+int64_t
+daemon :: append_to_log(const std::string& entry)
+{
+    log_entry_t t;
+    transaction_group tg;
+    e::unpacker up(entry);
+    up = up >> t >> tg;
+
+    if (!up.error())
+    {
+        po6::threads::mutex::hold hold(&m_log_refs_mtx);
+
+        // anything appended from here on lands at or above the durable bound,
+        // so the bound stands in for the group's first record
+        if (m_log_refs.find(tg) == m_log_refs.end())
+        {
+            m_log_refs[tg] = log_ref(m_log.durable());
+        }
+    }
+
+    const int64_t recno = m_log.append(entry.data(), entry.size());
+    disposition disp(tg, 0, 0);
+
+    if (!up.error() && t == LOG_ENTRY_DISPOSITION && recno >= 0)
+    {
+        up = up >> disp.outcome >> disp.begin;
+        assert(!up.error());
+        po6::threads::mutex::hold hold(&m_log_refs_mtx);
+        note_disposition(disp, recno);
+    }
+
+    return recno;
+}
+
+void
+daemon :: record_disposition(const transaction_group& tg, uint64_t outcome)
+{
+    // a group replayed from the log comes back with its disposition, and
+    // needs no second record of it
+    if (m_dispositions.has(tg))
+    {
+        return;
+    }
+
+    // a group this server never saw begin began no later than now
+    uint64_t begin = po6::wallclock_time();
+    m_begins.begin(tg, &begin);
+    std::string entry;
+    e::packer(&entry) << LOG_ENTRY_DISPOSITION << tg << outcome << begin;
+    append_to_log(entry);
+    m_dispositions.put(tg, outcome);
+}
+
+// call with m_log_refs_mtx held
+void
+daemon :: note_disposition(const disposition& disp, int64_t recno)
+{
+    log_ref_map_t::iterator it = m_log_refs.find(disp.tg);
+
+    if (it != m_log_refs.end())
+    {
+        it->second.disposition = std::max(it->second.disposition, recno);
+    }
+
+    m_disposition_log[recno] = disp;
+}
+
+bool
+daemon :: replay_log()
+{
+    int64_t count = m_log.replay(&daemon::replay_entry, this);
+
+    if (count < 0)
+    {
+        LOG(ERROR) << "could not replay log: " << po6::strerror(m_log.error());
+        return false;
+    }
+
+    LOG(INFO) << "replayed " << count << " log entries";
+    return true;
+}
+
+void
+daemon :: replay_entry(void* p, int64_t recno, const unsigned char* entry, size_t entry_sz)
+{
+    static_cast<daemon*>(p)->replay(recno, entry, entry_sz);
+}
+
+void
+daemon :: replay(int64_t recno, const unsigned char* entry, size_t entry_sz)
+{
+    // transactions hold slices of the entry, so it needs a buffer of its own
+    std::auto_ptr<e::buffer> buf(e::buffer::create(reinterpret_cast<const char*>(entry), entry_sz));
+    e::unpacker up = buf->unpack_from(0);
+    log_entry_t t = LOG_ENTRY_NOP;
+    transaction_group tg;
+    up = up >> t >> tg;
+
+    if (up.error())
+    {
+        LOG(ERROR) << "dropping corrupt log entry #" << recno;
+        return;
+    }
+
+    {
+        po6::threads::mutex::hold hold(&m_log_refs_mtx);
+        std::pair<log_ref_map_t::iterator, bool> ins;
+        ins = m_log_refs.insert(std::make_pair(tg, log_ref(recno)));
+        ins.first->second.first = std::min(ins.first->second.first, recno);
+    }
+
+    switch (t)
+    {
+        case LOG_ENTRY_TX_BEGIN:
+        case LOG_ENTRY_TX_READ:
+        case LOG_ENTRY_TX_WRITE:
+        case LOG_ENTRY_TX_PREPARE:
+        case LOG_ENTRY_TX_BATCH:
+        case LOG_ENTRY_TX_ABORT:
+        {
+            uint64_t seqno = 0;
+            up = up >> seqno;
+
+            if (up.error())
+            {
+                LOG(ERROR) << "dropping corrupt log entry #" << recno;
+                return;
+            }
+
+            transaction_map_t::state_reference tsr;
+            transaction* xact = m_transactions.get_or_create_state(tg, &tsr);
+            assert(xact);
+            xact->replay(seqno, t, up, buf, this);
+            break;
+        }
+        case LOG_ENTRY_LOCAL_VOTE_1A:
+        case LOG_ENTRY_LOCAL_VOTE_2A:
+        case LOG_ENTRY_LOCAL_LEARN:
+        {
+            local_voter_map_t::state_reference lvsr;
+            local_voter* lv = m_local_voters.get_or_create_state(tg, &lvsr);
+            assert(lv);
+            lv->replay(t, up, this);
+            break;
+        }
+        case LOG_ENTRY_GLOBAL_PROPOSE:
+        case LOG_ENTRY_GLOBAL_VOTE_1A:
+        case LOG_ENTRY_GLOBAL_VOTE_2A:
+        case LOG_ENTRY_GLOBAL_VOTE_2B:
+        {
+            global_voter_map_t::state_reference gvsr;
+            global_voter* gv = m_global_voters.get_or_create_state(tg, &gvsr);
+            assert(gv);
+            gv->replay(recno, t, up, this);
+            break;
+        }
+        case LOG_ENTRY_DISPOSITION:
+        {
+            disposition disp(tg, 0, 0);
+            up = up >> disp.outcome >> disp.begin;
+
+            if (up.error())
+            {
+                LOG(ERROR) << "dropping corrupt log entry #" << recno;
+                return;
+            }
+
+            m_dispositions.put(tg, disp.outcome);
+            po6::threads::mutex::hold hold(&m_log_refs_mtx);
+            note_disposition(disp, recno);
+            break;
+        }
+        case LOG_ENTRY_CONFIG:
+        case LOG_ENTRY_NOP:
+            break;
+        default:
+            LOG(ERROR) << "dropping log entry #" << recno << " of unknown type " << t;
+            break;
+    }
+}
+
+void
+daemon :: collect_log()
+{
+    const int64_t durable = m_log.durable();
+    int64_t lower_bound = durable;
+    // Every group that began below the cluster's low water mark is resolved
+    // on every server, and every group older than BEGIN_EXPIRY has been
+    // pushed to abort, so no one will ask after their dispositions again.
+    const uint64_t now = po6::wallclock_time();
+    const uint64_t forget_before = std::max<uint64_t>(get_config()->timestamp_bottom(),
+                                                      now > BEGIN_EXPIRY ? now - BEGIN_EXPIRY : 0);
+    std::vector<disposition> carry;
+    std::vector<transaction_group> forget;
+
+    {
+        po6::threads::mutex::hold hold(&m_log_refs_mtx);
+
+        for (log_ref_map_t::iterator it = m_log_refs.begin();
+                it != m_log_refs.end(); )
+        {
+            // the group's records may go once its disposition is on disk
+            if (it->second.disposition >= 0 &&
+                it->second.disposition < durable)
+            {
+                m_log_refs.erase(it++);
+            }
+            else
+            {
+                lower_bound = std::min(lower_bound, it->second.first);
+                ++it;
+            }
+        }
+
+        const int64_t limit = m_log.truncation_limit(lower_bound);
+
+        while (!m_disposition_log.empty() &&
+               m_disposition_log.begin()->first <= limit)
+        {
+            const disposition& disp(m_disposition_log.begin()->second);
+
+            if (disp.begin < forget_before)
+            {
+                forget.push_back(disp.tg);
+            }
+            else
+            {
+                carry.push_back(disp);
+            }
+
+            m_disposition_log.erase(m_disposition_log.begin());
+        }
+    }
+
+    for (size_t i = 0; i < forget.size(); ++i)
+    {
+        m_dispositions.del(forget[i]);
+    }
+
+    for (size_t i = 0; i < carry.size(); ++i)
+    {
+        std::string entry;
+        e::packer(&entry) << LOG_ENTRY_DISPOSITION << carry[i].tg
+                          << carry[i].outcome << carry[i].begin;
+        m_carried_forward = std::max(m_carried_forward, append_to_log(entry));
+    }
+
+    // the old records may go only once their copies are on disk
+    if (m_carried_forward >= durable)
+    {
+        return;
+    }
+
+    m_log.truncate(lower_bound);
+}
+
+void
+daemon :: track_begin(const transaction_group& tg, uint64_t timestamp)
+{
+    m_begins.track(tg, timestamp);
+}
+
+void
+daemon :: report_low_water()
+{
+    // peers learn of a begin some time after the originating txman picks its
+    // timestamp, and clocks disagree across data centers; hold the mark back
+    // by enough that neither lets it pass a transaction still in flight
+    const uint64_t SLACK = 60 * PO6_SECONDS;
+    const uint64_t now = po6::wallclock_time();
+    std::vector<transaction_group> expired;
+    uint64_t low_water = m_begins.low_water(now, now > BEGIN_EXPIRY ? now - BEGIN_EXPIRY : 0,
+                                            &daemon::has_disposition, this, &expired);
+
+    for (size_t i = 0; i < expired.size(); ++i)
+    {
+        transaction_map_t::state_reference tsr;
+        transaction* xact = m_transactions.get_state(expired[i], &tsr);
+
+        if (xact)
+        {
+            xact->expire(this);
+        }
+    }
+
+    low_water = low_water > SLACK ? low_water - SLACK : 0;
+    std::string input;
+    e::packer(&input) << m_us.id << low_water;
+    m_coord->fire_and_forget("txman_low_water", input.data(), input.size());
+}
+
+bool
+daemon :: has_disposition(void* p, const transaction_group& tg)
+{
+    return static_cast<daemon*>(p)->m_dispositions.has(tg);
+}
+
+uint64_t
+daemon :: schedule_pump(pump_t type, const transaction_group& tg, uint64_t when)
+{
+    return m_pump_timers.schedule(when, pump_timer(type, tg));
+}
+
 void
 daemon :: pump()
 {
@@ -1669,32 +2247,67 @@ daemon :: pump()
     }
 
     LOG(INFO) << "pumping thread started";
+    std::vector<pump_timer> due;
 
     while (true)
     {
-        sleep(PO6_MILLIS * 250);
+        po6::sleep(m_pump_timers.tick());
 
         if (e::atomic::increment_32_nobarrier(&s_interrupts, 0) > 0)
         {
             break;
         }
 
-        for (transaction_map_t::iterator it(&m_transactions); it.valid(); ++it)
-        {
-            transaction* xact = *it;
-            xact->externally_work_state_machine(this);
-        }
+        // Each state machine schedules a wakeup for when a request it sent
+        // becomes eligible for a resend.  Those that have since finished are
+        // gone from their table, and those still waiting on a reply get one
+        // pass that resends only what is due.
+        due.clear();
+        m_pump_timers.expire(po6::monotonic_time(), &due);
 
-        for (local_voter_map_t::iterator it(&m_local_voters); it.valid(); ++it)
+        for (size_t i = 0; i < due.size(); ++i)
         {
-            local_voter* lv = *it;
-            lv->externally_work_state_machine(this);
-        }
-
-        for (global_voter_map_t::iterator it(&m_global_voters); it.valid(); ++it)
-        {
-            global_voter* lv = *it;
-            lv->externally_work_state_machine(this);
+            switch (due[i].type)
+            {
+                case PUMP_TRANSACTION:
+                {
+                    transaction_map_t::state_reference tsr;
+                    transaction* xact = m_transactions.get_state(due[i].tg, &tsr);
+
+                    if (xact)
+                    {
+                        xact->externally_work_state_machine(this);
+                    }
+
+                    break;
+                }
+                case PUMP_LOCAL_VOTER:
+                {
+                    local_voter_map_t::state_reference lvsr;
+                    local_voter* lv = m_local_voters.get_state(due[i].tg, &lvsr);
+
+                    if (lv)
+                    {
+                        lv->externally_work_state_machine(this);
+                    }
+
+                    break;
+                }
+                case PUMP_GLOBAL_VOTER:
+                {
+                    global_voter_map_t::state_reference gvsr;
+                    global_voter* gv = m_global_voters.get_state(due[i].tg, &gvsr);
+
+                    if (gv)
+                    {
+                        gv->externally_work_state_machine(this);
+                    }
+
+                    break;
+                }
+                default:
+                    abort();
+            }
         }
     }
 
@@ -30,6 +30,7 @@
 
 // STL
 #include <algorithm>
+#include <map>
 #include <string>
 
 // po6
@@ -53,9 +54,11 @@
 #include "common/coordinator_link.h"
 #include "common/ids.h"
 #include "common/network_msgtype.h"
+#include "common/timer_wheel.h"
 #include "common/transaction_id.h"
 #include "common/transaction_group.h"
 #include "common/txman.h"
+#include "txman/begin_tracker.h"
 #include "txman/configuration.h"
 #include "txman/durable_log.h"
 #include "txman/global_voter.h"
@@ -85,12 +88,22 @@ class daemon
                 bool set_coordinator,
                 const char* coordinator,
                 const char* data_center,
-                unsigned threads);
+                unsigned threads,
+                unsigned log_segments);
 
     private:
         struct coordinator_callback;
         struct durable_msg;
         struct durable_cb;
+        // where a transaction group's records start in the log, and where
+        // its disposition landed, if it has one
+        struct log_ref
+        {
+            log_ref() : first(-1), disposition(-1) {}
+            log_ref(int64_t f) : first(f), disposition(-1) {}
+            int64_t first;
+            int64_t disposition;
+        };
         typedef e::state_hash_table<uint64_t, kvs_read> read_map_t;
         typedef e::state_hash_table<uint64_t, kvs_write> write_map_t;
         typedef e::state_hash_table<uint64_t, kvs_lock_op> lock_op_map_t;
@@ -98,8 +111,28 @@ class daemon
         typedef e::state_hash_table<transaction_group, local_voter> local_voter_map_t;
         typedef e::state_hash_table<transaction_group, global_voter> global_voter_map_t;
         typedef e::nwf_hash_map<transaction_group, uint64_t, transaction_group::hash> disposition_map_t;
+        typedef e::compat::unordered_map<transaction_group, log_ref, e::compat::hash<transaction_group> > log_ref_map_t;
+        // a disposition record in the log, and when its group began
+        struct disposition
+        {
+            disposition() : tg(), outcome(), begin() {}
+            disposition(const transaction_group& t, uint64_t o, uint64_t b)
+                : tg(t), outcome(o), begin(b) {}
+            transaction_group tg;
+            uint64_t outcome;
+            uint64_t begin;
+        };
+        typedef std::map<int64_t, disposition> disposition_log_t;
         typedef std::vector<durable_msg> durable_msg_heap_t;
         typedef std::vector<durable_cb> durable_cb_heap_t;
+        enum pump_t { PUMP_TRANSACTION, PUMP_LOCAL_VOTER, PUMP_GLOBAL_VOTER };
+        struct pump_timer
+        {
+            pump_timer() : type(), tg() {}
+            pump_timer(pump_t t, const transaction_group& g) : type(t), tg(g) {}
+            pump_t type;
+            transaction_group tg;
+        };
         friend class mapper;
         friend class transaction;
         friend class local_voter;
@@ -107,6 +140,7 @@ class daemon
         friend class kvs_lock_op;
         friend class kvs_read;
         friend class kvs_write;
+        friend class pump_wakeup;
 
     private:
         void loop(size_t thread);
@@ -116,6 +150,8 @@ class daemon
         void process_begin(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_read(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_write(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_multi_read(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_multi_write(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_commit(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_abort(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_wound(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
@@ -155,6 +191,21 @@ class daemon
         void send_when_durable(int64_t idx, const comm_id* ids, e::buffer** msgs, size_t sz);
         void callback_when_durable(const std::string& entry, const transaction_group& tg, uint64_t seqno);
         void durable();
+
+        // durable log maintenance
+        int64_t append_to_log(const std::string& entry);
+        void record_disposition(const transaction_group& tg, uint64_t outcome);
+        void note_disposition(const disposition& d, int64_t recno);
+        bool replay_log();
+        static void replay_entry(void* p, int64_t recno, const unsigned char* entry, size_t entry_sz);
+        void replay(int64_t recno, const unsigned char* entry, size_t entry_sz);
+        void collect_log();
+
+        // version garbage collection
+        void track_begin(const transaction_group& tg, uint64_t timestamp);
+        void report_low_water();
+        static bool has_disposition(void* p, const transaction_group& tg);
+        uint64_t schedule_pump(pump_t type, const transaction_group& tg, uint64_t when);
         void pump();
 
     private:
@@ -181,8 +232,30 @@ class daemon
         int64_t m_durable_up_to;
         durable_msg_heap_t m_durable_msgs;
         durable_cb_heap_t m_durable_cbs;
+        // the most recent send_when_durable latencies, for debug_dump
+        std::vector<uint64_t> m_durable_latencies;
+        size_t m_durable_latencies_idx;
+
+        // the lowest log record of each transaction group without a durable
+        // disposition; the log may discard everything below the minimum.
+        // Dispositions outlive their groups' records, so each is rewritten
+        // whenever the log is about to discard the record that holds it,
+        // until its group began below the cluster's low water mark or so
+        // long ago that m_begins would have expired it.
+        po6::threads::mutex m_log_refs_mtx;
+        log_ref_map_t m_log_refs;
+        disposition_log_t m_disposition_log;
+        int64_t m_carried_forward;
+        uint64_t m_log_collected;
+
+        // the begin timestamp of each transaction group without a
+        // disposition; the minimum is reported to the coordinator, which
+        // lets key-value stores discard the versions nothing can read
+        begin_tracker m_begins;
+        uint64_t m_low_water_reported;
 
         // state machine pumping
+        timer_wheel<pump_timer> m_pump_timers;
         po6::threads::thread m_pumping_thread;
 
     private:
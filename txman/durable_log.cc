@@ -27,19 +27,29 @@
 
 // C
 #include <assert.h>
+#include <limits.h>
+#include <stdio.h>
 #include <string.h>
 
 // POSIX
 #include <dirent.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 // STL
 #include <algorithm>
+#include <sstream>
 #include <vector>
 
+// po6
+#include <po6/time.h>
+
 // e
+#include <e/compat.h>
 #include <e/endian.h>
 #include <e/guard.h>
 #include <e/serialization.h>
@@ -52,6 +62,17 @@
 using consus::durable_log;
 
 #define RECORD_HEADER_SIZE (2 * sizeof(uint64_t))
+// once a segment grows past this size, it is sealed and replaced
+#define SEGMENT_MAX_BYTES (64ULL * 1024ULL * 1024ULL)
+#define INDEX_FILE "INDEX"
+#define INDEX_TEMP "INDEX.tmp"
+// every record is header, entry, and CRC
+#define IOVECS_PER_RECORD 3
+// how quickly the fsync latency averages follow new samples (1/2^x)
+#define FSYNC_EWMA_SHIFT 3
+// while overlap is disabled, let one fsync overlap every this many anyway so
+// that the policy notices when the device speeds up again
+#define FSYNC_PROBE_INTERVAL 64
 
 static void
 encode_header(uint64_t recno, uint64_t size, unsigned char* header)
@@ -60,65 +81,272 @@ encode_header(uint64_t recno, uint64_t size, unsigned char* header)
     e::pack64be(size, header + sizeof(uint64_t));
 }
 
+static std::string
+segment_name(uint64_t segno)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "log.%016llx", static_cast<unsigned long long>(segno));
+    return std::string(buf);
+}
+
 struct durable_log :: segment
 {
-    segment(po6::threads::mutex* mtx, int x)
-        : fd(x)
+    segment(po6::threads::mutex* mtx, uint64_t s, int64_t l, int x)
+        : segno(s)
+        , lower(l)
+        , fd(x)
         , offset_next_write(0)
         , offset_last_fsync(0)
-        , recno_last_write(0)
-        , recno_last_fsync(0)
+        , recno_last_write(l - 1)
+        , recno_first_unflushed(l)
         , ongoing_writes(0)
         , done_writing(mtx)
         , syncing(false)
+        , writing(false)
+        , pending()
     {
     }
+    uint64_t segno;
+    int64_t lower;
     po6::io::fd fd;
     uint64_t offset_next_write;
     uint64_t offset_last_fsync;
     uint64_t recno_last_write;
-    uint64_t recno_last_fsync;
+    // only meaningful while offset_next_write > offset_last_fsync
+    uint64_t recno_first_unflushed;
     int32_t ongoing_writes;
     po6::threads::cond done_writing;
     bool syncing;
+    // one appender at a time writes everything pending for the segment
+    bool writing;
+    std::vector<writer*> pending;
+};
+
+// One record on its way to disk.
+struct durable_log :: writer
+{
+    writer(po6::threads::mutex* mtx, const unsigned char* e, size_t e_sz)
+        : offset(0)
+        , entry(e)
+        , entry_sz(e_sz)
+        , done(false)
+        , error(0)
+        , cond(mtx)
+    {
+    }
+    uint64_t offset;
+    unsigned char header[RECORD_HEADER_SIZE];
+    const unsigned char* entry;
+    size_t entry_sz;
+    unsigned char crc[sizeof(uint32_t)];
+    bool done;
+    int error;
+    po6::threads::cond cond;
+
+    size_t size() const { return RECORD_HEADER_SIZE + entry_sz + sizeof(uint32_t); }
+    static bool by_offset(const writer* lhs, const writer* rhs) { return lhs->offset < rhs->offset; }
+
+    private:
+        writer(const writer&);
+        writer& operator = (const writer&);
+};
+
+// Write the records with as few pwritev calls as possible:  records at
+// adjacent offsets go out together.  Returns 0 or an errno.
+int
+durable_log :: write_records(int fd, std::vector<writer*>* ws)
+{
+    std::sort(ws->begin(), ws->end(), writer::by_offset);
+    const size_t max_records = IOV_MAX / IOVECS_PER_RECORD;
+    std::vector<struct iovec> iov;
+    size_t idx = 0;
+
+    while (idx < ws->size())
+    {
+        const uint64_t offset = (*ws)[idx]->offset;
+        uint64_t next = offset;
+        iov.clear();
+
+        while (idx < ws->size() &&
+               (*ws)[idx]->offset == next &&
+               iov.size() / IOVECS_PER_RECORD < max_records)
+        {
+            writer* w = (*ws)[idx];
+            struct iovec v[IOVECS_PER_RECORD];
+            v[0].iov_base = w->header;
+            v[0].iov_len = RECORD_HEADER_SIZE;
+            v[1].iov_base = const_cast<unsigned char*>(w->entry);
+            v[1].iov_len = w->entry_sz;
+            v[2].iov_base = w->crc;
+            v[2].iov_len = sizeof(uint32_t);
+            iov.insert(iov.end(), v, v + IOVECS_PER_RECORD);
+            next += w->size();
+            ++idx;
+        }
+
+        ssize_t ret = pwritev(fd, &iov[0], iov.size(), offset);
+
+        if (ret < 0)
+        {
+            return errno;
+        }
+        else if (uint64_t(ret) != next - offset)
+        {
+            return EIO;
+        }
+    }
+
+    return 0;
+}
+
+// Reads the intact prefix of one segment, one record at a time.
+class durable_log :: reader
+{
+    public:
+        reader(int fd);
+        ~reader() throw ();
+
+    public:
+        // false at the end of the segment, or at the first torn/corrupt record
+        bool next();
+        int64_t recno() const { return m_recno; }
+        const unsigned char* data() const { return &m_buf[RECORD_HEADER_SIZE]; }
+        size_t size() const { return m_size; }
+        int fd() const { return m_fd.get(); }
+        uint64_t end() const { return m_offset; }
+        uint64_t file_size() const { return m_file_size; }
+
+    private:
+        po6::io::fd m_fd;
+        uint64_t m_file_size;
+        uint64_t m_offset;
+        int64_t m_recno;
+        size_t m_size;
+        std::vector<unsigned char> m_buf;
+
+    private:
+        reader(const reader&);
+        reader& operator = (const reader&);
 };
 
+durable_log :: reader :: reader(int f)
+    : m_fd(f)
+    , m_file_size(0)
+    , m_offset(0)
+    , m_recno(0)
+    , m_size(0)
+    , m_buf()
+{
+    struct stat st;
+
+    if (fstat(m_fd.get(), &st) == 0)
+    {
+        m_file_size = st.st_size;
+    }
+}
+
+durable_log :: reader :: ~reader() throw ()
+{
+}
+
+bool
+durable_log :: reader :: next()
+{
+    assert(m_offset <= m_file_size);
+    const uint64_t remain = m_file_size - m_offset;
+    unsigned char header[RECORD_HEADER_SIZE];
+
+    if (remain < RECORD_HEADER_SIZE + sizeof(uint32_t) ||
+        pread(m_fd.get(), header, RECORD_HEADER_SIZE, m_offset) != ssize_t(RECORD_HEADER_SIZE))
+    {
+        return false;
+    }
+
+    uint64_t recno;
+    uint64_t size;
+    e::unpack64be(header, &recno);
+    e::unpack64be(header + sizeof(uint64_t), &size);
+
+    // a zero record number is a hole left by an append that never finished
+    if (recno == 0 || size > remain - RECORD_HEADER_SIZE - sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    const size_t record_sz = RECORD_HEADER_SIZE + size + sizeof(uint32_t);
+    m_buf.resize(record_sz);
+
+    if (pread(m_fd.get(), &m_buf[0], record_sz, m_offset) != ssize_t(record_sz))
+    {
+        return false;
+    }
+
+    uint32_t crc = crc32c(0, &m_buf[0], RECORD_HEADER_SIZE + size);
+    uint32_t stored;
+    e::unpack32be(&m_buf[RECORD_HEADER_SIZE + size], &stored);
+
+    if (crc != stored)
+    {
+        return false;
+    }
+
+    m_recno = recno;
+    m_size = size;
+    m_offset += record_sz;
+    return true;
+}
+
 durable_log :: durable_log()
     : m_path()
     , m_dir()
     , m_lockfile()
     , m_mtx()
     , m_cond(&m_mtx)
-    , m_flush(po6::threads::make_obj_func(&durable_log::flush, this))
+    , m_flushers()
     , m_error(0)
     , m_wakeup(false)
     , m_next_entry(1)
-    , m_segment_a(NULL)
-    , m_segment_b(NULL)
+    , m_next_segno(1)
+    , m_segments()
+    , m_sealed()
+    , m_truncate_below(0)
+    , m_truncating(false)
+    , m_index_mtx()
+    , m_syncs(0)
+    , m_sync_limit(1)
+    , m_fsync_solo(0)
+    , m_fsync_overlap(0)
+    , m_fsyncs_since_probe(0)
 {
-    m_flush.start();
 }
 
 durable_log :: ~durable_log() throw ()
 {
     close();
-    m_flush.join();
 
-    if (m_segment_a)
+    for (size_t i = 0; i < m_flushers.size(); ++i)
     {
-        delete m_segment_a;
+        m_flushers[i]->join();
     }
 
-    if (m_segment_b)
+    for (size_t i = 0; i < m_segments.size(); ++i)
     {
-        delete m_segment_b;
+        delete m_segments[i];
     }
 }
 
 bool
-durable_log :: open(const std::string& dir)
+durable_log :: open(const std::string& dir, unsigned segments)
 {
     po6::threads::mutex::hold hold(&m_mtx);
+    assert(m_segments.empty());
+
+    if (segments < 2)
+    {
+        m_error = errno = EINVAL;
+        return false;
+    }
+
     m_path = dir;
     struct stat st;
     int ret = stat(m_path.c_str(), &st);
@@ -161,19 +389,64 @@ durable_log :: open(const std::string& dir)
         return false;
     }
 
-    // XXX do rotation on these and don't overwrite the old
-    int file_a = openat(m_dir.get(), "file_a", O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
-    int file_b = openat(m_dir.get(), "file_b", O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+    std::vector<index_entry> idx;
 
-    if (file_a < 0 || file_b < 0)
+    if (!read_index(&idx))
     {
-        ::close(file_a);
-        ::close(file_b);
+        m_error = errno;
+        return false;
+    }
+
+    // every segment from the previous run is sealed; replay() reads them and
+    // truncate() eventually removes them
+    for (size_t i = 0; i < idx.size(); ++i)
+    {
+        sealed s;
+
+        if (!scan_segment(idx[i].segno, idx[i].lower, &s))
+        {
+            m_error = errno;
+            return false;
+        }
+
+        m_sealed.push_back(s);
+        m_next_entry = std::max(m_next_entry, uint64_t(s.upper + 1));
+        m_next_segno = std::max(m_next_segno, idx[i].segno + 1);
+    }
+
+    for (unsigned i = 0; i < segments; ++i)
+    {
+        const uint64_t segno = m_next_segno++;
+        int fd = create_segment(segno);
+
+        if (fd < 0)
+        {
+            m_error = errno;
+            return false;
+        }
+
+        m_segments.push_back(new segment(&m_mtx, segno, m_next_entry, fd));
+    }
+
+    snapshot_index(&idx);
+
+    if (!write_index(idx))
+    {
+        m_error = errno;
         return false;
     }
 
-    m_segment_a = new segment(&m_mtx, file_a);
-    m_segment_b = new segment(&m_mtx, file_b);
+    // one segment always takes appends while the rest may be syncing
+    m_sync_limit = segments - 1;
+
+    for (unsigned i = 0; i + 1 < segments; ++i)
+    {
+        using namespace po6::threads;
+        e::compat::shared_ptr<thread> t(new thread(make_obj_func(&durable_log::flush, this)));
+        m_flushers.push_back(t);
+        t->start();
+    }
+
     return true;
 }
 
@@ -194,9 +467,8 @@ durable_log :: append(const char* entry, size_t entry_sz)
 int64_t
 durable_log :: append(const unsigned char* entry, size_t entry_sz)
 {
-    unsigned char header[RECORD_HEADER_SIZE];
+    writer w(&m_mtx, entry, entry_sz);
     segment* seg;
-    uint64_t offset;
     uint64_t recno;
 
     {
@@ -213,39 +485,185 @@ durable_log :: append(const unsigned char* entry, size_t entry_sz)
         seg = select_segment_write();
         assert(seg);
         assert(!seg->syncing);
-        offset = seg->offset_next_write;
-        seg->offset_next_write += RECORD_HEADER_SIZE + entry_sz + sizeof(uint32_t);
+
+        if (seg->offset_next_write == seg->offset_last_fsync)
+        {
+            seg->recno_first_unflushed = recno;
+        }
+
+        w.offset = seg->offset_next_write;
+        seg->offset_next_write += w.size();
         seg->recno_last_write = recno;
         ++seg->ongoing_writes;
     }
 
-    encode_header(recno, entry_sz, header);
+    encode_header(recno, entry_sz, w.header);
     uint32_t crc = 0;
-    crc = crc32c(crc, header, RECORD_HEADER_SIZE);
+    crc = crc32c(crc, w.header, RECORD_HEADER_SIZE);
     crc = crc32c(crc, entry, entry_sz);
-    unsigned char crcbuf[sizeof(uint32_t)];
-    e::pack32be(crc, crcbuf);
+    e::pack32be(crc, w.crc);
 
-    if (pwrite(seg->fd.get(), header, RECORD_HEADER_SIZE, offset) < 0 ||
-        pwrite(seg->fd.get(), entry, entry_sz, offset + RECORD_HEADER_SIZE) < 0 ||
-        pwrite(seg->fd.get(), crcbuf, sizeof(uint32_t), offset + RECORD_HEADER_SIZE + entry_sz) < 0)
+    po6::threads::mutex::hold hold(&m_mtx);
+    seg->pending.push_back(&w);
+
+    while (!w.done && seg->writing)
     {
-        int e = errno;
-        po6::threads::mutex::hold hold(&m_mtx);
-        m_error = e;
+        w.cond.wait();
+    }
+
+    if (!w.done)
+    {
+        // no one is writing to this segment, so write everything that has
+        // queued up behind us in one go
+        std::vector<writer*> batch;
+        batch.swap(seg->pending);
+        seg->writing = true;
+        m_mtx.unlock();
+        int err = write_records(seg->fd.get(), &batch);
+        m_mtx.lock();
+        seg->writing = false;
+
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            batch[i]->done = true;
+            batch[i]->error = err;
+
+            if (batch[i] != &w)
+            {
+                batch[i]->cond.signal();
+            }
+        }
+
+        if (!seg->pending.empty())
+        {
+            seg->pending.front()->cond.signal();
+        }
+
+        if (err != 0)
+        {
+            m_error = err;
+        }
+
+        assert(seg->ongoing_writes >= int32_t(batch.size()));
+        seg->ongoing_writes -= batch.size();
+
+        if (seg->ongoing_writes == 0)
+        {
+            seg->done_writing.broadcast();
+        }
+
+        m_cond.broadcast();
+    }
+
+    if (w.error != 0)
+    {
+        errno = w.error;
         return -1;
     }
 
+    return recno;
+}
+
+int64_t
+durable_log :: replay(void (*f)(void*, int64_t, const unsigned char*, size_t), void* p)
+{
+    std::vector<sealed> segs;
+
+    {
+        po6::threads::mutex::hold hold(&m_mtx);
+
+        if (m_error)
+        {
+            errno = m_error;
+            return -1;
+        }
+
+        segs = m_sealed;
+    }
+
+    typedef e::compat::shared_ptr<reader> reader_ptr;
+    std::vector<reader_ptr> readers;
+
+    for (size_t i = 0; i < segs.size(); ++i)
+    {
+        int fd = openat(m_dir.get(), segment_name(segs[i].segno).c_str(), O_RDONLY);
+
+        if (fd < 0)
+        {
+            int e = errno;
+            po6::threads::mutex::hold hold(&m_mtx);
+            m_error = e;
+            return -1;
+        }
+
+        reader_ptr r(new reader(fd));
+
+        if (r->next())
+        {
+            readers.push_back(r);
+        }
+    }
+
+    // records within a segment are in order, so merging the heads of each
+    // segment streams the whole log in order
+    int64_t count = 0;
+
+    while (!readers.empty())
+    {
+        size_t min = 0;
+
+        for (size_t i = 1; i < readers.size(); ++i)
+        {
+            if (readers[i]->recno() < readers[min]->recno())
+            {
+                min = i;
+            }
+        }
+
+        f(p, readers[min]->recno(), readers[min]->data(), readers[min]->size());
+        ++count;
+
+        if (!readers[min]->next())
+        {
+            readers.erase(readers.begin() + min);
+        }
+    }
+
+    return count;
+}
+
+void
+durable_log :: truncate(int64_t lower_bound)
+{
     po6::threads::mutex::hold hold(&m_mtx);
-    --seg->ongoing_writes;
 
-    if (seg->ongoing_writes == 0)
+    if (lower_bound > m_truncate_below)
     {
-        seg->done_writing.broadcast();
-        m_cond.broadcast();
+        m_truncate_below = lower_bound;
+
+        if (truncation_pending())
+        {
+            m_cond.broadcast();
+        }
     }
+}
 
-    return recno;
+int64_t
+durable_log :: truncation_limit(int64_t lower_bound)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    lower_bound = std::max(lower_bound, m_truncate_below);
+    int64_t limit = -1;
+
+    for (size_t i = 0; i < m_sealed.size(); ++i)
+    {
+        if (m_sealed[i].upper < lower_bound)
+        {
+            limit = std::max(limit, m_sealed[i].upper);
+        }
+    }
+
+    return limit;
 }
 
 int64_t
@@ -291,6 +709,20 @@ durable_log :: error()
     return m_error;
 }
 
+std::string
+durable_log :: debug_dump()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    std::ostringstream ostr;
+    ostr << "segments=" << m_segments.size()
+         << " sealed=" << m_sealed.size()
+         << " fsyncs_in_flight=" << m_syncs
+         << " fsync_limit=" << m_sync_limit
+         << " fsync_solo=" << m_fsync_solo / PO6_MICROS << "us"
+         << " fsync_overlapped=" << m_fsync_overlap / PO6_MICROS << "us";
+    return ostr.str();
+}
+
 void
 durable_log :: flush()
 {
@@ -308,14 +740,15 @@ durable_log :: flush()
     while (true)
     {
         uint64_t offset_saved;
-        uint64_t recno_saved;
-        segment* seg;
+        bool overlapped = false;
+        segment* seg = NULL;
 
         {
             po6::threads::mutex::hold hold(&m_mtx);
 
             while (m_error == 0 &&
-                   !(seg = select_segment_fsync()))
+                   !(seg = select_segment_fsync()) &&
+                   (m_truncating || !truncation_pending()))
             {
                 m_cond.wait();
             }
@@ -325,17 +758,43 @@ durable_log :: flush()
                 break;
             }
 
-            seg->syncing = true;
+            if (seg)
+            {
+                seg->syncing = true;
+                overlapped = m_syncs > 0;
+                ++m_syncs;
+
+                while (seg->ongoing_writes > 0)
+                {
+                    seg->done_writing.wait();
+                }
+
+                offset_saved = seg->offset_next_write;
+            }
+            else
+            {
+                m_truncating = true;
+            }
+        }
+
+        if (!seg)
+        {
+            bool ret = remove_truncated();
+            int e = errno;
+            po6::threads::mutex::hold hold(&m_mtx);
+            m_truncating = false;
 
-            while (seg->ongoing_writes > 0)
+            if (!ret)
             {
-                seg->done_writing.wait();
+                m_error = e;
             }
 
-            offset_saved = seg->offset_next_write;
-            recno_saved = seg->recno_last_write;
+            m_cond.broadcast();
+            continue;
         }
 
+        const uint64_t start = po6::monotonic_time();
+
         if (fsync(seg->fd.get()) < 0)
         {
             int e = errno;
@@ -343,105 +802,423 @@ durable_log :: flush()
             m_error = e;
         }
 
+        const uint64_t elapsed = po6::monotonic_time() - start;
+        bool full;
+
         {
             po6::threads::mutex::hold hold(&m_mtx);
-            seg->syncing = false;
+            // nothing is written to a syncing segment, so it is now clean
+            assert(seg->offset_next_write == offset_saved);
             seg->offset_last_fsync = offset_saved;
-            seg->recno_last_fsync = recno_saved;
+            overlapped = overlapped || m_syncs > 1;
+            --m_syncs;
+            adapt_sync_limit(elapsed, overlapped);
+            // keep appends away from a full segment until it is replaced
+            full = m_error == 0 && seg->offset_next_write >= SEGMENT_MAX_BYTES;
+            seg->syncing = full;
+            m_cond.broadcast();
+        }
+
+        if (full && !rotate(seg))
+        {
+            int e = errno;
+            po6::threads::mutex::hold hold(&m_mtx);
+            m_error = e;
+            seg->syncing = false;
             m_cond.broadcast();
         }
     }
 }
 
+// Append to the open segment that already has the most unflushed data so
+// that each fsync covers as long a run of records as possible.
 durable_log::segment*
 durable_log :: select_segment_write()
 {
-    segment* a = m_segment_a;
-    segment* b = m_segment_b;
-    assert(a->offset_next_write >= a->offset_last_fsync);
-    assert(b->offset_next_write >= b->offset_last_fsync);
-    const uint64_t a_unflushed = a->offset_next_write - a->offset_last_fsync;
-    const uint64_t b_unflushed = b->offset_next_write - b->offset_last_fsync;
+    segment* best = NULL;
 
-    if (a_unflushed < b_unflushed && !a->syncing)
+    for (size_t i = 0; i < m_segments.size(); ++i)
     {
-        return a;
+        segment* seg = m_segments[i];
+        assert(seg->offset_next_write >= seg->offset_last_fsync);
+
+        if (seg->syncing)
+        {
+            continue;
+        }
+
+        if (!best ||
+            seg->offset_next_write - seg->offset_last_fsync >
+            best->offset_next_write - best->offset_last_fsync)
+        {
+            best = seg;
+        }
     }
-    else if (a_unflushed > b_unflushed && !b->syncing)
+
+    return best;
+}
+
+// Pick the dirtiest segment, provided that syncing it leaves another segment
+// open for appends and the adaptive policy allows another fsync in flight.
+durable_log::segment*
+durable_log :: select_segment_fsync()
+{
+    segment* best = NULL;
+    size_t open = 0;
+
+    for (size_t i = 0; i < m_segments.size(); ++i)
     {
-        return b;
+        segment* seg = m_segments[i];
+        assert(seg->offset_next_write >= seg->offset_last_fsync);
+
+        if (seg->syncing)
+        {
+            continue;
+        }
+
+        ++open;
+
+        if (seg->offset_next_write > seg->offset_last_fsync &&
+            (!best ||
+             seg->offset_next_write - seg->offset_last_fsync >
+             best->offset_next_write - best->offset_last_fsync))
+        {
+            best = seg;
+        }
     }
-    else if (!a->syncing)
+
+    if (!best || open < 2)
     {
-        return a;
+        return NULL;
     }
-    else if (!b->syncing)
+
+    // an idle log always syncs right away; beyond that, overlap only as far
+    // as the policy allows, with the occasional probe past the limit
+    if (m_syncs >= m_sync_limit)
     {
-        return b;
+        if (m_fsyncs_since_probe < FSYNC_PROBE_INTERVAL)
+        {
+            return NULL;
+        }
+
+        m_fsyncs_since_probe = 0;
+    }
+
+    return best;
+}
+
+// Called with m_mtx held after each fsync.  Compare how long fsyncs take when
+// they run alone and when they overlap another.  If overlapping slows each
+// fsync nearly in proportion, the device is serializing them, so stop
+// overlapping and let batches grow instead; if overlapping is nearly free,
+// allow more of it to cut latency.
+void
+durable_log :: adapt_sync_limit(uint64_t elapsed, bool overlapped)
+{
+    uint64_t* avg = overlapped ? &m_fsync_overlap : &m_fsync_solo;
+
+    if (*avg == 0)
+    {
+        *avg = elapsed;
     }
     else
     {
-        return NULL;
+        *avg = *avg - (*avg >> FSYNC_EWMA_SHIFT) + (elapsed >> FSYNC_EWMA_SHIFT);
+    }
+
+    ++m_fsyncs_since_probe;
+
+    if (m_fsync_solo == 0 || m_fsync_overlap == 0)
+    {
+        return;
+    }
+
+    const unsigned max_limit = m_segments.size() - 1;
+
+    if (m_fsync_overlap * 4 > m_fsync_solo * 7 && m_sync_limit > 1)
+    {
+        --m_sync_limit;
+    }
+    else if (m_fsync_overlap * 4 < m_fsync_solo * 5 && m_sync_limit < max_limit)
+    {
+        ++m_sync_limit;
     }
 }
 
-durable_log::segment*
-durable_log :: select_segment_fsync()
+int64_t
+durable_log :: durable_lock_held_elsewhere()
 {
-    segment* a = m_segment_a;
-    segment* b = m_segment_b;
+    int64_t bound = m_next_entry;
 
-    if (!a || !b)
+    for (size_t i = 0; i < m_segments.size(); ++i)
     {
-        return NULL;
+        segment* seg = m_segments[i];
+        assert(seg->offset_next_write >= seg->offset_last_fsync);
+
+        if (seg->offset_next_write > seg->offset_last_fsync)
+        {
+            bound = std::min(bound, int64_t(seg->recno_first_unflushed));
+        }
     }
 
-    assert(!a->syncing);
-    assert(!b->syncing);
-    assert(a->offset_next_write >= a->offset_last_fsync);
-    assert(b->offset_next_write >= b->offset_last_fsync);
-    const uint64_t a_unflushed = a->offset_next_write - a->offset_last_fsync;
-    const uint64_t b_unflushed = b->offset_next_write - b->offset_last_fsync;
+    return bound;
+}
+
+int
+durable_log :: create_segment(uint64_t segno)
+{
+    int fd = openat(m_dir.get(), segment_name(segno).c_str(),
+                    O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
 
-    if (a_unflushed < b_unflushed)
+    if (fd >= 0 && fsync(m_dir.get()) < 0)
     {
-        return b;
+        int e = errno;
+        ::close(fd);
+        errno = e;
+        return -1;
     }
-    else if (a_unflushed > b_unflushed)
+
+    return fd;
+}
+
+bool
+durable_log :: scan_segment(uint64_t segno, int64_t lower, sealed* s)
+{
+    int fd = openat(m_dir.get(), segment_name(segno).c_str(), O_RDWR);
+
+    if (fd < 0)
     {
-        return a;
+        return false;
     }
-    else if (a_unflushed > 0)
+
+    reader r(fd);
+    int64_t upper = 0;
+
+    while (r.next())
     {
-        return a;
+        upper = std::max(upper, r.recno());
     }
-    else if (b_unflushed > 0)
+
+    // drop a torn tail so that appends never follow garbage
+    if (r.end() < r.file_size() &&
+        (ftruncate(r.fd(), r.end()) < 0 || fsync(r.fd()) < 0))
     {
-        return b;
+        return false;
     }
-    else
+
+    *s = sealed(segno, lower, upper);
+    return true;
+}
+
+bool
+durable_log :: read_index(std::vector<index_entry>* idx)
+{
+    idx->clear();
+    po6::io::fd fd(openat(m_dir.get(), INDEX_FILE, O_RDONLY));
+
+    if (fd.get() < 0)
     {
-        return NULL;
+        // a fresh log has no index
+        return errno == ENOENT;
+    }
+
+    struct stat st;
+
+    if (fstat(fd.get(), &st) < 0)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> buf(st.st_size);
+
+    if (buf.size() < sizeof(uint64_t) + sizeof(uint32_t) ||
+        fd.xread(&buf[0], buf.size()) != ssize_t(buf.size()))
+    {
+        errno = EIO;
+        return false;
+    }
+
+    const size_t body_sz = buf.size() - sizeof(uint32_t);
+    uint32_t crc;
+    uint64_t count;
+    e::unpack32be(&buf[body_sz], &crc);
+    e::unpack64be(&buf[0], &count);
+
+    if (crc != crc32c(0, &buf[0], body_sz) ||
+        count != (body_sz - sizeof(uint64_t)) / (2 * sizeof(uint64_t)))
+    {
+        errno = EIO;
+        return false;
     }
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        const unsigned char* ptr = &buf[sizeof(uint64_t) + i * 2 * sizeof(uint64_t)];
+        uint64_t segno;
+        uint64_t lower;
+        e::unpack64be(ptr, &segno);
+        e::unpack64be(ptr + sizeof(uint64_t), &lower);
+        idx->push_back(index_entry(segno, lower));
+    }
+
+    return true;
 }
 
-int64_t
-durable_log :: durable_lock_held_elsewhere()
+bool
+durable_log :: write_index(const std::vector<index_entry>& idx)
+{
+    std::vector<unsigned char> buf(sizeof(uint64_t)
+                                   + idx.size() * 2 * sizeof(uint64_t)
+                                   + sizeof(uint32_t));
+    e::pack64be(idx.size(), &buf[0]);
+
+    for (size_t i = 0; i < idx.size(); ++i)
+    {
+        unsigned char* ptr = &buf[sizeof(uint64_t) + i * 2 * sizeof(uint64_t)];
+        e::pack64be(idx[i].segno, ptr);
+        e::pack64be(idx[i].lower, ptr + sizeof(uint64_t));
+    }
+
+    const size_t body_sz = buf.size() - sizeof(uint32_t);
+    e::pack32be(crc32c(0, &buf[0], body_sz), &buf[body_sz]);
+
+    // write-then-rename so a crash leaves either the old or the new index
+    po6::io::fd fd(openat(m_dir.get(), INDEX_TEMP, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR));
+
+    if (fd.get() < 0 ||
+        fd.xwrite(&buf[0], buf.size()) != ssize_t(buf.size()) ||
+        fsync(fd.get()) < 0 ||
+        renameat(m_dir.get(), INDEX_TEMP, m_dir.get(), INDEX_FILE) < 0 ||
+        fsync(m_dir.get()) < 0)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool
+durable_log :: rotate(segment* seg)
 {
-    segment* a = m_segment_a;
-    segment* b = m_segment_b;
-    assert(a->offset_next_write >= a->offset_last_fsync);
-    assert(b->offset_next_write >= b->offset_last_fsync);
+    uint64_t segno;
+    int64_t lower;
 
-    if (a->recno_last_fsync > b->recno_last_fsync)
     {
-        std::swap(a, b);
+        po6::threads::mutex::hold hold(&m_mtx);
+        assert(seg->syncing);
+        assert(seg->ongoing_writes == 0);
+        segno = m_next_segno++;
+        lower = m_next_entry;
     }
 
-    if (a->offset_next_write - a->offset_last_fsync > 0)
+    int fd = create_segment(segno);
+
+    if (fd < 0)
     {
-        return a->recno_last_fsync + 1;
+        return false;
+    }
+
+    std::vector<index_entry> idx;
+    po6::threads::mutex::hold hold_index(&m_index_mtx);
+
+    {
+        po6::threads::mutex::hold hold(&m_mtx);
+        m_sealed.push_back(sealed(seg->segno, seg->lower, seg->recno_last_write));
+        seg->segno = segno;
+        seg->lower = lower;
+        seg->fd = fd;
+        seg->offset_next_write = 0;
+        seg->offset_last_fsync = 0;
+        snapshot_index(&idx);
+    }
+
+    // the new segment must be in the index before it takes any appends
+    bool ret = write_index(idx);
+    int e = errno;
+    po6::threads::mutex::hold hold(&m_mtx);
+    seg->syncing = false;
+    m_cond.broadcast();
+    errno = e;
+    return ret;
+}
+
+bool
+durable_log :: remove_truncated()
+{
+    std::vector<uint64_t> victims;
+    std::vector<index_entry> idx;
+    po6::threads::mutex::hold hold_index(&m_index_mtx);
+
+    {
+        po6::threads::mutex::hold hold(&m_mtx);
+        size_t w = 0;
+
+        for (size_t r = 0; r < m_sealed.size(); ++r)
+        {
+            if (m_sealed[r].upper < m_truncate_below)
+            {
+                victims.push_back(m_sealed[r].segno);
+            }
+            else
+            {
+                m_sealed[w] = m_sealed[r];
+                ++w;
+            }
+        }
+
+        m_sealed.resize(w);
+        snapshot_index(&idx);
+    }
+
+    if (victims.empty())
+    {
+        return true;
+    }
+
+    // drop the segments from the index first so it never names missing files
+    if (!write_index(idx))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < victims.size(); ++i)
+    {
+        if (unlinkat(m_dir.get(), segment_name(victims[i]).c_str(), 0) < 0 &&
+            errno != ENOENT)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+durable_log :: snapshot_index(std::vector<index_entry>* idx)
+{
+    idx->clear();
+
+    for (size_t i = 0; i < m_sealed.size(); ++i)
+    {
+        idx->push_back(index_entry(m_sealed[i].segno, m_sealed[i].lower));
+    }
+
+    for (size_t i = 0; i < m_segments.size(); ++i)
+    {
+        idx->push_back(index_entry(m_segments[i]->segno, m_segments[i]->lower));
+    }
+}
+
+bool
+durable_log :: truncation_pending()
+{
+    for (size_t i = 0; i < m_sealed.size(); ++i)
+    {
+        if (m_sealed[i].upper < m_truncate_below)
+        {
+            return true;
+        }
     }
 
-    return b->recno_last_fsync + 1;
+    return false;
 }
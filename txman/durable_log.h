@@ -43,6 +43,7 @@
 #include <po6/threads/thread.h>
 
 // e
+#include <e/compat.h>
 #include <e/lockfile.h>
 
 // consus
@@ -57,22 +58,66 @@ class durable_log
         ~durable_log() throw ();
 
     public:
-        bool open(const std::string& dir);
+        // Appends are spread across "segments" files, of which all but one
+        // may be fsync'd at once.  Two segments is the classic ping-pong.
+        bool open(const std::string& dir, unsigned segments);
         void close();
         int64_t append(const char* entry, size_t entry_sz);
         int64_t append(const unsigned char* entry, size_t entry_sz);
-        int64_t replay(void (*f)(void*, const unsigned char*, size_t), void* p);
+        // Hand every record recovered by open() to f, in record number order.
+        // Must be called before the first append.  Returns the number of
+        // records replayed, or -1 on error.
+        int64_t replay(void (*f)(void*, int64_t, const unsigned char*, size_t), void* p);
+        // Records below lower_bound are no longer needed; segments containing
+        // only such records will be removed in the background.
+        void truncate(int64_t lower_bound);
+        // The highest record number truncate(lower_bound) may remove, or -1
+        // if it would remove nothing.
+        int64_t truncation_limit(int64_t lower_bound);
         int64_t durable();
         int64_t wait(int64_t prev_ub);
         void wake();
         int error();
+        std::string debug_dump();
 
     private:
         class segment;
+        class reader;
+        struct writer;
+        // a segment that no longer receives appends
+        struct sealed
+        {
+            sealed() : segno(0), lower(0), upper(0) {}
+            sealed(uint64_t s, int64_t l, int64_t u) : segno(s), lower(l), upper(u) {}
+            uint64_t segno;
+            int64_t lower;
+            int64_t upper;
+        };
+        // what the INDEX file records for each segment:  no record in the
+        // segment has a record number below "lower"
+        struct index_entry
+        {
+            index_entry() : segno(0), lower(0) {}
+            index_entry(uint64_t s, int64_t l) : segno(s), lower(l) {}
+            uint64_t segno;
+            int64_t lower;
+        };
         void flush();
         segment* select_segment_write();
         segment* select_segment_fsync();
         int64_t durable_lock_held_elsewhere();
+        static int write_records(int fd, std::vector<writer*>* ws);
+        // segment management; called without m_mtx held
+        int create_segment(uint64_t segno);
+        bool scan_segment(uint64_t segno, int64_t lower, sealed* s);
+        bool read_index(std::vector<index_entry>* idx);
+        bool write_index(const std::vector<index_entry>& idx);
+        bool rotate(segment* seg);
+        bool remove_truncated();
+        // called with m_mtx held
+        void snapshot_index(std::vector<index_entry>* idx);
+        bool truncation_pending();
+        void adapt_sync_limit(uint64_t elapsed, bool overlapped);
 
     private:
         std::string m_path;
@@ -80,12 +125,26 @@ class durable_log
         e::lockfile m_lockfile;
         po6::threads::mutex m_mtx;
         po6::threads::cond m_cond;
-        po6::threads::thread m_flush;
+        std::vector<e::compat::shared_ptr<po6::threads::thread> > m_flushers;
         int m_error;
         bool m_wakeup;
         uint64_t m_next_entry;
-        segment* m_segment_a;
-        segment* m_segment_b;
+        uint64_t m_next_segno;
+        std::vector<segment*> m_segments;
+        std::vector<sealed> m_sealed;
+        int64_t m_truncate_below;
+        bool m_truncating;
+        // serializes INDEX rewrites; acquired before m_mtx
+        po6::threads::mutex m_index_mtx;
+
+        // adaptive flush policy:  overlapping fsyncs cuts latency only if the
+        // device can service them in parallel; otherwise it just shrinks
+        // each batch.  m_sync_limit tracks how many fsyncs may be in flight.
+        unsigned m_syncs;
+        unsigned m_sync_limit;
+        uint64_t m_fsync_solo;
+        uint64_t m_fsync_overlap;
+        uint64_t m_fsyncs_since_probe;
 
     private:
         durable_log(const durable_log&);
@@ -150,6 +150,7 @@ global_voter :: global_voter(const transaction_group& tg)
     , m_global_exec()
     , m_has_outcome(false)
     , m_outcome(0)
+    , m_wakeup()
 {
     for (unsigned i = 0; i < CONSUS_MAX_REPLICATION_FACTOR; ++i)
     {
@@ -253,7 +254,7 @@ global_voter :: propose(const generalized_paxos::command& c, daemon* d)
         std::string entry;
         e::packer(&entry)
             << LOG_ENTRY_GLOBAL_PROPOSE << m_tg << c;
-        int64_t id = d->m_log.append(entry.data(), entry.size());
+        int64_t id = d->append_to_log(entry);
         m_highest_log_entry = std::max(m_highest_log_entry, id);
         work_state_machine(d);
     }
@@ -289,7 +290,7 @@ global_voter :: process_p1a(comm_id id, const generalized_paxos::message_p1a& m,
         std::string entry;
         e::packer(&entry)
             << LOG_ENTRY_GLOBAL_VOTE_1A << m_tg << m;
-        int64_t x = d->m_log.append(entry.data(), entry.size());
+        int64_t x = d->append_to_log(entry);
         m_highest_log_entry = std::max(m_highest_log_entry, x);
         LOG_IF(INFO, s_debug_mode) << logid() << "following " << ph(m.b);
     }
@@ -358,7 +359,7 @@ global_voter :: process_p2a(comm_id id, const generalized_paxos::message_p2a& m,
         std::string entry;
         e::packer(&entry)
             << LOG_ENTRY_GLOBAL_VOTE_2A << m_tg << m;
-        int64_t x = d->m_log.append(entry.data(), entry.size());
+        int64_t x = d->append_to_log(entry);
         m_highest_log_entry = std::max(m_highest_log_entry, x);
         LOG_IF(INFO, s_debug_mode)
             << logid() << ph(m.b)
@@ -379,6 +380,7 @@ global_voter :: process_p2a(comm_id id, const generalized_paxos::message_p2a& m,
         d->send_when_durable(m_highest_log_entry, m_tg.group, msg);
         m_outer_rate_m2b = r;
         m_outer_rate_m2b_timestamp = now;
+        schedule_wakeup(now, d);
     }
 
     work_state_machine(d);
@@ -402,7 +404,7 @@ global_voter :: process_p2b(const generalized_paxos::message_p2b& m, daemon* d)
         std::string entry;
         e::packer(&entry)
             << LOG_ENTRY_GLOBAL_VOTE_2B << m_tg << m;
-        int64_t x = d->m_log.append(entry.data(), entry.size());
+        int64_t x = d->append_to_log(entry);
         m_highest_log_entry = std::max(m_highest_log_entry, x);
         LOG_IF(INFO, s_debug_mode)
             << logid() << comm_id(m.acceptor.get())
@@ -414,6 +416,94 @@ global_voter :: process_p2b(const generalized_paxos::message_p2b& m, daemon* d)
     return m_has_outcome;
 }
 
+void
+global_voter :: replay(int64_t recno, log_entry_t t, e::unpacker up, daemon* d)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (!preconditions_for_data_center_paxos(d))
+    {
+        return;
+    }
+
+    switch (t)
+    {
+        case LOG_ENTRY_GLOBAL_PROPOSE:
+        {
+            generalized_paxos::command c;
+            up = up >> c;
+
+            if (!up.error())
+            {
+                m_data_center_gp.propose(c);
+            }
+
+            break;
+        }
+        case LOG_ENTRY_GLOBAL_VOTE_1A:
+        {
+            generalized_paxos::message_p1a m;
+            generalized_paxos::message_p1b r;
+            bool send = false;
+            up = up >> m;
+
+            if (!up.error())
+            {
+                m_data_center_gp.process_p1a(m, &send, &r);
+            }
+
+            break;
+        }
+        case LOG_ENTRY_GLOBAL_VOTE_2A:
+        {
+            generalized_paxos::message_p2a m;
+            generalized_paxos::message_p2b r;
+            bool send = false;
+            up = up >> m;
+
+            if (!up.error())
+            {
+                m_data_center_gp.process_p2a(m, &send, &r);
+            }
+
+            break;
+        }
+        case LOG_ENTRY_GLOBAL_VOTE_2B:
+        {
+            generalized_paxos::message_p2b m;
+            up = up >> m;
+
+            if (!up.error())
+            {
+                m_data_center_gp.process_p2b(m);
+            }
+
+            break;
+        }
+        case LOG_ENTRY_TX_BEGIN:
+        case LOG_ENTRY_TX_READ:
+        case LOG_ENTRY_TX_WRITE:
+        case LOG_ENTRY_TX_PREPARE:
+        case LOG_ENTRY_TX_BATCH:
+        case LOG_ENTRY_TX_ABORT:
+        case LOG_ENTRY_LOCAL_VOTE_1A:
+        case LOG_ENTRY_LOCAL_VOTE_2A:
+        case LOG_ENTRY_LOCAL_LEARN:
+        case LOG_ENTRY_CONFIG:
+        case LOG_ENTRY_NOP:
+        default:
+            ::abort();
+    }
+
+    if (up.error())
+    {
+        LOG(ERROR) << logid() << "dropping corrupt " << t << " log entry";
+        return;
+    }
+
+    m_highest_log_entry = std::max(m_highest_log_entry, recno);
+}
+
 void
 global_voter :: externally_work_state_machine(daemon* d)
 {
@@ -714,6 +804,7 @@ global_voter :: work_state_machine(daemon* d)
         d->send_when_durable(m_highest_log_entry, m_tg.group, msg);
         m_outer_rate_m1a = m1;
         m_outer_rate_m1a_timestamp = now;
+        schedule_wakeup(now, d);
     }
 
     if (send_m2 &&
@@ -733,6 +824,7 @@ global_voter :: work_state_machine(daemon* d)
         d->send_when_durable(m_highest_log_entry, m_tg.group, msg);
         m_outer_rate_m2a = m2;
         m_outer_rate_m2a_timestamp = now;
+        schedule_wakeup(now, d);
     }
 
     if (send_m3 &&
@@ -752,6 +844,7 @@ global_voter :: work_state_machine(daemon* d)
         d->send_when_durable(m_highest_log_entry, m_tg.group, msg);
         m_outer_rate_m2b = m3;
         m_outer_rate_m2b_timestamp = now;
+        schedule_wakeup(now, d);
     }
 
     if (!preconditions_for_global_paxos(d))
@@ -770,6 +863,7 @@ global_voter :: work_state_machine(daemon* d)
         propose_global(cg, d))
     {
         m_rate_vote_timestamp = now;
+        schedule_wakeup(now, d);
     }
 
     generalized_paxos::cstruct dc_learned = m_data_center_gp.learned();
@@ -944,6 +1038,7 @@ global_voter :: send_global(const generalized_paxos::message_p1a& m, daemon* d)
             LOG_IF(INFO, s_debug_mode) << XXX() << m_tg.group << " leading " << ph(m.b);
             m_inner_rate_m1a = m;
             m_inner_rate_m1a_timestamp = now;
+            schedule_wakeup(now, d);
         }
     }
 }
@@ -965,6 +1060,7 @@ global_voter :: send_global(const generalized_paxos::message_p1b& m, daemon* d)
             LOG_IF(INFO, s_debug_mode) << XXX() << m_tg.group << " following " << ph(m.b);
             m_inner_rate_m1b = m;
             m_inner_rate_m1b_timestamp = now;
+            schedule_wakeup(now, d);
         }
     }
 }
@@ -986,6 +1082,7 @@ global_voter :: send_global(const generalized_paxos::message_p2a& m, daemon* d)
             LOG_IF(INFO, s_debug_mode) << XXX() << m_tg.group << " proposing " << pretty_print_inner(m.v);
             m_inner_rate_m2a = m;
             m_inner_rate_m2a_timestamp = now;
+            schedule_wakeup(now, d);
         }
     }
 }
@@ -1007,6 +1104,7 @@ global_voter :: send_global(const generalized_paxos::message_p2b& m, daemon* d)
             LOG_IF(INFO, s_debug_mode) << XXX() << m_tg.group << " accepted " << pretty_print_inner(m.v);
             m_inner_rate_m2b = m;
             m_inner_rate_m2b_timestamp = now;
+            schedule_wakeup(now, d);
         }
     }
 }
@@ -1038,6 +1136,13 @@ global_voter :: propose_global(const generalized_paxos::command& c, daemon* d)
     return true;
 }
 
+void
+global_voter :: schedule_wakeup(uint64_t now, daemon* d)
+{
+    const uint64_t when = now + d->resend_interval() + 1;
+    m_wakeup.no_earlier_than(d, daemon::PUMP_GLOBAL_VOTER, m_tg, when);
+}
+
 uint64_t
 global_voter :: tally_votes(const char* prefix, const generalized_paxos::cstruct& votes)
 {
@@ -33,8 +33,10 @@
 
 // consus
 #include "namespace.h"
+#include "common/timer_wheel.h"
 #include "common/transaction_group.h"
 #include "txman/generalized_paxos.h"
+#include "txman/log_entry_t.h"
 
 BEGIN_CONSUS_NAMESPACE
 class daemon;
@@ -67,6 +69,8 @@ class global_voter
         bool process_p1b(const generalized_paxos::message_p1b& m, daemon* d);
         bool process_p2a(comm_id id, const generalized_paxos::message_p2a& m, daemon* d);
         bool process_p2b(const generalized_paxos::message_p2b& m, daemon* d);
+        // rebuild data center paxos state from this server's own durable log
+        void replay(int64_t recno, log_entry_t t, e::unpacker up, daemon* d);
         void externally_work_state_machine(daemon* d);
         bool outcome(uint64_t* v);
         void unvoted_data_centers(paxos_group_id* dcs, size_t* dcs_sz);
@@ -89,6 +93,7 @@ class global_voter
         void send_global(const generalized_paxos::message_p2a& m, daemon* d);
         void send_global(const generalized_paxos::message_p2b& m, daemon* d);
         bool propose_global(const generalized_paxos::command& c, daemon* d);
+        void schedule_wakeup(uint64_t now, daemon* d);
         uint64_t tally_votes(const char* prefix, const generalized_paxos::cstruct& v);
 
     private:
@@ -131,6 +136,8 @@ class global_voter
         // outcome
         bool m_has_outcome;
         uint64_t m_outcome;
+        // when the pumping thread will next revisit this voter
+        pump_wakeup m_wakeup;
 
     private:
         global_voter(const global_voter&);
@@ -80,7 +80,7 @@ kvs_lock_op :: doit(lock_op op, const e::slice& table, const e::slice& key, cons
     msg->pack_at(BUSYBEE_HEADER_SIZE)
         << KVS_LOCK_OP << m_state_key << table << key << tg << op;
     configuration* c = d->get_config();
-    comm_id kvs = c->choose_kvs(d->m_us.dc);
+    comm_id kvs = c->choose_kvs(d->m_us.dc, table, key, m_state_key);
     d->send(kvs, msg);
     po6::threads::mutex::hold hold(&m_mtx);
     m_init = true;
@@ -82,7 +82,7 @@ kvs_read :: read(const e::slice& table, const e::slice& key, uint64_t timestamp,
     msg->pack_at(BUSYBEE_HEADER_SIZE)
         << KVS_REP_RD << m_state_key << table << key << timestamp;
     configuration* c = d->get_config();
-    comm_id kvs = c->choose_kvs(d->m_us.dc);
+    comm_id kvs = c->choose_kvs(d->m_us.dc, table, key, m_state_key);
     d->send(kvs, msg);
     po6::threads::mutex::hold hold(&m_mtx);
     m_init = true;
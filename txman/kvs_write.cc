@@ -89,7 +89,7 @@ kvs_write :: write(unsigned flags,
     msg->pack_at(BUSYBEE_HEADER_SIZE)
         << KVS_REP_WR << m_state_key << uint8_t(flags) << table << key << timestamp << value;
     configuration* c = d->get_config();
-    comm_id kvs = c->choose_kvs(d->m_us.dc);
+    comm_id kvs = c->choose_kvs(d->m_us.dc, table, key, m_state_key);
     d->send(kvs, msg);
     po6::threads::mutex::hold hold(&m_mtx);
     m_init = true;
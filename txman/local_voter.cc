@@ -77,6 +77,7 @@ local_voter :: local_voter(const transaction_group& tg)
     , m_has_outcome(false)
     , m_outcome(0)
     , m_outcome_in_dispositions(false)
+    , m_wakeup()
 {
     po6::threads::mutex::hold hold(&m_mtx);
 
@@ -280,7 +281,7 @@ local_voter :: vote_2b(comm_id id, unsigned idx,
         std::string entry;
         e::packer(&entry)
             << LOG_ENTRY_LOCAL_LEARN << m_tg << uint8_t(idx) << m_votes[idx].learned();
-        d->m_log.append(entry.data(), entry.size());
+        d->append_to_log(entry);
         LOG_IF(INFO, s_debug_mode) << logid() << " instance[" << idx << "] decided to " << value_to_string(p.v) << "; overall votes are " << votes();
     }
 
@@ -313,7 +314,7 @@ local_voter :: vote_learn(unsigned idx, uint64_t v, daemon* d)
         std::string entry;
         e::packer(&entry)
             << LOG_ENTRY_LOCAL_LEARN << m_tg << uint8_t(idx) << v;
-        d->m_log.append(entry.data(), entry.size());
+        d->append_to_log(entry);
         log = true;
     }
 
@@ -322,6 +323,85 @@ local_voter :: vote_learn(unsigned idx, uint64_t v, daemon* d)
     work_state_machine(d);
 }
 
+void
+local_voter :: replay(log_entry_t t, e::unpacker up, daemon* d)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (!preconditions_for_paxos(d))
+    {
+        return;
+    }
+
+    uint8_t idx;
+    up = up >> idx;
+
+    if (up.error() || idx >= m_group.members_sz)
+    {
+        LOG(ERROR) << logid() << " dropping corrupt " << t << " log entry";
+        return;
+    }
+
+    switch (t)
+    {
+        case LOG_ENTRY_LOCAL_VOTE_1A:
+        {
+            paxos_synod::ballot b;
+            paxos_synod::ballot a;
+            paxos_synod::pvalue p;
+            up = up >> b;
+
+            if (!up.error())
+            {
+                m_votes[idx].phase1a(b, &a, &p);
+            }
+
+            break;
+        }
+        case LOG_ENTRY_LOCAL_VOTE_2A:
+        {
+            paxos_synod::pvalue p;
+            bool send = false;
+            up = up >> p;
+
+            if (!up.error())
+            {
+                m_votes[idx].phase2a(p, &send);
+            }
+
+            break;
+        }
+        case LOG_ENTRY_LOCAL_LEARN:
+        {
+            uint64_t v;
+            up = up >> v;
+
+            if (!up.error())
+            {
+                m_votes[idx].force_learn(v);
+            }
+
+            break;
+        }
+        case LOG_ENTRY_TX_BEGIN:
+        case LOG_ENTRY_TX_READ:
+        case LOG_ENTRY_TX_WRITE:
+        case LOG_ENTRY_TX_PREPARE:
+        case LOG_ENTRY_TX_BATCH:
+        case LOG_ENTRY_TX_ABORT:
+        case LOG_ENTRY_GLOBAL_PROPOSE:
+        case LOG_ENTRY_GLOBAL_VOTE_1A:
+        case LOG_ENTRY_GLOBAL_VOTE_2A:
+        case LOG_ENTRY_GLOBAL_VOTE_2B:
+        case LOG_ENTRY_CONFIG:
+        case LOG_ENTRY_NOP:
+        default:
+            ::abort();
+    }
+
+    LOG_IF(ERROR, up.error()) << logid() << " instance[" << unsigned(idx) << "] dropping corrupt " << t << " log entry";
+}
+
 void
 local_voter :: externally_work_state_machine(daemon* d)
 {
@@ -513,6 +593,7 @@ local_voter :: work_paxos_vote(unsigned idx, daemon* d, uint64_t preference)
                 d->send(m_group, msg);
                 m_phases[idx] = paxos_synod::PHASE1;
                 m_timestamps[idx] = now;
+                schedule_wakeup(now, d);
             }
 
             break;
@@ -527,6 +608,7 @@ local_voter :: work_paxos_vote(unsigned idx, daemon* d, uint64_t preference)
                 d->send(m_group, msg);
                 m_phases[idx] = paxos_synod::PHASE2;
                 m_timestamps[idx] = now;
+                schedule_wakeup(now, d);
             }
 
             break;
@@ -539,6 +621,7 @@ local_voter :: work_paxos_vote(unsigned idx, daemon* d, uint64_t preference)
                 d->send(m_group, msg);
                 m_phases[idx] = paxos_synod::LEARNED;
                 m_timestamps[idx] = now;
+                schedule_wakeup(now, d);
             }
 
             break;
@@ -546,3 +629,10 @@ local_voter :: work_paxos_vote(unsigned idx, daemon* d, uint64_t preference)
             ::abort();
     }
 }
+
+void
+local_voter :: schedule_wakeup(uint64_t now, daemon* d)
+{
+    const uint64_t when = now + d->resend_interval() + 1;
+    m_wakeup.no_earlier_than(d, daemon::PUMP_LOCAL_VOTER, m_tg, when);
+}
@@ -33,7 +33,9 @@
 
 // consus
 #include "namespace.h"
+#include "common/timer_wheel.h"
 #include "common/transaction_group.h"
+#include "txman/log_entry_t.h"
 #include "txman/paxos_synod.h"
 
 BEGIN_CONSUS_NAMESPACE
@@ -59,6 +61,8 @@ class local_voter
         void vote_2a(comm_id id, unsigned idx, const paxos_synod::pvalue& p, daemon* d);
         void vote_2b(comm_id id, unsigned idx, const paxos_synod::pvalue& p, daemon* d);
         void vote_learn(unsigned idx, uint64_t v, daemon* d);
+        // rebuild acceptor state from this server's own durable log
+        void replay(log_entry_t t, e::unpacker up, daemon* d);
         void externally_work_state_machine(daemon* d);
         bool outcome(uint64_t* v);
         uint64_t outcome();
@@ -69,6 +73,7 @@ class local_voter
         bool preconditions_for_paxos(daemon* d);
         void work_state_machine(daemon* d);
         void work_paxos_vote(unsigned idx, daemon* d, uint64_t preferred);
+        void schedule_wakeup(uint64_t now, daemon* d);
 
     private:
         const transaction_group m_tg;
@@ -83,6 +88,7 @@ class local_voter
         bool m_has_outcome;
         uint64_t m_outcome;
         bool m_outcome_in_dispositions;
+        pump_wakeup m_wakeup;
 
     private:
         local_voter(const local_voter&);
@@ -40,11 +40,13 @@ consus :: is_paxos_2a_log_entry(log_entry_t t)
         case LOG_ENTRY_TX_READ:
         case LOG_ENTRY_TX_WRITE:
         case LOG_ENTRY_TX_PREPARE:
+        case LOG_ENTRY_TX_BATCH:
         case LOG_ENTRY_TX_ABORT:
             return true;
         case LOG_ENTRY_LOCAL_VOTE_1A:
         case LOG_ENTRY_LOCAL_VOTE_2A:
         case LOG_ENTRY_LOCAL_LEARN:
+        case LOG_ENTRY_DISPOSITION:
         case LOG_ENTRY_GLOBAL_PROPOSE:
         case LOG_ENTRY_GLOBAL_VOTE_1A:
         case LOG_ENTRY_GLOBAL_VOTE_2A:
@@ -66,10 +68,12 @@ consus :: operator << (std::ostream& lhs, const log_entry_t& rhs)
         STRINGIFY(LOG_ENTRY_TX_READ);
         STRINGIFY(LOG_ENTRY_TX_WRITE);
         STRINGIFY(LOG_ENTRY_TX_PREPARE);
+        STRINGIFY(LOG_ENTRY_TX_BATCH);
         STRINGIFY(LOG_ENTRY_TX_ABORT);
         STRINGIFY(LOG_ENTRY_LOCAL_VOTE_1A);
         STRINGIFY(LOG_ENTRY_LOCAL_VOTE_2A);
         STRINGIFY(LOG_ENTRY_LOCAL_LEARN);
+        STRINGIFY(LOG_ENTRY_DISPOSITION);
         STRINGIFY(LOG_ENTRY_GLOBAL_PROPOSE);
         STRINGIFY(LOG_ENTRY_GLOBAL_VOTE_1A);
         STRINGIFY(LOG_ENTRY_GLOBAL_VOTE_2A);
@@ -47,10 +47,12 @@ enum log_entry_t
     LOG_ENTRY_TX_READ       = 7938,
     LOG_ENTRY_TX_WRITE      = 7939,
     LOG_ENTRY_TX_PREPARE    = 7940,
+    LOG_ENTRY_TX_BATCH      = 7941,
     LOG_ENTRY_TX_ABORT      = 7943,
     LOG_ENTRY_LOCAL_VOTE_1A = 7944,
     LOG_ENTRY_LOCAL_VOTE_2A = 7946,
     LOG_ENTRY_LOCAL_LEARN   = 7947,
+    LOG_ENTRY_DISPOSITION   = 7948,
     LOG_ENTRY_GLOBAL_PROPOSE = 8000,
     LOG_ENTRY_GLOBAL_VOTE_1A = 8001,
     LOG_ENTRY_GLOBAL_VOTE_2A = 8002,
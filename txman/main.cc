@@ -68,6 +68,7 @@ main(int argc, const char* argv[])
     const char* pidfile = "";
     bool has_pidfile = false;
     long threads = 0;
+    long log_segments = 2;
     bool log_immediate = false;
     sigset_t ss;
 
@@ -108,6 +109,9 @@ main(int argc, const char* argv[])
     ap.arg().name('t', "threads")
             .description("the number of threads which will handle network traffic")
             .metavar("N").as_long(&threads);
+    ap.arg().long_name("log-segments")
+            .description("spread the durable log across this many files so fsyncs can overlap (default: 2)")
+            .metavar("N").as_long(&log_segments);
     ap.arg().long_name("log-immediate")
             .description("immediately flush all log output")
             .set_true(&log_immediate).hidden();
@@ -204,6 +208,12 @@ main(int argc, const char* argv[])
         return EXIT_FAILURE;
     }
 
+    if (log_segments < 2 || log_segments > 64)
+    {
+        std::cerr << "log-segments must be between 2 and 64" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     try
     {
         consus::daemon d;
@@ -213,7 +223,7 @@ main(int argc, const char* argv[])
                      std::string(pidfile), has_pidfile,
                      listen, bind_to,
                      conn.isset(), conn.conn_str(),
-                     data_center, threads);
+                     data_center, threads, log_segments);
     }
     catch (std::exception& e)
     {
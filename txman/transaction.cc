@@ -28,6 +28,7 @@
 #define __STDC_LIMIT_MACROS
 
 // STL
+#include <algorithm>
 #include <sstream>
 #include <string>
 
@@ -44,6 +45,7 @@
 // consus
 #include "common/consus.h"
 #include "common/ids.h"
+#include "txman/batch_entry.h"
 #include "txman/daemon.h"
 #include "txman/log_entry_t.h"
 #include "txman/transaction.h"
@@ -121,6 +123,8 @@ struct transaction :: operation
     e::slice value;
     consus_returncode rc;
     e::compat::shared_ptr<e::buffer> backing;
+    // set on the first operation of a batch to one past its last slot
+    uint64_t batch_end;
 
     // locking
     bool require_lock;
@@ -169,6 +173,7 @@ transaction :: operation :: operation()
     , value()
     , rc(CONSUS_GARBAGE)
     , backing()
+    , batch_end(0)
     , require_lock(false)
     , lock_acquired(false)
     , lock_released(false)
@@ -251,6 +256,7 @@ transaction :: transaction(const transaction_group& tg)
     , m_prefer_to_commit(true)
     , m_ops()
     , m_deferred_2b()
+    , m_wakeup()
 {
     po6::threads::mutex::hold hold(&m_mtx);
 
@@ -376,6 +382,7 @@ transaction :: internal_begin(const char* source, uint64_t timestamp,
         m_init_timestamp = timestamp;
         m_timestamp = std::max(m_timestamp, timestamp); // XXX replay
         m_group = group;
+        d->track_begin(m_tg, timestamp);
 
         for (unsigned i = 0; i < dcs.size() && i < CONSUS_MAX_REPLICATION_FACTOR; ++i)
         {
@@ -610,15 +617,182 @@ transaction :: internal_write(const char* source, uint64_t seqno,
 }
 
 void
-transaction :: prepare(comm_id id, uint64_t nonce, uint64_t seqno, daemon* d)
+transaction :: multi_read(comm_id id, uint64_t nonce, uint64_t seqno,
+                          const e::slice& table,
+                          const std::vector<e::slice>& keys,
+                          std::auto_ptr<e::buffer> _backing,
+                          daemon* d)
 {
+    e::compat::shared_ptr<e::buffer> backing(_backing.release());
+    po6::threads::mutex::hold hold(&m_mtx);
+    CLIENT_RETURN_IF_EXECUTED(seqno, id, nonce, "multi-read");
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        internal_read("client", seqno + i, table, keys[i], backing, d);
+    }
+
+    if (!set_batch(seqno, keys.size()))
+    {
+        INVARIANT_VIOLATION("multi-read");
+        avoid_commit_if_possible(d);
+        return;
+    }
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        m_ops[seqno + i].require_lock = true;
+        m_ops[seqno + i].require_read = true;
+    }
+
+    m_ops[seqno].set_client(id, nonce);
+    work_state_machine(d);
+}
+
+void
+transaction :: multi_write(comm_id id, uint64_t nonce, uint64_t seqno,
+                           const e::slice& table,
+                           const std::vector<e::slice>& keys,
+                           const std::vector<e::slice>& values,
+                           std::auto_ptr<e::buffer> _backing,
+                           daemon* d)
+{
+    assert(keys.size() == values.size());
+    e::compat::shared_ptr<e::buffer> backing(_backing.release());
     po6::threads::mutex::hold hold(&m_mtx);
-    CLIENT_RETURN_IF_EXECUTED(seqno, id, nonce, "prepare");
-    internal_end_of_transaction("client", "prepare", LOG_ENTRY_TX_PREPARE, seqno, d);
+    CLIENT_RETURN_IF_EXECUTED(seqno, id, nonce, "multi-write");
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        internal_write("client", seqno + i, table, keys[i], values[i], backing, d);
+    }
+
+    if (!set_batch(seqno, keys.size()))
+    {
+        INVARIANT_VIOLATION("multi-write");
+        avoid_commit_if_possible(d);
+        return;
+    }
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        m_ops[seqno + i].require_lock = true;
+        m_ops[seqno + i].require_write = true;
+    }
+
     m_ops[seqno].set_client(id, nonce);
     work_state_machine(d);
 }
 
+void
+transaction :: paxos_2a_batch(uint64_t seqno,
+                              e::unpacker up,
+                              std::auto_ptr<e::buffer> _backing,
+                              daemon* d)
+{
+    e::compat::shared_ptr<e::buffer> backing(_backing.release());
+    po6::threads::mutex::hold hold(&m_mtx);
+    internal_batch("paxos 2a", seqno, up, backing, d);
+    work_state_machine(d);
+}
+
+// A batch entry holds the log entries of its operations, each packed as a
+// slice, just like a commit record does.  See parse_batch_entry.
+void
+transaction :: internal_batch(const char* source, uint64_t seqno,
+                              e::unpacker up,
+                              e::compat::shared_ptr<e::buffer> backing,
+                              daemon* d)
+{
+    ensure_initialized();
+    INTERNAL_RETURN_IF_EXECUTED(seqno, source, "batch");
+    std::vector<batch_operation> ops;
+
+    if (!parse_batch_entry(up, m_tg, seqno, &ops))
+    {
+        UNPACK_ERROR(std::string(source) + "::batch");
+        avoid_commit_if_possible(d);
+        return;
+    }
+
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        const batch_operation& op(ops[i]);
+
+        if (op.type == LOG_ENTRY_TX_READ)
+        {
+            internal_read(source, op.seqno, op.table, op.key, backing, d);
+        }
+        else
+        {
+            internal_write(source, op.seqno, op.table, op.key, op.value, backing, d);
+        }
+
+        if (op.seqno < m_ops.size())
+        {
+            m_ops[op.seqno].require_lock = true;
+            m_ops[op.seqno].lock_acquired = true;
+
+            if (op.type == LOG_ENTRY_TX_READ)
+            {
+                m_ops[op.seqno].timestamp = op.timestamp;
+            }
+            else
+            {
+                m_ops[op.seqno].require_write = true;
+            }
+        }
+    }
+
+    if (!set_batch(seqno, ops.size()))
+    {
+        LOG_IF(INFO, s_debug_mode) << logid() << " batch failed; invariants violated";
+        avoid_commit_if_possible(d);
+        return;
+    }
+}
+
+void
+transaction :: prepare(comm_id id, uint64_t nonce, uint64_t seqno,
+                       const std::vector<e::slice>& tables,
+                       const std::vector<e::slice>& keys,
+                       const std::vector<e::slice>& values,
+                       std::auto_ptr<e::buffer> _backing,
+                       daemon* d)
+{
+    assert(tables.size() == keys.size());
+    assert(keys.size() == values.size());
+    e::compat::shared_ptr<e::buffer> backing(_backing.release());
+    po6::threads::mutex::hold hold(&m_mtx);
+    const uint64_t writes = keys.size();
+    CLIENT_RETURN_IF_EXECUTED(seqno + writes, id, nonce, "prepare");
+
+    if (writes > 0)
+    {
+        for (size_t i = 0; i < writes; ++i)
+        {
+            internal_write("client", seqno + i, tables[i], keys[i], values[i], backing, d);
+        }
+
+        if (!set_batch(seqno, writes))
+        {
+            INVARIANT_VIOLATION("prepare");
+            avoid_commit_if_possible(d);
+            return;
+        }
+
+        for (size_t i = 0; i < writes; ++i)
+        {
+            m_ops[seqno + i].require_lock = true;
+            m_ops[seqno + i].require_write = true;
+        }
+    }
+
+    internal_end_of_transaction("client", "prepare", LOG_ENTRY_TX_PREPARE, seqno + writes, d);
+    m_ops[seqno + writes].set_client(id, nonce);
+    work_state_machine(d);
+}
+
 void
 transaction :: paxos_2a_prepare(uint64_t seqno,
                                 e::unpacker up,
@@ -727,6 +901,8 @@ transaction :: paxos_2a(uint64_t seqno,
             return paxos_2a_read(seqno, up, backing, d);
         case LOG_ENTRY_TX_WRITE:
             return paxos_2a_write(seqno, up, backing, d);
+        case LOG_ENTRY_TX_BATCH:
+            return paxos_2a_batch(seqno, up, backing, d);
         case LOG_ENTRY_TX_PREPARE:
             return paxos_2a_prepare(seqno, up, backing, d);
         case LOG_ENTRY_TX_ABORT:
@@ -745,6 +921,111 @@ transaction :: paxos_2a(uint64_t seqno,
     }
 }
 
+void
+transaction :: replay(uint64_t seqno,
+                      log_entry_t t,
+                      e::unpacker up,
+                      std::auto_ptr<e::buffer> _backing,
+                      daemon* d)
+{
+    assert(is_paxos_2a_log_entry(t));
+    e::compat::shared_ptr<e::buffer> backing(_backing.release());
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    // mirrors the paxos 2a handlers, but leaves work_state_machine to the
+    // caller because replay happens before the network is up
+    switch (t)
+    {
+        case LOG_ENTRY_TX_BEGIN:
+        {
+            uint64_t timestamp;
+            std::vector<paxos_group_id> dcs;
+            up = up >> timestamp >> dcs;
+            const paxos_group* group = d->get_config()->get_group(m_tg.group);
+
+            if (seqno != 0 || up.error() || up.remain() || !group)
+            {
+                UNPACK_ERROR("replay::begin");
+                avoid_commit_if_possible(d);
+                return;
+            }
+
+            internal_begin("replay", timestamp, *group, dcs, d);
+            break;
+        }
+        case LOG_ENTRY_TX_READ:
+        {
+            e::slice table;
+            e::slice key;
+            uint64_t timestamp;
+            up = up >> table >> key >> timestamp;
+
+            if (up.error() || up.remain())
+            {
+                UNPACK_ERROR("replay::read");
+                avoid_commit_if_possible(d);
+                return;
+            }
+
+            internal_read("replay", seqno, table, key, backing, d);
+            m_ops[seqno].require_lock = true;
+            m_ops[seqno].lock_acquired = true;
+            m_ops[seqno].timestamp = timestamp;
+            break;
+        }
+        case LOG_ENTRY_TX_WRITE:
+        {
+            e::slice table;
+            e::slice key;
+            e::slice value;
+            up = up >> table >> key >> value;
+
+            if (up.error() || up.remain())
+            {
+                UNPACK_ERROR("replay::write");
+                avoid_commit_if_possible(d);
+                return;
+            }
+
+            internal_write("replay", seqno, table, key, value, backing, d);
+            m_ops[seqno].require_lock = true;
+            m_ops[seqno].lock_acquired = true;
+            m_ops[seqno].require_write = true;
+            break;
+        }
+        case LOG_ENTRY_TX_BATCH:
+            internal_batch("replay", seqno, up, backing, d);
+            break;
+        case LOG_ENTRY_TX_PREPARE:
+            internal_end_of_transaction("replay", "prepare", LOG_ENTRY_TX_PREPARE, seqno, d);
+            break;
+        case LOG_ENTRY_TX_ABORT:
+            internal_end_of_transaction("replay", "abort", LOG_ENTRY_TX_ABORT, seqno, d);
+            break;
+        case LOG_ENTRY_LOCAL_VOTE_1A:
+        case LOG_ENTRY_LOCAL_VOTE_2A:
+        case LOG_ENTRY_LOCAL_LEARN:
+        case LOG_ENTRY_GLOBAL_PROPOSE:
+        case LOG_ENTRY_GLOBAL_VOTE_1A:
+        case LOG_ENTRY_GLOBAL_VOTE_2A:
+        case LOG_ENTRY_GLOBAL_VOTE_2B:
+        case LOG_ENTRY_CONFIG:
+        case LOG_ENTRY_NOP:
+        default:
+            ::abort();
+    }
+
+    if (seqno >= m_ops.size())
+    {
+        return;
+    }
+
+    // the entry came from our own log, so it is already durable here
+    m_ops[seqno].log_write_issued = true;
+    m_ops[seqno].log_write_durable = true;
+    internal_paxos_2b(d->m_us.id, seqno, d);
+}
+
 void
 transaction :: paxos_2b(comm_id id, uint64_t seqno, daemon* d)
 {
@@ -855,6 +1136,7 @@ transaction :: commit_record(e::slice commit_record, std::auto_ptr<e::buffer> _b
             case LOG_ENTRY_TX_PREPARE:
                 commit_record_prepare(seqno, eup, backing, d);
                 break;
+            case LOG_ENTRY_TX_BATCH:
             case LOG_ENTRY_TX_ABORT:
             case LOG_ENTRY_CONFIG:
             case LOG_ENTRY_LOCAL_VOTE_1A:
@@ -1117,34 +1399,20 @@ transaction :: work_state_machine_executing(daemon* d)
 {
     size_t done = 0;
 
-    for (size_t i = 0; i < m_ops.size(); ++i)
+    // a batch becomes durable as a unit once every operation in it has
+    // executed; its durability is tracked on its first operation
+    for (size_t i = 0; i < m_ops.size(); i = batch_end(i))
     {
-        if (m_ops[i].type == LOG_ENTRY_NOP)
-        {
-            continue;
-        }
+        const size_t end = batch_end(i);
+        bool executed = true;
 
-        if (m_ops[i].require_lock && !m_ops[i].lock_acquired)
+        for (size_t j = i; j < end; ++j)
         {
-            acquire_lock(i, d);
-            continue;
-        }
-
-        if (m_ops[i].require_read && !m_ops[i].read_done)
-        {
-            start_read(i, d);
-            continue;
-        }
-
-        if (m_ops[i].require_verify_read && !m_ops[i].verify_read_done)
-        {
-            start_verify_read(i, d);
-            continue;
+            executed = execute(j, d) && executed;
         }
 
-        if (m_ops[i].require_verify_write && !m_ops[i].verify_write_done)
+        if (!executed)
         {
-            start_verify_write(i, d);
             continue;
         }
 
@@ -1167,12 +1435,16 @@ transaction :: work_state_machine_executing(daemon* d)
             continue;
         }
 
-        if (m_ops[i].client != comm_id())
+        if (m_ops[i].client != comm_id() && m_ops[i].batch_end != 0)
+        {
+            send_tx_batch(i, d);
+        }
+        else if (m_ops[i].client != comm_id())
         {
             send_response(&m_ops[i], d);
         }
 
-        ++done;
+        done += end - i;
     }
 
     if (done == m_ops.size() && !m_ops.empty() &&
@@ -1200,7 +1472,7 @@ transaction :: work_state_machine_executing(daemon* d)
 void
 transaction :: work_state_machine_local_commit_vote(daemon* d)
 {
-    for (size_t i = 0; i < m_ops.size(); ++i)
+    for (size_t i = 0; i < m_ops.size(); i = batch_end(i))
     {
         if (m_ops[i].type == LOG_ENTRY_NOP)
         {
@@ -1289,20 +1561,9 @@ transaction :: work_state_machine_global_commit_vote(daemon* d)
 
     if (undecided_sz > 0)
     {
+        // most passes find nothing due for a resend; only build the commit
+        // record when one is
         std::string commit_record;
-        e::packer pa(&commit_record);
-
-        for (size_t i = 0; i < m_ops.size(); ++i)
-        {
-            if (m_ops[i].type == LOG_ENTRY_NOP)
-            {
-                continue;
-            }
-
-            std::string log_entry = generate_log_entry(i);
-            pa = pa << e::slice(log_entry);
-        }
-
         const configuration* c = d->get_config();
         const uint64_t now = po6::monotonic_time();
 
@@ -1328,6 +1589,11 @@ transaction :: work_state_machine_global_commit_vote(daemon* d)
                 if (c->get_state(g->members[j]) == txman_state::ONLINE &&
                     m_dcs_timestamps[idx] + d->resend_interval() < now)
                 {
+                    if (commit_record.empty())
+                    {
+                        commit_record = generate_commit_record();
+                    }
+
                     transaction_group tg(g->id, m_tg.txid);
                     const size_t sz = BUSYBEE_HEADER_SIZE
                                     + pack_size(COMMIT_RECORD)
@@ -1338,6 +1604,7 @@ transaction :: work_state_machine_global_commit_vote(daemon* d)
                         << COMMIT_RECORD << tg << e::slice(commit_record);
                     d->send(g->members[j], msg);
                     m_dcs_timestamps[idx] = now;
+                    schedule_wakeup(now, d);
                     break;
                 }
             }
@@ -1456,6 +1723,52 @@ transaction :: work_state_machine_aborted(daemon* d)
     }
 }
 
+bool
+transaction :: execute(uint64_t seqno, daemon* d)
+{
+    operation& op(m_ops[seqno]);
+
+    if (op.type == LOG_ENTRY_NOP)
+    {
+        return false;
+    }
+
+    if (op.require_lock && !op.lock_acquired)
+    {
+        acquire_lock(seqno, d);
+        return false;
+    }
+
+    if (op.require_read && !op.read_done)
+    {
+        start_read(seqno, d);
+        return false;
+    }
+
+    if (op.require_verify_read && !op.verify_read_done)
+    {
+        start_verify_read(seqno, d);
+        return false;
+    }
+
+    if (op.require_verify_write && !op.verify_write_done)
+    {
+        start_verify_write(seqno, d);
+        return false;
+    }
+
+    return true;
+}
+
+void
+transaction :: expire(daemon* d)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    LOG(WARNING) << logid() << " unresolved since " << m_init_timestamp
+                 << "; no longer holding back the low water mark";
+    avoid_commit_if_possible(d);
+}
+
 void
 transaction :: avoid_commit_if_possible(daemon* d)
 {
@@ -1512,6 +1825,49 @@ transaction :: resize_to_hold(uint64_t seqno)
     return true;
 }
 
+bool
+transaction :: set_batch(uint64_t seqno, uint64_t count)
+{
+    if (count == 0 || !resize_to_hold(seqno + count - 1))
+    {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < seqno; i = batch_end(i))
+    {
+        if (i + 1 < batch_end(i) && batch_end(i) > seqno)
+        {
+            return false;
+        }
+    }
+
+    const uint64_t end = seqno + count;
+
+    if (m_ops[seqno].batch_end != 0 && m_ops[seqno].batch_end != end)
+    {
+        return false;
+    }
+
+    for (uint64_t i = seqno + 1; i < end; ++i)
+    {
+        if (m_ops[i].batch_end != 0)
+        {
+            return false;
+        }
+    }
+
+    m_ops[seqno].batch_end = end;
+    return true;
+}
+
+uint64_t
+transaction :: batch_end(uint64_t seqno)
+{
+    assert(seqno < m_ops.size());
+    const uint64_t end = m_ops[seqno].batch_end;
+    return end > seqno + 1 ? std::min(end, uint64_t(m_ops.size())) : seqno + 1;
+}
+
 void
 transaction :: acquire_lock(uint64_t seqno, daemon* d)
 {
@@ -1725,6 +2081,29 @@ transaction :: cancel_write(uint64_t seqno, daemon* d)
 
 std::string
 transaction :: generate_log_entry(uint64_t seqno)
+{
+    assert(seqno < m_ops.size());
+
+    if (m_ops[seqno].batch_end == 0)
+    {
+        return generate_op_log_entry(seqno);
+    }
+
+    std::string entry;
+    e::packer pa(&entry);
+    pa = pa << LOG_ENTRY_TX_BATCH << m_tg << seqno;
+
+    for (uint64_t i = seqno; i < batch_end(seqno); ++i)
+    {
+        std::string op_entry = generate_op_log_entry(i);
+        pa = pa << e::slice(op_entry);
+    }
+
+    return entry;
+}
+
+std::string
+transaction :: generate_op_log_entry(uint64_t seqno)
 {
     assert(seqno < m_ops.size());
     std::string entry;
@@ -1749,6 +2128,7 @@ transaction :: generate_log_entry(uint64_t seqno)
         case LOG_ENTRY_TX_ABORT:
             pa << LOG_ENTRY_TX_ABORT << m_tg << seqno;
             break;
+        case LOG_ENTRY_TX_BATCH:
         case LOG_ENTRY_LOCAL_VOTE_1A:
         case LOG_ENTRY_LOCAL_VOTE_2A:
         case LOG_ENTRY_LOCAL_LEARN:
@@ -1765,16 +2145,36 @@ transaction :: generate_log_entry(uint64_t seqno)
     return entry;
 }
 
+std::string
+transaction :: generate_commit_record()
+{
+    std::string commit_record;
+    e::packer pa(&commit_record);
+
+    for (size_t i = 0; i < m_ops.size(); ++i)
+    {
+        if (m_ops[i].type == LOG_ENTRY_NOP)
+        {
+            continue;
+        }
+
+        std::string log_entry = generate_op_log_entry(i);
+        pa = pa << e::slice(log_entry);
+    }
+
+    return commit_record;
+}
+
 void
 transaction :: record_commit(daemon* d)
 {
-    d->m_dispositions.put(m_tg, CONSUS_VOTE_COMMIT);
+    d->record_disposition(m_tg, CONSUS_VOTE_COMMIT);
 }
 
 void
 transaction :: record_abort(daemon* d)
 {
-    d->m_dispositions.put(m_tg, CONSUS_VOTE_ABORT);
+    d->record_disposition(m_tg, CONSUS_VOTE_ABORT);
 }
 
 void
@@ -1818,6 +2218,7 @@ transaction :: send_response(operation* op, daemon* d)
         case LOG_ENTRY_TX_ABORT:
 			// only sent after a vote
             return;
+        case LOG_ENTRY_TX_BATCH:
         case LOG_ENTRY_LOCAL_VOTE_1A:
         case LOG_ENTRY_LOCAL_VOTE_2A:
         case LOG_ENTRY_LOCAL_LEARN:
@@ -1934,6 +2335,46 @@ transaction :: send_tx_write(operation* op, daemon* d)
     op->client = comm_id();
 }
 
+void
+transaction :: send_tx_batch(uint64_t seqno, daemon* d)
+{
+    operation* op = &m_ops[seqno];
+    assert(op->client != comm_id());
+    const uint64_t end = batch_end(seqno);
+
+    // writes get the same response as a single write
+    if (op->type != LOG_ENTRY_TX_READ)
+    {
+        return send_tx_write(op, d);
+    }
+
+    size_t sz = BUSYBEE_HEADER_SIZE
+              + pack_size(CLIENT_RESPONSE)
+              + sizeof(uint64_t)
+              + pack_size(CONSUS_SUCCESS)
+              + VARINT_64_MAX_SIZE;
+
+    for (uint64_t i = seqno; i < end; ++i)
+    {
+        sz += pack_size(m_ops[i].rc)
+            + sizeof(uint64_t)
+            + pack_size(m_ops[i].value);
+    }
+
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::packer pa = msg->pack_at(BUSYBEE_HEADER_SIZE);
+    pa = pa << CLIENT_RESPONSE << op->nonce << CONSUS_SUCCESS
+            << e::pack_varint(end - seqno);
+
+    for (uint64_t i = seqno; i < end; ++i)
+    {
+        pa = pa << m_ops[i].rc << m_ops[i].timestamp << m_ops[i].value;
+    }
+
+    d->send(op->client, msg);
+    op->client = comm_id();
+}
+
 void
 transaction :: send_tx_commit(daemon* d)
 {
@@ -1986,6 +2427,7 @@ transaction :: send_to_group(std::auto_ptr<e::buffer> msg, uint64_t timestamps[C
         std::auto_ptr<e::buffer> m(msg->copy());
         d->send(m_group.members[i], m);
         timestamps[i] = now;
+        schedule_wakeup(now, d);
     }
 }
 
@@ -2011,9 +2453,17 @@ transaction :: send_to_nondurable(uint64_t seqno, std::auto_ptr<e::buffer> msg,
         std::auto_ptr<e::buffer> m(msg->copy());
         d->send(m_group.members[i], m);
         timestamps[i] = now;
+        schedule_wakeup(now, d);
     }
 }
 
+void
+transaction :: schedule_wakeup(uint64_t now, daemon* d)
+{
+    const uint64_t when = now + d->resend_interval() + 1;
+    m_wakeup.no_earlier_than(d, daemon::PUMP_TRANSACTION, m_tg, when);
+}
+
 std::ostream&
 consus :: operator << (std::ostream& lhs, const transaction::state_t& rhs)
 {
@@ -28,11 +28,15 @@
 #ifndef consus_txman_transaction_h_
 #define consus_txman_transaction_h_
 
+// STL
+#include <vector>
+
 // consus
 #include <consus.h>
 #include "namespace.h"
 #include "common/consus.h"
 #include "common/ids.h"
+#include "common/timer_wheel.h"
 #include "common/transaction_id.h"
 #include "common/transaction_group.h"
 #include "txman/log_entry_t.h"
@@ -81,12 +85,36 @@ class transaction
                    const e::slice& value,
                    std::auto_ptr<e::buffer> backing,
                    daemon* d);
-        void prepare(comm_id id, uint64_t nonce, uint64_t seqno, daemon* d);
+        // a batch of operations in consecutive slots starting at "seqno";
+        // they are logged and replicated as one LOG_ENTRY_TX_BATCH and the
+        // client gets one response once all of them are durable
+        void multi_read(comm_id id, uint64_t nonce, uint64_t seqno,
+                        const e::slice& table,
+                        const std::vector<e::slice>& keys,
+                        std::auto_ptr<e::buffer> backing,
+                        daemon* d);
+        void multi_write(comm_id id, uint64_t nonce, uint64_t seqno,
+                         const e::slice& table,
+                         const std::vector<e::slice>& keys,
+                         const std::vector<e::slice>& values,
+                         std::auto_ptr<e::buffer> backing,
+                         daemon* d);
+        // writes the client buffered until commit occupy the slots before
+        // the prepare, starting at "seqno", and form one batch
+        void prepare(comm_id id, uint64_t nonce, uint64_t seqno,
+                     const std::vector<e::slice>& tables,
+                     const std::vector<e::slice>& keys,
+                     const std::vector<e::slice>& values,
+                     std::auto_ptr<e::buffer> backing,
+                     daemon* d);
         void abort(comm_id id, uint64_t nonce, uint64_t seqno, daemon* d);
 
     public:
         void paxos_2a(uint64_t seqno, log_entry_t t, e::unpacker up,
                       std::auto_ptr<e::buffer> backing, daemon* d);
+        // rebuild state from this server's own durable log; sends nothing
+        void replay(uint64_t seqno, log_entry_t t, e::unpacker up,
+                    std::auto_ptr<e::buffer> backing, daemon* d);
         void paxos_2b(comm_id id, uint64_t seqno, daemon* d);
         void commit_record(e::slice commit_record,
                            std::auto_ptr<e::buffer> _backing,
@@ -104,6 +132,9 @@ class transaction
         void callback_verify_write(consus_returncode rc, uint64_t timestamp, const e::slice& value,
                                    uint64_t seqno, daemon*d);
 
+        // the group has been unresolved too long to hold back garbage
+        // collection; steer it to abort
+        void expire(daemon* d);
         void externally_work_state_machine(daemon* d);
         std::string debug_dump();
         std::string logid();
@@ -120,6 +151,8 @@ class transaction
                            std::auto_ptr<e::buffer> backing, daemon* d);
         void paxos_2a_write(uint64_t seqno, e::unpacker up,
                             std::auto_ptr<e::buffer> backing, daemon* d);
+        void paxos_2a_batch(uint64_t seqno, e::unpacker up,
+                            std::auto_ptr<e::buffer> backing, daemon* d);
         void paxos_2a_prepare(uint64_t seqno, e::unpacker up,
                               std::auto_ptr<e::buffer> backing, daemon* d);
         void paxos_2a_abort(uint64_t seqno, e::unpacker up,
@@ -147,6 +180,10 @@ class transaction
                             const e::slice& value,
                             e::compat::shared_ptr<e::buffer> backing,
                             daemon* d);
+        void internal_batch(const char* source, uint64_t seqno,
+                            e::unpacker up,
+                            e::compat::shared_ptr<e::buffer> backing,
+                            daemon* d);
         void internal_end_of_transaction(const char* source,
                                          const char* op,
                                          log_entry_t let,
@@ -162,9 +199,13 @@ class transaction
         void work_state_machine_aborted(daemon* d);
 
         // execution utils
+        bool execute(uint64_t seqno, daemon* d);
         void avoid_commit_if_possible(daemon* d);
         bool is_durable(uint64_t seqno);
         bool resize_to_hold(uint64_t seqno);
+        bool set_batch(uint64_t seqno, uint64_t count);
+        // one past the last slot of the batch starting at "seqno"
+        uint64_t batch_end(uint64_t seqno);
 
         // key value store utils
         void acquire_lock(uint64_t seqno, daemon* d);
@@ -176,6 +217,8 @@ class transaction
 
         // inter-data center
         std::string generate_log_entry(uint64_t seqno);
+        std::string generate_op_log_entry(uint64_t seqno);
+        std::string generate_commit_record();
 
         // commit
         void record_commit(daemon* d);
@@ -192,10 +235,14 @@ class transaction
         void send_tx_begin(operation* op, daemon* d);
         void send_tx_read(operation* op, daemon* d);
         void send_tx_write(operation* op, daemon* d);
+        void send_tx_batch(uint64_t seqno, daemon* d);
         void send_tx_commit(daemon* d);
         void send_tx_abort(daemon* d);
         void send_to_group(std::auto_ptr<e::buffer> msg, uint64_t timestamps[CONSUS_MAX_REPLICATION_FACTOR], daemon* d);
         void send_to_nondurable(uint64_t seqno, std::auto_ptr<e::buffer> msg, uint64_t timestamps[CONSUS_MAX_REPLICATION_FACTOR], daemon* d);
+        // ask the daemon to pump this transaction once a request sent at
+        // "now" may be resent
+        void schedule_wakeup(uint64_t now, daemon* d);
 
     private:
         const transaction_group m_tg;
@@ -211,6 +258,7 @@ class transaction
         bool m_prefer_to_commit;
         std::vector<operation> m_ops;
         std::vector<std::pair<comm_id, uint64_t> > m_deferred_2b;
+        pump_wakeup m_wakeup;
 
     private:
         transaction(const transaction&);